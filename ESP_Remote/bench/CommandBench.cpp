@@ -0,0 +1,709 @@
+// Command ingest-to-IR benchmark. Replaces main.cpp/App.cpp in the `bench`
+// (ESP32) and `bench-native` (host) environments: setup() feeds canned MQTT
+// commands through the same steps as handleMqttMessage() and prints one JSON
+// line per case, prefixed "[BENCH] ":
+//
+//   ingest_us   parse + route + handleCommand + state serialize (p50/p99)
+//   edge_us     message in -> IR task starts the first frame (p50/p99)
+//   allocs      heap allocations during ingest (mean/max per command)
+//   arena_*     JsonArena allocations and heap fallbacks per command
+//   stack_peak  bytes of the bench task's stack used by the case
+//   cmds_per_s  sustained rate with commands back to back, frames on air
+//
+// The "payload" lines replay messages recorded from the Android app, each on
+// its own topic:
+//
+//   parse_us             deserializeJson() into the message arena (p50/p99)
+//   parse_allocs_max     heap allocations of that parse
+//   first_ingest_allocs  heap allocations of the first whole ingest, which
+//                        also stores a learned code the message carries
+//   ingest_allocs_max    the same for the repeats of the message
+//
+// On the ESP32, the "ac_memo" lines then compare, for every
+// AcController::kModels remote, IRac encoding a state against an
+// AcFrameMemo hit for it. The host IRac does not encode, so there is nothing
+// to compare there:
+//
+//   encode_us   IRac::sendAc() call -> first IR edge (p50)
+//   hit_ns      AcFrameMemo::find() for a stored state (mean); absent when
+//               the frames were not memoized
+//   frame_bytes RMT symbols kept for both states
+//
+// Broker publish and Wi-Fi are left out. Timing uses micros(), which is
+// esp_timer_get_time() on the ESP32 core. Percentiles are nearest-rank.
+//
+//   pio run -e bench-native
+//   .pio/build/bench-native/program --run-ms 0 | grep '^\[BENCH\]'
+//   pio run -e bench -t upload && pio device monitor
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <IRac.h>
+#include <IRutils.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "AcFrameMemo.h"
+#include "CommandBatch.h"
+#include "Config.h"
+#include "DeviceManager.h"
+#include "IrPinRecorder.h"
+#include "IrTransmitter.h"
+#include "JsonArena.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "devices/AcController.h"
+#include "devices/DvdController.h"
+#include "devices/FanController.h"
+#include "devices/ProjectorController.h"
+#include "devices/StbController.h"
+#include "devices/TvController.h"
+
+#ifndef ESP_PLATFORM
+#include <NativeSim.h>
+#endif
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 100
+#endif
+
+namespace {
+
+// Only allocations made by the bench task while it is inside ingest() count.
+thread_local bool countAllocations = false;
+std::atomic<uint32_t> allocationCount{0};
+
+}  // namespace
+
+#ifdef ESP_PLATFORM
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see the
+// `bench` env); operator new and String both end up here.
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  if (countAllocations) ++allocationCount;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  if (countAllocations) ++allocationCount;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  if (countAllocations) ++allocationCount;
+  return __real_realloc(ptr, size);
+}
+}
+#else
+// The host String is std::string, so operator new sees every allocation the
+// firmware makes; JsonArena heap fallbacks are reported separately.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(size_t size) {
+  if (countAllocations) ++allocationCount;
+  if (void *ptr = malloc(size != 0 ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+#pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+constexpr size_t kIterations = BENCH_ITERATIONS;
+// Same as the network task, where MQTT callbacks run on the device.
+constexpr uint32_t kBenchStackBytes = NET_TASK_STACK_BYTES;
+constexpr UBaseType_t kBenchPriority = 1;
+// Quiet time after the last frame so the next command starts on an idle
+// transmitter; channel digits leave 120 ms (kChannelGapMs) behind them.
+constexpr uint32_t kSettleMs = 50;
+constexpr uint32_t kChannelSettleMs = 130;
+constexpr uint32_t kFrameTimeoutMs = 2000;
+// Back-to-back commands wait for this much queue space (longest channel).
+constexpr uint16_t kMaxFramesPerCommand = 4;
+// Recorded payloads are parsed kIterations times but ingested only this
+// often: their IR frames go on air.
+constexpr size_t kPayloadIngests = 5;
+// IRac sends every encode on air on the ESP32, so few of them per state.
+constexpr size_t kAcMemoEncodes = 5;
+constexpr size_t kAcMemoLookups = 1000;
+
+const String kNodeTopicPrefix = String("iot/nodes/") + NODE_ID + "/";
+
+IrTransmitter irTransmitter(IR_LED_PIN);
+AcController acController(NODE_ID, irTransmitter);
+FanController fanController(NODE_ID, irTransmitter);
+TvController tvController(NODE_ID, irTransmitter);
+StbController stbController(NODE_ID, irTransmitter);
+DvdController dvdController(NODE_ID, irTransmitter);
+ProjectorController projectorController(NODE_ID, irTransmitter);
+DeviceManager deviceManager;
+
+alignas(8) uint8_t messageArenaBuffer[MQTT_JSON_ARENA_BYTES];
+JsonArena messageArena(messageArenaBuffer, sizeof(messageArenaBuffer));
+
+struct BenchCase {
+  const char *name;
+  const char *device;       // topic is <prefix><device>/cmd
+  const char *warmup;       // sent once before measuring; nullptr = payloads[0]
+  const char *const *payloads;  // rotated through
+  size_t payloadCount;
+  size_t iterations;
+  uint32_t settleMs;
+};
+
+constexpr const char *kTvKey[] = {
+    R"({"cmd":"key","key":"VOLUME_UP","brand":"LG","type":"TV","index":1})",
+};
+// Android-side names that go through the alias table.
+constexpr const char *kTvKeyAlias[] = {
+    R"({"cmd":"key","key":"CHANNEL_UP","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"key","key":"volume_down","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"key","key":"SOURCE","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"key","key":"MORE_INFO","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"key","key":"Confirm","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"key","key":"SETTINGS","brand":"LG","type":"TV","index":1})",
+};
+// Four presses in one message; the remote is the one tv_key selected.
+constexpr const char *kTvBatch[] = {
+    R"({"cmd":"batch","steps":[{"key":"VOLUME_UP","repeat":3},"MUTE"]})",
+};
+constexpr const char *kTvChannel[] = {
+    R"({"cmd":"channel","channel":"7","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"channel","channel":"12","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"channel","channel":"123","brand":"LG","type":"TV","index":1})",
+    R"({"cmd":"channel","channel":104,"brand":"LG","type":"TV","index":1})",
+};
+constexpr const char *kStbChannel[] = {
+    R"({"cmd":"channel","channel":"5","brand":"Samsung","type":"STB","index":1})",
+    R"({"cmd":"channel","channel":"48","brand":"Samsung","type":"STB","index":1})",
+    R"({"cmd":"channel","channel":"506","brand":"Samsung","type":"STB","index":1})",
+};
+// "flush" skips the coalescing window, so every command sends its own frame.
+constexpr const char *kAcSet[] = {
+    R"({"cmd":"set","power":true,"mode":"cool","temp":24,"fan":"auto","swing":false,"brand":"Daikin","index":1,"flush":true})",
+    R"({"cmd":"set","power":true,"mode":"cool","temp":25,"fan":"high","swing":true,"brand":"Daikin","index":1,"flush":true})",
+    R"({"cmd":"set","power":true,"mode":"dry","temp":26,"fan":"low","swing":false,"brand":"Daikin","index":1,"flush":true})",
+};
+// A 280-bit Daikin frame: learned once, then replayed by name.
+constexpr const char *kAcLearnedWarmup =
+    R"({"cmd":"key","key":"BENCH_LEARNED","ir":{"protocol":"DAIKIN","bits":280,)"
+    R"("code":"11DA2700C50000D711DA27004200005411DA270009303C0060000006600000C300008D"}})";
+constexpr const char *kAcLearned[] = {
+    R"({"cmd":"key","key":"BENCH_LEARNED"})",
+};
+constexpr const char *kFanKey[] = {
+    R"({"cmd":"key","key":"SPEED_UP","brand":"LG","type":"FAN","index":1})",
+    R"({"cmd":"key","key":"SWING","brand":"LG","type":"FAN","index":1})",
+};
+constexpr const char *kDvdKey[] = {
+    R"({"cmd":"key","key":"PLAY_PAUSE","brand":"LG","type":"DVD","index":1})",
+    R"({"cmd":"key","key":"STOP","brand":"LG","type":"DVD","index":1})",
+};
+constexpr const char *kProjectorKey[] = {
+    R"({"cmd":"key","key":"MENU","brand":"InFocus","type":"PROJECTOR","index":1})",
+    R"({"cmd":"key","key":"POWER","brand":"InFocus","type":"PROJECTOR","index":1})",
+};
+
+// Recorded from the Android app (org.json keeps insertion order), one per
+// screen and command shape, with the topic it publishes on. Learned codes are
+// what the node's ir/learn result returned for the key.
+struct RecordedPayload {
+  const char *name;
+  const char *topicSuffix;
+  const char *json;
+};
+
+const RecordedPayload kRecordedPayloads[] = {
+    {"tv_key", "tv/cmd",
+     R"({"cmd":"key","brand":"LG","type":"TV","index":1,"key":"VOL_UP"})"},
+    {"tv_key_learned", "tv/cmd",
+     R"({"cmd":"key","brand":"LG","type":"TV","index":1,"key":"NETFLIX",)"
+     R"("ir":{"protocol":"NEC","code":"20DF6A95","bits":32}})"},
+    {"tv_channel", "tv/cmd",
+     R"({"cmd":"channel","brand":"LG","type":"TV","index":1,)"
+     R"("channel":"105"})"},
+    {"stb_key", "stb/cmd",
+     R"({"cmd":"key","brand":"Samsung","type":"STB","index":1,"key":"OK"})"},
+    {"dvd_key", "dvd/cmd",
+     R"({"cmd":"key","device":"dvd","brand":"LG","type":"DVD","index":1,)"
+     R"("key":"PLAY_PAUSE"})"},
+    {"projector_key", "projector/cmd",
+     R"({"cmd":"key","device":"projector","brand":"InFocus",)"
+     R"("type":"PROJECTOR","index":1,"key":"MENU"})"},
+    {"fan_key", "fan/cmd",
+     R"({"cmd":"key","brand":"LG","type":"FAN","index":1,)"
+     R"("key":"SPEED_UP"})"},
+    {"fan_learned", "commands",
+     R"({"device":"fan","cmd":"key","key":"SWING",)"
+     R"("ir":{"protocol":"NEC","code":"FF9867","bits":32}})"},
+    {"ac_power", "ir/test",
+     R"({"cmd":"power","value":true,"brand":"Daikin","type":"AC",)"
+     R"("index":1})"},
+    {"ac_set", "ir/test",
+     R"({"cmd":"set","brand":"Daikin","type":"AC","index":1,"temp":24,)"
+     R"("mode":"cool","fan":"auto"})"},
+    {"ac_learned", "commands",
+     R"({"device":"ac","cmd":"key","key":"POWER_ON","ir":{"protocol":)"
+     R"("DAIKIN","code":"11DA2700C50000D711DA27004200005411DA270009303C)"
+     R"(0060000006600000C300008D","bits":280}})"},
+};
+
+template <size_t N>
+constexpr size_t countOf(const char *const (&)[N]) {
+  return N;
+}
+
+// Channel cases are bound by digit gaps on air, so they run fewer commands.
+const BenchCase kCases[] = {
+    {"tv_key", "tv", nullptr, kTvKey, countOf(kTvKey), kIterations, kSettleMs},
+    {"tv_key_alias", "tv", nullptr, kTvKeyAlias, countOf(kTvKeyAlias),
+     kIterations, kSettleMs},
+    {"tv_batch", "tv", nullptr, kTvBatch, countOf(kTvBatch), kIterations,
+     kSettleMs},
+    {"tv_channel", "tv", nullptr, kTvChannel, countOf(kTvChannel),
+     kIterations / 4, kChannelSettleMs},
+    {"stb_channel", "stb", nullptr, kStbChannel, countOf(kStbChannel),
+     kIterations / 4, kChannelSettleMs},
+    {"ac_set", "ac", nullptr, kAcSet, countOf(kAcSet), kIterations, kSettleMs},
+    {"ac_learned_raw", "ac", kAcLearnedWarmup, kAcLearned, countOf(kAcLearned),
+     kIterations, kSettleMs},
+    {"fan_key", "fan", nullptr, kFanKey, countOf(kFanKey), kIterations,
+     kSettleMs},
+    {"dvd_key", "dvd", nullptr, kDvdKey, countOf(kDvdKey), kIterations,
+     kSettleMs},
+    {"projector_key", "projector", nullptr, kProjectorKey,
+     countOf(kProjectorKey), kIterations, kSettleMs},
+};
+
+struct CaseResult {
+  size_t n = 0;
+  size_t failures = 0;  // commands that were rejected or put nothing on air
+  uint32_t ingestP50Us = 0;
+  uint32_t ingestP99Us = 0;
+  uint32_t edgeP50Us = 0;
+  uint32_t edgeP99Us = 0;
+  float allocsMean = 0;
+  uint32_t allocsMax = 0;
+  float arenaAllocsMean = 0;
+  uint32_t arenaFallbacks = 0;
+  uint32_t stackPeak = 0;
+  float cmdsPerS = 0;
+  uint32_t dropped = 0;
+  uint32_t txStackFree = 0;
+};
+
+struct CaseRun {
+  const BenchCase *bench;
+  QueueHandle_t done;
+};
+
+// Same steps as App.cpp handleMqttMessage(), minus logging, tracing and the
+// publish.
+bool ingest(const char *topic, const char *json, size_t length) {
+  const uint32_t receivedUs = micros();
+  JsonDocument doc(&messageArena);
+  if (deserializeJson(doc, json, length)) return false;
+
+  const TopicMatch match = deviceManager.route(topic);
+  if (match.route != TopicRoute::kCommand) return false;
+
+  DeviceController *controller = match.controller;
+  const char *device = doc["device"].as<const char *>();
+  if (device != nullptr && device[0] != '\0' &&
+      strcasecmp(device, "null") != 0) {
+    controller = deviceManager.find(device);
+  }
+  const char *command = doc["cmd"].as<const char *>();
+  if (command != nullptr && strcasecmp(command, "batch") == 0) {
+    JsonDocument stateDoc(&messageArena);
+    CommandBatch::Result result;
+    CommandBatch::run(doc.as<JsonObjectConst>(), controller, deviceManager,
+                      irTransmitter, stateDoc, result);
+    return result.error == nullptr;
+  }
+  if (controller == nullptr) return false;
+
+  JsonDocument stateDoc(&messageArena);
+  const uint32_t framesBefore = irTransmitter.enqueued();
+  const bool changed =
+      controller->handleCommand(doc.as<JsonObjectConst>(), stateDoc);
+  Metrics::DeviceCounters &counters = controller->metrics();
+  ++counters.commands;
+  counters.irFrames += irTransmitter.enqueued() - framesBefore;
+  counters.commandUs.record(micros() - receivedUs);
+  if (changed && strcmp(controller->deviceType(), "ac") == 0) {
+    JsonDocument message(&messageArena);
+    if (controller->stateTracker().update(stateDoc.as<JsonObjectConst>(),
+                                          false, STATE_PUBLISH_DELTAS,
+                                          message) !=
+        StateTracker::Publish::kNothing) {
+      char buffer[256];
+      if (serializeJson(message, buffer, sizeof(buffer)) == 0) return false;
+    }
+  }
+  return true;
+}
+
+bool waitForSent(uint32_t sent) {
+  const uint32_t startedAt = millis();
+  while (irTransmitter.stats().sent < sent) {
+    if (millis() - startedAt > kFrameTimeoutMs) return false;
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+uint32_t percentile(std::vector<uint32_t> &samples, uint8_t p) {
+  if (samples.empty()) return 0;
+  std::sort(samples.begin(), samples.end());
+  size_t rank = (samples.size() * p + 99) / 100;
+  if (rank == 0) rank = 1;
+  return samples[rank - 1];
+}
+
+void dropRecordedFrames() {
+#ifndef ESP_PLATFORM
+  NativeSim::takeIrFrames();  // the host recorder would keep every frame
+#endif
+}
+
+void runCase(const BenchCase &bench, CaseResult &result) {
+  const String topic = kNodeTopicPrefix + bench.device + "/cmd";
+  const char *warmup = bench.warmup != nullptr ? bench.warmup : bench.payloads[0];
+  ingest(topic.c_str(), warmup, strlen(warmup));
+  waitForSent(irTransmitter.stats().enqueued);
+  delay(bench.settleMs);
+  dropRecordedFrames();
+
+  std::vector<uint32_t> ingestUs;
+  std::vector<uint32_t> edgeUs;
+  ingestUs.reserve(bench.iterations);
+  edgeUs.reserve(bench.iterations);
+  uint64_t allocTotal = 0;
+  const JsonArena::Stats arenaBefore = messageArena.stats();
+
+  // Latency: one command at a time on an idle transmitter.
+  for (size_t i = 0; i < bench.iterations; ++i) {
+    const char *payload = bench.payloads[i % bench.payloadCount];
+    const size_t length = strlen(payload);
+    const IrTransmitter::Stats before = irTransmitter.stats();
+
+    allocationCount = 0;
+    countAllocations = true;
+    const uint32_t t0 = micros();
+    const bool accepted = ingest(topic.c_str(), payload, length);
+    const uint32_t t1 = micros();
+    countAllocations = false;
+
+    const uint32_t allocs = allocationCount;
+    allocTotal += allocs;
+    result.allocsMax = std::max(result.allocsMax, allocs);
+    ingestUs.push_back(t1 - t0);
+
+    const IrTransmitter::Stats queued = irTransmitter.stats();
+    if (!accepted || queued.enqueued == before.enqueued ||
+        !waitForSent(before.sent + 1)) {
+      ++result.failures;
+      continue;
+    }
+    edgeUs.push_back(irTransmitter.stats().lastStartUs - t0);
+    waitForSent(before.sent + (queued.enqueued - before.enqueued));
+    delay(bench.settleMs);
+    dropRecordedFrames();
+  }
+
+  const JsonArena::Stats arenaAfter = messageArena.stats();
+  result.n = bench.iterations;
+  result.ingestP50Us = percentile(ingestUs, 50);
+  result.ingestP99Us = percentile(ingestUs, 99);
+  result.edgeP50Us = percentile(edgeUs, 50);
+  result.edgeP99Us = percentile(edgeUs, 99);
+  if (bench.iterations > 0) {
+    result.allocsMean = static_cast<float>(allocTotal) / bench.iterations;
+    result.arenaAllocsMean =
+        static_cast<float>(arenaAfter.allocations - arenaBefore.allocations) /
+        bench.iterations;
+  }
+  result.arenaFallbacks = arenaAfter.heapFallbacks - arenaBefore.heapFallbacks;
+
+  // Throughput: back to back, only held off by a nearly full queue.
+  const uint32_t droppedBefore = irTransmitter.stats().dropped;
+  const uint32_t startedUs = micros();
+  for (size_t i = 0; i < bench.iterations; ++i) {
+    while (irTransmitter.stats().depth + kMaxFramesPerCommand >
+           IR_TX_QUEUE_DEPTH) {
+      vTaskDelay(1);
+    }
+    const char *payload = bench.payloads[i % bench.payloadCount];
+    ingest(topic.c_str(), payload, strlen(payload));
+    dropRecordedFrames();
+  }
+  waitForSent(irTransmitter.stats().enqueued);
+  const uint32_t elapsedUs = micros() - startedUs;
+  if (elapsedUs > 0) {
+    result.cmdsPerS = bench.iterations * 1e6f / elapsedUs;
+  }
+  const IrTransmitter::Stats after = irTransmitter.stats();
+  result.dropped = after.dropped - droppedBefore;
+  result.txStackFree = after.taskStackFree;
+  delay(bench.settleMs);
+  dropRecordedFrames();
+}
+
+// Each case gets a fresh task so its stack high-water mark is its own.
+void caseTask(void *arg) {
+  CaseRun *run = static_cast<CaseRun *>(arg);
+  CaseResult result;
+  runCase(*run->bench, result);
+  const UBaseType_t stackFree = uxTaskGetStackHighWaterMark(nullptr);
+  result.stackPeak = kBenchStackBytes > stackFree ? kBenchStackBytes - stackFree : 0;
+  xQueueSend(run->done, &result, portMAX_DELAY);
+  vTaskDelete(nullptr);
+}
+
+void printResult(const BenchCase &bench, const CaseResult &result) {
+  JsonDocument doc;
+  doc["case"] = bench.name;
+  doc["n"] = result.n;
+  doc["failures"] = result.failures;
+  doc["ingest_us_p50"] = result.ingestP50Us;
+  doc["ingest_us_p99"] = result.ingestP99Us;
+  doc["edge_us_p50"] = result.edgeP50Us;
+  doc["edge_us_p99"] = result.edgeP99Us;
+  doc["allocs_mean"] = result.allocsMean;
+  doc["allocs_max"] = result.allocsMax;
+  doc["arena_allocs_mean"] = result.arenaAllocsMean;
+  doc["arena_fallbacks"] = result.arenaFallbacks;
+  doc["stack_peak"] = result.stackPeak;
+  doc["cmds_per_s"] = result.cmdsPerS;
+  doc["dropped"] = result.dropped;
+  doc["tx_stack_free"] = result.txStackFree;
+  char line[512];
+  serializeJson(doc, line, sizeof(line));
+  Serial.printf("[BENCH] %s\n", line);
+}
+
+// Per recorded message: deserializeJson() alone, then a few whole ingests,
+// each with its heap allocations. Ingests start on an idle transmitter.
+void runPayloadBench() {
+  std::vector<uint32_t> parseUs;
+  parseUs.reserve(kIterations);
+  for (const RecordedPayload &payload : kRecordedPayloads) {
+    const String topic = kNodeTopicPrefix + payload.topicSuffix;
+    const size_t length = strlen(payload.json);
+    parseUs.clear();
+    uint32_t parseAllocsMax = 0;
+    uint32_t firstIngestAllocs = 0;
+    uint32_t ingestAllocsMax = 0;
+    size_t failures = 0;
+    const JsonArena::Stats arenaBefore = messageArena.stats();
+
+    for (size_t i = 0; i < kIterations; ++i) {
+      allocationCount = 0;
+      countAllocations = true;
+      const uint32_t t0 = micros();
+      JsonDocument doc(&messageArena);
+      const DeserializationError err =
+          deserializeJson(doc, payload.json, length);
+      const uint32_t t1 = micros();
+      countAllocations = false;
+      parseUs.push_back(t1 - t0);
+      parseAllocsMax = std::max<uint32_t>(parseAllocsMax, allocationCount);
+      if (err) ++failures;
+    }
+
+    for (size_t i = 0; i < kPayloadIngests; ++i) {
+      const uint32_t enqueuedBefore = irTransmitter.stats().enqueued;
+      allocationCount = 0;
+      countAllocations = true;
+      const bool accepted = ingest(topic.c_str(), payload.json, length);
+      countAllocations = false;
+      if (i == 0) {
+        firstIngestAllocs = allocationCount;
+      } else {
+        ingestAllocsMax = std::max<uint32_t>(ingestAllocsMax, allocationCount);
+      }
+      if (!accepted) ++failures;
+      if (irTransmitter.stats().enqueued != enqueuedBefore) {
+        waitForSent(irTransmitter.stats().enqueued);
+        delay(kChannelSettleMs);
+      }
+      dropRecordedFrames();
+    }
+
+    JsonDocument doc;
+    doc["case"] = "payload";
+    doc["name"] = payload.name;
+    doc["bytes"] = length;
+    doc["n"] = kIterations;
+    doc["failures"] = failures;
+    doc["parse_us_p50"] = percentile(parseUs, 50);
+    doc["parse_us_p99"] = percentile(parseUs, 99);
+    doc["parse_allocs_max"] = parseAllocsMax;
+    doc["first_ingest_allocs"] = firstIngestAllocs;
+    doc["ingest_allocs_max"] = ingestAllocsMax;
+    doc["arena_fallbacks"] =
+        messageArena.stats().heapFallbacks - arenaBefore.heapFallbacks;
+    char line[256];
+    serializeJson(doc, line, sizeof(line));
+    Serial.printf("[BENCH] %s\n", line);
+  }
+}
+
+#ifdef ESP_PLATFORM
+// Cool 24 auto and cool 26 low, the kind of states users cycle through.
+void acMemoState(const AcController::IrModelConfig &model, bool second,
+                 stdAc::state_t &state) {
+  IRac::initState(&state);
+  state.protocol = model.protocol;
+  state.model = static_cast<int16_t>(model.model);
+  state.power = true;
+  state.celsius = true;
+  state.mode = stdAc::opmode_t::kCool;
+  state.degrees = second ? 26 : 24;
+  state.fanspeed = second ? stdAc::fanspeed_t::kLow : stdAc::fanspeed_t::kAuto;
+  state.swingv = stdAc::swingv_t::kOff;
+  state.swingh = stdAc::swingh_t::kOff;
+}
+#endif
+
+#ifdef ESP_PLATFORM
+void runAcMemoBench() {
+  // Bench-local, so the transmitter's own memo and stats stay untouched.
+  IRac irAc(IR_LED_PIN, IR_SEND_INVERTED, IR_SEND_USE_MODULATION);
+  std::vector<uint32_t> encodeUs;
+  for (size_t m = 0; m < AcController::modelCount(); ++m) {
+    const AcController::IrModelConfig &model = AcController::model(m);
+    AcFrameMemo memo;
+    stdAc::state_t states[2];
+    acMemoState(model, false, states[0]);
+    acMemoState(model, true, states[1]);
+
+    encodeUs.clear();
+    size_t frameBytes = 0;
+    for (size_t i = 0; i < 2 * kAcMemoEncodes; ++i) {
+      const stdAc::state_t &state = states[i % 2];
+      const stdAc::state_t prev = irAc.getStatePrev();
+      irAc.next = state;
+      IrPinRecorder::start(IR_LED_PIN, IR_SEND_INVERTED ? LOW : HIGH);
+      const uint32_t t0 = micros();
+      irAc.sendAc();
+      const uint32_t t1 = micros();
+      IrPulseTrain sent;
+      uint32_t firstEdgeUs = 0;
+      const bool recorded = IrPinRecorder::finish(sent, &firstEdgeUs);
+      encodeUs.push_back(recorded ? firstEdgeUs - t0 : t1 - t0);
+      if (recorded && !memo.find(state, prev)) {
+        IrRmtFrame frame;
+        IrRmtBackend::build(sent, frame);
+        frameBytes += frame.items.size() * sizeof(rmt_item32_t);
+        memo.store(state, prev, std::move(frame));
+      }
+      delay(kSettleMs);
+    }
+
+    // Alternating, each state is sent after the other one.
+    const bool memoizable = AcFrameMemo::isMemoizable(states[0]);
+    size_t hits = 0;
+    const uint32_t t0 = micros();
+    for (size_t i = 0; i < kAcMemoLookups; ++i) {
+      if (memo.find(states[i % 2], states[(i + 1) % 2]) != nullptr) ++hits;
+    }
+    const uint32_t hitNs = (micros() - t0) * 1000 / kAcMemoLookups;
+
+    JsonDocument doc;
+    doc["case"] = "ac_memo";
+    doc["brand"] = model.brand;
+    doc["type"] = model.type;
+    doc["protocol"] = typeToString(model.protocol);
+    doc["memoizable"] = memoizable;
+    doc["encode_us_p50"] = percentile(encodeUs, 50);
+    if (hits == kAcMemoLookups) doc["hit_ns"] = hitNs;
+    doc["frame_bytes"] = frameBytes;
+    char line[256];
+    serializeJson(doc, line, sizeof(line));
+    Serial.printf("[BENCH] %s\n", line);
+  }
+}
+#endif
+
+}  // namespace
+
+void setup() {
+  Serial.begin(115200);
+  delay(100);
+  Serial.println();
+  Log::begin();
+
+  irTransmitter.begin();
+  deviceManager.setTopicPrefix(kNodeTopicPrefix.c_str());
+  deviceManager.registerController(acController);
+  deviceManager.registerController(fanController);
+  deviceManager.registerController(tvController);
+  deviceManager.registerController(stbController);
+  deviceManager.registerController(dvdController);
+  deviceManager.registerController(projectorController);
+  deviceManager.addRoute("commands", TopicRoute::kCommand);
+  deviceManager.addRoute("ir/test", TopicRoute::kCommand, &acController);
+  deviceManager.begin();
+
+  {
+    JsonDocument doc;
+    doc["bench"] = "command";
+#ifdef ESP_PLATFORM
+    doc["platform"] = "esp32";
+#else
+    doc["platform"] = "host";
+#endif
+    doc["iterations"] = kIterations;
+    doc["arena_bytes"] = MQTT_JSON_ARENA_BYTES;
+    doc["log_level"] = LOG_LEVEL;
+    char line[160];
+    serializeJson(doc, line, sizeof(line));
+    Serial.printf("[BENCH] %s\n", line);
+  }
+
+  QueueHandle_t done = xQueueCreate(1, sizeof(CaseResult));
+  if (done == nullptr) {
+    Serial.println(F("[BENCH] Failed to create result queue"));
+    return;
+  }
+  for (const BenchCase &bench : kCases) {
+    CaseRun run{&bench, done};
+    if (xTaskCreatePinnedToCore(caseTask, "bench", kBenchStackBytes, &run,
+                                kBenchPriority, nullptr,
+                                NET_TASK_CORE) != pdPASS) {
+      Serial.printf("[BENCH] Failed to start case %s\n", bench.name);
+      continue;
+    }
+    CaseResult result;
+    xQueueReceive(done, &result, portMAX_DELAY);
+    printResult(bench, result);
+  }
+  vQueueDelete(done);
+  runPayloadBench();
+#ifdef ESP_PLATFORM
+  runAcMemoBench();
+#endif
+  Serial.printf("[BENCH] done (log dropped=%lu)\n",
+                static_cast<unsigned long>(Log::stats().dropped));
+}
+
+void loop() { delay(1000); }
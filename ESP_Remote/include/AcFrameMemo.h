@@ -0,0 +1,77 @@
+#pragma once
+
+#include <IRac.h>
+#include <list>
+
+#include "Config.h"
+#include "IrRmtBackend.h"
+
+// Encoded A/C frames by the settings they were encoded from, so a state the
+// user keeps coming back to (cool 24 auto, cool 26 low) is replayed instead
+// of going through IRac and the protocol class again. Keyed by protocol,
+// model, power, mode, temperature, fan and swing, and by the power, mode and
+// swing of the state IRac sent before: some protocols (Samsung and Sharp
+// A/C) build a different frame when the power changes. The remaining
+// state_t fields are always the IRac::initState() defaults for AcController.
+//
+// Most recently used first; the oldest frames go once their RMT symbols
+// pass `capBytes`. Owned by the IR task.
+class AcFrameMemo {
+ public:
+  struct Stats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    uint16_t entries = 0;
+    uint32_t bytes = 0;
+  };
+
+  explicit AcFrameMemo(size_t capBytes = AC_FRAME_MEMO_BYTES)
+      : capBytes_(capBytes) {}
+
+  // Only protocols with a state frame (hasACState()). IRac turns changes of
+  // value protocols (Coolix swing, LG power off) into separate toggle
+  // commands, which a frame per state cannot replay.
+  static bool isMemoizable(const stdAc::state_t &state);
+
+  // The frame IRac sends for `state` after `prev` (IRac::getStatePrev()),
+  // or nullptr (counted as a miss).
+  const IrRmtFrame *find(const stdAc::state_t &state,
+                         const stdAc::state_t &prev);
+  // False if `state` is not memoizable or the frame alone is over the cap.
+  bool store(const stdAc::state_t &state, const stdAc::state_t &prev,
+             IrRmtFrame &&frame);
+  void clear();
+
+  Stats stats() const { return stats_; }
+
+ private:
+  struct Key {
+    decode_type_t protocol;
+    int16_t model;
+    bool power;
+    bool celsius;
+    stdAc::opmode_t mode;
+    int16_t tenthDegrees;
+    stdAc::fanspeed_t fan;
+    stdAc::swingv_t swingv;
+    stdAc::swingh_t swingh;
+    // What IRac reads from its previous state.
+    bool prevPower;
+    stdAc::opmode_t prevMode;
+    stdAc::swingv_t prevSwingv;
+    stdAc::swingh_t prevSwingh;
+    bool operator==(const Key &other) const;
+  };
+  struct Entry {
+    Key key;
+    IrRmtFrame frame;
+  };
+
+  static Key keyFor(const stdAc::state_t &state, const stdAc::state_t &prev);
+  static size_t bytesOf(const IrRmtFrame &frame);
+
+  size_t capBytes_;
+  std::list<Entry> entries_;
+  Stats stats_;
+};
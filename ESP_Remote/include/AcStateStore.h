@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct RemoteProfile {
+  String brand;
+  String type;
+  uint16_t index = 0;
+};
+
+struct AcState {
+  bool power = false;
+  String mode = "cool";
+  int temp = 24;
+  String fan = "auto";
+  bool swing = false;
+};
+
+// Last A/C state and remote profile, kept in NVS so a reboot resumes (and
+// publishes) what the unit was last told instead of cool/24/auto. AcController
+// coalesces writes; save() also skips records identical to the stored one.
+//
+// Record layout (little endian, about 40 bytes):
+//   "AS" u8 version, u8 flags (bit 0 power, bit 1 swing), i8 temp,
+//   u16 profile index, then mode, fan, brand and type as u8 length + bytes,
+//   u32 CRC-32 of everything before it.
+namespace AcStateStore {
+
+struct Stats {
+  uint32_t loads = 0;
+  uint32_t loadErrors = 0;  // bad header/CRC; the defaults are kept
+  uint32_t writes = 0;
+  uint32_t writeErrors = 0;
+  uint32_t unchanged = 0;  // saves skipped because flash already matched
+};
+
+// False (and both outputs untouched) when nothing valid is stored.
+bool load(AcState &state, RemoteProfile &remote);
+bool save(const AcState &state, const RemoteProfile &remote);
+
+Stats stats();
+
+void encode(const AcState &state, const RemoteProfile &remote,
+            std::vector<uint8_t> &out);
+bool decode(const uint8_t *data, size_t length, AcState &state,
+            RemoteProfile &remote);
+
+}  // namespace AcStateStore
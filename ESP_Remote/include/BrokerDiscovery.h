@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Finds the MQTT broker when MQTT_HOST is empty. A search is a sequence of
+// non-blocking poll() steps: the UDP DISCOVER_IOT_MQTT probe is re-broadcast
+// with a doubling interval and an mDNS _mqtt._tcp query runs alongside it;
+// the first answer wins. The last broker that accepted a connection is kept
+// in NVS so a reboot or Wi-Fi reconnect can try it before searching.
+namespace BrokerDiscovery {
+
+struct Broker {
+  String host;
+  uint16_t port = 0;
+};
+
+enum class Status : uint8_t {
+  kIdle,
+  kSearching,
+  kFound,
+  kTimedOut,
+};
+
+void begin();
+
+// Last broker passed to remember(), if any.
+bool remembered(Broker &out);
+// Persists `broker`; a no-op if it is already the remembered one.
+void remember(const Broker &broker);
+void forget();
+
+// Starts a search unless one is running, then advances it. kFound fills
+// `out` and ends the search; kTimedOut ends it after
+// MQTT_DISCOVERY_TIMEOUT_MS.
+Status poll(Broker &out);
+bool searching();
+void stop();
+
+// Parses a "MQTT://host:port" announcement; port 0 or garbage means
+// MQTT_PORT.
+bool parseAnnouncement(const char *text, Broker &out);
+
+}  // namespace BrokerDiscovery
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "KeyId.h"
+#include "PerfectHash.h"
+
+// Compile-time indexes for the controllers' codeset tables.
+//
+// Each controller keeps its KeyCommand/RemoteConfig tables as constexpr data.
+// buildRemoteIndex() searches (at compile time) for a hash seed that places
+// every (brand, type, index) in its own slot; buildKeyIndex() resolves every
+// command name to its KeyId and stores a direct KeyId -> command table per
+// remote. A press then costs one hash over the profile strings and one array
+// read, with no String temporaries and no scan over the table.
+//
+// Remote must look like the controllers' RemoteConfig (brand, type, index,
+// commands, commandCount) and commands[] like KeyCommand (key, ...).
+namespace CodesetIndex {
+
+using PerfectHash::equalsFolded;
+
+constexpr size_t kRemoteLoadDivisor = 4;
+
+constexpr uint32_t hashRemote(const char *brand, const char *type,
+                              uint16_t index, uint32_t seed) {
+  using PerfectHash::mix;
+  using PerfectHash::mixText;
+  const uint32_t h =
+      mixText(mixText(PerfectHash::seedBasis(seed), brand), type);
+  return PerfectHash::finish(mix(mix(h, index & 0xFF), index >> 8));
+}
+
+// ---------------------------------------------------------------------------
+// (brand, type, index) -> position in the remote table.
+
+template <size_t NRemotes>
+struct RemoteIndex {
+  static constexpr size_t kSlots =
+      PerfectHash::slotsFor(NRemotes, kRemoteLoadDivisor);
+
+  uint32_t seed = 0;
+  bool complete = false;
+  // True when every entry is either fully keyed (type and index set) or a
+  // brand-less catch-all with index 0. Only then can a hashed probe stand in
+  // for the scan; see findRemote().
+  bool fastPath = false;
+  uint8_t slots[kSlots] = {};
+};
+
+template <typename Remote, size_t NRemotes>
+constexpr RemoteIndex<NRemotes> buildRemoteIndex(
+    const Remote (&remotes)[NRemotes]) {
+  RemoteIndex<NRemotes> out{};
+  constexpr size_t mask = RemoteIndex<NRemotes>::kSlots - 1;
+  if (NRemotes > PerfectHash::kMaxEntries) return out;
+
+  out.fastPath = true;
+  for (size_t r = 0; r < NRemotes; ++r) {
+    const Remote &remote = remotes[r];
+    const bool keyed = remote.type != nullptr && remote.type[0] != '\0' &&
+                       remote.index != 0;
+    const bool catchAll =
+        (remote.brand == nullptr || remote.brand[0] == '\0') &&
+        remote.index == 0;
+    if (!keyed && !catchAll) out.fastPath = false;
+  }
+
+  for (uint32_t seed = 0; seed <= PerfectHash::kMaxSeed; ++seed) {
+    for (size_t i = 0; i <= mask; ++i) out.slots[i] = 0;
+    bool ok = true;
+    for (size_t r = 0; ok && r < NRemotes; ++r) {
+      const Remote &remote = remotes[r];
+      const size_t slot =
+          hashRemote(remote.brand, remote.type, remote.index, seed) & mask;
+      if (out.slots[slot] == 0) {
+        out.slots[slot] = static_cast<uint8_t>(r + 1);
+        continue;
+      }
+      // An identical earlier entry shadows this one, as in a linear scan.
+      const Remote &other = remotes[out.slots[slot] - 1];
+      ok = other.index == remote.index &&
+           equalsFolded(other.brand, remote.brand) &&
+           equalsFolded(other.type, remote.type);
+    }
+    if (ok) {
+      out.seed = seed;
+      out.complete = true;
+      return out;
+    }
+  }
+  return out;
+}
+
+template <typename Remote, size_t NRemotes>
+const Remote *probeRemote(const RemoteIndex<NRemotes> &table,
+                          const Remote *remotes, const char *brand,
+                          const char *type, uint16_t index) {
+  constexpr size_t mask = RemoteIndex<NRemotes>::kSlots - 1;
+  const uint8_t slot =
+      table.slots[hashRemote(brand, type, index, table.seed) & mask];
+  if (slot == 0) return nullptr;
+  const Remote *remote = &remotes[slot - 1];
+  if (remote->index != index || !equalsFolded(remote->brand, brand) ||
+      !equalsFolded(remote->type, type)) {
+    return nullptr;
+  }
+  return remote;
+}
+
+// Same result as the original first-match scan: an exact brand or exact
+// index match wins, otherwise the first entry that is compatible at all.
+template <typename Remote, size_t NRemotes>
+const Remote *scanRemote(const Remote *remotes, const char *brand,
+                         const char *type, uint16_t index) {
+  const bool anyBrand = brand == nullptr || brand[0] == '\0';
+  const Remote *fallback = nullptr;
+  for (size_t r = 0; r < NRemotes; ++r) {
+    const Remote &remote = remotes[r];
+    const bool remoteAnyBrand =
+        remote.brand == nullptr || remote.brand[0] == '\0';
+    const bool brandEqual = remote.brand != nullptr &&
+                            equalsFolded(brand, remote.brand);
+    const bool brandMatch = anyBrand || remoteAnyBrand || brandEqual;
+    const bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
+                           equalsFolded(type, remote.type);
+    const bool indexMatch =
+        remote.index == 0 || index == 0 || remote.index == index;
+    if (brandMatch && typeMatch && indexMatch) {
+      if (fallback == nullptr) fallback = &remote;
+      if (brandEqual || (remote.index != 0 && remote.index == index)) {
+        return &remote;
+      }
+    }
+  }
+  return fallback;
+}
+
+// With a brand and a non-zero index, the scan above can only stop on
+// (brand, type, index) or ("", type, index); whichever comes first in the
+// table wins. Anything else (no brand, index 0, no exact entry) is rare and
+// goes through the scan.
+template <typename Remote, size_t NRemotes>
+const Remote *findRemote(const RemoteIndex<NRemotes> &table,
+                         const Remote *remotes, const char *brand,
+                         const char *type, uint16_t index) {
+  if (table.fastPath && brand != nullptr && brand[0] != '\0' && index != 0) {
+    const Remote *exact = probeRemote(table, remotes, brand, type, index);
+    const Remote *generic = probeRemote(table, remotes, "", type, index);
+    if (exact != nullptr && (generic == nullptr || exact < generic)) {
+      return exact;
+    }
+    if (generic != nullptr) return generic;
+  }
+  return scanRemote<Remote, NRemotes>(remotes, brand, type, index);
+}
+
+// ---------------------------------------------------------------------------
+// (remote position, KeyId) -> command.
+
+template <size_t NRemotes>
+struct KeyIndex {
+  // False if a table uses a key name missing from IR_BUILTIN_KEYS.
+  bool complete = false;
+  uint8_t slots[NRemotes][KeyIds::kBuiltinCount] = {};  // position + 1
+};
+
+template <typename Remote, size_t NRemotes>
+constexpr KeyIndex<NRemotes> buildKeyIndex(const Remote (&remotes)[NRemotes]) {
+  KeyIndex<NRemotes> out{};
+  for (size_t r = 0; r < NRemotes; ++r) {
+    const Remote &remote = remotes[r];
+    if (remote.commandCount > PerfectHash::kMaxEntries) return out;
+    for (size_t c = 0; c < remote.commandCount; ++c) {
+      const KeyId id = KeyIds::builtin(remote.commands[c].key);
+      if (id == KeyId::kNone) return out;
+      uint8_t &slot = out.slots[r][static_cast<size_t>(id)];
+      // Repeated key names: the first one wins, as in a linear scan.
+      if (slot == 0) slot = static_cast<uint8_t>(c + 1);
+    }
+  }
+  out.complete = true;
+  return out;
+}
+
+template <typename Remote, size_t NRemotes>
+auto findKey(const KeyIndex<NRemotes> &table, const Remote *remotes,
+             const Remote *remote, KeyId key) -> decltype(remote->commands) {
+  const size_t id = static_cast<size_t>(key);
+  if (remote == nullptr || remote < remotes || remote >= remotes + NRemotes ||
+      key == KeyId::kNone || id >= KeyIds::kBuiltinCount) {
+    return nullptr;
+  }
+  const uint8_t position = table.slots[remote - remotes][id];
+  return position != 0 ? &remote->commands[position - 1] : nullptr;
+}
+
+}  // namespace CodesetIndex
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "DeviceManager.h"
+#include "IrTransmitter.h"
+
+// {"cmd":"batch","steps":[...]} runs a scripted sequence from one message
+// instead of one MQTT round trip per key:
+//
+//   {"cmd":"batch","id":7,"gapMs":150,"steps":[
+//     "POWER",                                   key for the topic's device
+//     {"key":"VOL_UP","repeat":5},               pressed five times
+//     {"device":"ac","cmd":"temp","value":22,"flush":true}]}
+//
+// A step is a key name or an object. Objects with "cmd" are any device
+// command, run through handleCommand(); objects with only "key" are key
+// presses. "device" sends the step to another controller, "repeat" (default
+// 1) runs it several times and "gapMs" (default: the batch's "gapMs", else
+// 0) is the quiet time after every run. A/C state commands are not
+// coalesced: each run sends its frame in its place in the sequence.
+//
+// Every step's controller is looked up before anything is queued, and the
+// batch is refused as a whole when it would not fit in the free IR queue
+// slots, so the frames go out as one uninterrupted sequence.
+namespace CommandBatch {
+
+// Steps are bounded by the IR queue anyway (each takes at least one slot).
+constexpr size_t kMaxSteps = IR_TX_QUEUE_DEPTH;
+static_assert(kMaxSteps <= 32, "Result bit masks hold 32 steps");
+
+struct Result {
+  uint8_t steps = 0;
+  uint8_t ok = 0;               // steps that queued a frame or changed state
+  uint16_t frames = 0;          // IR frames queued
+  uint16_t dropped = 0;         // frames the IR queue refused anyway
+  uint32_t failed = 0;          // bit i: step i queued nothing and changed
+                                // nothing
+  uint32_t changed = 0;         // bit i: controller #i reported new state
+  const char *error = nullptr;  // batch refused; nothing was run
+  int8_t errorStep = -1;        // offending step, when there is one
+};
+
+// `controller` is the message's device; it may be null when every step
+// names its own. Counts commands and frames on each controller's metrics.
+// `stateDoc` is scratch space for handleCommand().
+void run(JsonObjectConst cmd, DeviceController *controller,
+         DeviceManager &devices, IrTransmitter &ir, JsonDocument &stateDoc,
+         Result &result);
+
+// {"steps":..,"ok":..,"frames":..,"dropped":..,"failed":[..]} or
+// {"error":"..","step":..}.
+void toJson(const Result &result, JsonObject out);
+
+}  // namespace CommandBatch
@@ -15,6 +15,19 @@ constexpr auto WIFI_PASSWORD = "24091996";
 constexpr auto WIFI_AP_SSID_PREFIX = "ESP_REMOTE";
 constexpr auto WIFI_AP_PASSWORD = "";
 
+// Kết nối nhanh: thử vào thẳng BSSID + kênh của lần kết nối thành công trước
+// (không quét). Quá WIFI_DIRECTED_JOIN_TIMEOUT_MS thì quay về quét như cũ.
+// WIFI_FAST_JOIN_STATIC_IP dùng lại IP DHCP lần trước làm IP tĩnh (bỏ qua
+// DHCP); chỉ bật khi router giữ cố định IP cho ESP32.
+constexpr uint32_t WIFI_DIRECTED_JOIN_TIMEOUT_MS = 4000;
+constexpr bool WIFI_FAST_JOIN_STATIC_IP = false;
+
+// Quét Wi-Fi chạy nền (không chặn loop). Khi chưa kết nối/đang mở portal, danh
+// sách được làm mới mỗi WIFI_SCAN_REFRESH_MS. Khi kết nối, kết quả cũ hơn
+// WIFI_SCAN_MAX_AGE_MS sẽ bị quét lại trước khi chọn SSID.
+constexpr uint32_t WIFI_SCAN_REFRESH_MS = 30000;
+constexpr uint32_t WIFI_SCAN_MAX_AGE_MS = 20000;
+
 // ==== MQTT configuration ====================================================
 // Nếu bỏ trống MQTT_HOST, ESP32 sẽ cố gắng tự động tìm broker bằng broadcast.
 // Chỉ cần điền IP khi muốn ép kết nối tới một broker cụ thể.
@@ -35,6 +48,72 @@ constexpr auto NODE_ID = "esp-remote";
 constexpr uint16_t MQTT_DISCOVERY_PORT = 4210;
 constexpr unsigned long MQTT_DISCOVERY_TIMEOUT_MS = 5000UL;
 constexpr auto MQTT_DISCOVERY_REQUEST = "DISCOVER_IOT_MQTT";
+// Gói dò được phát lại sau 250 ms, 500 ms, 1 s... cho tới khi hết timeout.
+// Song song đó hỏi mDNS dịch vụ _mqtt._tcp. Broker kết nối thành công gần nhất
+// được lưu NVS và thử trước ở lần sau (không cần broadcast).
+constexpr uint32_t MQTT_DISCOVERY_RETRY_MS = 250;
+constexpr bool MQTT_DISCOVERY_USE_MDNS = true;
+
+// ==== MQTT reconnect ========================================================
+// Mất broker thì thử lại trong loop() (không chặn portal/IR): thời gian chờ tăng
+// gấp đôi từ MIN tới MAX, có thêm ngẫu nhiên. Mở TCP tới broker tối đa
+// MQTT_CONNECT_TIMEOUT_MS. Sau MQTT_CONNECT_ATTEMPT_BUDGET lần lỗi liên tiếp,
+// broker tự dò (MQTT_HOST trống) sẽ được dò lại.
+constexpr uint32_t MQTT_RECONNECT_MIN_MS = 1000;
+constexpr uint32_t MQTT_RECONNECT_MAX_MS = 60000;
+constexpr uint32_t MQTT_CONNECT_TIMEOUT_MS = 3000;
+constexpr uint8_t MQTT_CONNECT_ATTEMPT_BUDGET = 5;
+
+// Bộ nhớ tĩnh cho JSON của một bản tin MQTT (lệnh + state trả về). Bản tin quá
+// lớn vẫn chạy được nhưng phải xin heap (xem json_arena trong /status).
+constexpr size_t MQTT_JSON_ARENA_BYTES = 3072;
+
+// ==== State publishing ====================================================
+// State chỉ được publish khi có trường thay đổi, kèm "seq" tăng dần (bắt đầu
+// lại từ 1 sau khi khởi động) và "updatedAt" (millis() lúc đổi). Bật
+// STATE_PUBLISH_DELTAS để mỗi thay đổi chỉ gửi các trường đã đổi lên
+// <state topic>/delta (không retained, trường bị bỏ mang giá trị null). Bản
+// đầy đủ (retained) vẫn gửi khi kết nối MQTT và khi nhận {"cmd":"state"} trên
+// topic lệnh của thiết bị; client thấy "seq" bị nhảy thì gửi lệnh này.
+constexpr bool STATE_PUBLISH_DELTAS = false;
+
+// ==== Tracing =============================================================
+// Ghi mốc thời gian (micros) các bước nóng: nhận MQTT, parse JSON, gọi
+// controller, phát IR, publish. Bộ đệm vòng giữ TRACE_BUFFER_EVENTS sự kiện
+// mới nhất (8 byte/sự kiện, phải là luỹ thừa của 2). Lấy dữ liệu dạng CSV:
+// gửi {} tới iot/nodes/<NODE_ID>/debug/trace/cmd (trả về trên .../debug/trace)
+// hoặc mở http://192.168.4.1/trace khi portal đang chạy.
+constexpr bool TRACE_ENABLED = true;
+constexpr uint16_t TRACE_BUFFER_EVENTS = 256;
+
+// ==== Metrics ==============================================================
+// Gửi định kỳ một bản JSON gọn lên iot/nodes/<NODE_ID>/metrics: bộ đếm theo
+// từng thiết bị (lệnh, frame IR, phím không biết, trúng mã đã học / mã có sẵn),
+// histogram độ trễ xử lý lệnh và thời gian một vòng loop, lỗi JSON, số lần nối
+// lại MQTT, heap trống và khối heap lớn nhất. Đặt 0 để tắt.
+constexpr uint32_t METRICS_PUBLISH_INTERVAL_MS = 30000;
+
+// ==== Logging ==============================================================
+// Mức log chọn lúc biên dịch bằng -DLOG_LEVEL=LOG_LEVEL_DEBUG (hoặc _INFO,
+// _WARN, _ERROR, _NONE) trong build_flags; mặc định LOG_LEVEL_INFO. Các dòng
+// trên mức này không sinh code và không tính tham số. Dòng được bật xếp vào
+// hàng đợi, task "log" ưu tiên thấp mới ghi ra Serial; hàng đợi đầy thì dòng
+// mới bị bỏ và đếm vào log.dropped (xem /status).
+constexpr uint8_t LOG_QUEUE_LINES = 32;
+constexpr uint8_t LOG_LINE_BYTES = 128;  // dài hơn sẽ bị cắt, kết thúc bằng "..."
+
+// ==== Tasks ================================================================
+// Firmware chia thành các task FreeRTOS ghim lõi, nói chuyện với nhau qua hàng
+// đợi SPSC không khoá: task "net" (Wi-Fi, MQTT, discovery, portal, publish)
+// chạy trên lõi của Wi-Fi stack; "ir_tx" (phát) và "ir_rx" (học lệnh) chạy trên
+// lõi còn lại nên ngắt Wi-Fi không làm lệch timing IR, và một burst A/C dài
+// không chặn việc xử lý mạng. Mức trống stack từng task có trong /status và
+// metrics (stack_free).
+constexpr uint8_t NET_TASK_CORE = 0;  // cùng lõi với Wi-Fi/lwIP (PRO_CPU)
+constexpr uint8_t IR_TASK_CORE = 1;   // APP_CPU
+constexpr uint32_t NET_TASK_STACK_BYTES = 8192;
+constexpr uint32_t IR_RX_TASK_STACK_BYTES = 4096;
+constexpr uint8_t IR_RX_POLL_MS = 5;  // chu kỳ ir_rx đọc bộ thu khi đang học
 
 // ==== Optional hardware configuration ======================================
 // Chân LED trạng thái (tuỳ board). Với ESP32 DevKit v1, LED onboard nằm tại GPIO2.
@@ -54,3 +133,70 @@ constexpr bool IR_SEND_USE_MODULATION = true;
 // lần giúp tăng khả năng nhận khi IR yếu/đi tản (module 360°).
 constexpr uint8_t IR_AC_LEARNED_BURST_COUNT = 1;      // >=1
 constexpr uint16_t IR_AC_LEARNED_BURST_GAP_MS = 80;   // khoảng nghỉ giữa burst
+
+// Gộp lệnh A/C: kéo thanh nhiệt độ sinh ra cả loạt lệnh temp/set. Lệnh đầu tiên
+// mở cửa sổ AC_COALESCE_WINDOW_MS, các lệnh sau chỉ cập nhật state; hết cửa sổ
+// mới phát một frame và publish state một lần (giá trị cuối cùng thắng). Lệnh
+// {"cmd":"flush"} hoặc "flush": true phát ngay. Đặt 0 để phát từng lệnh.
+constexpr uint16_t AC_COALESCE_WINDOW_MS = 250;
+
+// Lưu state A/C + hãng/model đang chọn vào NVS để khởi động lại vẫn giữ (và
+// publish lên MQTT) state cũ thay vì mặc định cool/24/auto, app không phải gửi
+// lại. Ghi gộp giống mã học: chỉ ghi khi không có lệnh mới trong
+// AC_STATE_WRITE_DELAY_MS, nhưng không trễ quá AC_STATE_WRITE_MAX_DELAY_MS;
+// state không đổi thì không ghi.
+constexpr bool AC_STATE_PERSIST = true;
+constexpr uint32_t AC_STATE_WRITE_DELAY_MS = 5000;
+constexpr uint32_t AC_STATE_WRITE_MAX_DELAY_MS = 60000;
+
+// Hàng đợi phát IR: lệnh MQTT chỉ xếp frame vào hàng đợi, task riêng sẽ phát.
+// Khi hàng đợi đầy, frame mới bị bỏ (không chặn vòng lặp MQTT).
+constexpr uint8_t IR_TX_QUEUE_DEPTH = 16;
+
+// Phát IR bằng ngoại vi RMT (sóng mang + timing do phần cứng tạo, không bị
+// ngắt Wi-Fi làm lệch). Các giao thức RMT chưa hỗ trợ vẫn dùng IRsend.
+constexpr bool IR_TX_USE_RMT = true;
+constexpr uint8_t IR_TX_RMT_CHANNEL = 0;
+constexpr uint8_t IR_RMT_FRAME_CACHE_SIZE = 48;  // số frame giữ lại (LRU)
+// Frame A/C (>64 bit) đã học: nhịp thu lúc học được dựng thành symbol RMT ở
+// lần gửi đầu và giữ lại (LRU) trong giới hạn byte này (4 byte/symbol).
+constexpr size_t IR_STATE_FRAME_CACHE_BYTES = 12 * 1024;
+// Frame A/C do IRac mã hoá: lần gửi đầu ghi lại xung trên chân LED, các lần
+// sau cùng trạng thái (mode/nhiệt độ/quạt/swing) phát lại qua RMT, bỏ qua bộ
+// mã hoá. Giới hạn bộ nhớ của cache (LRU); 0 để tắt.
+constexpr size_t AC_FRAME_MEMO_BYTES = 16 * 1024;
+
+// ==== Scenes ================================================================
+// Scene: chuỗi lệnh IR cho nhiều thiết bị, chạy bằng một bản tin. Lưu bằng
+// {"name":"cinema","steps":[...]} trên iot/nodes/<NODE_ID>/scene/set (bước
+// như lệnh batch: {"device":"tv","key":"POWER","gapMs":800}; A/C:
+// {"device":"ac","power":true,"temp":24}), xoá bằng {"name":..,"delete":true}.
+// Chạy bằng {"name":"cinema"} trên .../scene/run, kết quả trả về trên
+// .../scene. Mã IR được tra sẵn lúc lưu (theo hãng/model và mã đã học lúc
+// đó), nên đổi hãng hoặc học lại phím thì cần lưu lại scene.
+constexpr uint8_t SCENE_MAX_COUNT = 8;
+constexpr uint8_t SCENE_MAX_STEPS = 16;  // <= IR_TX_QUEUE_DEPTH
+
+// ==== Scheduler =============================================================
+// Hẹn giờ lệnh ngay trên ESP32 (giờ lấy từ SNTP), không cần app online. Lưu
+// bằng {"name":"ac-off","cron":"0 2 * * *","device":"ac","command":{...}} hoặc
+// {"name":..,"at":<Unix giây>|"inMs":..,"scene":"cinema"} trên
+// iot/nodes/<NODE_ID>/schedule/set, xoá bằng {"name":..,"delete":true}; kết
+// quả trên .../schedule. Cron 5 trường (phút giờ ngày tháng thứ) theo giờ
+// địa phương SCHED_TIMEZONE (chuỗi TZ POSIX). Lệnh trễ quá
+// SCHED_LATE_LIMIT_MS (mất điện, mất giờ) thì bỏ qua, không chạy bù.
+constexpr uint8_t SCHED_MAX_JOBS = 16;
+constexpr auto SCHED_TIMEZONE = "<+07>-7";  // Việt Nam, UTC+7
+constexpr auto SNTP_SERVER = "pool.ntp.org";
+constexpr auto SNTP_SERVER_FALLBACK = "time.google.com";
+constexpr uint32_t SCHED_LATE_LIMIT_MS = 60000;
+
+// ==== Learned IR codes =====================================================
+// Lệnh IR đã học được lưu vào NVS (mỗi thiết bị một blob nhị phân có CRC), nạp
+// lại khi dùng lần đầu sau khi khởi động. Ghi gộp để đỡ mòn flash: chỉ ghi khi
+// không có lệnh học mới trong IR_LEARNED_WRITE_DELAY_MS, nhưng không trễ quá
+// IR_LEARNED_WRITE_MAX_DELAY_MS.
+constexpr bool IR_LEARNED_PERSIST = true;
+constexpr uint32_t IR_LEARNED_WRITE_DELAY_MS = 3000;
+constexpr uint32_t IR_LEARNED_WRITE_MAX_DELAY_MS = 30000;
+constexpr uint8_t IR_LEARNED_MAX_KEYS = 64;  // số phím học tối đa mỗi thiết bị
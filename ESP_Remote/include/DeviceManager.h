@@ -2,6 +2,11 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <vector>
+
+#include "IrFrame.h"
+#include "Metrics.h"
+#include "StateTracker.h"
 
 class DeviceController {
  public:
@@ -11,21 +16,98 @@ class DeviceController {
   virtual void begin() {}
   virtual void serializeState(JsonDocument &doc) const = 0;
   virtual bool handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) = 0;
+  // A key step of a "batch" command (see CommandBatch.h): resolves
+  // `keyName` once, then queues it `presses` times, each frame followed by
+  // `gapAfterMs` of quiet, with the state effects of as many "key" commands.
+  // Returns the presses queued; 0 when the key has no code.
+  virtual uint8_t sendKeyPresses(const char *keyName, uint8_t presses,
+                                 uint16_t gapAfterMs) = 0;
+  // The frame a "key" command for `keyName` would send right now, for scenes
+  // that are compiled ahead of time (RC5/RC6 toggle bits are not flipped).
+  // False when the key has no code.
+  virtual bool resolveKey(const char *keyName, IrFrame &frame) = 0;
+  // IR queue slots handleCommand(cmd) takes at most, so a batch can be
+  // refused up front instead of overflowing the queue halfway.
+  virtual size_t irSlotsFor(JsonObjectConst /*cmd*/) const { return 1; }
+  // Sends a state change held back for coalescing now. True if one was
+  // sent; the caller then publishes serializeState().
+  virtual bool flush() { return false; }
+  // Called on every network task iteration. Returns true when a deferred
+  // state change was just sent; the caller then publishes serializeState().
+  virtual bool poll() { return false; }
+
+  Metrics::DeviceCounters &metrics() { return metrics_; }
+  const Metrics::DeviceCounters &metrics() const { return metrics_; }
+  StateTracker &stateTracker() { return stateTracker_; }
+
+ protected:
+  Metrics::DeviceCounters metrics_;
+  StateTracker stateTracker_;
+};
+
+// What an incoming topic is for.
+enum class TopicRoute : uint8_t {
+  kNone,      // not one of ours
+  kCommand,   // device command; `controller` is the topic's device, if any
+  kLearn,     // IR learn request; `controller` is the device to learn for
+  kTrace,     // trace buffer dump request
+  kSceneSet,  // scene upload or delete
+  kSceneRun,  // scene trigger
+  kSchedule,  // timed job upload or delete
+};
+
+struct TopicMatch {
+  TopicRoute route = TopicRoute::kNone;
+  DeviceController *controller = nullptr;
 };
 
+// Registry of controllers and of the MQTT topics routed to them. Every topic
+// is <prefix><suffix>; the suffixes are hashed once when routes are added, so
+// routing a message is a prefix compare, one hash of the suffix and a scan of
+// a dozen integers.
 class DeviceManager {
  public:
+  // `topicPrefix` is "iot/nodes/<NODE_ID>/". Must be called before routes
+  // are added.
+  void setTopicPrefix(const char *topicPrefix);
+
+  // Registers the controller and routes "<deviceType>/cmd" to it.
   void registerController(DeviceController &controller);
+  void addRoute(const char *suffix, TopicRoute route,
+                DeviceController *controller = nullptr);
   void begin();
-  DeviceController *find(const String &deviceType);
-  size_t count() const { return controllerCount_; }
+
+  DeviceController *find(const char *deviceType);
+  TopicMatch route(const char *topic) const;
+
+  size_t count() const { return controllers_.size(); }
   DeviceController *at(size_t index) {
-    if (index >= controllerCount_) return nullptr;
-    return controllers_[index];
+    if (index >= controllers_.size()) return nullptr;
+    return controllers_[index].controller;
+  }
+  // Registration index of `controller`, or -1.
+  int indexOf(const DeviceController *controller) const;
+
+  // Full topics to subscribe to, in registration order.
+  size_t routeCount() const { return routes_.size(); }
+  const char *routeTopic(size_t index) const {
+    if (index >= routes_.size()) return nullptr;
+    return routes_[index].topic.c_str();
   }
 
  private:
-  static constexpr size_t kMaxControllers = 6;
-  DeviceController *controllers_[kMaxControllers] = {nullptr};
-  size_t controllerCount_ = 0;
+  struct Registered {
+    DeviceController *controller;
+    uint32_t typeHash;
+  };
+  struct Route {
+    String topic;
+    uint32_t suffixHash;
+    TopicRoute route;
+    DeviceController *controller;
+  };
+
+  std::vector<Registered> controllers_;
+  std::vector<Route> routes_;
+  String topicPrefix_;
 };
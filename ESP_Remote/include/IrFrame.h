@@ -0,0 +1,31 @@
+#pragma once
+
+#include <IRremoteESP8266.h>
+#include <stdint.h>
+#include <vector>
+
+// A key press resolved down to what goes on air, so it can be stored and
+// replayed later without looking the key up again (see Scenes).
+struct IrFrame {
+  decode_type_t protocol = decode_type_t::UNKNOWN;
+  uint16_t nbits = 0;
+  uint64_t value = 0;          // frames up to 64 bits
+  std::vector<uint8_t> state;  // wider frames, sent as state bytes
+  uint8_t repeat = 1;          // state frames: copies sent back to back
+  uint16_t repeatGapMs = 0;
+
+  // Same choice as the controllers' sendLearnedKey(): the raw bytes for
+  // frames wider than 64 bits, else the value.
+  static IrFrame fromCode(decode_type_t protocol, uint64_t value,
+                          uint16_t nbits, const std::vector<uint8_t> &raw) {
+    IrFrame frame;
+    frame.protocol = protocol;
+    frame.nbits = nbits;
+    if (!raw.empty() && nbits > 64) {
+      frame.state = raw;
+    } else {
+      frame.value = value;
+    }
+    return frame;
+  }
+};
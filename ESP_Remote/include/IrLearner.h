@@ -3,8 +3,14 @@
 #include <Arduino.h>
 #include <IRrecv.h>
 #include <IRremoteESP8266.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
 #include <vector>
 
+#include "SpscQueue.h"
+
 struct IrLearningResult {
   bool success = false;
   String device;
@@ -14,8 +20,14 @@ struct IrLearningResult {
   uint16_t bits = 0;
   String error;
   std::vector<uint8_t> raw;  // dữ liệu đầy đủ để gửi lại gói >64 bit
+  std::vector<uint8_t> timing;  // nhịp thu được, xem IrWaveform::pack()
 };
 
+// Captures one frame per learn request. The receiver belongs to the "ir_rx"
+// task pinned to IR_TASK_CORE, which also enables it so the capture timer
+// interrupt lands on that core. The network task talks to it through two
+// SPSC rings: startLearning() queues a request, loop() hands finished results
+// to the callback.
 class IrLearner {
  public:
   using ResultCallback = void (*)(const IrLearningResult &result);
@@ -23,31 +35,50 @@ class IrLearner {
   explicit IrLearner(uint8_t recvPin);
 
   void begin();
+  // Network task only: runs the callback for every finished capture.
   void loop();
 
+  // Network task only. Fails at once when the receiver is not up yet, the
+  // key is missing or a capture is already running; a request that loses a
+  // race for the receiver comes back as a "busy" result instead.
   bool startLearning(const String &device, const String &key, String &errorOut);
   bool isLearning() const { return learning_; }
 
   void setResultCallback(ResultCallback cb) { callback_ = cb; }
+  uint32_t taskStackFree() const;
 
  private:
+  struct Request {
+    String device;
+    String key;
+  };
+
+  static void taskEntry(void *arg);
+  void run();
+  void accept(Request &request);
+  void poll();
   void emitResult(bool success, const char *error = nullptr,
                   const String &protocol = String(),
                   const String &code = String(), uint16_t bits = 0,
-                  const uint8_t *raw = nullptr, uint16_t nbytes = 0);
+                  const uint8_t *raw = nullptr, uint16_t nbytes = 0,
+                  std::vector<uint8_t> timing = {});
   void reset();
 
   static constexpr unsigned long kLearningTimeoutMs = 15000UL;
   static constexpr uint16_t kCaptureBuffer = 2000;  // lớn hơn để giữ trọn gói AC
   static constexpr uint8_t kTimeoutMs = 50;         // giữ mặc định 50 ms
+  static constexpr UBaseType_t kTaskPriority = 2;   // same as ir_tx
 
   uint8_t recvPin_;
   IRrecv receiver_;
   decode_results results_{};
-  bool ready_ = false;
-  bool learning_ = false;
+  std::atomic<bool> ready_{false};
+  std::atomic<bool> learning_{false};
   unsigned long startTime_ = 0;
   String device_;
   String key_;
   ResultCallback callback_ = nullptr;
+  TaskHandle_t task_ = nullptr;
+  SpscQueue<Request, 2> requests_;           // network task -> ir_rx
+  SpscQueue<IrLearningResult, 4> finished_;  // ir_rx -> network task
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "IrWaveform.h"
+
+// Records what IRsend puts on the IR pin, as a mark/space pulse train.
+// IRac has no way to hand out the frame it encodes, but every protocol ends
+// in IRsend::ledOn()/ledOff(), i.e. digitalWrite() on the LED pin. On the
+// ESP32 core digitalWrite() is a weak alias, so this module defines it,
+// passes every write through and, while recording, timestamps the LED
+// edges. Carrier cycles are folded back into marks; the carrier frequency
+// and duty cycle are measured from them.
+//
+// One recording at a time, started and finished by the same task. On hosts
+// without the hook nothing is ever recorded.
+namespace IrPinRecorder {
+
+// Starts recording writes to `pin`; `onLevel` is the level that lights the
+// LED. False if a recording is already running.
+bool start(uint8_t pin, uint8_t onLevel);
+
+// Stops recording. The last space runs from the final edge until now. False
+// (and `out` empty) when nothing was sent or the frame did not fit.
+// `firstEdgeUs`, if given, gets the micros() of the first edge.
+bool finish(IrPulseTrain &out, uint32_t *firstEdgeUs = nullptr);
+
+}  // namespace IrPinRecorder
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <vector>
+
+#include "IrWaveform.h"
+
+// A pulse train converted to RMT symbols, ready to be replayed as-is.
+struct IrRmtFrame {
+  uint32_t carrierHz = 38000;
+  uint8_t dutyPercent = 50;
+  std::vector<rmt_item32_t> items;
+  uint32_t trailingGapUs = 0;  // enforced by the caller, not by the RMT
+};
+
+// Drives the IR LED through the ESP32 RMT peripheral. The RMT generates the
+// carrier and the mark/space timings in hardware, so the CPU is free (and
+// Wi-Fi interrupts can't stretch a bit) for the whole frame.
+class IrRmtBackend {
+ public:
+  IrRmtBackend(uint8_t pin, rmt_channel_t channel);
+
+  bool begin();
+  bool ready() const { return ready_; }
+
+  // Converts an encoded pulse train into RMT symbols. Pure data work: do it
+  // once and keep the result.
+  static void build(const IrPulseTrain &train, IrRmtFrame &out);
+
+  // Re-attaches the pin to the RMT (IRsend/IRac may have claimed it as a
+  // plain GPIO in between) and blocks the calling task until the frame is
+  // out.
+  bool transmit(const IrRmtFrame &frame);
+
+ private:
+  void applyCarrier(uint32_t carrierHz, uint8_t dutyPercent);
+
+  uint8_t pin_;
+  rmt_channel_t channel_;
+  bool ready_ = false;
+  uint32_t carrierHz_ = 0;
+  uint8_t dutyPercent_ = 0;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IRac.h>
+#include <IRremoteESP8266.h>
+#include <IRsend.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "AcFrameMemo.h"
+#include "Config.h"
+#include "IrRmtBackend.h"
+#include "SpscQueue.h"
+
+// One unit of IR work. Jobs are copied by value into the ring, so
+// everything (including A/C state bytes) lives inline: enqueueing never
+// allocates. The one exception is `timing`, which only shares a recipe
+// someone else already owns.
+struct IrTransmitJob {
+  enum class Kind : uint8_t {
+    kValue,  // protocol + value + nbits (<= 64 bit)
+    kState,  // protocol + state bytes (A/C style, > 64 bit)
+    kAc,     // IRac::sendAc() with a full stdAc::state_t
+    kPause,  // nothing on air; only holds the next job off by gapAfterMs
+  };
+
+  Kind kind = Kind::kValue;
+  decode_type_t protocol = decode_type_t::UNKNOWN;
+  uint64_t value = 0;
+  uint16_t nbits = 0;
+  uint16_t nbytes = 0;
+  uint8_t state[kStateSizeMax] = {0};
+  stdAc::state_t ac{};
+  // kState only: the captured timing of a learned frame (IrWaveform recipe).
+  std::shared_ptr<const std::vector<uint8_t>> timing;
+  uint8_t repeat = 1;         // number of times the frame is emitted
+  uint16_t repeatGapMs = 0;   // quiet time between repeats
+  uint16_t gapAfterMs = 0;    // quiet time before the next job may start
+  uint32_t enqueuedAtMs = 0;
+};
+
+// Owns the IR LED. Controllers enqueue frames from the MQTT callback and a
+// dedicated FreeRTOS task drains the queue, so mqtt.loop() never waits for a
+// frame to finish. Inter-frame gaps are enforced by the task against a
+// deadline instead of delay() in the caller.
+//
+// The queue is a single-producer ring: every send*() call must come from the
+// network task (the only one that runs controllers). The "ir_tx" task is
+// pinned to IR_TASK_CORE and sleeps on a task notification while the ring is
+// empty.
+//
+// With IR_TX_USE_RMT, value frames of protocols IrWaveform can encode are
+// converted to RMT symbols once, kept in an LRU cache of
+// IR_RMT_FRAME_CACHE_SIZE frames by (protocol, value, nbits) and replayed by
+// the RMT peripheral. State frames that come with a captured
+// timing recipe are unpacked once into an LRU cache capped at
+// IR_STATE_FRAME_CACHE_BYTES, so a repeated A/C key is replayed without any
+// protocol encoding. A/C states sent through IRac are recorded off the LED
+// pin the first time (IrPinRecorder) and replayed from an AcFrameMemo after
+// that. Everything else still goes through IRsend.
+class IrTransmitter {
+ public:
+  struct Stats {
+    uint32_t enqueued = 0;
+    uint32_t dropped = 0;
+    uint32_t sent = 0;
+    uint16_t depth = 0;
+    uint16_t peakDepth = 0;
+    uint32_t lastWaitMs = 0;   // enqueue -> first edge of the last job
+    uint32_t maxWaitMs = 0;
+    uint32_t totalWaitMs = 0;  // divide by `sent` for the mean
+    uint32_t lastStartUs = 0;  // micros() at the first edge of the last job
+    uint32_t rmtFrames = 0;
+    uint32_t frameCacheMisses = 0;
+    uint16_t frameCacheSize = 0;
+    uint32_t stateFrameMisses = 0;
+    uint32_t stateCacheBytes = 0;
+    uint32_t acMemoHits = 0;
+    uint32_t acMemoMisses = 0;
+    uint32_t acMemoBytes = 0;
+    uint32_t taskStackFree = 0;  // bytes of the task's stack never touched
+  };
+
+  explicit IrTransmitter(uint8_t irPin);
+
+  void begin();
+
+  bool sendValue(decode_type_t protocol, uint64_t value, uint16_t nbits,
+                 uint16_t gapAfterMs = 0);
+  // `timing`, when given, is replayed through the RMT instead of encoding
+  // `state` with IRsend.
+  bool sendState(decode_type_t protocol, const uint8_t *state, uint16_t nbytes,
+                 uint8_t repeat = 1, uint16_t repeatGapMs = 0,
+                 uint16_t gapAfterMs = 0,
+                 std::shared_ptr<const std::vector<uint8_t>> timing = {});
+  bool sendAc(const stdAc::state_t &state);
+  // Keeps the LED quiet for `ms` after whatever is queued before it.
+  bool pause(uint16_t ms);
+
+  // Pure bit helpers, kept here so controllers don't need their own IRsend.
+  uint64_t toggleRC5(uint64_t value) { return irSend_.toggleRC5(value); }
+  uint64_t toggleRC6(uint64_t value, uint16_t nbits) {
+    return irSend_.toggleRC6(value, nbits);
+  }
+
+  uint8_t pin() const { return irPin_; }
+  // Frames accepted (pauses not counted) and refused so far; cheaper than
+  // stats() for per-command deltas.
+  uint32_t enqueued() const { return enqueued_; }
+  uint32_t dropped() const { return dropped_; }
+  // Jobs that can be queued right now without a drop. Network task only.
+  size_t freeSlots() const { return queue_.capacity() - queue_.size(); }
+  Stats stats() const;
+
+ private:
+  struct FrameKey {
+    decode_type_t protocol;
+    uint16_t nbits;
+    uint64_t value;
+    bool operator==(const FrameKey &other) const {
+      return protocol == other.protocol && nbits == other.nbits &&
+             value == other.value;
+    }
+  };
+  struct FrameKeyHash {
+    size_t operator()(const FrameKey &key) const {
+      return static_cast<size_t>(key.value ^ (key.value >> 32)) ^
+             (static_cast<size_t>(key.protocol) << 16) ^ key.nbits;
+    }
+  };
+
+  struct ValueFrame {
+    FrameKey key;
+    IrRmtFrame frame;
+  };
+  using ValueFrameList = std::list<ValueFrame>;
+
+  // Keyed by the recipe it was built from; holding the pointer keeps its
+  // address from being reused by another recipe while the entry lives.
+  struct StateFrame {
+    std::shared_ptr<const std::vector<uint8_t>> recipe;
+    IrRmtFrame frame;
+  };
+
+  static void taskEntry(void *arg);
+  bool enqueue(IrTransmitJob &job);
+  void run();
+  uint32_t transmit(const IrTransmitJob &job);
+  const IrRmtFrame *rmtFrameFor(const IrTransmitJob &job);
+  const IrRmtFrame *stateFrameFor(const IrTransmitJob &job);
+  uint32_t transmitAc(const stdAc::state_t &state);
+  void claimPinForIrSend();
+  void waitForQuietPeriod();
+
+  static constexpr uint32_t kTaskStackBytes = 4096;
+  static constexpr UBaseType_t kTaskPriority = 2;
+
+  uint8_t irPin_;
+  IRsend irSend_;
+  IRac irAc_;
+  IrRmtBackend rmt_;
+  bool pinOnRmt_ = false;
+  ValueFrameList frameCache_;  // most recently sent first
+  std::unordered_map<FrameKey, ValueFrameList::iterator, FrameKeyHash>
+      frameIndex_;
+  std::list<StateFrame> stateCache_;  // most recently sent first
+  AcFrameMemo acMemo_;
+  SpscQueue<IrTransmitJob, IR_TX_QUEUE_DEPTH> queue_;
+  TaskHandle_t task_ = nullptr;
+  uint32_t quietUntilMs_ = 0;
+
+  volatile uint32_t enqueued_ = 0;
+  volatile uint32_t dropped_ = 0;
+  volatile uint32_t sent_ = 0;
+  volatile uint16_t peakDepth_ = 0;
+  volatile uint32_t lastWaitMs_ = 0;
+  volatile uint32_t maxWaitMs_ = 0;
+  volatile uint32_t totalWaitMs_ = 0;
+  volatile uint32_t lastStartUs_ = 0;
+  volatile uint32_t rmtFrames_ = 0;
+  volatile uint32_t frameCacheMisses_ = 0;
+  volatile uint16_t frameCacheSize_ = 0;  // frameCache_ is owned by the task
+  volatile uint32_t stateFrameMisses_ = 0;
+  volatile uint32_t stateCacheBytes_ = 0;  // as is stateCache_
+  volatile uint32_t acMemoHits_ = 0;        // and acMemo_
+  volatile uint32_t acMemoMisses_ = 0;
+  volatile uint32_t acMemoBytes_ = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <IRremoteESP8266.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Platform-independent IR frame encoder. Turns protocol/value/nbits into the
+// exact mark/space list IRsend would bit-bang, so the frame can be handed to
+// a hardware peripheral (RMT) in one go. Nothing here touches Arduino APIs,
+// which keeps the encoder buildable on a workstation.
+struct IrPulseTrain {
+  uint32_t carrierHz = 38000;
+  uint8_t dutyPercent = 50;
+  // Microseconds, alternating mark/space and always starting with a mark.
+  // The final entry is the trailing space IRsend leaves before the next frame.
+  std::vector<uint32_t> durations;
+};
+
+namespace IrWaveform {
+
+// True when encode() can produce a pulse train for this protocol. Other
+// protocols must go through IRsend.
+bool isSupported(decode_type_t protocol);
+
+// Encodes a <= 64-bit frame, including the repeats IRsend::send() adds by
+// default (e.g. Sony is always sent three times). Returns false and leaves
+// `out` empty for unsupported protocols or bit counts.
+bool encode(decode_type_t protocol, uint64_t value, uint16_t nbits,
+            IrPulseTrain &out);
+
+// Learned frames wider than 64 bits (A/C states) have no encoder here, so
+// the capture a key was learned from is kept instead, as a compact timing
+// recipe: every duration snapped to one of at most 16 mark and 16 space
+// levels, one byte per mark/space pair. pack() returns false for captures
+// too irregular for that; those keys keep going through IRsend.
+//
+// Recipe (little endian): u8 mark levels M, u8 space levels S, (M + S) u16
+// level durations in us, u16 pair count, then per pair u8 (mark << 4 |
+// space).
+//
+// `markExcessUs` is taken off every mark and added to every space: IRrecv
+// reads marks long by about 50 us, the default; pass 0 for exact timings.
+bool pack(const std::vector<uint32_t> &capturedUs,
+          std::vector<uint8_t> &recipe, uint32_t markExcessUs = 50);
+bool unpack(const uint8_t *recipe, size_t length, IrPulseTrain &out);
+
+}  // namespace IrWaveform
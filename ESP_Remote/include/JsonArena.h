@@ -0,0 +1,47 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator for short-lived JsonDocuments (one MQTT message at a time).
+// Blocks are carved from a fixed buffer and the arena rewinds once every block
+// has been released, so parsing a command does not touch the heap. Requests
+// that do not fit fall back to malloc() and are counted.
+//
+// Not thread-safe: use it from the task that owns the documents.
+class JsonArena : public ArduinoJson::Allocator {
+ public:
+  struct Stats {
+    uint32_t allocations = 0;
+    uint32_t heapFallbacks = 0;
+    uint32_t peakBytes = 0;
+    uint32_t capacity = 0;
+  };
+
+  JsonArena(uint8_t *buffer, size_t capacity);
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t newSize) override;
+
+  Stats stats() const;
+
+ private:
+  struct Header {
+    size_t size;
+  };
+
+  bool owns(const void *ptr) const;
+  Header *headerOf(void *ptr) const;
+  static size_t alignUp(size_t size);
+
+  uint8_t *buffer_;
+  size_t capacity_;
+  size_t used_ = 0;
+  size_t last_ = SIZE_MAX;  // offset of the most recent block's header
+  uint16_t live_ = 0;
+  uint32_t allocations_ = 0;
+  uint32_t heapFallbacks_ = 0;
+  size_t peak_ = 0;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PerfectHash.h"
+
+// Every key name that appears in a built-in codeset table, plus the few keys
+// the controllers synthesize themselves (channel digits, DASH). Keep DIGIT_0..9
+// contiguous: KeyIds::digit() relies on it.
+#define IR_BUILTIN_KEYS(X)        \
+  X(kPower, "POWER")              \
+  X(kPowerOff, "POWER_OFF")       \
+  X(kMute, "MUTE")                \
+  X(kVolUp, "VOL_UP")             \
+  X(kVolDown, "VOL_DOWN")         \
+  X(kChUp, "CH_UP")               \
+  X(kChDown, "CH_DOWN")           \
+  X(kTvAv, "TV_AV")               \
+  X(kSource, "SOURCE")            \
+  X(kMenu, "MENU")                \
+  X(kExit, "EXIT")                \
+  X(kHome, "HOME")                \
+  X(kBack, "BACK")                \
+  X(kOk, "OK")                    \
+  X(kUp, "UP")                    \
+  X(kDown, "DOWN")                \
+  X(kLeft, "LEFT")                \
+  X(kRight, "RIGHT")              \
+  X(kMore, "MORE")                \
+  X(kInfo, "INFO")                \
+  X(kDigit0, "DIGIT_0")           \
+  X(kDigit1, "DIGIT_1")           \
+  X(kDigit2, "DIGIT_2")           \
+  X(kDigit3, "DIGIT_3")           \
+  X(kDigit4, "DIGIT_4")           \
+  X(kDigit5, "DIGIT_5")           \
+  X(kDigit6, "DIGIT_6")           \
+  X(kDigit7, "DIGIT_7")           \
+  X(kDigit8, "DIGIT_8")           \
+  X(kDigit9, "DIGIT_9")           \
+  X(kDash, "DASH")                \
+  X(kPageUp, "PAGE_UP")           \
+  X(kPageDown, "PAGE_DOWN")       \
+  X(kRed, "RED")                  \
+  X(kGreen, "GREEN")              \
+  X(kYellow, "YELLOW")            \
+  X(kBlue, "BLUE")                \
+  X(kUsb, "USB")                  \
+  X(kPlayPause, "PLAY_PAUSE")     \
+  X(kStop, "STOP")                \
+  X(kFf, "FF")                    \
+  X(kRew, "REW")                  \
+  X(kNext, "NEXT")                \
+  X(kPrev, "PREV")                \
+  X(kEject, "EJECT")              \
+  X(kSubtitle, "SUBTITLE")        \
+  X(kTitle, "TITLE")              \
+  X(kVideo, "VIDEO")              \
+  X(kZoomIn, "ZOOM_IN")           \
+  X(kZoomOut, "ZOOM_OUT")         \
+  X(kTrapUp, "TRAP_UP")           \
+  X(kTrapDown, "TRAP_DOWN")       \
+  X(kFreeze, "FREEZE")            \
+  X(kType, "TYPE")                \
+  X(kTimer, "TIMER")              \
+  X(kSwing, "SWING")              \
+  X(kSpeedUp, "SPEED_UP")         \
+  X(kSpeedDown, "SPEED_DOWN")
+
+// Interned key name. Built-in names get fixed ids at compile time; names only
+// ever seen in learned commands are interned at runtime from kFirstCustom on.
+enum class KeyId : uint16_t {
+  kNone = 0,
+#define IR_KEY_ENUM(id, name) id,
+  IR_BUILTIN_KEYS(IR_KEY_ENUM)
+#undef IR_KEY_ENUM
+  kFirstCustom,
+};
+
+// Name -> id entry, used for the built-in table and for per-device aliases.
+struct KeyName {
+  const char *key;
+  KeyId id;
+};
+
+namespace KeyIds {
+
+constexpr size_t kMaxNameLength = 31;
+constexpr size_t kBuiltinCount = static_cast<size_t>(KeyId::kFirstCustom);
+
+constexpr KeyName kBuiltinNames[] = {
+#define IR_KEY_NAME(id, name) {name, KeyId::id},
+    IR_BUILTIN_KEYS(IR_KEY_NAME)
+#undef IR_KEY_NAME
+};
+
+// Compile-time lookup for table generation; kNone for unknown names.
+constexpr KeyId builtin(const char *name) {
+  for (const KeyName &entry : kBuiltinNames) {
+    if (PerfectHash::equalsFolded(entry.key, name)) return entry.id;
+  }
+  return KeyId::kNone;
+}
+
+constexpr KeyId digit(char c) {
+  return (c >= '0' && c <= '9')
+             ? static_cast<KeyId>(static_cast<uint16_t>(KeyId::kDigit0) +
+                                  (c - '0'))
+             : KeyId::kNone;
+}
+
+// Device-specific spellings, checked before the shared names (the TV maps
+// INFO to MORE while the projector maps MORE to INFO).
+template <size_t N>
+struct AliasTable {
+  const KeyName *entries;
+  PerfectHash::NameIndex<N> index;
+};
+
+template <size_t N>
+constexpr AliasTable<N> makeAliasTable(const KeyName (&entries)[N]) {
+  return AliasTable<N>{entries, PerfectHash::buildNameIndex(entries)};
+}
+
+// Trims surrounding whitespace and upper-cases `name` into `out`. False for
+// blank or over-long names.
+bool normalize(const char *name, char (&out)[kMaxNameLength + 1]);
+
+bool isBlank(const char *name);
+
+// Lookups never allocate and return kNone for names that are neither
+// built-in nor interned yet.
+KeyId findNormalized(const char *normalized);
+KeyId find(const char *name);
+
+// Like find(), but registers unknown names. Only learning goes through here,
+// so the (rare) allocation stays off the key-press path.
+KeyId internNormalized(const char *normalized);
+KeyId intern(const char *name);
+
+// Canonical upper-case name, "" for kNone/unknown ids.
+const char *name(KeyId id);
+
+template <size_t N>
+KeyId resolve(const char *name, const AliasTable<N> &aliases) {
+  char normalized[kMaxNameLength + 1];
+  if (!normalize(name, normalized)) return KeyId::kNone;
+  const KeyName *alias =
+      PerfectHash::findName(aliases.index, aliases.entries, normalized);
+  return alias != nullptr ? alias->id : findNormalized(normalized);
+}
+
+template <size_t N>
+KeyId resolveOrIntern(const char *name, const AliasTable<N> &aliases) {
+  char normalized[kMaxNameLength + 1];
+  if (!normalize(name, normalized)) return KeyId::kNone;
+  const KeyName *alias =
+      PerfectHash::findName(aliases.index, aliases.entries, normalized);
+  return alias != nullptr ? alias->id : internNormalized(normalized);
+}
+
+}  // namespace KeyIds
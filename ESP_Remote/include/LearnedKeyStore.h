@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "LearnedKeyTable.h"
+
+// Where learned tables are persisted: one blob per device. The NVS backend
+// is the default; the interface lets a RAM stand-in replace flash off-target.
+class LearnedStoreBackend {
+ public:
+  virtual ~LearnedStoreBackend() = default;
+  // False if the blob does not exist or cannot be read.
+  virtual bool read(const char *name, std::vector<uint8_t> &out) = 0;
+  virtual bool write(const char *name, const uint8_t *data, size_t length) = 0;
+  virtual bool erase(const char *name) = 0;
+};
+
+// Persistence for LearnedKeyTable. A table opts in with persistAs(name); it
+// is then loaded lazily on first use and written back by loop() once it has
+// been idle for IR_LEARNED_WRITE_DELAY_MS, so a burst of learns costs one
+// flash write.
+//
+// Blob layout (little endian):
+//   header  "LK" u8 version, u8 count, u16 payload length, u32 CRC-32(payload)
+//   record  u8 nameLen, name, i16 protocol, u16 nbits, u8 codeLen, code,
+//           u16 timingLen, timing
+// `code` is the value trimmed to (nbits + 7) / 8 bytes for frames up to 64
+// bits, and the raw state bytes for wider frames. `timing` is the capture
+// recipe of a wide frame (LearnedKey::timing), possibly empty; version 1
+// blobs have no timing fields. Names, not KeyIds, are stored because
+// runtime-interned ids are not stable across boots.
+namespace LearnedKeyStore {
+
+struct Stats {
+  uint32_t loads = 0;
+  uint32_t loadErrors = 0;  // bad header/CRC; the table starts empty
+  uint32_t writes = 0;
+  uint32_t writeErrors = 0;
+  uint32_t lastWriteBytes = 0;
+};
+
+// nullptr restores the NVS backend.
+void setBackend(LearnedStoreBackend *backend);
+
+// Called by LearnedKeyTable::persistAs().
+void track(LearnedKeyTable &table);
+bool load(const char *name, std::vector<LearnedKey> &out);
+
+// Writes tables whose coalescing window has elapsed.
+void loop();
+// Writes every dirty table now.
+void flushAll();
+
+Stats stats();
+
+void encode(const std::vector<LearnedKey> &entries, std::vector<uint8_t> &out);
+bool decode(const uint8_t *data, size_t length, std::vector<LearnedKey> &out);
+
+}  // namespace LearnedKeyStore
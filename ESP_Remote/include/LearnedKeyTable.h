@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <IRremoteESP8266.h>
+#include <memory>
+#include <vector>
+
+#include "KeyId.h"
+
+struct LearnedKey {
+  KeyId id = KeyId::kNone;
+  decode_type_t protocol = decode_type_t::UNKNOWN;
+  uint64_t value = 0;  // 0 for frames wider than 64 bits, see raw
+  uint16_t nbits = 0;
+  std::vector<uint8_t> raw;
+  // Wide frames learned from the receiver: the capture, as an IrWaveform
+  // recipe, so IrTransmitter can replay it instead of encoding `raw`. Shared
+  // so queued frames keep it alive across a relearn.
+  std::shared_ptr<const std::vector<uint8_t>> timing;
+};
+
+// Learned IR codes of one controller, keyed by interned KeyId so a press is
+// an integer compare per entry instead of re-canonicalizing every name.
+class LearnedKeyTable {
+ public:
+  // Adds or replaces the code for `id`. False for kNone, UNKNOWN, 0 bits or
+  // a full table. `timing` (wide frames only) replaces the kept capture; an
+  // empty one keeps it as long as the code itself is unchanged.
+  bool save(KeyId id, decode_type_t protocol, uint64_t value, uint16_t nbits,
+            const std::vector<uint8_t> &raw = {},
+            const std::vector<uint8_t> &timing = {});
+  // Same, from the {"protocol", "code", "bits"} object a key command may
+  // carry. `code` is hex, left-padded to the frame size.
+  bool saveFromJson(KeyId id, JsonObjectConst ir);
+  const LearnedKey *find(KeyId id);
+  size_t size();
+
+  // Keeps the table in LearnedKeyStore under `name` (a string literal such
+  // as deviceType()). Nothing is read until the table is first used.
+  void persistAs(const char *name);
+  const char *persistName() const { return persistName_; }
+
+  // Write-back bookkeeping for LearnedKeyStore.
+  bool dirty() const { return dirty_; }
+  uint32_t dirtySinceMs() const { return dirtySinceMs_; }
+  uint32_t lastChangeMs() const { return lastChangeMs_; }
+  const std::vector<LearnedKey> &entries() const { return entries_; }
+  void markClean() { dirty_ = false; }
+
+ private:
+  void ensureLoaded();
+  void markDirty();
+
+  std::vector<LearnedKey> entries_;
+  const char *persistName_ = nullptr;
+  bool loaded_ = true;  // nothing to load until persistAs()
+  bool dirty_ = false;
+  uint32_t dirtySinceMs_ = 0;
+  uint32_t lastChangeMs_ = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Compile-time log levels; pick one with -DLOG_LEVEL=... in build_flags.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// printf-style, one line per call (the newline is added). Lines above
+// LOG_LEVEL compile to nothing: the format is still type-checked but the
+// arguments are never evaluated.
+#define LOG_AT_(level, ...)                          \
+  do {                                               \
+    if (LOG_LEVEL >= (level)) Log::write(__VA_ARGS__); \
+  } while (0)
+
+#define LOG_E(...) LOG_AT_(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_W(...) LOG_AT_(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_I(...) LOG_AT_(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_D(...) LOG_AT_(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Buffered Serial sink: callers format into a fixed-size line and queue it
+// without blocking; a low-priority task does the slow UART writes. Lines that
+// do not fit in the queue are dropped and counted.
+namespace Log {
+
+struct Stats {
+  uint32_t written = 0;    // lines accepted (queued, or printed before begin())
+  uint32_t dropped = 0;    // queue full
+  uint32_t truncated = 0;  // longer than LOG_LINE_BYTES
+  uint16_t peakQueued = 0;
+  uint32_t taskStackFree = 0;  // bytes of the drain task's stack never touched
+};
+
+// Starts the drain task on NET_TASK_CORE, away from IR timing; call after
+// Serial.begin(). Until then lines are
+// written to Serial synchronously.
+void begin();
+
+// Safe from any task, not from ISRs. Use the LOG_x macros instead.
+void write(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+Stats stats();
+
+}  // namespace Log
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class DeviceManager;
+
+// Counters and fixed-bucket latency histograms, published as one compact JSON
+// snapshot on iot/nodes/<id>/metrics. Everything is updated from the network
+// task (MQTT callback, controllers, its main loop), so plain integers suffice.
+// Counters only grow; watchers diff consecutive snapshots.
+namespace Metrics {
+
+// Bucket upper bounds in microseconds; one more bucket catches the rest.
+constexpr uint32_t kBucketBoundsUs[] = {50,   100,   250,   500,   1000,
+                                        2500, 5000, 10000, 25000, 100000};
+constexpr size_t kBucketCount =
+    sizeof(kBucketBoundsUs) / sizeof(kBucketBoundsUs[0]) + 1;
+
+class Histogram {
+ public:
+  void record(uint32_t us);
+  uint32_t count() const { return count_; }
+  // {"n":..,"sum_us":..,"max_us":..,"b":[per-bucket counts]}
+  void toJson(JsonObject out) const;
+
+ private:
+  uint32_t buckets_[kBucketCount] = {};
+  uint32_t count_ = 0;
+  uint64_t sumUs_ = 0;
+  uint32_t maxUs_ = 0;
+};
+
+// Kept by each DeviceController.
+struct DeviceCounters {
+  uint32_t commands = 0;     // messages handed to the controller
+  uint32_t irFrames = 0;     // frames its commands got into the IR queue
+  uint32_t unknownKeys = 0;  // no learned code and no built-in code
+  uint32_t learnedHits = 0;  // frames sent from a learned code
+  uint32_t codesetHits = 0;  // frames sent from the built-in codesets/models
+  uint32_t coalesced = 0;    // state changes merged into a later frame
+  Histogram commandUs;       // MQTT callback entry -> handleCommand() returned
+};
+
+struct NodeCounters {
+  uint32_t parseErrors = 0;
+  uint32_t mqttReconnects = 0;  // successful connects after the first
+  uint32_t stateUnchanged = 0;  // state publishes skipped, nothing changed
+  Histogram loopUs;             // one network task iteration
+};
+
+NodeCounters &node();
+
+// Fills `doc` with the node counters, heap figures and one object per
+// registered controller, keyed by device type. Empty histograms are left out.
+void snapshot(DeviceManager &devices, JsonDocument &doc);
+
+}  // namespace Metrics
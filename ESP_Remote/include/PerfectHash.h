@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Case-folded string hashing shared by the compile-time lookup tables
+// (CodesetIndex, KeyIds). Everything here is constexpr so the tables can be
+// generated by the compiler and stored in flash.
+namespace PerfectHash {
+
+constexpr char fold(char c) {
+  return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// Case-insensitive equality; nullptr compares equal to "".
+constexpr bool equalsFolded(const char *a, const char *b) {
+  if (a == nullptr) a = "";
+  if (b == nullptr) b = "";
+  while (*a != '\0' && fold(*a) == fold(*b)) {
+    ++a;
+    ++b;
+  }
+  return fold(*a) == fold(*b);
+}
+
+constexpr uint32_t mix(uint32_t h, uint8_t byte) {
+  return (h ^ byte) * 16777619UL;  // FNV-1a step
+}
+
+constexpr uint32_t mixText(uint32_t h, const char *s) {
+  if (s != nullptr) {
+    for (; *s != '\0'; ++s) h = mix(h, static_cast<uint8_t>(fold(*s)));
+  }
+  return mix(h, 0);  // field separator, so ("AB","C") != ("A","BC")
+}
+
+constexpr uint32_t seedBasis(uint32_t seed) {
+  return 2166136261UL ^ (seed * 0x9E3779B1UL);
+}
+
+constexpr uint32_t finish(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85EBCA6BUL;
+  h ^= h >> 13;
+  return h;
+}
+
+constexpr uint32_t hashText(const char *text, uint32_t seed) {
+  return finish(mixText(seedBasis(seed), text));
+}
+
+// Power-of-two slot count with a load factor of at most 1/loadDivisor.
+constexpr size_t slotsFor(size_t entries, size_t loadDivisor) {
+  size_t slots = entries > 0 ? 1 : 0;
+  while (slots > 0 && slots < entries * loadDivisor) slots <<= 1;
+  return slots;
+}
+
+constexpr uint32_t kMaxSeed = 0xFFFF;
+constexpr size_t kLoadDivisor = 4;
+constexpr size_t kMaxEntries = 254;  // slots store position + 1 in a uint8_t
+
+// Name -> entry index over a constexpr array of entries with a `key` member.
+template <size_t N>
+struct NameIndex {
+  static constexpr size_t kSlots = slotsFor(N, kLoadDivisor);
+
+  uint16_t seed = 0;
+  bool complete = false;
+  uint8_t slots[kSlots] = {};
+};
+
+template <typename Entry, size_t N>
+constexpr NameIndex<N> buildNameIndex(const Entry (&entries)[N]) {
+  NameIndex<N> out{};
+  constexpr size_t mask = NameIndex<N>::kSlots - 1;
+  if (N > kMaxEntries) return out;
+
+  for (uint32_t seed = 0; seed <= kMaxSeed; ++seed) {
+    for (size_t i = 0; i <= mask; ++i) out.slots[i] = 0;
+    bool ok = true;
+    for (size_t e = 0; ok && e < N; ++e) {
+      const size_t slot = hashText(entries[e].key, seed) & mask;
+      if (out.slots[slot] == 0) {
+        out.slots[slot] = static_cast<uint8_t>(e + 1);
+        continue;
+      }
+      // Repeated names: the first one wins, as in a linear scan.
+      ok = equalsFolded(entries[out.slots[slot] - 1].key, entries[e].key);
+    }
+    if (ok) {
+      out.seed = static_cast<uint16_t>(seed);
+      out.complete = true;
+      return out;
+    }
+  }
+  return out;
+}
+
+template <typename Entry, size_t N>
+const Entry *findName(const NameIndex<N> &index, const Entry *entries,
+                      const char *key) {
+  constexpr size_t mask = NameIndex<N>::kSlots - 1;
+  const uint8_t position = index.slots[hashText(key, index.seed) & mask];
+  if (position == 0) return nullptr;
+  const Entry *entry = &entries[position - 1];
+  return equalsFolded(entry->key, key) ? entry : nullptr;
+}
+
+}  // namespace PerfectHash
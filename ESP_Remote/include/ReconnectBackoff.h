@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Retry schedule for a connection that is re-established from loop(): the
+// delay doubles from minDelayMs up to maxDelayMs and is jittered so a room
+// of nodes does not hit a restarted broker in lockstep. Pure bookkeeping on
+// caller-supplied time, so it can be stepped with a fake clock off-target.
+class ReconnectBackoff {
+ public:
+  ReconnectBackoff(uint32_t minDelayMs, uint32_t maxDelayMs,
+                   uint8_t attemptBudget);
+
+  // True when the next attempt may start.
+  bool due(uint32_t nowMs) const;
+  // Records a failed attempt and schedules the next one. `entropy` is any
+  // random 32-bit value; the delay lands in [cap / 2, cap].
+  void failed(uint32_t nowMs, uint32_t entropy);
+  // Clears the failure streak; the next attempt is due immediately.
+  void succeeded();
+
+  // True once `attemptBudget` attempts in a row have failed, i.e. the
+  // caller should stop retrying the same target and re-resolve it.
+  bool budgetExhausted() const { return budgetFailures_ >= attemptBudget_; }
+  void resetBudget() { budgetFailures_ = 0; }
+
+  uint32_t failures() const { return failures_; }
+  uint32_t lastDelayMs() const { return lastDelayMs_; }
+  uint32_t retryInMs(uint32_t nowMs) const;
+
+ private:
+  uint32_t minDelayMs_;
+  uint32_t maxDelayMs_;
+  uint8_t attemptBudget_;
+  uint32_t failures_ = 0;
+  uint8_t budgetFailures_ = 0;
+  uint32_t lastFailureMs_ = 0;
+  uint32_t lastDelayMs_ = 0;
+};
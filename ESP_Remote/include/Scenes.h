@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CommandBatch.h"
+#include "DeviceManager.h"
+#include "IrTransmitter.h"
+
+class AcController;
+
+// Named multi-device sequences kept on the node, so "home theatre on" is one
+// message on iot/nodes/<id>/scene/run instead of a round trip per device.
+// A scene is compiled when it is uploaded: every key is resolved against the
+// controller's learned codes and codesets right then and the scene stores
+// the frames themselves, so running it only walks its bytes and queues them.
+// A/C steps store a state instead and go through AcController, which keeps
+// its state, NVS copy and MQTT state in step.
+//
+// Upload, on scene/set ("gapMs" on the scene is the default for its steps):
+//   {"name":"cinema","gapMs":300,"steps":[
+//     {"device":"tv","key":"POWER","gapMs":800},
+//     {"device":"stb","key":"POWER","repeat":1},
+//     {"device":"ac","power":true,"mode":"cool","temp":24}]}
+// Fields an A/C step leaves out keep the A/C's state at upload time.
+//
+// Compiled scene (little endian):
+//   "SN" u8 version, u8 step count, then per step
+//   u8 kind, u8 controller index, u8 presses, u16 gap after each press, and
+//     kValue  u16 protocol, u8 bits, u64 value
+//     kState  u16 protocol, u8 copies, u16 copy gap, u8 length + bytes
+//     kAc     u8 flags (bit 0 power, bit 1 swing), i8 temp, then mode and
+//             fan as u8 length + bytes
+// All scenes share one NVS blob: u8 count, then per scene u8 name length +
+// name and u16 length + compiled scene, then a CRC-32 of what precedes it.
+namespace Scenes {
+
+struct Stats {
+  uint32_t scenes = 0;
+  uint32_t runs = 0;
+  uint32_t loadErrors = 0;  // bad blob; started with no scenes
+  uint32_t writes = 0;
+  uint32_t writeErrors = 0;
+};
+
+// Loads the stored scenes. Call after the controllers' begin().
+void begin(DeviceManager &devices, IrTransmitter &ir, AcController &ac);
+
+// Compiles `scene` and stores it, replacing one with the same name. On
+// failure nothing changes and `error` (plus `errorStep`, or -1) says why.
+bool define(JsonObjectConst scene, const char *&error, int &errorStep);
+bool remove(const char *name);
+
+// Queues the scene's frames. Like a batch, it is refused as a whole when
+// they do not fit in the free IR queue slots.
+void run(const char *name, CommandBatch::Result &result);
+
+void list(JsonArray out);
+Stats stats();
+
+}  // namespace Scenes
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "DeviceManager.h"
+
+// Timed commands run by the node itself, so "A/C off at 02:00" does not
+// depend on the phone app staying online. A job is a device command or a
+// scene run, fired once ("at" / "inMs") or on a five-field cron rule in
+// local time (SCHED_TIMEZONE):
+//
+//   {"name":"ac-off","cron":"0 2 * * *","device":"ac",
+//    "command":{"cmd":"power","value":false}}
+//   {"name":"movie","inMs":1500,"scene":"cinema"}
+//   {"name":"wake","at":1767225600,"device":"tv","command":{"cmd":"key",
+//    "key":"POWER"}}
+//
+// Cron fields are minute, hour, day of month, month and day of week (0 or
+// 7 is Sunday); each is "*" or a list of numbers and ranges, with an
+// optional "/step". As in cron, a rule restricting both day fields fires
+// on either. Pending jobs sit in a min-heap keyed by due time (TimerHeap),
+// so arming one is O(log n) and loop() only looks at the earliest. A fired
+// job is handed back as a topic suffix and payload, and goes through the
+// same dispatch as an MQTT message. Cron jobs are re-armed from their own
+// due time rather than from when they ran, so a late loop does not drift.
+//
+// Jobs are kept in NVS (namespace "sched") as one JSON blob with a CRC-32.
+namespace Scheduler {
+
+struct Stats {
+  uint32_t jobs = 0;
+  uint32_t fired = 0;
+  uint32_t missed = 0;      // due more than SCHED_LATE_LIMIT_MS ago; skipped
+  uint32_t lateMaxMs = 0;   // worst time between due and fired
+  uint32_t loadErrors = 0;  // bad blob; started with no jobs
+  uint32_t writes = 0;
+  uint32_t writeErrors = 0;
+};
+
+using FireCallback = void (*)(const char *topicSuffix, const char *payload,
+                              size_t length);
+
+// Loads the stored jobs and applies SCHED_TIMEZONE. Nothing is armed until
+// loop() first sees a set clock.
+void begin(DeviceManager &devices, FireCallback fire);
+
+// Unix time in ms, or 0 while the clock has not been set (no SNTP yet).
+uint64_t clockMs();
+
+// Fires every job due by `nowMs` (Unix ms; 0 does nothing).
+void loop(uint64_t nowMs);
+
+// The wall clock was set or stepped (SNTP sync); the next loop() re-arms
+// the cron jobs from the new time. Safe to call from any task.
+void clockAdjusted();
+
+// Stores `job`, replacing one with the same name. On failure nothing
+// changes and `error` says why. `nowMs` is as for loop().
+bool define(JsonObjectConst job, uint64_t nowMs, const char *&error);
+bool remove(const char *name);
+
+// [{"name":..,"cron":..,"dueMs":..}]; "dueMs" is absent until the clock
+// is set.
+void list(JsonArray out);
+Stats stats();
+
+}  // namespace Scheduler
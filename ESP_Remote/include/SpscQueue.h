@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+
+// Bounded lock-free ring between exactly one producer task and exactly one
+// consumer task. Slots live inline, so a queue that is a global or a member
+// never touches the heap; push() and pop() are a couple of atomic loads and
+// one release store, with no critical section, so they are cheap enough for
+// the IR core. Neither side blocks: pair the queue with a task notification
+// (xTaskNotifyGive after push, ulTaskNotifyTake when pop finds it empty) or
+// poll it from a loop.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+ public:
+  // Producer side. Returns false (and leaves `item` alone) when full.
+  template <typename U>
+  bool push(U &&item) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= Capacity) return false;
+    slots_[tail & kMask] = std::forward<U>(item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T &out) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    out = std::move(slots_[head & kMask]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either side; a snapshot that may be stale by the time it is used.
+  size_t size() const {
+    // Head first: it never passes the tail, so the difference cannot wrap.
+    const uint32_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr size_t capacity() { return Capacity; }
+
+ private:
+  static constexpr uint32_t kMask = Capacity - 1;
+
+  T slots_[Capacity];
+  std::atomic<uint32_t> head_{0};  // next slot to pop; written by the consumer
+  std::atomic<uint32_t> tail_{0};  // next slot to fill; written by the producer
+};
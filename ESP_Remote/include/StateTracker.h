@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Last state a controller published, so state that did not change is not
+// published again. Every change bumps a sequence number; clients drop
+// messages whose "seq" they have already seen and ask for a snapshot
+// ({"cmd":"state"}) when "seq" skips, which also covers deltas lost while
+// they were offline. "seq" restarts at 1 after a reboot, so a snapshot
+// always replaces whatever the client had.
+class StateTracker {
+ public:
+  enum class Publish : uint8_t {
+    kNothing,   // unchanged and no snapshot wanted; `out` is empty
+    kSnapshot,  // `out` is the whole state
+    kDelta,     // `out` holds only the changed members (removed ones as null)
+  };
+
+  // Compares `state` (a serializeState() document) with the last one and
+  // fills `out` with what to publish, stamped with "seq" and "updatedAt"
+  // (millis() of the last change). A snapshot is produced when `snapshot` is
+  // set or `deltas` is not, otherwise a delta; either only when something
+  // changed unless `snapshot` is set.
+  Publish update(JsonObjectConst state, bool snapshot, bool deltas,
+                 JsonDocument &out);
+
+  uint32_t seq() const { return seq_; }
+  uint32_t changedAtMs() const { return changedAtMs_; }
+
+ private:
+  JsonDocument last_;  // heap; a few hundred bytes for the A/C
+  uint32_t seq_ = 0;
+  uint32_t changedAtMs_ = 0;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary min-heap of due times over a fixed set of slots (0..Capacity-1),
+// for the Scheduler. push(), pop() and erase() are O(log n); each slot's
+// position is tracked, so a slot can be re-armed or cancelled without a scan.
+// Equal due times come out in the order they were pushed.
+template <size_t Capacity>
+class TimerHeap {
+  static_assert(Capacity > 0 && Capacity < UINT8_MAX,
+                "TimerHeap slots are uint8_t");
+
+ public:
+  TimerHeap() { clear(); }
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  bool contains(uint8_t slot) const {
+    return slot < Capacity && where_[slot] != kAbsent;
+  }
+  // Only valid when not empty().
+  uint8_t topSlot() const { return entries_[0].slot; }
+  uint64_t topDue() const { return entries_[0].due; }
+
+  // Arms `slot` for `due`, moving it if it was already armed.
+  void push(uint8_t slot, uint64_t due) {
+    if (slot >= Capacity) return;
+    erase(slot);
+    const size_t at = size_++;
+    entries_[at] = {due, order_++, slot};
+    where_[slot] = static_cast<uint8_t>(at);
+    siftUp(at);
+  }
+
+  uint8_t pop() {
+    const uint8_t slot = entries_[0].slot;
+    removeAt(0);
+    return slot;
+  }
+
+  void erase(uint8_t slot) {
+    if (contains(slot)) removeAt(where_[slot]);
+  }
+
+  void clear() {
+    size_ = 0;
+    for (size_t i = 0; i < Capacity; ++i) where_[i] = kAbsent;
+  }
+
+ private:
+  static constexpr uint8_t kAbsent = UINT8_MAX;
+
+  struct Entry {
+    uint64_t due;
+    uint32_t order;  // push order; breaks ties between equal due times
+    uint8_t slot;
+  };
+
+  static bool before(const Entry &a, const Entry &b) {
+    if (a.due != b.due) return a.due < b.due;
+    return static_cast<int32_t>(a.order - b.order) < 0;
+  }
+
+  void place(size_t at, const Entry &entry) {
+    entries_[at] = entry;
+    where_[entry.slot] = static_cast<uint8_t>(at);
+  }
+
+  void siftUp(size_t at) {
+    const Entry entry = entries_[at];
+    while (at > 0) {
+      const size_t parent = (at - 1) / 2;
+      if (!before(entry, entries_[parent])) break;
+      place(at, entries_[parent]);
+      at = parent;
+    }
+    place(at, entry);
+  }
+
+  void siftDown(size_t at) {
+    const Entry entry = entries_[at];
+    for (;;) {
+      size_t child = 2 * at + 1;
+      if (child >= size_) break;
+      if (child + 1 < size_ && before(entries_[child + 1], entries_[child])) {
+        ++child;
+      }
+      if (!before(entries_[child], entry)) break;
+      place(at, entries_[child]);
+      at = child;
+    }
+    place(at, entry);
+  }
+
+  void removeAt(size_t at) {
+    where_[entries_[at].slot] = kAbsent;
+    const size_t last = --size_;
+    if (at == last) return;
+    // The last entry fills the hole; it may belong above or below it.
+    const uint8_t moved = entries_[last].slot;
+    place(at, entries_[last]);
+    siftDown(at);
+    if (where_[moved] == at) siftUp(at);
+  }
+
+  Entry entries_[Capacity];
+  uint8_t where_[Capacity];
+  size_t size_ = 0;
+  uint32_t order_ = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Fixed-size ring of timestamped hot-path events (8 bytes each), cheap enough
+// to leave on in production. Any task may record; the newest
+// TRACE_BUFFER_EVENTS events survive. Dumped as CSV on
+// iot/nodes/<id>/debug/trace and the portal's /trace.
+namespace Trace {
+
+// `tag` and `value` meaning per event.
+enum class Event : uint8_t {
+  kMqttReceive = 1,  // value: payload bytes
+  kJsonParsed,       // tag: DeserializationError::Code
+  kDispatch,         // tag: controller index in DeviceManager
+  kCommandDone,      // tag: 1 if the state changed
+  kIrQueued,         // tag: IrTransmitJob::Kind, value: jobs already queued
+  kIrDropped,        // tag: IrTransmitJob::Kind
+  kIrStart,          // tag: IrTransmitJob::Kind, value: decode_type_t
+  kIrEnd,            // tag: IrTransmitJob::Kind, value: decode_type_t
+  kPublish,          // tag: 1 if accepted, value: payload bytes
+};
+
+struct Record {
+  uint32_t atUs = 0;  // micros()
+  uint16_t value = 0;
+  Event event = Event::kMqttReceive;
+  uint8_t tag = 0;
+};
+
+// Lock-free; safe from any task, not from ISRs.
+void record(Event event, uint8_t tag = 0, uint16_t value = 0);
+
+// Copies the events still in the ring, oldest first. Events being written
+// while the copy runs are skipped.
+void snapshot(std::vector<Record> &out);
+// Events recorded since boot (including the ones overwritten).
+uint32_t recorded();
+void clear();
+
+const char *eventName(Event event);
+// "us,event,tag,value" rows; the last row is "<now>,dump,0,<rows>".
+void toCsv(const std::vector<Record> &records, String &out);
+
+}  // namespace Trace
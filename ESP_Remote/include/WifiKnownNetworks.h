@@ -7,6 +7,15 @@ namespace WifiKnownNetworks {
 struct Network {
   String ssid;
   String password;
+  // Access point and channel of the last successful join (channel 0: none),
+  // for a directed join that skips the scan.
+  uint8_t bssid[6] = {0};
+  uint8_t channel = 0;
+  // Lease from that join, reusable as a static configuration (ip 0: none).
+  uint32_t ip = 0;
+  uint32_t gateway = 0;
+  uint32_t subnet = 0;
+  uint32_t dns = 0;
 };
 
 void begin();
@@ -17,9 +26,23 @@ void upsert(const String &ssid, const String &password);
 // Reorders existing entry as most-recent (does not change password).
 void markUsed(const String &ssid);
 
-// Finds a known SSID from a Wi-Fi scan and returns the best candidate to
-// connect to (by RSSI).
-bool selectBestFromScan(Network &out);
+// Records the link that just came up (and marks the SSID as most recent).
+// Only writes NVS when something changed.
+void rememberLink(const String &ssid, const uint8_t *bssid, uint8_t channel,
+                  uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns);
+
+// Most recently used network, if its last link was recorded.
+bool lastLink(Network &out);
+
+enum class ScanPick : uint8_t {
+  kPicked,
+  kNoMatch,
+  kPending,  // scan results too old; a scan was requested, ask again later
+};
+
+// Finds a known SSID in the WifiScanCache results and returns the best
+// candidate to connect to (by RSSI). Never scans in the caller's context.
+ScanPick selectBestFromScan(Network &out);
 
 // Debug helper.
 size_t count();
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Background Wi-Fi scan service. Scans run asynchronously from loop() and
+// leave an RSSI-sorted snapshot that the connect path, the portal and
+// /status read without blocking.
+namespace WifiScanCache {
+
+struct Entry {
+  String ssid;
+  int32_t rssi = 0;
+  uint8_t encryption = 0;  // wifi_auth_mode_t
+  uint8_t channel = 0;
+  uint8_t bssid[6] = {0};
+};
+
+// Drives the scan state machine. `periodic` allows the scheduled refresh
+// every WIFI_SCAN_REFRESH_MS (the caller passes false while connected, as a
+// scan briefly takes the radio off-channel).
+void loop(bool periodic);
+
+// Asks for a new scan at the next loop() (no-op while one is running).
+void request();
+
+bool scanning();
+// True once a scan has finished, even if it found nothing or failed.
+bool hasResults();
+// Milliseconds since the last scan finished; UINT32_MAX if none has.
+uint32_t ageMs();
+// Strongest first; one entry per BSSID.
+const std::vector<Entry> &results();
+
+}  // namespace WifiScanCache
@@ -2,7 +2,6 @@
 
 #include <IRac.h>
 #include <IRremoteESP8266.h>
-#include <IRsend.h>
 #include <vector>
 
 #if defined(__has_include)
@@ -11,22 +10,12 @@
 #endif
 #endif
 
+#include "AcStateStore.h"
 #include "Config.h"
 #include "DeviceManager.h"
-
-struct RemoteProfile {
-  String brand;
-  String type;
-  uint16_t index = 0;
-};
-
-struct AcState {
-  bool power = false;
-  String mode = "cool";
-  int temp = 24;
-  String fan = "auto";
-  bool swing = false;
-};
+#include "IrTransmitter.h"
+#include "KeyId.h"
+#include "LearnedKeyTable.h"
 
 #if defined(IRREMOTEESP8266_VERSION_MAJOR)
 #if (IRREMOTEESP8266_VERSION_MAJOR > 2) ||                         \
@@ -42,19 +31,16 @@ struct AcState {
 #define AC_CONTROLLER_HAS_REMOTE_MODEL_ENUM 0
 #endif
 
+// State commands ("set", "temp", "power", ...) are coalesced: the first one
+// opens an AC_COALESCE_WINDOW_MS window, later ones only update the state, and
+// poll() sends one frame with the final state when the window closes. A
+// {"cmd":"flush"} command, or "flush": true on a state command, sends at once.
+//
+// With AC_STATE_PERSIST, begin() restores the last sent state and profile from
+// AcStateStore; poll() writes them back once no state has been sent for
+// AC_STATE_WRITE_DELAY_MS, but no later than AC_STATE_WRITE_MAX_DELAY_MS.
 class AcController : public DeviceController {
  public:
-  AcController(const char *nodeId, uint8_t irPin);
-
-  const char *deviceType() const override { return "ac"; }
-  const char *stateTopic() const override { return stateTopic_.c_str(); }
-  void begin() override;
-  void serializeState(JsonDocument &doc) const override;
-  bool handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) override;
-  bool learnKey(const String &key, decode_type_t protocol, uint64_t value,
-                uint16_t nbits, const std::vector<uint8_t> &raw = {});
-
- private:
   struct IrModelConfig {
     const char *brand;
     const char *type;
@@ -67,6 +53,31 @@ class AcController : public DeviceController {
     uint16_t index;
   };
 
+  AcController(const char *nodeId, IrTransmitter &transmitter);
+
+  const char *deviceType() const override { return "ac"; }
+  const char *stateTopic() const override { return stateTopic_.c_str(); }
+  void begin() override;
+  void serializeState(JsonDocument &doc) const override;
+  bool handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) override;
+  uint8_t sendKeyPresses(const char *keyName, uint8_t presses,
+                         uint16_t gapAfterMs) override;
+  bool resolveKey(const char *keyName, IrFrame &frame) override;
+  const AcState &state() const { return state_; }
+  // Scene step: takes `state` as is and sends it at once, skipping the
+  // coalescing window. The caller publishes the new state.
+  void applySceneState(const AcState &state);
+  bool flush() override;
+  bool poll() override;
+  bool learnKey(const String &key, decode_type_t protocol, uint64_t value,
+                uint16_t nbits, const std::vector<uint8_t> &raw = {},
+                const std::vector<uint8_t> &timing = {});
+
+  // The built-in remotes (kModels), for the bench.
+  static size_t modelCount();
+  static const IrModelConfig &model(size_t index);
+
+ private:
   static const IrModelConfig kModels[];
   static const IrModelConfig *findModel(const String &brand, const String &type,
                                         uint16_t index);
@@ -74,27 +85,21 @@ class AcController : public DeviceController {
   static stdAc::fanspeed_t parseFan(const String &fan);
   static stdAc::swingv_t parseSwing(bool enabled);
 
-  bool applyState(JsonDocument &stateDoc);
-
-  struct LearnedCommand {
-    String key;
-    decode_type_t protocol;
-    uint64_t value;
-    uint16_t nbits;
-    std::vector<uint8_t> raw;
-  };
+  // Sends state_ with the selected model and closes the coalescing window.
+  void applyState();
+  void persistIfDue();
 
-  void saveLearnedCommand(const String &key, decode_type_t protocol,
-                          uint64_t value, uint16_t nbits,
-                          const std::vector<uint8_t> &raw = {});
-  bool sendLearnedKey(const String &key);
+  bool sendLearnedKey(KeyId key, uint16_t gapAfterMs = 0);
 
   String stateTopic_;
-  uint8_t irPin_;
-  IRac irAc_;
-  IRsend irSend_;
-  bool irReady_ = false;
+  IrTransmitter &ir_;
+  stdAc::state_t irState_{};
   AcState state_;
   RemoteProfile remote_;
-  std::vector<LearnedCommand> learnedCommands_;
+  LearnedKeyTable learned_;
+  bool pending_ = false;  // state_ changed since the last frame
+  uint32_t pendingSinceMs_ = 0;
+  bool unsaved_ = false;  // sent since the last AcStateStore::save()
+  uint32_t unsavedSinceMs_ = 0;
+  uint32_t lastSentMs_ = 0;
 };
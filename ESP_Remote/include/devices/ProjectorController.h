@@ -2,11 +2,13 @@
 
 #include <ArduinoJson.h>
 #include <IRremoteESP8266.h>
-#include <IRsend.h>
 #include <vector>
 
 #include "Config.h"
 #include "DeviceManager.h"
+#include "IrTransmitter.h"
+#include "KeyId.h"
+#include "LearnedKeyTable.h"
 
 struct ProjectorState {
   bool power = false;
@@ -30,49 +32,39 @@ class ProjectorController : public DeviceController {
     size_t commandCount;
   };
 
-  ProjectorController(const char *nodeId, uint8_t irPin);
+  ProjectorController(const char *nodeId, IrTransmitter &transmitter);
 
   const char *deviceType() const override { return "projector"; }
   const char *stateTopic() const override { return stateTopic_.c_str(); }
   void begin() override;
   void serializeState(JsonDocument &doc) const override;
   bool handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) override;
+  uint8_t sendKeyPresses(const char *keyName, uint8_t presses,
+                         uint16_t gapAfterMs) override;
+  bool resolveKey(const char *keyName, IrFrame &frame) override;
   bool learnKey(const String &key, decode_type_t protocol, uint64_t value,
-                uint16_t nbits, const std::vector<uint8_t> &raw = {});
+                uint16_t nbits, const std::vector<uint8_t> &raw = {},
+                const std::vector<uint8_t> &timing = {});
 
  private:
   static const RemoteConfig kRemotes[];
   static const RemoteConfig *findRemote(const String &brand,
                                         const String &type,
                                         uint16_t index);
-  static const KeyCommand *findKey(const RemoteConfig *remote,
-                                   const String &key);
+  static const KeyCommand *findKey(const RemoteConfig *remote, KeyId key);
 
-  bool sendKey(const String &key);
-  bool applyKeyEffects(const String &key);
+  bool sendKey(KeyId key, uint16_t gapAfterMs = 0);
+  bool applyKeyEffects(KeyId key);
   bool applyState(JsonDocument &stateDoc);
 
-  struct LearnedCommand {
-    String key;
-    decode_type_t protocol;
-    uint64_t value;
-    uint16_t nbits;
-    std::vector<uint8_t> raw;
-  };
-
-  void saveLearnedCommand(const String &key, decode_type_t protocol,
-                          uint64_t value, uint16_t nbits,
-                          const std::vector<uint8_t> &raw = {});
-  bool sendLearnedKey(const String &key);
+  bool sendLearnedKey(KeyId key, uint16_t gapAfterMs = 0);
 
   String stateTopic_;
-  uint8_t irPin_;
-  IRsend irSend_;
-  bool irReady_ = false;
+  IrTransmitter &ir_;
   ProjectorState state_;
   String remoteBrand_;
   String remoteType_;
   uint16_t remoteIndex_ = 0;
-  std::vector<LearnedCommand> learnedCommands_;
+  LearnedKeyTable learned_;
 };
 
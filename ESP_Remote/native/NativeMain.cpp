@@ -0,0 +1,205 @@
+// Host entry point for `pio run -e native`: runs setup()/loop() of the
+// firmware against the simulated Wi-Fi, broker and IR hardware of
+// NativeShims and prints what the node publishes and transmits. As on the
+// ESP32 core, setup() and loop() run in a "loopTask" task; script lines are
+// fed from the firmware's network task (NativeSim::setNetworkTick) and the
+// output is printed from the main thread.
+//
+//   .pio/build/native/program [--script FILE] [--run-ms N] [--ssid S]
+//                             [--password P] [--quiet]
+//
+// Script lines are "<at_ms> <command>", '#' starts a comment, "~/" in a
+// topic expands to iot/nodes/<NODE_ID>/:
+//   500  pub ~/ac/cmd {"power":true,"temp":24}
+//   900  ir NEC 0x20DF10EF 32
+//   1200 wifi down | wifi up | broker down | broker up
+//   1500 http GET /status | http POST /save ssid=x&password=y
+
+#include <Arduino.h>
+#include <IRutils.h>
+#include <NativeSim.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+
+void setup();
+void loop();
+
+namespace {
+
+// Same as ARDUINO_LOOP_STACK_SIZE on the ESP32 core.
+constexpr uint32_t kLoopTaskStackBytes = 8192;
+
+struct ScriptLine {
+  uint32_t atMs = 0;
+  std::string command;
+  std::string rest;
+};
+
+std::vector<ScriptLine> script;
+size_t nextLine = 0;
+std::atomic<bool> setupDone{false};
+std::atomic<uint32_t> startedAt{0};
+
+std::string expandTopic(const std::string &topic) {
+  if (topic.compare(0, 2, "~/") != 0) return topic;
+  return std::string("iot/nodes/") + NODE_ID + "/" + topic.substr(2);
+}
+
+bool loadScript(const char *path, std::vector<ScriptLine> &out) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t hash = line.find('#');
+    if (hash == 0 || (hash != std::string::npos && line[hash - 1] == ' ')) {
+      line.erase(hash);
+    }
+    std::istringstream fields(line);
+    ScriptLine entry;
+    if (!(fields >> entry.atMs >> entry.command)) continue;
+    std::getline(fields >> std::ws, entry.rest);
+    out.push_back(entry);
+  }
+  std::stable_sort(out.begin(), out.end(),
+                   [](const ScriptLine &a, const ScriptLine &b) {
+                     return a.atMs < b.atMs;
+                   });
+  return true;
+}
+
+void runCommand(const ScriptLine &line) {
+  std::istringstream args(line.rest);
+  if (line.command == "pub") {
+    std::string topic, payload;
+    args >> topic;
+    std::getline(args >> std::ws, payload);
+    NativeSim::publishToNode(String(expandTopic(topic)), String(payload));
+  } else if (line.command == "ir") {
+    std::string protocol, value;
+    unsigned bits = 0;
+    args >> protocol >> value >> bits;
+    NativeSim::injectIrReceive(strToDecodeType(protocol.c_str()),
+                               strtoull(value.c_str(), nullptr, 16),
+                               static_cast<uint16_t>(bits));
+  } else if (line.command == "wifi") {
+    NativeSim::setWifiAvailable(line.rest != "down");
+  } else if (line.command == "broker") {
+    NativeSim::setBrokerReachable(line.rest != "down");
+  } else if (line.command == "http") {
+    std::string method, uri, body;
+    args >> method >> uri >> body;
+    int status = 0;
+    const String response =
+        NativeSim::http(method.c_str(), String(uri), status, String(body));
+    printf("[SIM] t=%lu HTTP %s %s -> %d %s\n", millis(), method.c_str(),
+           uri.c_str(), status, response.c_str());
+  } else {
+    printf("[SIM] Unknown script command '%s'\n", line.command.c_str());
+  }
+}
+
+// Network task: runs the script lines that are due.
+void runDueScript() {
+  if (!setupDone) return;
+  const uint32_t elapsed = millis() - startedAt;
+  while (nextLine < script.size() && elapsed >= script[nextLine].atMs) {
+    runCommand(script[nextLine++]);
+  }
+}
+
+void loopTask(void *) {
+  setup();
+  startedAt = millis();
+  setupDone = true;
+  for (;;) loop();
+}
+
+void drainOutputs() {
+  for (const auto &message : NativeSim::takePublished()) {
+    printf("[SIM] t=%lu PUB %s%s %s\n", static_cast<unsigned long>(message.atMs),
+           message.topic.c_str(), message.retained ? " (retained)" : "",
+           message.payload.c_str());
+  }
+  for (const auto &frame : NativeSim::takeIrFrames()) {
+    printf("[SIM] t=%lu IR %s %s", static_cast<unsigned long>(frame.atMs),
+           frame.kind, typeToString(frame.protocol).c_str());
+    if (!frame.detail.isEmpty()) {
+      printf(" %s\n", frame.detail.c_str());
+    } else if (!frame.state.empty()) {
+      printf(" ");
+      for (const uint8_t b : frame.state) printf("%02X", b);
+      printf(" %u\n", frame.nbits);
+    } else {
+      printf(" 0x%llX %u\n", static_cast<unsigned long long>(frame.value),
+             frame.nbits);
+    }
+  }
+  fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t runMs = 5000;
+  const char *scriptPath = nullptr;
+  NativeSim::AccessPoint ap;
+  ap.ssid = WIFI_SSID;
+  ap.password = WIFI_PASSWORD;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--script" && hasValue) {
+      scriptPath = argv[++i];
+    } else if (arg == "--run-ms" && hasValue) {
+      runMs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--ssid" && hasValue) {
+      ap.ssid = argv[++i];
+    } else if (arg == "--password" && hasValue) {
+      ap.password = argv[++i];
+    } else if (arg == "--quiet") {
+      NativeSim::setSerialEcho(false);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--script FILE] [--run-ms N] [--ssid S] "
+              "[--password P] [--quiet]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (scriptPath != nullptr && !loadScript(scriptPath, script)) {
+    fprintf(stderr, "cannot read script %s\n", scriptPath);
+    return 2;
+  }
+  NativeSim::addAccessPoint(ap);
+  NativeSim::setNetworkTick(runDueScript);
+
+  if (xTaskCreatePinnedToCore(loopTask, "loopTask", kLoopTaskStackBytes,
+                              nullptr, 1, nullptr, 1) != pdPASS) {
+    fprintf(stderr, "cannot start loopTask\n");
+    return 1;
+  }
+  while (!setupDone) {
+    drainOutputs();
+    delay(1);
+  }
+  while (millis() - startedAt < runMs) {
+    drainOutputs();
+    delay(1);
+  }
+  delay(50);  // let the IR task finish the frames it has dequeued
+  drainOutputs();
+  fflush(stdout);
+  // Firmware tasks never return; skip static destructors they may still use.
+  _Exit(0);
+}
@@ -0,0 +1,240 @@
+#include <Arduino.h>
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "NativeSim.h"
+
+namespace {
+
+const auto kStartTime = std::chrono::steady_clock::now();
+std::mt19937 randomEngine(0x5eed);
+
+constexpr size_t kUartFifoBytes = 128;
+std::mutex uartMutex;
+// When the simulated TX FIFO finishes draining.
+std::chrono::steady_clock::time_point uartIdleAt = kStartTime;
+
+std::atomic<uint32_t> minFreeHeap{UINT32_MAX};
+
+std::string formatInteger(unsigned long long value, bool negative,
+                          unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  std::string digits;
+  do {
+    const unsigned digit = static_cast<unsigned>(value % base);
+    digits.insert(digits.begin(),
+                  static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10));
+    value /= base;
+  } while (value != 0);
+  if (negative) digits.insert(digits.begin(), '-');
+  return digits;
+}
+
+std::string formatSigned(long long value, unsigned char base) {
+  // Like WString, only base 10 prints a sign; other bases show the bits.
+  if (base == 10 && value < 0) {
+    return formatInteger(0ULL - static_cast<unsigned long long>(value), true,
+                         base);
+  }
+  return formatInteger(static_cast<unsigned long>(value), false, base);
+}
+
+std::string formatFloat(double value, unsigned int decimalPlaces) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimalPlaces),
+           value);
+  return buffer;
+}
+
+}  // namespace
+
+HardwareSerial Serial;
+EspClass ESP;
+
+String::String(unsigned char value, unsigned char base)
+    : s_(formatInteger(value, false, base)) {}
+String::String(int value, unsigned char base) : s_(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base)
+    : s_(formatInteger(value, false, base)) {}
+String::String(long value, unsigned char base)
+    : s_(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base)
+    : s_(formatInteger(value, false, base)) {}
+String::String(long long value, unsigned char base)
+    : s_(formatSigned(value, base)) {}
+String::String(unsigned long long value, unsigned char base)
+    : s_(formatInteger(value, false, base)) {}
+String::String(float value, unsigned int decimalPlaces)
+    : s_(formatFloat(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces)
+    : s_(formatFloat(value, decimalPlaces)) {}
+
+void String::replace(char find, char replacement) {
+  for (char &c : s_) {
+    if (c == find) c = replacement;
+  }
+}
+
+void String::replace(const String &find, const String &replacement) {
+  if (find.s_.empty()) return;
+  size_t pos = 0;
+  while ((pos = s_.find(find.s_, pos)) != std::string::npos) {
+    s_.replace(pos, find.s_.size(), replacement.s_);
+    pos += replacement.s_.size();
+  }
+}
+
+void String::remove(unsigned int index) {
+  if (index < s_.size()) s_.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < s_.size()) s_.erase(index, count);
+}
+
+void String::toLowerCase() {
+  for (char &c : s_) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+void String::toUpperCase() {
+  for (char &c : s_) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+void String::trim() {
+  const size_t begin = s_.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    s_.clear();
+    return;
+  }
+  const size_t end = s_.find_last_not_of(" \t\r\n");
+  s_ = s_.substr(begin, end - begin + 1);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && write(buffer[n]) == 1) ++n;
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char stackBuffer[256];
+  va_list args;
+  va_start(args, format);
+  const int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+  va_end(args);
+  if (length < 0) return 0;
+  if (static_cast<size_t>(length) < sizeof(stackBuffer)) {
+    return write(reinterpret_cast<const uint8_t *>(stackBuffer), length);
+  }
+  std::string heapBuffer(static_cast<size_t>(length) + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&heapBuffer[0], heapBuffer.size(), format, args);
+  va_end(args);
+  return write(reinterpret_cast<const uint8_t *>(heapBuffer.data()), length);
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    const int c = read();
+    if (c < 0) break;
+    buffer[n++] = static_cast<char>(c);
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (baud_ != 0) {
+    // 10 bits per byte on the wire (8N1).
+    const auto perByte = std::chrono::nanoseconds(10000000000ULL / baud_);
+    std::lock_guard<std::mutex> lock(uartMutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (uartIdleAt < now) uartIdleAt = now;
+    uartIdleAt += perByte * size;
+    const auto fifoWindow = perByte * kUartFifoBytes;
+    if (uartIdleAt - now > fifoWindow) {
+      std::this_thread::sleep_until(uartIdleAt - fifoWindow);
+    }
+  }
+  if (NativeSim::serialEcho()) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+void HardwareSerial::flush() { fflush(stdout); }
+
+unsigned long millis() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - kStartTime)
+          .count());
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - kStartTime)
+          .count());
+}
+
+uint32_t EspClass::getFreeHeap() {
+  const size_t free = mallinfo2().fordblks;
+  const uint32_t bytes =
+      free > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(free);
+  uint32_t low = minFreeHeap.load(std::memory_order_relaxed);
+  while (bytes < low &&
+         !minFreeHeap.compare_exchange_weak(low, bytes,
+                                            std::memory_order_relaxed)) {
+  }
+  return bytes;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  getFreeHeap();
+  return minFreeHeap.load(std::memory_order_relaxed);
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() { std::this_thread::yield(); }
+
+void configTzTime(const char *tz, const char *, const char *, const char *) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  NativeSim::recordPin(pin, value);
+}
+
+int digitalRead(uint8_t pin) { return NativeSim::pinLevel(pin); }
+
+long random(long howBig) {
+  if (howBig <= 0) return 0;
+  return std::uniform_int_distribution<long>(0, howBig - 1)(randomEngine);
+}
+
+long random(long howSmall, long howBig) {
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed) { randomEngine.seed(seed); }
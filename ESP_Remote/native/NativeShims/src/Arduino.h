@@ -0,0 +1,330 @@
+#pragma once
+
+// Host stand-in for the parts of the ESP32 Arduino core the firmware uses.
+// String follows WString semantics closely enough for the firmware and for
+// ArduinoJson's ::String adapter; time comes from the host's steady clock.
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX 16
+#define DEC 10
+#define OCT 8
+#define BIN 2
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define IRAM_ATTR
+#define PROGMEM
+
+class __FlashStringHelper;
+#define F(string_literal) \
+  (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String {
+ public:
+  String(const char *cstr = "") : s_(cstr != nullptr ? cstr : "") {}
+  String(const char *cstr, unsigned int length) : s_(cstr, length) {}
+  String(const __FlashStringHelper *str)
+      : s_(reinterpret_cast<const char *>(str)) {}
+  String(const std::string &str) : s_(str) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned int length() const { return static_cast<unsigned int>(s_.size()); }
+  bool isEmpty() const { return s_.empty(); }
+  void clear() { s_.clear(); }
+  bool reserve(unsigned int size) {
+    s_.reserve(size);
+    return true;
+  }
+
+  char charAt(unsigned int index) const {
+    return index < s_.size() ? s_[index] : '\0';
+  }
+  void setCharAt(unsigned int index, char c) {
+    if (index < s_.size()) s_[index] = c;
+  }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return s_[index]; }
+
+  bool concat(const String &str) {
+    s_ += str.s_;
+    return true;
+  }
+  bool concat(const char *cstr) {
+    if (cstr == nullptr) return false;
+    s_ += cstr;
+    return true;
+  }
+  bool concat(const char *cstr, unsigned int length) {
+    if (cstr == nullptr) return false;
+    s_.append(cstr, length);
+    return true;
+  }
+  bool concat(char c) {
+    s_ += c;
+    return true;
+  }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+  bool concat(const __FlashStringHelper *str) {
+    return concat(reinterpret_cast<const char *>(str));
+  }
+
+  template <typename T>
+  String &operator+=(const T &value) {
+    concat(value);
+    return *this;
+  }
+
+  int compareTo(const String &other) const { return s_.compare(other.s_); }
+  bool equals(const String &other) const { return s_ == other.s_; }
+  bool equals(const char *cstr) const { return s_ == (cstr ? cstr : ""); }
+  bool equalsIgnoreCase(const String &other) const {
+    return s_.size() == other.s_.size() &&
+           strcasecmp(s_.c_str(), other.s_.c_str()) == 0;
+  }
+  bool startsWith(const String &prefix) const {
+    return s_.compare(0, prefix.s_.size(), prefix.s_) == 0;
+  }
+  bool startsWith(const String &prefix, unsigned int offset) const {
+    return offset <= s_.size() &&
+           s_.compare(offset, prefix.s_.size(), prefix.s_) == 0;
+  }
+  bool endsWith(const String &suffix) const {
+    return s_.size() >= suffix.s_.size() &&
+           s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(),
+                      suffix.s_) == 0;
+  }
+
+  bool operator==(const String &other) const { return s_ == other.s_; }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &other) const { return s_ != other.s_; }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+  bool operator<(const String &other) const { return s_ < other.s_; }
+  bool operator>(const String &other) const { return s_ > other.s_; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    return position(s_.find(c, from));
+  }
+  int indexOf(const String &str, unsigned int from = 0) const {
+    return position(s_.find(str.s_, from));
+  }
+  int lastIndexOf(char c) const { return position(s_.rfind(c)); }
+  int lastIndexOf(const String &str) const { return position(s_.rfind(str.s_)); }
+
+  String substring(unsigned int from) const {
+    return from >= s_.size() ? String() : String(s_.substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+      const unsigned int tmp = from;
+      from = to;
+      to = tmp;
+    }
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to - from));
+  }
+
+  void replace(char find, char replacement);
+  void replace(const String &find, const String &replacement);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  double toDouble() const { return strtod(s_.c_str(), nullptr); }
+
+  const std::string &str() const { return s_; }
+
+ private:
+  static int position(size_t pos) {
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+  }
+
+  std::string s_;
+};
+
+// Result type of String concatenation in the ESP32 core; ArduinoJson knows
+// it by name.
+class StringSumHelper : public String {
+ public:
+  StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const String &lhs, const char *rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const char *lhs, const String &rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const String &lhs, char rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+inline StringSumHelper operator+(const String &lhs, int rhs) {
+  return lhs + String(rhs);
+}
+inline StringSumHelper operator+(const String &lhs, unsigned int rhs) {
+  return lhs + String(rhs);
+}
+inline StringSumHelper operator+(const String &lhs, long rhs) {
+  return lhs + String(rhs);
+}
+inline StringSumHelper operator+(const String &lhs, unsigned long rhs) {
+  return lhs + String(rhs);
+}
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) {
+    return str == nullptr
+               ? 0
+               : write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+  }
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const __FlashStringHelper *s) {
+    return write(reinterpret_cast<const char *>(s));
+  }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) {
+    return print(String(value, base));
+  }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) {
+    return print(String(value, base));
+  }
+  size_t print(double value, int digits = 2) {
+    return print(String(value, digits));
+  }
+  size_t println() { return write("\n"); }
+  template <typename T>
+  size_t println(const T &value) {
+    const size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &value, int format) {
+    const size_t n = print(value, format);
+    return n + println();
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeoutMs) { timeoutMs_ = timeoutMs; }
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    return readBytes(reinterpret_cast<char *>(buffer), length);
+  }
+
+ protected:
+  unsigned long timeoutMs_ = 1000;
+};
+
+// Writes to stdout unless NativeSim::setSerialEcho(false).
+// Writes block like the ESP32 UART driver with no TX ring buffer: once the
+// 128-byte hardware FIFO is full, the caller waits for bytes to leave at the
+// configured baud rate.
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) { baud_ = baud; }
+  void end() { baud_ = 0; }
+  explicit operator bool() const { return true; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+ private:
+  unsigned long baud_ = 0;
+};
+
+extern HardwareSerial Serial;
+
+// Heap figures come from the host allocator's arena (free bytes it holds);
+// there is no fragmentation model, so the largest block equals free heap.
+class EspClass {
+ public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap() { return getFreeHeap(); }
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// The host clock is already set; only the time zone is applied.
+void configTzTime(const char *tz, const char *server1,
+                  const char *server2 = nullptr, const char *server3 = nullptr);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+template <typename T, typename L, typename H>
+T constrain(T value, L low, H high) {
+  return value < low ? low : (value > high ? high : value);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "IPAddress.h"
+
+class Client : public Stream {
+ public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual explicit operator bool() { return connected() != 0; }
+};
@@ -0,0 +1,220 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <Arduino.h>
+
+#include <pthread.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct NativeQueue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+};
+
+struct NativeTask {
+  std::string name;
+  TaskFunction_t code = nullptr;
+  void *arg = nullptr;
+  uint8_t *stack = nullptr;  // lowest address; the stack grows down to it
+  size_t stackSize = 0;
+  uint32_t requestedBytes = 0;
+  // Frame of the task entry; glibc keeps the thread descriptor and TLS above
+  // it, which FreeRTOS would not count against the task.
+  const uint8_t *entryFrame = nullptr;
+  // Recorded for xPortGetCoreID(); the host scheduler does not pin threads.
+  BaseType_t core = tskNO_AFFINITY;
+  // Direct-to-task notification value, used as a counting semaphore.
+  std::mutex notifyMutex;
+  std::condition_variable notified;
+  uint32_t notifyValue = 0;
+};
+
+namespace {
+
+// Host code (glibc printf, the shims) needs far more stack than the same
+// code on the ESP32, so every task gets this much on top of what it asked
+// for. High-water marks are still reported against the requested size.
+constexpr size_t kHostStackHeadroom = 64 * 1024;
+constexpr uint8_t kStackFill = 0xA5;  // what FreeRTOS paints new stacks with
+
+thread_local NativeTask *currentTask = nullptr;
+
+void *taskTrampoline(void *arg) {
+  NativeTask *task = static_cast<NativeTask *>(arg);
+  currentTask = task;
+  task->entryFrame = static_cast<const uint8_t *>(__builtin_frame_address(0));
+  task->code(task->arg);
+  return nullptr;
+}
+
+// Waits on `queue` until `ready` holds or `wait` ticks pass.
+template <typename Predicate>
+bool waitFor(NativeQueue *queue, std::unique_lock<std::mutex> &lock,
+             TickType_t wait, Predicate ready) {
+  if (wait == portMAX_DELAY) {
+    queue->changed.wait(lock, ready);
+    return true;
+  }
+  return queue->changed.wait_for(lock, std::chrono::milliseconds(wait), ready);
+}
+
+}  // namespace
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0 || itemSize == 0) return nullptr;
+  NativeQueue *queue = new NativeQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+  if (queue == nullptr || item == nullptr) return errQUEUE_FULL;
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue, lock, wait,
+               [queue] { return queue->items.size() < queue->length; })) {
+    return errQUEUE_FULL;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+  if (queue == nullptr || item == nullptr) return pdFALSE;
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!waitFor(queue, lock, wait, [queue] { return !queue->items.empty(); })) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  if (queue == nullptr) return 0;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return static_cast<UBaseType_t>(queue->items.size());
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  if (queue == nullptr) return 0;
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->length - static_cast<UBaseType_t>(queue->items.size());
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name,
+                       uint32_t stackBytes, void *arg, UBaseType_t priority,
+                       TaskHandle_t *created) {
+  return xTaskCreatePinnedToCore(code, name, stackBytes, arg, priority,
+                                 created, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name,
+                                   uint32_t stackBytes, void *arg,
+                                   UBaseType_t, TaskHandle_t *created,
+                                   BaseType_t core) {
+  if (code == nullptr) return pdFAIL;
+  NativeTask *task = new NativeTask();
+  task->core = core;
+  task->name = name != nullptr ? name : "";
+  task->code = code;
+  task->arg = arg;
+  task->requestedBytes = stackBytes;
+  task->stackSize = stackBytes + kHostStackHeadroom;
+  task->stack = static_cast<uint8_t *>(malloc(task->stackSize));
+  if (task->stack == nullptr) {
+    delete task;
+    return pdFAIL;
+  }
+  memset(task->stack, kStackFill, task->stackSize);
+
+  // Firmware tasks never return; the thread is detached and dies with the
+  // process. The stack and NativeTask are leaked for the same reason.
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, task->stack, task->stackSize);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_t thread;
+  const int err = pthread_create(&thread, &attr, taskTrampoline, task);
+  pthread_attr_destroy(&attr);
+  if (err != 0) {
+    free(task->stack);
+    delete task;
+    return pdFAIL;
+  }
+  if (created != nullptr) *created = task;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Only self-deletion is supported, which is all the firmware uses.
+  if (task == nullptr || task == currentTask) pthread_exit(nullptr);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask; }
+
+BaseType_t xPortGetCoreID() {
+  // Unpinned tasks and the main thread report core 0, like a task started
+  // from app_main().
+  if (currentTask == nullptr || currentTask->core == tskNO_AFFINITY) return 0;
+  return currentTask->core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (task == nullptr) return pdFAIL;
+  std::lock_guard<std::mutex> lock(task->notifyMutex);
+  ++task->notifyValue;
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait) {
+  NativeTask *task = currentTask;
+  if (task == nullptr) return 0;  // the main thread cannot be notified
+  std::unique_lock<std::mutex> lock(task->notifyMutex);
+  auto ready = [task] { return task->notifyValue != 0; };
+  if (wait == portMAX_DELAY) {
+    task->notified.wait(lock, ready);
+  } else {
+    task->notified.wait_for(lock, std::chrono::milliseconds(wait), ready);
+  }
+  const uint32_t value = task->notifyValue;
+  if (value != 0) task->notifyValue = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  if (task == nullptr) task = currentTask;
+  if (task == nullptr) return 0;  // the main thread has no painted stack
+  size_t untouched = 0;
+  while (untouched < task->stackSize && task->stack[untouched] == kStackFill) {
+    ++untouched;
+  }
+  const size_t used =
+      static_cast<size_t>(task->entryFrame - (task->stack + untouched));
+  return used >= task->requestedBytes
+             ? 0
+             : static_cast<UBaseType_t>(task->requestedBytes - used);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() { return static_cast<TickType_t>(millis()); }
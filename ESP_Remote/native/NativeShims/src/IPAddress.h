@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// IPv4 address stored as on the ESP32: first octet in the lowest byte, so
+// the uint32_t conversion matches lwIP's network-order ip4_addr_t.
+class IPAddress {
+ public:
+  IPAddress() = default;
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : addr_(static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) |
+              (static_cast<uint32_t>(c) << 16) |
+              (static_cast<uint32_t>(d) << 24)) {}
+  IPAddress(uint32_t addr) : addr_(addr) {}
+
+  operator uint32_t() const { return addr_; }
+  uint8_t operator[](int index) const {
+    return static_cast<uint8_t>(addr_ >> (8 * index));
+  }
+  bool operator==(const IPAddress &other) const { return addr_ == other.addr_; }
+  bool operator!=(const IPAddress &other) const { return addr_ != other.addr_; }
+
+  String toString() const;
+  bool fromString(const char *text);
+  bool fromString(const String &text) { return fromString(text.c_str()); }
+
+ private:
+  uint32_t addr_ = 0;
+};
+
+extern const IPAddress INADDR_NONE;
@@ -0,0 +1,285 @@
+#include <IRac.h>
+#include <IRrecv.h>
+#include <IRsend.h>
+#include <IRutils.h>
+
+#include "NativeSimInternal.h"
+
+namespace {
+
+constexpr uint64_t kRC5ToggleMask = 0x800;
+constexpr uint64_t kRC6Mode0ToggleMask = 0x10000;
+constexpr uint64_t kRC6_36ToggleMask = 0x8000;
+constexpr uint16_t kRC6Mode0Bits = 20;
+
+struct ProtocolName {
+  decode_type_t type;
+  const char *name;
+};
+
+const ProtocolName kProtocolNames[] = {
+#define NATIVE_IR_NAME(name) {decode_type_t::name, #name},
+    NATIVE_IR_PROTOCOLS(NATIVE_IR_NAME)
+#undef NATIVE_IR_NAME
+};
+
+const char *opmodeName(stdAc::opmode_t mode) {
+  switch (mode) {
+    case stdAc::opmode_t::kAuto:
+      return "auto";
+    case stdAc::opmode_t::kCool:
+      return "cool";
+    case stdAc::opmode_t::kHeat:
+      return "heat";
+    case stdAc::opmode_t::kDry:
+      return "dry";
+    case stdAc::opmode_t::kFan:
+      return "fan";
+    default:
+      return "off";
+  }
+}
+
+const char *fanName(stdAc::fanspeed_t fan) {
+  switch (fan) {
+    case stdAc::fanspeed_t::kMin:
+      return "min";
+    case stdAc::fanspeed_t::kLow:
+      return "low";
+    case stdAc::fanspeed_t::kMedium:
+      return "medium";
+    case stdAc::fanspeed_t::kHigh:
+      return "high";
+    case stdAc::fanspeed_t::kMax:
+      return "max";
+    case stdAc::fanspeed_t::kMediumHigh:
+      return "medium-high";
+    default:
+      return "auto";
+  }
+}
+
+}  // namespace
+
+// ---- IRsend ------------------------------------------------------------------
+
+bool IRsend::send(decode_type_t type, uint64_t data, uint16_t nbits,
+                  uint16_t repeat) {
+  (void)repeat;
+  if (type == decode_type_t::UNKNOWN || type == decode_type_t::UNUSED ||
+      nbits == 0 || nbits > 64) {
+    return false;
+  }
+  NativeSim::IrFrame frame;
+  frame.kind = "value";
+  frame.protocol = type;
+  frame.value = data;
+  frame.nbits = nbits;
+  NativeSim::internal::recordIrFrame(frame);
+  return true;
+}
+
+bool IRsend::send(decode_type_t type, const uint8_t *state, uint16_t nbytes) {
+  if (type == decode_type_t::UNKNOWN || state == nullptr || nbytes == 0 ||
+      nbytes > kStateSizeMax) {
+    return false;
+  }
+  NativeSim::IrFrame frame;
+  frame.kind = "state";
+  frame.protocol = type;
+  frame.nbits = static_cast<uint16_t>(nbytes * 8);
+  frame.state.assign(state, state + nbytes);
+  NativeSim::internal::recordIrFrame(frame);
+  return true;
+}
+
+uint64_t IRsend::toggleRC5(uint64_t data) { return data ^ kRC5ToggleMask; }
+
+uint64_t IRsend::toggleRC6(uint64_t data, uint16_t nbits) {
+  return data ^ (nbits == kRC6Mode0Bits ? kRC6Mode0ToggleMask
+                                        : kRC6_36ToggleMask);
+}
+
+// ---- IRac ----------------------------------------------------------------------
+
+bool IRac::isProtocolSupported(decode_type_t protocol) {
+  switch (protocol) {
+    case decode_type_t::AIRTON:
+    case decode_type_t::AIRWELL:
+    case decode_type_t::AMCOR:
+    case decode_type_t::ARGO:
+    case decode_type_t::BOSCH144:
+    case decode_type_t::CARRIER_AC64:
+    case decode_type_t::COOLIX:
+    case decode_type_t::CORONA_AC:
+    case decode_type_t::DAIKIN:
+    case decode_type_t::DAIKIN128:
+    case decode_type_t::DAIKIN152:
+    case decode_type_t::DAIKIN160:
+    case decode_type_t::DAIKIN176:
+    case decode_type_t::DAIKIN2:
+    case decode_type_t::DAIKIN216:
+    case decode_type_t::DAIKIN64:
+    case decode_type_t::DELONGHI_AC:
+    case decode_type_t::ECOCLIM:
+    case decode_type_t::ELECTRA_AC:
+    case decode_type_t::FUJITSU_AC:
+    case decode_type_t::GOODWEATHER:
+    case decode_type_t::GREE:
+    case decode_type_t::HAIER_AC:
+    case decode_type_t::HAIER_AC_YRW02:
+    case decode_type_t::HAIER_AC160:
+    case decode_type_t::HAIER_AC176:
+    case decode_type_t::HITACHI_AC:
+    case decode_type_t::HITACHI_AC1:
+    case decode_type_t::HITACHI_AC264:
+    case decode_type_t::HITACHI_AC296:
+    case decode_type_t::HITACHI_AC344:
+    case decode_type_t::HITACHI_AC424:
+    case decode_type_t::KELON:
+    case decode_type_t::KELON168:
+    case decode_type_t::KELVINATOR:
+    case decode_type_t::LG:
+    case decode_type_t::LG2:
+    case decode_type_t::MIDEA:
+    case decode_type_t::MIRAGE:
+    case decode_type_t::MITSUBISHI_AC:
+    case decode_type_t::MITSUBISHI112:
+    case decode_type_t::MITSUBISHI136:
+    case decode_type_t::MITSUBISHI_HEAVY_88:
+    case decode_type_t::MITSUBISHI_HEAVY_152:
+    case decode_type_t::NEOCLIMA:
+    case decode_type_t::PANASONIC_AC:
+    case decode_type_t::PANASONIC_AC32:
+    case decode_type_t::RHOSS:
+    case decode_type_t::SAMSUNG_AC:
+    case decode_type_t::SANYO_AC:
+    case decode_type_t::SANYO_AC88:
+    case decode_type_t::SHARP_AC:
+    case decode_type_t::TCL112AC:
+    case decode_type_t::TECHNIBEL_AC:
+    case decode_type_t::TECO:
+    case decode_type_t::TEKNOPOINT:
+    case decode_type_t::TOSHIBA_AC:
+    case decode_type_t::TRANSCOLD:
+    case decode_type_t::TROTEC:
+    case decode_type_t::TROTEC_3550:
+    case decode_type_t::TRUMA:
+    case decode_type_t::VESTEL_AC:
+    case decode_type_t::VOLTAS:
+    case decode_type_t::WHIRLPOOL_AC:
+    case decode_type_t::YORK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void IRac::initState(stdAc::state_t *state) {
+  if (state != nullptr) *state = stdAc::state_t();
+}
+
+bool IRac::sendAc() {
+  if (!isProtocolSupported(next.protocol)) return false;
+  char detail[128];
+  snprintf(detail, sizeof(detail),
+           "model=%d power=%s mode=%s temp=%.1f%s fan=%s swingv=%d", next.model,
+           next.power ? "on" : "off", opmodeName(next.mode), next.degrees,
+           next.celsius ? "C" : "F", fanName(next.fanspeed),
+           static_cast<int>(next.swingv));
+  NativeSim::IrFrame frame;
+  frame.kind = "ac";
+  frame.protocol = next.protocol;
+  frame.detail = detail;
+  NativeSim::internal::recordIrFrame(frame);
+  prev_ = next;
+  return true;
+}
+
+// ---- IRrecv --------------------------------------------------------------------
+
+bool IRrecv::decode(decode_results *results, void *, uint8_t, uint16_t) {
+  if (!enabled_ || results == nullptr) return false;
+  NativeSim::IrFrame frame;
+  if (!NativeSim::internal::nextIrReceive(frame)) return false;
+  *results = decode_results();
+  results->decode_type = frame.protocol;
+  results->bits = frame.nbits;
+  if (!frame.state.empty()) {
+    memcpy(results->state, frame.state.data(),
+           std::min<size_t>(frame.state.size(), kStateSizeMax));
+  } else {
+    results->value = frame.value;
+  }
+  return true;
+}
+
+// ---- IRutils -------------------------------------------------------------------
+
+String typeToString(decode_type_t protocol, bool isRepeat) {
+  String out = "UNKNOWN";
+  for (const auto &entry : kProtocolNames) {
+    if (entry.type == protocol) {
+      out = entry.type == decode_type_t::NEC_LIKE ? "NEC (non-strict)"
+                                                  : entry.name;
+      break;
+    }
+  }
+  if (isRepeat) out += " (Repeat)";
+  return out;
+}
+
+decode_type_t strToDecodeType(const char *str) {
+  if (str == nullptr) return decode_type_t::UNKNOWN;
+  for (const auto &entry : kProtocolNames) {
+    if (strcasecmp(entry.name, str) == 0) return entry.type;
+  }
+  return decode_type_t::UNKNOWN;
+}
+
+bool hasACState(decode_type_t protocol) {
+  // Value-encoded A/C protocols that IRac also drives.
+  switch (protocol) {
+    case decode_type_t::COOLIX:
+    case decode_type_t::LG:
+    case decode_type_t::LG2:
+    case decode_type_t::MIDEA:
+    case decode_type_t::GOODWEATHER:
+    case decode_type_t::DAIKIN64:
+    case decode_type_t::AIRTON:
+    case decode_type_t::AIRWELL:
+    case decode_type_t::DELONGHI_AC:
+    case decode_type_t::DOSHISHA:
+    case decode_type_t::ECOCLIM:
+    case decode_type_t::CARRIER_AC64:
+    case decode_type_t::KELON:
+    case decode_type_t::PANASONIC_AC32:
+    case decode_type_t::TECHNIBEL_AC:
+    case decode_type_t::TECO:
+    case decode_type_t::TRANSCOLD:
+    case decode_type_t::TRUMA:
+    case decode_type_t::VESTEL_AC:
+      return false;
+    default:
+      return IRac::isProtocolSupported(protocol);
+  }
+}
+
+String uint64ToString(uint64_t input, uint8_t base) {
+  return String(static_cast<unsigned long long>(input), base);
+}
+
+String resultToHexidecimal(const decode_results *result) {
+  String out = "0x";
+  if (hasACState(result->decode_type) || result->bits > 64) {
+    for (uint16_t i = 0; result->bits > i * 8 && i < kStateSizeMax; ++i) {
+      if (result->state[i] < 0x10) out += '0';
+      out += uint64ToString(result->state[i], 16);
+    }
+  } else {
+    out += uint64ToString(result->value, 16);
+  }
+  out.toUpperCase();
+  out.setCharAt(1, 'x');
+  return out;
+}
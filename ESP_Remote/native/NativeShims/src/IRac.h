@@ -0,0 +1,35 @@
+#pragma once
+
+#include "IRsend.h"
+
+// IRac front end: sendAc() records the requested A/C settings in NativeSim
+// rather than encoding a protocol frame.
+class IRac {
+ public:
+  explicit IRac(uint16_t pin, bool inverted = false,
+                bool use_modulation = true)
+      : pin_(pin) {
+    (void)inverted;
+    (void)use_modulation;
+    initState(&next);
+    initState(&prev_);
+  }
+
+  static bool isProtocolSupported(decode_type_t protocol);
+  static void initState(stdAc::state_t *state);
+
+  bool sendAc();
+  bool sendAc(const stdAc::state_t desired) {
+    next = desired;
+    return sendAc();
+  }
+  stdAc::state_t getState() { return next; }
+  stdAc::state_t getStatePrev() { return prev_; }
+  void markAsSent() { prev_ = next; }
+
+  stdAc::state_t next;
+
+ private:
+  uint16_t pin_;
+  stdAc::state_t prev_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "IRremoteESP8266.h"
+
+struct decode_results {
+  decode_type_t decode_type = decode_type_t::UNKNOWN;
+  uint64_t value = 0;
+  uint32_t address = 0;
+  uint32_t command = 0;
+  uint8_t state[kStateSizeMax] = {0};
+  uint16_t bits = 0;
+  volatile uint16_t *rawbuf = nullptr;
+  uint16_t rawlen = 0;
+  bool overflow = false;
+  bool repeat = false;
+};
+
+// Receiver fed by NativeSim::injectIrReceive(); there are no raw timings.
+class IRrecv {
+ public:
+  IRrecv(uint16_t recvpin, uint16_t bufsize = 100, uint8_t timeout = 15,
+         bool save_buffer = false, uint8_t timer_num = 0)
+      : pin_(recvpin) {
+    (void)bufsize;
+    (void)timeout;
+    (void)save_buffer;
+    (void)timer_num;
+  }
+  void enableIRIn(bool pullup = false) {
+    (void)pullup;
+    enabled_ = true;
+  }
+  void disableIRIn() { enabled_ = false; }
+  void resume() {}
+  bool decode(decode_results *results, void *save = nullptr,
+              uint8_t max_skip = 0, uint16_t noise_floor = 0);
+  void setUnknownThreshold(uint16_t length) { (void)length; }
+
+ private:
+  uint16_t pin_;
+  bool enabled_ = false;
+};
@@ -0,0 +1,5 @@
+#pragma once
+#define _IRREMOTEESP8266_VERSION_MAJOR 2
+#define _IRREMOTEESP8266_VERSION_MINOR 8
+#define _IRREMOTEESP8266_VERSION_PATCH 6
+#define _IRREMOTEESP8266_VERSION_STR "2.8.6"
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "IRremoteESP8266.h"
+
+namespace stdAc {
+enum class opmode_t {
+  kOff = -1,
+  kAuto = 0,
+  kCool = 1,
+  kHeat = 2,
+  kDry = 3,
+  kFan = 4,
+  kLastOpmodeEnum = kFan
+};
+enum class fanspeed_t {
+  kAuto = 0,
+  kMin = 1,
+  kLow = 2,
+  kMedium = 3,
+  kHigh = 4,
+  kMax = 5,
+  kMediumHigh = 6,
+  kLastFanspeedEnum = kMediumHigh
+};
+enum class swingv_t {
+  kOff = -1,
+  kAuto = 0,
+  kHighest = 1,
+  kHigh = 2,
+  kMiddle = 3,
+  kLow = 4,
+  kLowest = 5,
+  kUpperMiddle = 6,
+  kLastSwingvEnum = kUpperMiddle
+};
+enum class swingh_t {
+  kOff = -1,
+  kAuto = 0,
+  kLeftMax = 1,
+  kLeft = 2,
+  kMiddle = 3,
+  kRight = 4,
+  kRightMax = 5,
+  kWide = 6,
+  kLastSwinghEnum = kWide
+};
+enum class ac_command_t {
+  kControlCommand = 0,
+  kSensorTempReport,
+  kTimerCommand,
+  kConfigCommand
+};
+
+struct state_t {
+  decode_type_t protocol = decode_type_t::UNKNOWN;
+  int16_t model = -1;
+  bool power = false;
+  stdAc::opmode_t mode = stdAc::opmode_t::kOff;
+  float degrees = 25;
+  bool celsius = true;
+  stdAc::fanspeed_t fanspeed = stdAc::fanspeed_t::kAuto;
+  stdAc::swingv_t swingv = stdAc::swingv_t::kOff;
+  stdAc::swingh_t swingh = stdAc::swingh_t::kOff;
+  bool quiet = false;
+  bool turbo = false;
+  bool econo = false;
+  bool light = false;
+  bool filter = false;
+  bool clean = false;
+  bool beep = false;
+  int16_t sleep = -1;
+  int16_t clock = -1;
+  stdAc::ac_command_t command = stdAc::ac_command_t::kControlCommand;
+  bool iFeel = false;
+  float sensorTemperature = 0;
+};
+}  // namespace stdAc
+
+// Records every frame in NativeSim instead of modulating a pin.
+class IRsend {
+ public:
+  explicit IRsend(uint16_t pin, bool inverted = false,
+                  bool use_modulation = true)
+      : pin_(pin) {
+    (void)inverted;
+    (void)use_modulation;
+  }
+  void begin() {}
+
+  bool send(decode_type_t type, uint64_t data, uint16_t nbits,
+            uint16_t repeat = 0);
+  bool send(decode_type_t type, const uint8_t *state, uint16_t nbytes);
+
+  uint64_t toggleRC5(uint64_t data);
+  uint64_t toggleRC6(uint64_t data, uint16_t nbits);
+
+ private:
+  uint16_t pin_;
+};
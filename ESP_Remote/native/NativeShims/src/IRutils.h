@@ -0,0 +1,12 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "IRrecv.h"
+#include "IRremoteESP8266.h"
+
+String typeToString(decode_type_t protocol, bool isRepeat = false);
+decode_type_t strToDecodeType(const char *str);
+bool hasACState(decode_type_t protocol);
+String uint64ToString(uint64_t input, uint8_t base = 10);
+String resultToHexidecimal(const decode_results *result);
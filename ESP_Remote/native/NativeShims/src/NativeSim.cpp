@@ -0,0 +1,210 @@
+#include "NativeSim.h"
+
+#include <WiFi.h>
+#include <WebServer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "NativeSimInternal.h"
+
+namespace NativeSim {
+namespace {
+
+constexpr const char *kBrokerHost = "127.0.0.1";
+constexpr uint16_t kBrokerPort = 1883;
+
+std::vector<AccessPoint> accessPointList;
+bool wifiUp = true;
+bool brokerUp = true;
+std::atomic<uint32_t> connects{0};
+bool echoSerial = true;
+
+void (*networkTickHandler)() = nullptr;
+
+// The network task publishes while the driver's thread takes the output.
+std::mutex brokerMutex;
+std::deque<Message> toNode;
+std::vector<Message> fromNode;
+std::map<std::string, Message> retained;
+
+// IR frames arrive from the ir_tx task and leave through the ir_rx task.
+std::mutex irMutex;
+std::vector<IrFrame> irSent;
+std::deque<IrFrame> irReceived;
+
+std::vector<WebServer *> servers;
+// The status LED (network task) and the IR pin (ir_tx) are set concurrently.
+std::mutex pinMutex;
+std::map<uint8_t, uint8_t> pinLevels;
+
+void retain(const Message &message) {
+  if (!message.retained) return;
+  if (message.payload.isEmpty()) {
+    retained.erase(message.topic.str());
+  } else {
+    retained[message.topic.str()] = message;
+  }
+}
+
+HTTPMethod parseMethod(const char *method) {
+  if (method != nullptr && strcasecmp(method, "POST") == 0) return HTTP_POST;
+  return HTTP_GET;
+}
+
+}  // namespace
+
+void setNetworkTick(void (*handler)()) { networkTickHandler = handler; }
+
+void addAccessPoint(const AccessPoint &ap) { accessPointList.push_back(ap); }
+
+void clearAccessPoints() { accessPointList.clear(); }
+
+void setWifiAvailable(bool available) { wifiUp = available; }
+
+const char *brokerHost() { return kBrokerHost; }
+
+uint16_t brokerPort() { return kBrokerPort; }
+
+void setBrokerReachable(bool reachable) { brokerUp = reachable; }
+
+bool brokerReachable() { return brokerUp; }
+
+uint32_t brokerConnects() { return connects; }
+
+void publishToNode(const String &topic, const String &payload, bool keep) {
+  Message message;
+  message.topic = topic;
+  message.payload = payload;
+  message.retained = keep;
+  message.atMs = millis();
+  std::lock_guard<std::mutex> lock(brokerMutex);
+  retain(message);
+  toNode.push_back(message);
+}
+
+std::vector<Message> takePublished() {
+  std::lock_guard<std::mutex> lock(brokerMutex);
+  std::vector<Message> out;
+  out.swap(fromNode);
+  return out;
+}
+
+std::vector<IrFrame> takeIrFrames() {
+  std::lock_guard<std::mutex> lock(irMutex);
+  std::vector<IrFrame> out;
+  out.swap(irSent);
+  return out;
+}
+
+void injectIrReceive(decode_type_t protocol, uint64_t value, uint16_t nbits,
+                     const std::vector<uint8_t> &state) {
+  IrFrame frame;
+  frame.protocol = protocol;
+  frame.value = value;
+  frame.nbits = nbits;
+  frame.state = state;
+  frame.kind = state.empty() ? "value" : "state";
+  frame.atMs = millis();
+  std::lock_guard<std::mutex> lock(irMutex);
+  irReceived.push_back(frame);
+}
+
+String http(const char *method, const String &uri, int &status,
+            const String &body) {
+  status = 0;
+  String response;
+  // A handler may stop its own server (the portal does on /save).
+  const std::vector<WebServer *> listening = servers;
+  for (WebServer *server : listening) {
+    if (server->simHandle(parseMethod(method), uri, body, status, response)) {
+      break;
+    }
+  }
+  return response;
+}
+
+void setSerialEcho(bool echo) { echoSerial = echo; }
+
+bool serialEcho() { return echoSerial; }
+
+void recordPin(uint8_t pin, uint8_t level) {
+  std::lock_guard<std::mutex> lock(pinMutex);
+  pinLevels[pin] = level;
+}
+
+int pinLevel(uint8_t pin) {
+  std::lock_guard<std::mutex> lock(pinMutex);
+  auto it = pinLevels.find(pin);
+  return it != pinLevels.end() ? it->second : LOW;
+}
+
+namespace internal {
+
+void networkTick() {
+  WiFi.simStep();
+  if (networkTickHandler != nullptr) networkTickHandler();
+}
+
+const std::vector<AccessPoint> &accessPoints() { return accessPointList; }
+
+bool wifiAvailable() { return wifiUp; }
+
+bool brokerAccepts(const char *host, uint16_t port) {
+  ++connects;
+  return brokerUp && host != nullptr && strcmp(host, kBrokerHost) == 0 &&
+         port == kBrokerPort;
+}
+
+void brokerReceive(const Message &message) {
+  std::lock_guard<std::mutex> lock(brokerMutex);
+  retain(message);
+  fromNode.push_back(message);
+}
+
+bool brokerNextForNode(Message &out) {
+  std::lock_guard<std::mutex> lock(brokerMutex);
+  if (toNode.empty()) return false;
+  out = toNode.front();
+  toNode.pop_front();
+  return true;
+}
+
+std::vector<Message> brokerRetained() {
+  std::lock_guard<std::mutex> lock(brokerMutex);
+  std::vector<Message> out;
+  for (const auto &entry : retained) out.push_back(entry.second);
+  return out;
+}
+
+void recordIrFrame(IrFrame frame) {
+  frame.atMs = millis();
+  std::lock_guard<std::mutex> lock(irMutex);
+  irSent.push_back(std::move(frame));
+}
+
+bool nextIrReceive(IrFrame &out) {
+  std::lock_guard<std::mutex> lock(irMutex);
+  if (irReceived.empty()) return false;
+  out = irReceived.front();
+  irReceived.pop_front();
+  return true;
+}
+
+void registerServer(WebServer *server) {
+  if (std::find(servers.begin(), servers.end(), server) == servers.end()) {
+    servers.push_back(server);
+  }
+}
+
+void unregisterServer(WebServer *server) {
+  servers.erase(std::remove(servers.begin(), servers.end(), server),
+                servers.end());
+}
+
+}  // namespace internal
+}  // namespace NativeSim
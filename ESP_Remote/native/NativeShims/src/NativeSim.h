@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IRremoteESP8266.h>
+#include <vector>
+
+// Control surface of the host simulator. The shims in this library stand in
+// for the radio, the broker and the IR LED; NativeMain (or any other host
+// driver) uses these calls to feed the firmware and inspect what it did.
+namespace NativeSim {
+
+struct AccessPoint {
+  String ssid;
+  String password;
+  int32_t rssi = -50;
+  uint8_t channel = 6;
+  uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+};
+
+// One PUBLISH the firmware sent to the in-process broker.
+struct Message {
+  String topic;
+  String payload;
+  bool retained = false;
+  uint32_t atMs = 0;
+};
+
+// One frame that reached IRsend/IRac. `kind` is "value", "state" or "ac".
+struct IrFrame {
+  const char *kind = "value";
+  decode_type_t protocol = decode_type_t::UNKNOWN;
+  uint64_t value = 0;
+  uint16_t nbits = 0;
+  std::vector<uint8_t> state;
+  String detail;  // A/C settings for "ac" frames
+  uint32_t atMs = 0;
+};
+
+// The firmware's network task is the only thread that may touch the radio,
+// the broker session and the portal, so the simulator advances from there:
+// every PubSubClient::loop() delivers due Wi-Fi events and scan results, then
+// runs `handler`. Host drivers change Wi-Fi/broker reachability, publish to
+// the node and make HTTP requests from the handler; takePublished() and
+// takeIrFrames() are safe from any thread.
+void setNetworkTick(void (*handler)());
+
+// ---- Wi-Fi ----------------------------------------------------------------
+void addAccessPoint(const AccessPoint &ap);
+void clearAccessPoints();
+// Takes every AP off the air (and drops the station) or brings them back.
+void setWifiAvailable(bool available);
+
+// ---- Broker ---------------------------------------------------------------
+// The broker answers UDP discovery and TCP connects at this address.
+const char *brokerHost();
+uint16_t brokerPort();
+// An unreachable broker refuses connects and drops the current session.
+void setBrokerReachable(bool reachable);
+bool brokerReachable();
+// TCP connects the firmware opened to the broker, refused ones included.
+uint32_t brokerConnects();
+// Queues a message for the firmware; it is delivered from mqtt.loop() when
+// the topic matches one of the node's subscriptions.
+void publishToNode(const String &topic, const String &payload,
+                   bool retained = false);
+std::vector<Message> takePublished();
+
+// ---- IR ---------------------------------------------------------------------
+std::vector<IrFrame> takeIrFrames();
+// The next IRrecv::decode() returns this frame. `state` carries the bytes of
+// protocols wider than 64 bits.
+void injectIrReceive(decode_type_t protocol, uint64_t value, uint16_t nbits,
+                     const std::vector<uint8_t> &state = {});
+
+// ---- Portal -----------------------------------------------------------------
+// Runs the handler the firmware registered for `uri` (query string allowed;
+// `body` is an application/x-www-form-urlencoded POST body). Returns the
+// response body and sets `status`; 0 when no server is listening.
+String http(const char *method, const String &uri, int &status,
+            const String &body = String());
+
+// ---- Misc -------------------------------------------------------------------
+void setSerialEcho(bool echo);
+bool serialEcho();
+void recordPin(uint8_t pin, uint8_t level);
+int pinLevel(uint8_t pin);
+
+}  // namespace NativeSim
@@ -0,0 +1,33 @@
+#pragma once
+
+// Shared state between the shims and NativeSim. Not for use by the firmware
+// or by host drivers.
+
+#include <vector>
+
+#include "NativeSim.h"
+
+class WebServer;
+
+namespace NativeSim {
+namespace internal {
+
+// Runs from PubSubClient::loop(); see setNetworkTick().
+void networkTick();
+
+const std::vector<AccessPoint> &accessPoints();
+bool wifiAvailable();
+
+bool brokerAccepts(const char *host, uint16_t port);
+void brokerReceive(const Message &fromNode);
+bool brokerNextForNode(Message &out);
+std::vector<Message> brokerRetained();
+
+void recordIrFrame(IrFrame frame);
+bool nextIrReceive(IrFrame &out);
+
+void registerServer(WebServer *server);
+void unregisterServer(WebServer *server);
+
+}  // namespace internal
+}  // namespace NativeSim
@@ -0,0 +1,92 @@
+#include <Preferences.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+std::mutex nvsMutex;
+
+std::map<std::string, Namespace> &flash() {
+  static std::map<std::string, Namespace> partitions;
+  return partitions;
+}
+
+// NVS limits keys and namespaces to 15 characters.
+bool validName(const char *name) {
+  return name != nullptr && *name != '\0' && strlen(name) <= 15;
+}
+
+}  // namespace
+
+bool Preferences::begin(const char *name, bool readOnly, const char *) {
+  if (open_ || !validName(name)) return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  namespace_ = name;
+  readOnly_ = readOnly;
+  if (!readOnly) flash()[namespace_.str()];
+  open_ = true;
+  return true;
+}
+
+void Preferences::end() { open_ = false; }
+
+bool Preferences::clear() {
+  if (!open_ || readOnly_) return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  flash()[namespace_.str()].clear();
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  if (!open_ || readOnly_ || !validName(key)) return false;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  return flash()[namespace_.str()].erase(key) != 0;
+}
+
+bool Preferences::isKey(const char *key) { return getBytesLength(key) != 0; }
+
+size_t Preferences::putBytes(const char *key, const void *value,
+                             size_t length) {
+  if (!open_ || readOnly_ || !validName(key) || value == nullptr) return 0;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  flash()[namespace_.str()][key].assign(bytes, bytes + length);
+  return length;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength) {
+  if (!open_ || !validName(key) || buffer == nullptr) return 0;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  const Namespace &space = flash()[namespace_.str()];
+  auto it = space.find(key);
+  if (it == space.end() || it->second.size() > maxLength) return 0;
+  memcpy(buffer, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  if (!open_ || !validName(key)) return 0;
+  std::lock_guard<std::mutex> lock(nvsMutex);
+  const Namespace &space = flash()[namespace_.str()];
+  auto it = space.find(key);
+  return it != space.end() ? it->second.size() : 0;
+}
+
+size_t Preferences::putString(const char *key, const char *value) {
+  if (value == nullptr) return 0;
+  // Stored with its terminator, as nvs_set_str() does.
+  return putBytes(key, value, strlen(value) + 1) > 0 ? strlen(value) : 0;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+  const size_t length = getBytesLength(key);
+  if (length == 0) return defaultValue;
+  std::vector<char> buffer(length);
+  if (getBytes(key, buffer.data(), length) != length) return defaultValue;
+  return String(buffer.data(), static_cast<unsigned>(strnlen(buffer.data(), length)));
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+
+// NVS stand-in: namespaces and keys live in process memory, so a run always
+// starts from an erased flash.
+class Preferences {
+ public:
+  bool begin(const char *name, bool readOnly = false,
+             const char *partition = nullptr);
+  void end();
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putBytes(const char *key, const void *value, size_t length);
+  size_t getBytes(const char *key, void *buffer, size_t maxLength);
+  size_t getBytesLength(const char *key);
+
+  size_t putString(const char *key, const char *value);
+  size_t putString(const char *key, const String &value) {
+    return putString(key, value.c_str());
+  }
+  String getString(const char *key, const String &defaultValue = String());
+
+  size_t putUChar(const char *key, uint8_t value) {
+    return putScalar(key, &value, sizeof(value));
+  }
+  uint8_t getUChar(const char *key, uint8_t defaultValue = 0) {
+    return getScalar(key, defaultValue);
+  }
+  size_t putUShort(const char *key, uint16_t value) {
+    return putScalar(key, &value, sizeof(value));
+  }
+  uint16_t getUShort(const char *key, uint16_t defaultValue = 0) {
+    return getScalar(key, defaultValue);
+  }
+  size_t putInt(const char *key, int32_t value) {
+    return putScalar(key, &value, sizeof(value));
+  }
+  int32_t getInt(const char *key, int32_t defaultValue = 0) {
+    return getScalar(key, defaultValue);
+  }
+  size_t putUInt(const char *key, uint32_t value) {
+    return putScalar(key, &value, sizeof(value));
+  }
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+    return getScalar(key, defaultValue);
+  }
+  size_t putULong64(const char *key, uint64_t value) {
+    return putScalar(key, &value, sizeof(value));
+  }
+  uint64_t getULong64(const char *key, uint64_t defaultValue = 0) {
+    return getScalar(key, defaultValue);
+  }
+  size_t putBool(const char *key, bool value) {
+    const uint8_t stored = value ? 1 : 0;
+    return putScalar(key, &stored, sizeof(stored));
+  }
+  bool getBool(const char *key, bool defaultValue = false) {
+    return getScalar<uint8_t>(key, defaultValue ? 1 : 0) != 0;
+  }
+
+ private:
+  size_t putScalar(const char *key, const void *value, size_t length) {
+    return putBytes(key, value, length);
+  }
+  template <typename T>
+  T getScalar(const char *key, T defaultValue) {
+    T value = defaultValue;
+    if (getBytesLength(key) != sizeof(T)) return defaultValue;
+    getBytes(key, &value, sizeof(T));
+    return value;
+  }
+
+  String namespace_;
+  bool open_ = false;
+  bool readOnly_ = false;
+};
@@ -0,0 +1,222 @@
+#include <PubSubClient.h>
+
+#include "NativeSimInternal.h"
+
+namespace {
+
+// MQTT topic filter match with '+' and '#'.
+bool topicMatches(const char *filter, const char *topic) {
+  while (*filter != '\0') {
+    if (*filter == '#') return true;
+    if (*filter == '+') {
+      while (*topic != '\0' && *topic != '/') ++topic;
+      ++filter;
+      continue;
+    }
+    if (*filter != *topic) return false;
+    ++filter;
+    ++topic;
+  }
+  return *topic == '\0';
+}
+
+}  // namespace
+
+PubSubClient::PubSubClient() : buffer_(MQTT_MAX_PACKET_SIZE) {}
+
+PubSubClient::PubSubClient(Client &client) : PubSubClient() {
+  client_ = &client;
+}
+
+PubSubClient &PubSubClient::setServer(IPAddress ip, uint16_t port) {
+  return setServer(ip.toString().c_str(), port);
+}
+
+PubSubClient &PubSubClient::setServer(const char *domain, uint16_t port) {
+  domain_ = domain;
+  port_ = port;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  callback_ = callback;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setClient(Client &client) {
+  client_ = &client;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setKeepAlive(uint16_t) { return *this; }
+
+PubSubClient &PubSubClient::setSocketTimeout(uint16_t) { return *this; }
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  buffer_.assign(size, 0);
+  return true;
+}
+
+bool PubSubClient::connect(const char *id, const char *, const char *,
+                           const char *willTopic, uint8_t, bool willRetain,
+                           const char *willMessage, bool) {
+  if (connected()) return true;
+  if (client_ == nullptr || id == nullptr) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  // Like the real client, reuse a socket the caller already opened.
+  if (!client_->connected() && !client_->connect(domain_.c_str(), port_)) {
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  willTopic_ = willTopic != nullptr ? willTopic : "";
+  willMessage_ = willMessage != nullptr ? willMessage : "";
+  willRetain_ = willRetain;
+  subscriptions_.clear();
+  session_ = true;
+  state_ = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  session_ = false;
+  subscriptions_.clear();
+  state_ = MQTT_DISCONNECTED;
+  if (client_ != nullptr) client_->stop();
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload,
+                           bool retained) {
+  return publish(topic, reinterpret_cast<const uint8_t *>(payload),
+                 payload != nullptr ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload,
+                           unsigned int length, bool retained) {
+  if (!connected() || topic == nullptr) return false;
+  const size_t packet = MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length;
+  if (packet > buffer_.size()) return false;
+  NativeSim::Message message;
+  message.topic = topic;
+  message.payload =
+      String(reinterpret_cast<const char *>(payload), static_cast<unsigned>(length));
+  message.retained = retained;
+  message.atMs = millis();
+  NativeSim::internal::brokerReceive(message);
+  return true;
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length,
+                                bool retained) {
+  if (!connected() || topic == nullptr) return false;
+  streaming_ = true;
+  pendingTopic_ = topic;
+  pendingPayload_ = "";
+  pendingRetained_ = retained;
+  pendingLength_ = length;
+  return true;
+}
+
+size_t PubSubClient::write(const uint8_t *buffer, size_t size) {
+  if (!streaming_ || buffer == nullptr) return 0;
+  pendingPayload_ += String(reinterpret_cast<const char *>(buffer),
+                             static_cast<unsigned>(size));
+  return size;
+}
+
+int PubSubClient::endPublish() {
+  if (!streaming_) return 0;
+  streaming_ = false;
+  // The real client announces the length up front; a mismatch corrupts the
+  // stream, so treat it as a failed publish.
+  if (!connected() || pendingPayload_.length() != pendingLength_) return 0;
+  NativeSim::Message message;
+  message.topic = pendingTopic_;
+  message.payload = pendingPayload_;
+  message.retained = pendingRetained_;
+  message.atMs = millis();
+  NativeSim::internal::brokerReceive(message);
+  return 1;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t) {
+  if (!connected() || topic == nullptr) return false;
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + 1 > buffer_.size()) {
+    return false;
+  }
+  if (!subscribed(topic)) subscriptions_.push_back(topic);
+  for (const auto &message : NativeSim::internal::brokerRetained()) {
+    if (topicMatches(topic, message.topic.c_str())) {
+      deliver(message.topic, message.payload);
+    }
+  }
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char *topic) {
+  if (!connected() || topic == nullptr) return false;
+  for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it) {
+    if (*it == topic) {
+      subscriptions_.erase(it);
+      break;
+    }
+  }
+  return true;
+}
+
+bool PubSubClient::subscribed(const char *topic) const {
+  for (const auto &filter : subscriptions_) {
+    if (topicMatches(filter.c_str(), topic)) return true;
+  }
+  return false;
+}
+
+void PubSubClient::deliver(const String &topic, const String &payload) {
+  if (!callback_) return;
+  // The real client hands out its receive buffer; the topic is copied to the
+  // front and the payload follows it, so a message must fit the buffer.
+  const size_t topicLength = topic.length();
+  if (MQTT_MAX_HEADER_SIZE + 2 + topicLength + payload.length() >
+      buffer_.size()) {
+    return;
+  }
+  uint8_t *base = buffer_.data();
+  memcpy(base, topic.c_str(), topicLength + 1);
+  uint8_t *body = base + topicLength + 1;
+  memcpy(body, payload.c_str(), payload.length());
+  callback_(reinterpret_cast<char *>(base), body, payload.length());
+}
+
+void PubSubClient::lose() {
+  if (!session_) return;
+  session_ = false;
+  subscriptions_.clear();
+  state_ = MQTT_CONNECTION_LOST;
+  if (!willTopic_.isEmpty()) {
+    NativeSim::Message will;
+    will.topic = willTopic_;
+    will.payload = willMessage_;
+    will.retained = willRetain_;
+    will.atMs = millis();
+    NativeSim::internal::brokerReceive(will);
+  }
+}
+
+bool PubSubClient::connected() {
+  if (session_ && (client_ == nullptr || !client_->connected())) lose();
+  return session_;
+}
+
+bool PubSubClient::loop() {
+  NativeSim::internal::networkTick();
+  if (!connected()) return false;
+  NativeSim::Message message;
+  while (session_ && NativeSim::internal::brokerNextForNode(message)) {
+    if (subscribed(message.topic.c_str())) {
+      deliver(message.topic, message.payload);
+    }
+  }
+  return session_;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Client.h"
+#include "IPAddress.h"
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CALLBACK_SIGNATURE \
+  std::function<void(char *, uint8_t *, unsigned int)> callback
+
+// PubSubClient talking to the in-process broker of NativeSim. Packet size
+// limits follow the real client (MQTT_MAX_PACKET_SIZE or setBufferSize()),
+// so oversized publishes fail and oversized deliveries are dropped the same
+// way they do on the device.
+class PubSubClient : public Print {
+ public:
+  PubSubClient();
+  explicit PubSubClient(Client &client);
+
+  PubSubClient &setServer(IPAddress ip, uint16_t port);
+  PubSubClient &setServer(const char *domain, uint16_t port);
+  PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient &setClient(Client &client);
+  PubSubClient &setKeepAlive(uint16_t keepAlive);
+  PubSubClient &setSocketTimeout(uint16_t timeout);
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return static_cast<uint16_t>(buffer_.size()); }
+
+  bool connect(const char *id) {
+    return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr);
+  }
+  bool connect(const char *id, const char *user, const char *pass) {
+    return connect(id, user, pass, nullptr, 0, false, nullptr);
+  }
+  bool connect(const char *id, const char *willTopic, uint8_t willQos,
+               bool willRetain, const char *willMessage) {
+    return connect(id, nullptr, nullptr, willTopic, willQos, willRetain,
+                   willMessage);
+  }
+  bool connect(const char *id, const char *user, const char *pass,
+               const char *willTopic, uint8_t willQos, bool willRetain,
+               const char *willMessage, bool cleanSession = true);
+  void disconnect();
+
+  bool publish(const char *topic, const char *payload) {
+    return publish(topic, payload, false);
+  }
+  bool publish(const char *topic, const char *payload, bool retained);
+  bool publish(const char *topic, const uint8_t *payload, unsigned int length) {
+    return publish(topic, payload, length, false);
+  }
+  bool publish(const char *topic, const uint8_t *payload, unsigned int length,
+               bool retained);
+
+  // Streamed publish: the payload does not have to fit the buffer.
+  bool beginPublish(const char *topic, unsigned int length, bool retained);
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int endPublish();
+
+  bool subscribe(const char *topic) { return subscribe(topic, 0); }
+  bool subscribe(const char *topic, uint8_t qos);
+  bool unsubscribe(const char *topic);
+
+  bool loop();
+  bool connected();
+  int state() { return state_; }
+
+ private:
+  bool subscribed(const char *topic) const;
+  void deliver(const String &topic, const String &payload);
+  void lose();
+
+  Client *client_ = nullptr;
+  String domain_;
+  uint16_t port_ = 0;
+  std::function<void(char *, uint8_t *, unsigned int)> callback_;
+  std::vector<uint8_t> buffer_;
+  std::vector<std::string> subscriptions_;
+  String willTopic_;
+  String willMessage_;
+  bool willRetain_ = false;
+  bool streaming_ = false;  // between beginPublish() and endPublish()
+  String pendingTopic_;
+  String pendingPayload_;
+  bool pendingRetained_ = false;
+  size_t pendingLength_ = 0;
+  bool session_ = false;
+  int state_ = MQTT_DISCONNECTED;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "WiFi.h"
+
+typedef enum {
+  HTTP_ANY,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+  HTTP_PATCH,
+  HTTP_DELETE,
+  HTTP_OPTIONS
+} HTTPMethod;
+
+// Handler registry without sockets: requests come from NativeSim::http() and
+// run synchronously on the caller's thread.
+class WebServer {
+ public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80) : port_(port) {}
+  ~WebServer();
+
+  void begin();
+  void stop();
+  void close() { stop(); }
+  void handleClient() {}
+  void on(const String &uri, THandlerFunction handler) {
+    on(uri, HTTP_ANY, handler);
+  }
+  void on(const String &uri, HTTPMethod method, THandlerFunction handler);
+  void onNotFound(THandlerFunction handler) { notFound_ = handler; }
+
+  String arg(const String &name);
+  bool hasArg(const String &name);
+  String uri() { return uri_; }
+  HTTPMethod method() { return method_; }
+
+  void send(int code, const char *contentType, const String &content);
+  void send(int code, const char *contentType, const char *content) {
+    send(code, contentType, String(content));
+  }
+  void send(int code, const String &contentType, const String &content) {
+    send(code, contentType.c_str(), content);
+  }
+
+  // Host only: dispatches one request, see NativeSim::http().
+  bool simHandle(HTTPMethod method, const String &uri, const String &body,
+                 int &status, String &response);
+
+ private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  };
+
+  int port_;
+  bool listening_ = false;
+  std::vector<Route> routes_;
+  THandlerFunction notFound_;
+  String uri_;
+  HTTPMethod method_ = HTTP_GET;
+  std::map<std::string, std::string> args_;
+  int status_ = 0;
+  String response_;
+};
@@ -0,0 +1,453 @@
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <WebServer.h>
+
+#include <stdlib.h>
+
+#include "NativeSimInternal.h"
+
+WiFiClass WiFi;
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+namespace {
+
+constexpr uint32_t kJoinDelayMs = 150;
+constexpr uint32_t kScanDelayMs = 400;
+constexpr uint8_t kReasonNoApFound = 201;
+constexpr uint8_t kReasonAuthFail = 202;
+constexpr uint8_t kReasonBeaconTimeout = 200;
+
+const IPAddress kStationIp(192, 168, 1, 50);
+const IPAddress kGateway(192, 168, 1, 1);
+const IPAddress kSubnet(255, 255, 255, 0);
+
+bool sameBssid(const uint8_t *a, const uint8_t *b) {
+  return memcmp(a, b, 6) == 0;
+}
+
+wifi_auth_mode_t authFor(const NativeSim::AccessPoint &ap) {
+  return ap.password.isEmpty() ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
+}
+
+std::string urlDecode(const std::string &in) {
+  std::string out;
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (in[i] == '+') {
+      out += ' ';
+    } else if (in[i] == '%' && i + 2 < in.size()) {
+      out += static_cast<char>(strtol(in.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else {
+      out += in[i];
+    }
+  }
+  return out;
+}
+
+void parseForm(const std::string &text, std::map<std::string, std::string> &out) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('&', pos);
+    if (end == std::string::npos) end = text.size();
+    const std::string pair = text.substr(pos, end - pos);
+    const size_t eq = pair.find('=');
+    if (!pair.empty()) {
+      out[urlDecode(pair.substr(0, eq))] =
+          eq == std::string::npos ? "" : urlDecode(pair.substr(eq + 1));
+    }
+    pos = end + 1;
+  }
+}
+
+}  // namespace
+
+// ---- IPAddress ---------------------------------------------------------------
+
+String IPAddress::toString() const {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1],
+           (*this)[2], (*this)[3]);
+  return String(buffer);
+}
+
+bool IPAddress::fromString(const char *text) {
+  unsigned a, b, c, d;
+  char tail;
+  if (text == nullptr ||
+      sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 ||
+      b > 255 || c > 255 || d > 255) {
+    return false;
+  }
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+// ---- WiFiClass ---------------------------------------------------------------
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase,
+                             int32_t channel, const uint8_t *bssid,
+                             bool connect) {
+  if (ssid == nullptr || *ssid == '\0') return WL_CONNECT_FAILED;
+  if (mode_ == WIFI_OFF) mode_ = WIFI_STA;
+  savedSsid_ = ssid;
+  savedPassword_ = passphrase != nullptr ? passphrase : "";
+  if (status_ == WL_CONNECTED) simDrop();
+  status_ = WL_DISCONNECTED;
+  if (!connect) return status_;
+
+  pending_ = Pending();
+  pending_.active = true;
+  pending_.ssid = savedSsid_;
+  pending_.password = savedPassword_;
+  pending_.channel = channel;
+  pending_.hasBssid = bssid != nullptr;
+  if (bssid != nullptr) memcpy(pending_.bssid, bssid, 6);
+  pending_.dueMs = millis() + kJoinDelayMs;
+  return status_;
+}
+
+wl_status_t WiFiClass::begin() {
+  if (savedSsid_.isEmpty()) return WL_CONNECT_FAILED;
+  const String ssid = savedSsid_;
+  const String password = savedPassword_;
+  return begin(ssid.c_str(), password.c_str());
+}
+
+bool WiFiClass::config(IPAddress localIp, IPAddress gateway, IPAddress subnet,
+                       IPAddress dns1, IPAddress) {
+  staticIp_ = static_cast<uint32_t>(localIp) != 0;
+  staticIpAddr_ = localIp;
+  staticGateway_ = gateway;
+  staticSubnet_ = subnet;
+  staticDns_ = dns1;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+  pending_.active = false;
+  if (eraseAp) {
+    savedSsid_.clear();
+    savedPassword_.clear();
+  }
+  if (wifiOff) mode_ = WIFI_OFF;
+  if (status_ == WL_CONNECTED) simDrop();
+  return true;
+}
+
+String WiFiClass::SSID(uint8_t index) const {
+  return index < scan_.size() ? scan_[index].ssid : String();
+}
+
+int32_t WiFiClass::RSSI() { return isConnected() ? rssi_ : 0; }
+
+int32_t WiFiClass::RSSI(uint8_t index) {
+  return index < scan_.size() ? scan_[index].rssi : 0;
+}
+
+uint8_t *WiFiClass::BSSID() { return isConnected() ? bssid_ : nullptr; }
+
+uint8_t *WiFiClass::BSSID(uint8_t index) {
+  return index < scan_.size() ? scan_[index].bssid : nullptr;
+}
+
+int32_t WiFiClass::channel() { return isConnected() ? channel_ : 0; }
+
+int32_t WiFiClass::channel(uint8_t index) {
+  return index < scan_.size() ? scan_[index].channel : 0;
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t index) {
+  return index < scan_.size() ? scan_[index].auth : WIFI_AUTH_OPEN;
+}
+
+int16_t WiFiClass::scanNetworks(bool async, bool, bool, uint32_t, uint8_t,
+                                const char *, const uint8_t *) {
+  if (scanRunning_) return WIFI_SCAN_RUNNING;
+  scanDelete();
+  scanRunning_ = true;
+  scanDueMs_ = millis() + kScanDelayMs;
+  if (async) return WIFI_SCAN_RUNNING;
+  delay(kScanDelayMs);
+  simStep();
+  return scanCount_;
+}
+
+int16_t WiFiClass::scanComplete() {
+  if (scanRunning_) return WIFI_SCAN_RUNNING;
+  return scanCount_;
+}
+
+void WiFiClass::scanDelete() {
+  scan_.clear();
+  scanCount_ = WIFI_SCAN_FAILED;
+}
+
+bool WiFiClass::softAP(const char *, const char *, int, int, int) {
+  apRunning_ = true;
+  mode_ = mode_ == WIFI_STA ? WIFI_AP_STA : WIFI_AP;
+  return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress localIp, IPAddress, IPAddress) {
+  apIp_ = localIp;
+  return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool) {
+  apRunning_ = false;
+  if (mode_ == WIFI_AP_STA) mode_ = WIFI_STA;
+  return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventSysCb cb, arduino_event_id_t) {
+  handlers_.push_back(cb);
+  return static_cast<wifi_event_id_t>(handlers_.size());
+}
+
+void WiFiClass::fire(arduino_event_t &event) {
+  for (auto &handler : handlers_) handler(&event);
+}
+
+void WiFiClass::fireDisconnected(uint8_t reason) {
+  arduino_event_t event = {};
+  event.event_id = ARDUINO_EVENT_WIFI_STA_DISCONNECTED;
+  event.event_info.wifi_sta_disconnected.reason = reason;
+  fire(event);
+}
+
+void WiFiClass::simDrop() {
+  status_ = WL_CONNECTION_LOST;
+  fireDisconnected(kReasonBeaconTimeout);
+}
+
+void WiFiClass::simStep() {
+  const uint32_t now = millis();
+
+  if (scanRunning_ && static_cast<int32_t>(now - scanDueMs_) >= 0) {
+    scanRunning_ = false;
+    scan_.clear();
+    if (NativeSim::internal::wifiAvailable()) {
+      for (const auto &ap : NativeSim::internal::accessPoints()) {
+        ScanEntry entry;
+        entry.ssid = ap.ssid;
+        entry.rssi = ap.rssi;
+        entry.channel = ap.channel;
+        memcpy(entry.bssid, ap.bssid, 6);
+        entry.auth = authFor(ap);
+        scan_.push_back(entry);
+      }
+    }
+    scanCount_ = static_cast<int16_t>(scan_.size());
+  }
+
+  if (status_ == WL_CONNECTED && !NativeSim::internal::wifiAvailable()) {
+    simDrop();
+  }
+
+  if (!pending_.active || static_cast<int32_t>(now - pending_.dueMs) < 0) {
+    return;
+  }
+  pending_.active = false;
+
+  const NativeSim::AccessPoint *match = nullptr;
+  bool ssidSeen = false;
+  if (NativeSim::internal::wifiAvailable()) {
+    for (const auto &ap : NativeSim::internal::accessPoints()) {
+      if (ap.ssid != pending_.ssid) continue;
+      if (pending_.channel != 0 && ap.channel != pending_.channel) continue;
+      if (pending_.hasBssid && !sameBssid(ap.bssid, pending_.bssid)) continue;
+      ssidSeen = true;
+      if (ap.password == pending_.password) {
+        match = &ap;
+        break;
+      }
+    }
+  }
+  if (match == nullptr) {
+    status_ = ssidSeen ? WL_CONNECT_FAILED : WL_NO_SSID_AVAIL;
+    fireDisconnected(ssidSeen ? kReasonAuthFail : kReasonNoApFound);
+    return;
+  }
+
+  status_ = WL_CONNECTED;
+  ssid_ = match->ssid;
+  memcpy(bssid_, match->bssid, 6);
+  channel_ = match->channel;
+  rssi_ = match->rssi;
+  ip_ = staticIp_ ? staticIpAddr_ : kStationIp;
+  gateway_ = staticIp_ ? staticGateway_ : kGateway;
+  subnet_ = staticIp_ ? staticSubnet_ : kSubnet;
+  dns_ = staticIp_ ? staticDns_ : kGateway;
+
+  arduino_event_t connected = {};
+  connected.event_id = ARDUINO_EVENT_WIFI_STA_CONNECTED;
+  connected.event_info.wifi_sta_connected.channel = match->channel;
+  memcpy(connected.event_info.wifi_sta_connected.bssid, match->bssid, 6);
+  fire(connected);
+
+  arduino_event_t gotIp = {};
+  gotIp.event_id = ARDUINO_EVENT_WIFI_STA_GOT_IP;
+  gotIp.event_info.got_ip.ip_info.ip.addr = static_cast<uint32_t>(ip_);
+  gotIp.event_info.got_ip.ip_info.netmask.addr = static_cast<uint32_t>(subnet_);
+  gotIp.event_info.got_ip.ip_info.gw.addr = static_cast<uint32_t>(gateway_);
+  fire(gotIp);
+}
+
+// ---- WiFiClient ----------------------------------------------------------------
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  connected_ = WiFi.isConnected() &&
+               NativeSim::internal::brokerAccepts(host, port);
+  return connected_ ? 1 : 0;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port, int32_t) {
+  return connect(host, port);
+}
+
+uint8_t WiFiClient::connected() {
+  if (connected_ &&
+      (!WiFi.isConnected() || !NativeSim::brokerReachable())) {
+    connected_ = false;
+  }
+  return connected_ ? 1 : 0;
+}
+
+// ---- WiFiUDP -------------------------------------------------------------------
+
+uint8_t WiFiUDP::begin(uint16_t) {
+  open_ = WiFi.isConnected();
+  return open_ ? 1 : 0;
+}
+
+void WiFiUDP::stop() {
+  open_ = false;
+  inbox_.clear();
+  current_.clear();
+  readPos_ = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress, uint16_t port) {
+  if (!open_) return 0;
+  destPort_ = port;
+  outgoing_.clear();
+  return 1;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+  outgoing_ += static_cast<char>(c);
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  outgoing_.append(reinterpret_cast<const char *>(buffer), size);
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (!open_) return 0;
+  // The simulated broker host runs the discovery responder.
+  if (outgoing_ == "DISCOVER_IOT_MQTT" && NativeSim::brokerReachable()) {
+    char reply[64];
+    snprintf(reply, sizeof(reply), "MQTT://%s:%u", NativeSim::brokerHost(),
+             NativeSim::brokerPort());
+    inbox_.push_back(reply);
+  }
+  (void)destPort_;
+  outgoing_.clear();
+  return 1;
+}
+
+int WiFiUDP::parsePacket() {
+  if (!open_ || inbox_.empty()) return 0;
+  current_ = inbox_.front();
+  inbox_.pop_front();
+  readPos_ = 0;
+  return static_cast<int>(current_.size());
+}
+
+int WiFiUDP::available() {
+  return static_cast<int>(current_.size() - readPos_);
+}
+
+int WiFiUDP::read() {
+  if (readPos_ >= current_.size()) return -1;
+  return static_cast<uint8_t>(current_[readPos_++]);
+}
+
+int WiFiUDP::read(char *buffer, size_t length) {
+  const size_t n = std::min(length, current_.size() - readPos_);
+  memcpy(buffer, current_.data() + readPos_, n);
+  readPos_ += n;
+  return static_cast<int>(n);
+}
+
+int WiFiUDP::peek() {
+  if (readPos_ >= current_.size()) return -1;
+  return static_cast<uint8_t>(current_[readPos_]);
+}
+
+// ---- WebServer -----------------------------------------------------------------
+
+WebServer::~WebServer() { stop(); }
+
+void WebServer::begin() {
+  if (listening_) return;
+  listening_ = true;
+  NativeSim::internal::registerServer(this);
+}
+
+void WebServer::stop() {
+  if (!listening_) return;
+  listening_ = false;
+  NativeSim::internal::unregisterServer(this);
+}
+
+void WebServer::on(const String &uri, HTTPMethod method,
+                   THandlerFunction handler) {
+  routes_.push_back(Route{uri, method, handler});
+}
+
+String WebServer::arg(const String &name) {
+  auto it = args_.find(name.str());
+  return it != args_.end() ? String(it->second) : String();
+}
+
+bool WebServer::hasArg(const String &name) {
+  return args_.count(name.str()) != 0;
+}
+
+void WebServer::send(int code, const char *, const String &content) {
+  status_ = code;
+  response_ = content;
+}
+
+bool WebServer::simHandle(HTTPMethod method, const String &uri,
+                          const String &body, int &status, String &response) {
+  if (!listening_) return false;
+  const int query = uri.indexOf('?');
+  uri_ = query < 0 ? uri : uri.substring(0, query);
+  method_ = method;
+  args_.clear();
+  if (query >= 0) parseForm(uri.substring(query + 1).str(), args_);
+  parseForm(body.str(), args_);
+  status_ = 0;
+  response_.clear();
+
+  THandlerFunction handler = notFound_;
+  for (const auto &route : routes_) {
+    if (route.uri == uri_ &&
+        (route.method == HTTP_ANY || route.method == method)) {
+      handler = route.handler;
+      break;
+    }
+  }
+  if (handler) handler();
+  status = handler ? status_ : 404;
+  response = response_;
+  return true;
+}
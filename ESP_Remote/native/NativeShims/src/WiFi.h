@@ -0,0 +1,206 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+#include "Client.h"
+#include "IPAddress.h"
+
+// Station/AP model driven by NativeSim: begin() joins one of the simulated
+// access points after a short delay and the result is reported through the
+// same arduino_event_t callbacks the ESP32 core fires.
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+} wl_status_t;
+typedef enum {
+  WIFI_AUTH_OPEN = 0,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK
+} wifi_auth_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_SCAN_DONE,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+  ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t channel;
+  int authmode;
+} wifi_event_sta_connected_t;
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+  int8_t rssi;
+} wifi_event_sta_disconnected_t;
+typedef struct {
+  struct {
+    struct {
+      uint32_t addr;
+    } ip, netmask, gw;
+  } ip_info;
+  bool ip_changed;
+} ip_event_got_ip_t;
+typedef union {
+  wifi_event_sta_connected_t wifi_sta_connected;
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+  ip_event_got_ip_t got_ip;
+} arduino_event_info_t;
+typedef struct {
+  arduino_event_id_t event_id;
+  arduino_event_info_t event_info;
+} arduino_event_t;
+
+typedef std::function<void(arduino_event_t *)> WiFiEventSysCb;
+typedef uint16_t wifi_event_id_t;
+
+class WiFiClass {
+ public:
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr,
+                    int32_t channel = 0, const uint8_t *bssid = nullptr,
+                    bool connect = true);
+  wl_status_t begin();
+  bool config(IPAddress localIp, IPAddress gateway, IPAddress subnet,
+              IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  bool isConnected() { return status_ == WL_CONNECTED; }
+  wl_status_t status() { return status_; }
+  bool mode(wifi_mode_t mode) {
+    mode_ = mode;
+    return true;
+  }
+  wifi_mode_t getMode() { return mode_; }
+
+  String SSID() const { return isConnectedConst() ? ssid_ : String(); }
+  String SSID(uint8_t index) const;
+  int32_t RSSI();
+  int32_t RSSI(uint8_t index);
+  uint8_t *BSSID();
+  uint8_t *BSSID(uint8_t index);
+  int32_t channel();
+  int32_t channel(uint8_t index);
+  wifi_auth_mode_t encryptionType(uint8_t index);
+
+  int16_t scanNetworks(bool async = false, bool showHidden = false,
+                       bool passive = false, uint32_t maxMsPerChannel = 300,
+                       uint8_t channel = 0, const char *ssid = nullptr,
+                       const uint8_t *bssid = nullptr);
+  int16_t scanComplete();
+  void scanDelete();
+
+  IPAddress localIP() { return isConnected() ? ip_ : IPAddress(); }
+  IPAddress subnetMask() { return isConnected() ? subnet_ : IPAddress(); }
+  IPAddress gatewayIP() { return isConnected() ? gateway_ : IPAddress(); }
+  IPAddress dnsIP(uint8_t = 0) { return isConnected() ? dns_ : IPAddress(); }
+  String macAddress() { return String("24:0A:C4:5A:1D:30"); }
+
+  bool softAP(const char *ssid, const char *passphrase = nullptr,
+              int channel = 1, int ssidHidden = 0, int maxConnection = 4);
+  bool softAPConfig(IPAddress localIp, IPAddress gateway, IPAddress subnet);
+  bool softAPdisconnect(bool wifiOff = false);
+  IPAddress softAPIP() { return apRunning_ ? apIp_ : IPAddress(); }
+
+  wifi_event_id_t onEvent(WiFiEventSysCb cb,
+                          arduino_event_id_t event = ARDUINO_EVENT_MAX);
+
+  // Host only: advances joins and scans, see NativeSim::setNetworkTick().
+  void simStep();
+  void simDrop();
+
+ private:
+  struct Pending {
+    bool active = false;
+    String ssid;
+    String password;
+    int32_t channel = 0;
+    bool hasBssid = false;
+    uint8_t bssid[6] = {0};
+    uint32_t dueMs = 0;
+  };
+
+  bool isConnectedConst() const { return status_ == WL_CONNECTED; }
+  void fire(arduino_event_t &event);
+  void fireDisconnected(uint8_t reason);
+
+  wl_status_t status_ = WL_DISCONNECTED;
+  wifi_mode_t mode_ = WIFI_OFF;
+  std::vector<WiFiEventSysCb> handlers_;
+  Pending pending_;
+  String savedSsid_;
+  String savedPassword_;
+  String ssid_;
+  uint8_t bssid_[6] = {0};
+  int32_t channel_ = 0;
+  int32_t rssi_ = 0;
+  IPAddress ip_;
+  IPAddress gateway_;
+  IPAddress subnet_;
+  IPAddress dns_;
+  bool staticIp_ = false;
+  IPAddress staticIpAddr_, staticGateway_, staticSubnet_, staticDns_;
+
+  bool scanRunning_ = false;
+  uint32_t scanDueMs_ = 0;
+  int16_t scanCount_ = WIFI_SCAN_FAILED;
+  struct ScanEntry {
+    String ssid;
+    int32_t rssi;
+    uint8_t channel;
+    uint8_t bssid[6];
+    wifi_auth_mode_t auth;
+  };
+  std::vector<ScanEntry> scan_;
+
+  bool apRunning_ = false;
+  IPAddress apIp_{192, 168, 4, 1};
+};
+
+extern WiFiClass WiFi;
+
+// TCP client that can only reach the simulated broker.
+class WiFiClient : public Client {
+ public:
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  int connect(const char *host, uint16_t port, int32_t timeoutMs);
+  void stop() override { connected_ = false; }
+  uint8_t connected() override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t) override { return connected() ? 1 : 0; }
+  size_t write(const uint8_t *, size_t size) override {
+    return connected() ? size : 0;
+  }
+  using Print::write;
+
+ private:
+  bool connected_ = false;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include "WiFi.h"
+
+// UDP socket on the simulated LAN. A broker discovery probe is answered with
+// the simulated broker's announcement while the broker is reachable.
+class WiFiUDP : public Stream {
+ public:
+  uint8_t begin(uint16_t port);
+  void stop();
+  int beginPacket(IPAddress ip, uint16_t port);
+  int endPacket();
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int parsePacket();
+  int available() override;
+  int read() override;
+  int read(char *buffer, size_t length);
+  int read(unsigned char *buffer, size_t length) {
+    return read(reinterpret_cast<char *>(buffer), length);
+  }
+  int peek() override;
+
+ private:
+  bool open_ = false;
+  uint16_t destPort_ = 0;
+  std::string outgoing_;
+  std::deque<std::string> inbox_;
+  std::string current_;
+  size_t readPos_ = 0;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+// Legacy RMT driver declarations. There is no RMT on the host: the driver
+// refuses to install, so IrTransmitter stays on IRsend and every frame is
+// recorded by the IRsend shim.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef int gpio_num_t;
+typedef enum {
+  RMT_CHANNEL_0,
+  RMT_CHANNEL_1,
+  RMT_CHANNEL_2,
+  RMT_CHANNEL_3,
+  RMT_CHANNEL_MAX
+} rmt_channel_t;
+typedef enum { RMT_MODE_TX, RMT_MODE_RX } rmt_mode_t;
+typedef enum { RMT_CARRIER_LEVEL_LOW, RMT_CARRIER_LEVEL_HIGH } rmt_carrier_level_t;
+typedef enum { RMT_IDLE_LEVEL_LOW, RMT_IDLE_LEVEL_HIGH } rmt_idle_level_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct {
+  uint32_t carrier_freq_hz;
+  rmt_carrier_level_t carrier_level;
+  rmt_idle_level_t idle_level;
+  uint8_t carrier_duty_percent;
+  uint32_t loop_count;
+  bool carrier_en;
+  bool loop_en;
+  bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+  rmt_mode_t rmt_mode;
+  rmt_channel_t channel;
+  gpio_num_t gpio_num;
+  uint8_t clk_div;
+  uint8_t mem_block_num;
+  uint32_t flags;
+  rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id)                          \
+  {RMT_MODE_TX, channel_id, gpio, 80, 1, 0,                              \
+   {38000, RMT_CARRIER_LEVEL_HIGH, RMT_IDLE_LEVEL_LOW, 33, 0, true, false, \
+    true}}
+
+inline esp_err_t rmt_config(const rmt_config_t *) { return ESP_OK; }
+inline esp_err_t rmt_driver_install(rmt_channel_t, size_t, int) {
+  return ESP_FAIL;
+}
+inline esp_err_t rmt_write_items(rmt_channel_t, const rmt_item32_t *, int,
+                                 bool) {
+  return ESP_FAIL;
+}
+inline esp_err_t rmt_set_gpio(rmt_channel_t, rmt_mode_t, gpio_num_t, bool) {
+  return ESP_FAIL;
+}
+inline esp_err_t rmt_set_tx_carrier(rmt_channel_t, bool, uint16_t, uint16_t,
+                                    rmt_carrier_level_t) {
+  return ESP_FAIL;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <sys/time.h>
+
+// The host clock needs no SNTP; the sync callback is never called.
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t) {}
@@ -0,0 +1,28 @@
+#pragma once
+
+// FreeRTOS types and macros for the host; tasks are pthreads on painted
+// stacks and ticks are milliseconds (configTICK_RATE_HZ 1000, as on the ESP32
+// core).
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+typedef struct NativeQueue *QueueHandle_t;
+typedef struct NativeTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(x) ((TickType_t)(x))
+#define tskNO_AFFINITY 0x7FFFFFFF
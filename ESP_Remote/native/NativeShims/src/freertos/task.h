@@ -0,0 +1,25 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name,
+                       uint32_t stackBytes, void *arg, UBaseType_t priority,
+                       TaskHandle_t *created);
+// `core` is recorded for xPortGetCoreID() but not enforced on the host.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name,
+                                   uint32_t stackBytes, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+// Bytes of the task's stack (as requested from xTaskCreate) never touched so
+// far; nullptr means the calling task.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+TickType_t xTaskGetTickCount();
+BaseType_t xPortGetCoreID();
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+// Returns the notification value before it was cleared (clearOnExit) or
+// decremented; 0 on timeout.
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait);
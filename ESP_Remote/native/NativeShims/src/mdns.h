@@ -0,0 +1,50 @@
+#pragma once
+
+// mDNS declarations (IDF 4.4 async query API). The host has no responder:
+// mdns_init() fails and discovery falls back to the UDP probe.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+#define MDNS_TYPE_PTR 0x000C
+#define ESP_IPADDR_TYPE_V4 0
+
+typedef struct {
+  uint32_t addr;
+} esp_ip4_addr_t;
+typedef struct {
+  union {
+    esp_ip4_addr_t ip4;
+  } u_addr;
+  uint8_t type;
+} esp_ip_addr_t;
+typedef struct mdns_ip_addr_s {
+  esp_ip_addr_t addr;
+  struct mdns_ip_addr_s *next;
+} mdns_ip_addr_t;
+typedef struct mdns_result_s {
+  struct mdns_result_s *next;
+  char *instance_name;
+  char *hostname;
+  uint16_t port;
+  mdns_ip_addr_t *addr;
+} mdns_result_t;
+typedef struct mdns_search_once_s mdns_search_once_t;
+
+inline esp_err_t mdns_init() { return ESP_FAIL; }
+inline mdns_search_once_t *mdns_query_async_new(const char *, const char *,
+                                                const char *, uint16_t,
+                                                uint32_t, size_t) {
+  return nullptr;
+}
+inline bool mdns_query_async_get_results(mdns_search_once_t *, uint32_t,
+                                         mdns_result_t **results) {
+  if (results != nullptr) *results = nullptr;
+  return true;
+}
+inline void mdns_query_async_delete(mdns_search_once_t *) {}
+inline void mdns_query_results_free(mdns_result_t *) {}
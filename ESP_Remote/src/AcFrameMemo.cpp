@@ -0,0 +1,84 @@
+#include "AcFrameMemo.h"
+
+#include <IRutils.h>
+
+bool AcFrameMemo::Key::operator==(const Key &other) const {
+  return protocol == other.protocol && model == other.model &&
+         power == other.power && celsius == other.celsius &&
+         mode == other.mode && tenthDegrees == other.tenthDegrees &&
+         fan == other.fan && swingv == other.swingv &&
+         swingh == other.swingh && prevPower == other.prevPower &&
+         prevMode == other.prevMode && prevSwingv == other.prevSwingv &&
+         prevSwingh == other.prevSwingh;
+}
+
+bool AcFrameMemo::isMemoizable(const stdAc::state_t &state) {
+  return hasACState(state.protocol);
+}
+
+AcFrameMemo::Key AcFrameMemo::keyFor(const stdAc::state_t &state,
+                                     const stdAc::state_t &prev) {
+  Key key;
+  key.protocol = state.protocol;
+  key.model = state.model;
+  key.power = state.power;
+  key.celsius = state.celsius;
+  key.mode = state.mode;
+  key.tenthDegrees = static_cast<int16_t>(state.degrees * 10);
+  key.fan = state.fanspeed;
+  key.swingv = state.swingv;
+  key.swingh = state.swingh;
+  key.prevPower = prev.power;
+  key.prevMode = prev.mode;
+  key.prevSwingv = prev.swingv;
+  key.prevSwingh = prev.swingh;
+  return key;
+}
+
+size_t AcFrameMemo::bytesOf(const IrRmtFrame &frame) {
+  return frame.items.size() * sizeof(rmt_item32_t);
+}
+
+const IrRmtFrame *AcFrameMemo::find(const stdAc::state_t &state,
+                                    const stdAc::state_t &prev) {
+  const Key key = keyFor(state, prev);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->key == key) {
+      entries_.splice(entries_.begin(), entries_, it);
+      ++stats_.hits;
+      return &entries_.front().frame;
+    }
+  }
+  ++stats_.misses;
+  return nullptr;
+}
+
+bool AcFrameMemo::store(const stdAc::state_t &state,
+                        const stdAc::state_t &prev, IrRmtFrame &&frame) {
+  const size_t bytes = bytesOf(frame);
+  if (!isMemoizable(state) || bytes == 0 || bytes > capBytes_) return false;
+
+  const Key key = keyFor(state, prev);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->key == key) {
+      stats_.bytes -= bytesOf(it->frame);
+      entries_.erase(it);
+      break;
+    }
+  }
+  while (stats_.bytes + bytes > capBytes_) {
+    stats_.bytes -= bytesOf(entries_.back().frame);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+  entries_.push_front({key, std::move(frame)});
+  stats_.bytes += bytes;
+  stats_.entries = static_cast<uint16_t>(entries_.size());
+  return true;
+}
+
+void AcFrameMemo::clear() {
+  entries_.clear();
+  stats_.entries = 0;
+  stats_.bytes = 0;
+}
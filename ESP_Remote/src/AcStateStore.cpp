@@ -0,0 +1,146 @@
+#include "AcStateStore.h"
+
+#include <Preferences.h>
+
+#include "Crc32.h"
+#include "Log.h"
+
+namespace AcStateStore {
+namespace {
+
+constexpr const char *kPrefsNamespace = "ac_state";
+constexpr const char *kPrefsKeyRecord = "rec";
+constexpr uint8_t kMagic0 = 'A';
+constexpr uint8_t kMagic1 = 'S';
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 7;  // magic, version, flags, temp, index
+constexpr size_t kCrcSize = 4;
+constexpr uint8_t kFlagPower = 0x01;
+constexpr uint8_t kFlagSwing = 0x02;
+
+Preferences prefs;
+bool opened = false;
+// What flash holds, so an unchanged state costs no write.
+std::vector<uint8_t> stored;
+Stats counters;
+
+bool open() {
+  if (!opened) opened = prefs.begin(kPrefsNamespace, false);
+  return opened;
+}
+
+void putText(std::vector<uint8_t> &out, const String &text) {
+  const size_t length = text.length() > UINT8_MAX ? UINT8_MAX : text.length();
+  out.push_back(static_cast<uint8_t>(length));
+  out.insert(out.end(), text.c_str(), text.c_str() + length);
+}
+
+bool getText(const uint8_t *&p, const uint8_t *end, String &out) {
+  if (end - p < 1) return false;
+  const size_t length = *p++;
+  if (static_cast<size_t>(end - p) < length) return false;
+  out = String();
+  out.reserve(length);
+  for (size_t i = 0; i < length; ++i) out += static_cast<char>(*p++);
+  return true;
+}
+
+}  // namespace
+
+bool load(AcState &state, RemoteProfile &remote) {
+  if (!open()) return false;
+  const size_t length = prefs.getBytesLength(kPrefsKeyRecord);
+  if (length == 0) return false;
+  std::vector<uint8_t> blob(length);
+  if (prefs.getBytes(kPrefsKeyRecord, blob.data(), length) != length) {
+    return false;
+  }
+  ++counters.loads;
+  if (!decode(blob.data(), blob.size(), state, remote)) {
+    ++counters.loadErrors;
+    LOG_W("[AC][STORE] Discarding corrupt state (%u bytes)",
+          static_cast<unsigned>(length));
+    return false;
+  }
+  stored.swap(blob);
+  return true;
+}
+
+bool save(const AcState &state, const RemoteProfile &remote) {
+  std::vector<uint8_t> blob;
+  encode(state, remote, blob);
+  if (blob == stored) {
+    ++counters.unchanged;
+    return true;
+  }
+  if (!open() ||
+      prefs.putBytes(kPrefsKeyRecord, blob.data(), blob.size()) !=
+          blob.size()) {
+    ++counters.writeErrors;
+    LOG_E("[AC][STORE] Write failed (%u bytes)",
+          static_cast<unsigned>(blob.size()));
+    return false;
+  }
+  ++counters.writes;
+  stored.swap(blob);
+  LOG_D("[AC][STORE] Saved %u bytes", static_cast<unsigned>(stored.size()));
+  return true;
+}
+
+Stats stats() { return counters; }
+
+void encode(const AcState &state, const RemoteProfile &remote,
+            std::vector<uint8_t> &out) {
+  out.clear();
+  out.push_back(kMagic0);
+  out.push_back(kMagic1);
+  out.push_back(kVersion);
+  out.push_back((state.power ? kFlagPower : 0) |
+                (state.swing ? kFlagSwing : 0));
+  const int temp = constrain(state.temp, INT8_MIN, INT8_MAX);
+  out.push_back(static_cast<uint8_t>(static_cast<int8_t>(temp)));
+  out.push_back(static_cast<uint8_t>(remote.index));
+  out.push_back(static_cast<uint8_t>(remote.index >> 8));
+  putText(out, state.mode);
+  putText(out, state.fan);
+  putText(out, remote.brand);
+  putText(out, remote.type);
+  const uint32_t crc = crc32(out.data(), out.size());
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    out.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+  }
+}
+
+bool decode(const uint8_t *data, size_t length, AcState &state,
+            RemoteProfile &remote) {
+  if (data == nullptr || length < kHeaderSize + kCrcSize ||
+      data[0] != kMagic0 || data[1] != kMagic1 || data[2] != kVersion) {
+    return false;
+  }
+  const size_t body = length - kCrcSize;
+  uint32_t crc = 0;
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    crc |= static_cast<uint32_t>(data[body + i]) << (8 * i);
+  }
+  if (crc32(data, body) != crc) return false;
+
+  AcState decodedState;
+  RemoteProfile decodedRemote;
+  decodedState.power = (data[3] & kFlagPower) != 0;
+  decodedState.swing = (data[3] & kFlagSwing) != 0;
+  decodedState.temp = static_cast<int8_t>(data[4]);
+  decodedRemote.index = static_cast<uint16_t>(data[5] | (data[6] << 8));
+  const uint8_t *p = data + kHeaderSize;
+  const uint8_t *end = data + body;
+  if (!getText(p, end, decodedState.mode) ||
+      !getText(p, end, decodedState.fan) ||
+      !getText(p, end, decodedRemote.brand) ||
+      !getText(p, end, decodedRemote.type) || p != end) {
+    return false;
+  }
+  state = decodedState;
+  remote = decodedRemote;
+  return true;
+}
+
+}  // namespace AcStateStore
@@ -3,15 +3,32 @@
 #include <PubSubClient.h>
 #include <WiFi.h>
 #include <WebServer.h>
-#include <WiFiUdp.h>
+#include <esp_sntp.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <cstring>
+#include <strings.h>
 #include <IRutils.h>
 
+#include "AcStateStore.h"
 #include "App.h"
+#include "BrokerDiscovery.h"
+#include "CommandBatch.h"
 #include "Config.h"
 #include "DeviceManager.h"
 #include "IrLearner.h"
+#include "JsonArena.h"
+#include "IrTransmitter.h"
+#include "LearnedKeyStore.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "ReconnectBackoff.h"
+#include "Scenes.h"
+#include "Scheduler.h"
+#include "SpscQueue.h"
+#include "Trace.h"
 #include "WifiKnownNetworks.h"
+#include "WifiScanCache.h"
 #include "devices/AcController.h"
 #include "devices/TvController.h"
 #include "devices/FanController.h"
@@ -23,107 +40,122 @@ namespace {
 constexpr unsigned long kStatusIntervalMs = 60UL * 1000UL;
 constexpr unsigned long kWifiConnectAttemptMs = 10000UL;
 constexpr unsigned long kWifiPortalCooldownMs = 1000UL;
+constexpr uint32_t kPortalScanMaxAgeMs = 10000UL;
+constexpr int kMqttTcpConnectFailed = -100;
+constexpr int kMqttNoBroker = -101;
 const IPAddress kWifiPortalIp(192, 168, 4, 1);
 const IPAddress kWifiPortalGateway(192, 168, 4, 1);
 const IPAddress kWifiPortalSubnet(255, 255, 255, 0);
 const String kStatusTopic = String("iot/nodes/") + NODE_ID + "/status";
-const String kCommandTopic = String("iot/nodes/") + NODE_ID + "/commands";
-const String kLegacyAcTopic = String("iot/nodes/") + NODE_ID + "/ir/test";
-const String kAcCommandTopic = String("iot/nodes/") + NODE_ID + "/ac/cmd";
-const String kFanCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/fan/cmd";
-const String kTvCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/tv/cmd";
-const String kDvdCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/dvd/cmd";
-const String kStbCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/stb/cmd";
-const String kProjectorCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/projector/cmd";
-const String kLearnCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/ir/learn/cmd";
-const String kFanLearnCommandTopic =
-    String("iot/nodes/") + NODE_ID + "/fan/learn/cmd";
 const String kLearnResultTopic =
     String("iot/nodes/") + NODE_ID + "/ir/learn";
-const String kDeviceLearnResultPrefix =
-    String("iot/nodes/") + NODE_ID + "/";
-const String kDiscoveryResponsePrefix = "MQTT://";
+const String kNodeTopicPrefix = String("iot/nodes/") + NODE_ID + "/";
+const String kDeviceLearnResultPrefix = kNodeTopicPrefix;
+const String kTraceTopic = kNodeTopicPrefix + "debug/trace";
+const String kMetricsTopic = kNodeTopicPrefix + "metrics";
+const String kBatchResultTopic = kNodeTopicPrefix + "batch";
+const String kSceneResultTopic = kNodeTopicPrefix + "scene";
+const String kScheduleResultTopic = kNodeTopicPrefix + "schedule";
 WiFiClient wifiClient;
 PubSubClient mqtt(wifiClient);
 DeviceManager deviceManager;
-AcController acController(NODE_ID, IR_LED_PIN);
-FanController fanController(NODE_ID, IR_LED_PIN);
-TvController tvController(NODE_ID, IR_LED_PIN);
-StbController stbController(NODE_ID, IR_LED_PIN);
-DvdController dvdController(NODE_ID, IR_LED_PIN);
-ProjectorController projectorController(NODE_ID, IR_LED_PIN);
+IrTransmitter irTransmitter(IR_LED_PIN);
+AcController acController(NODE_ID, irTransmitter);
+FanController fanController(NODE_ID, irTransmitter);
+TvController tvController(NODE_ID, irTransmitter);
+StbController stbController(NODE_ID, irTransmitter);
+DvdController dvdController(NODE_ID, irTransmitter);
+ProjectorController projectorController(NODE_ID, irTransmitter);
 IrLearner irLearner(IR_RECEIVER_PIN);
 
+TaskHandle_t networkTaskHandle = nullptr;
 unsigned long lastStatusPublished = 0;
+unsigned long lastMetricsPublished = 0;
+bool mqttEverConnected = false;
+bool sntpStarted = false;
 
+// Backing store for the documents of the MQTT message being handled.
+alignas(8) uint8_t messageArenaBuffer[MQTT_JSON_ARENA_BYTES];
+JsonArena messageArena(messageArenaBuffer, sizeof(messageArenaBuffer));
+
+void networkTask(void *);
+void networkStep();
+void addTaskStackFree(JsonObject out);
 void ensureWifiConnected();
 void ensureMqttConnected();
 void publishAvailability();
-void publishDeviceState(DeviceController &controller, bool retained = true);
+void publishMetrics();
+void publishState(DeviceController &controller, JsonDocument &state,
+                  bool snapshot);
+void publishDeviceState(DeviceController &controller, bool snapshot);
+void pollControllers();
 void handleMqttMessage(char *topic, byte *payload, unsigned int length);
-void handleLearnCommand(JsonObjectConst cmd, const String &topicDevice = String());
+void dispatchMessage(const char *topic, const char *json, size_t length,
+                     uint32_t receivedUs);
+void runScheduledJob(const char *topicSuffix, const char *payload,
+                     size_t length);
+void handleLearnCommand(JsonObjectConst cmd, const char *topicDevice = "");
+void handleBatchCommand(JsonObjectConst cmd, DeviceController *controller);
+void handleSceneCommand(JsonObjectConst cmd, TopicRoute route);
+void handleScheduleCommand(JsonObjectConst cmd);
+void handleTraceCommand(JsonObjectConst cmd);
 bool configureMqttServer();
-bool autoDiscoverBroker(String &hostOut, uint16_t &portOut);
-IPAddress calculateBroadcastAddress();
-bool parseDiscoveryResponse(const String &response, String &hostOut,
-                            uint16_t &portOut);
 void publishLearningResult(const IrLearningResult &result);
 bool mqttServerConfigured = false;
+ReconnectBackoff mqttBackoff(MQTT_RECONNECT_MIN_MS, MQTT_RECONNECT_MAX_MS,
+                             MQTT_CONNECT_ATTEMPT_BUDGET);
+// Set on every new Wi-Fi link: try the broker remembered in NVS before
+// searching. Cleared once that broker fails.
+bool mqttTryRememberedBroker = true;
+bool mqttUsingRememberedBroker = false;
+int mqttLastFailure = 0;  // PubSubClient state or one of kMqtt*Failed/NoBroker
 String resolvedMqttHost = MQTT_HOST;
 uint16_t resolvedMqttPort = MQTT_PORT;
 unsigned long wifiAttemptStartedAt = 0;
 bool wifiBeginCalled = false;
 bool wifiFallbackTried = false;
+
+// How the current Wi-Fi attempt was started, and boot/outage-to-online
+// timing per path.
+enum class WifiJoinPath : uint8_t {
+  kNone,
+  kDirected,  // cached BSSID + channel, no scan
+  kScan,      // best known SSID from a scan
+  kStored,    // credentials kept by the Wi-Fi stack
+  kFallback,  // WIFI_SSID from Config.h
+  kPortal,
+};
+WifiJoinPath wifiJoinPath = WifiJoinPath::kNone;
+WifiJoinPath wifiLinkPath = WifiJoinPath::kNone;
+bool wifiLinked = false;  // got an IP, no disconnect since
+bool wifiDirectedTried = false;
+bool wifiStaticIpApplied = false;
+bool wifiOutageActive = true;  // boot counts as an outage starting at 0
+unsigned long wifiOutageStartedAt = 0;
+uint32_t wifiLinkUpMs = 0;
+uint32_t wifiOnlineMs = 0;
 unsigned long portalStartedAt = 0;
 bool wifiPortalRunning = false;
 WebServer wifiPortalServer(80);
 String wifiPortalApSsid;
 
+// Link changes reported by the Wi-Fi event task, applied by networkStep().
+struct WifiLinkEvent {
+  bool up = false;  // got an IP; false: disconnected
+  uint32_t atMs = 0;
+  uint32_t ip = 0;
+  uint32_t gateway = 0;
+  uint32_t subnet = 0;
+  uint8_t bssid[6] = {};
+  uint8_t channel = 0;
+};
+SpscQueue<WifiLinkEvent, 8> wifiLinkEvents;
+
+void applyWifiLinkEvents();
 void startWifiPortal();
 void stopWifiPortal();
 void handleWifiPortalClient();
 
-String readPayload(byte *payload, unsigned int length) {
-  String data;
-  data.reserve(length);
-  for (unsigned int i = 0; i < length; ++i) {
-    data += static_cast<char>(payload[i]);
-  }
-  return data;
-}
-
-String inferDeviceFromTopic(const String &topic) {
-  if (topic.equalsIgnoreCase(kLegacyAcTopic)) {
-    return "ac";
-  }
-  if (topic.equalsIgnoreCase(kFanCommandTopic)) {
-    return "fan";
-  }
-
-  const String prefix = String("iot/nodes/") + NODE_ID + "/";
-  if (!topic.startsWith(prefix)) {
-    return "";
-  }
-
-  const int start = prefix.length();
-  const int nextSlash = topic.indexOf('/', start);
-  if (nextSlash == -1) {
-    const String suffix = topic.substring(start);
-    if (suffix.equalsIgnoreCase("commands")) {
-      return "";
-    }
-    return suffix;
-  }
-
-  return topic.substring(start, nextSlash);
-}
-
 }  // namespace
 
 void setupApp() {
@@ -133,69 +165,204 @@ void setupApp() {
   Serial.begin(115200);
   delay(100);
   Serial.println();
-  Serial.println(F("[BOOT] ESP32 multi-device node starting"));
+  Log::begin();
+  LOG_I("[BOOT] ESP32 multi-device node starting");
 
   WifiKnownNetworks::begin();
+  BrokerDiscovery::begin();
 
+  // Runs on the Arduino event task: only queue the event, networkStep()
+  // applies it on the network task that owns the Wi-Fi and MQTT state.
   WiFi.onEvent([](arduino_event_t *sys_event) {
+    WifiLinkEvent event;
+    event.atMs = millis();
     switch (sys_event->event_id) {
-      case ARDUINO_EVENT_WIFI_STA_GOT_IP:
-        Serial.printf("[WIFI] Connected, IP: %s\n",
-                      IPAddress(sys_event->event_info.got_ip.ip_info.ip.addr)
-                          .toString()
-                          .c_str());
-        WifiKnownNetworks::markUsed(WiFi.SSID());
-        mqttServerConfigured = false;
-        wifiBeginCalled = false;
-        wifiAttemptStartedAt = 0;
-        wifiFallbackTried = false;
-        stopWifiPortal();
+      case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
+        const auto &ipInfo = sys_event->event_info.got_ip.ip_info;
+        event.up = true;
+        event.ip = ipInfo.ip.addr;
+        event.gateway = ipInfo.gw.addr;
+        event.subnet = ipInfo.netmask.addr;
+        memcpy(event.bssid, WiFi.BSSID(), sizeof(event.bssid));
+        event.channel = static_cast<uint8_t>(WiFi.channel());
         break;
+      }
       case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
-        Serial.println(F("[WIFI] Disconnected"));
-        mqttServerConfigured = false;
-        wifiBeginCalled = false;
-        wifiAttemptStartedAt = 0;
-        wifiFallbackTried = false;
-        // Keep portal running if it was started; user can reconfigure.
+        event.up = false;
         break;
       default:
-        break;
+        return;
+    }
+    if (!wifiLinkEvents.push(event)) {
+      LOG_W("[WIFI] Link event queue full, %s dropped",
+            event.up ? "connect" : "disconnect");
     }
   });
 
+  irTransmitter.begin();
+
+  // Commands arrive on iot/nodes/<NODE_ID>/<suffix>; each controller also
+  // gets <deviceType>/cmd when it is registered.
+  deviceManager.setTopicPrefix(kNodeTopicPrefix.c_str());
   deviceManager.registerController(acController);
   deviceManager.registerController(fanController);
   deviceManager.registerController(tvController);
   deviceManager.registerController(stbController);
   deviceManager.registerController(dvdController);
   deviceManager.registerController(projectorController);
+  deviceManager.addRoute("commands", TopicRoute::kCommand);
+  deviceManager.addRoute("ir/test", TopicRoute::kCommand, &acController);
+  deviceManager.addRoute("ir/learn/cmd", TopicRoute::kLearn);
+  deviceManager.addRoute("fan/learn/cmd", TopicRoute::kLearn, &fanController);
+  deviceManager.addRoute("debug/trace/cmd", TopicRoute::kTrace);
+  deviceManager.addRoute("scene/set", TopicRoute::kSceneSet);
+  deviceManager.addRoute("scene/run", TopicRoute::kSceneRun);
+  deviceManager.addRoute("schedule/set", TopicRoute::kSchedule);
   deviceManager.begin();
+  Scenes::begin(deviceManager, irTransmitter, acController);
+  Scheduler::begin(deviceManager, runScheduledJob);
 
   irLearner.setResultCallback(publishLearningResult);
   irLearner.begin();
   
   ensureWifiConnected();
 
-  configureMqttServer();
   mqtt.setCallback(handleMqttMessage);
+  mqtt.setSocketTimeout(
+      static_cast<uint16_t>((MQTT_CONNECT_TIMEOUT_MS + 999) / 1000));
+
+  // From here on only the network task touches Wi-Fi, MQTT, the portal and
+  // the controllers.
+  if (xTaskCreatePinnedToCore(networkTask, "net", NET_TASK_STACK_BYTES,
+                              nullptr, 1, &networkTaskHandle,
+                              NET_TASK_CORE) != pdPASS) {
+    LOG_E("[BOOT] Failed to start network task");
+  }
 }
 
+// Everything runs in the pinned tasks started by setupApp(); the Arduino loop
+// task has nothing left to do, so give its stack back. Without a network
+// task the node keeps working from here, unpinned.
 void loopApp() {
+  if (networkTaskHandle != nullptr) vTaskDelete(nullptr);
+  networkStep();
+}
+
+namespace {
+
+void networkTask(void *) {
+  for (;;) {
+    networkStep();
+    // Blocking for a tick lets IDLE on this core feed the task watchdog.
+    vTaskDelay(1);
+  }
+}
+
+void networkStep() {
+  const uint32_t loopStartedUs = micros();
+  // First, before anything that can block, so jobs fire on their tick.
+  Scheduler::loop(Scheduler::clockMs());
+  applyWifiLinkEvents();
   ensureWifiConnected();
+  if (!sntpStarted && WiFi.status() == WL_CONNECTED) {
+    sntp_set_time_sync_notification_cb(
+        [](struct timeval *) { Scheduler::clockAdjusted(); });
+    configTzTime(SCHED_TIMEZONE, SNTP_SERVER, SNTP_SERVER_FALLBACK);
+    sntpStarted = true;
+  }
   ensureMqttConnected();
 
   mqtt.loop();
+  pollControllers();
   irLearner.loop();
+  LearnedKeyStore::loop();
   handleWifiPortalClient();
+  WifiScanCache::loop(wifiPortalRunning);
 
   const unsigned long now = millis();
   if (now - lastStatusPublished > kStatusIntervalMs) {
     publishAvailability();
   }
+  if (METRICS_PUBLISH_INTERVAL_MS > 0 &&
+      now - lastMetricsPublished >= METRICS_PUBLISH_INTERVAL_MS) {
+    publishMetrics();
+  }
+  Metrics::node().loopUs.record(micros() - loopStartedUs);
 }
 
-namespace {
+const char *wifiJoinPathName(WifiJoinPath path) {
+  switch (path) {
+    case WifiJoinPath::kDirected:
+      return "directed";
+    case WifiJoinPath::kScan:
+      return "scan";
+    case WifiJoinPath::kStored:
+      return "stored";
+    case WifiJoinPath::kFallback:
+      return "fallback";
+    case WifiJoinPath::kPortal:
+      return "portal";
+    default:
+      return "none";
+  }
+}
+
+void applyWifiLinkEvents() {
+  WifiLinkEvent event;
+  while (wifiLinkEvents.pop(event)) {
+    if (!event.up) {
+      // A join that failed also reports a disconnect; its attempt window
+      // runs out instead, so the fallback and the portal are reached.
+      if (!wifiLinked) continue;
+      wifiLinked = false;
+      LOG_I("[WIFI] Disconnected");
+      if (!wifiOutageActive) {
+        wifiOutageActive = true;
+        wifiOutageStartedAt = event.atMs;
+      }
+      mqttServerConfigured = false;
+      wifiBeginCalled = false;
+      wifiAttemptStartedAt = 0;
+      wifiFallbackTried = false;
+      // Keep portal running if it was started; user can reconfigure.
+      continue;
+    }
+    LOG_I("[WIFI] Connected, IP: %s", IPAddress(event.ip).toString().c_str());
+    // Skipped when the link is gone again: its disconnect is next in the
+    // queue, and WiFi.SSID() would be empty.
+    if (WiFi.isConnected()) {
+      WifiKnownNetworks::rememberLink(
+          WiFi.SSID(), event.bssid, event.channel, event.ip, event.gateway,
+          event.subnet, static_cast<uint32_t>(WiFi.dnsIP()));
+    }
+    wifiLinked = true;
+    wifiLinkPath = wifiJoinPath;
+    wifiLinkUpMs = event.atMs - wifiOutageStartedAt;
+    wifiDirectedTried = false;
+    mqttServerConfigured = false;
+    mqttTryRememberedBroker = true;
+    mqttBackoff.succeeded();  // new link: first attempt goes out at once
+    wifiBeginCalled = false;
+    wifiAttemptStartedAt = 0;
+    wifiFallbackTried = false;
+    stopWifiPortal();
+  }
+}
+
+// Joins the last good AP on its channel, skipping the scan (and DHCP, when
+// WIFI_FAST_JOIN_STATIC_IP reuses the previous lease).
+void beginDirectedJoin(const WifiKnownNetworks::Network &network) {
+  if (WIFI_FAST_JOIN_STATIC_IP && network.ip != 0) {
+    wifiStaticIpApplied =
+        WiFi.config(IPAddress(network.ip), IPAddress(network.gateway),
+                    IPAddress(network.subnet), IPAddress(network.dns));
+  }
+  LOG_I("[WIFI] Directed join SSID=%s ch=%u%s", network.ssid.c_str(),
+        network.channel, wifiStaticIpApplied ? " (static IP)" : "");
+  wifiJoinPath = WifiJoinPath::kDirected;
+  WiFi.begin(network.ssid.c_str(), network.password.c_str(), network.channel,
+             network.bssid);
+}
 
 void ensureWifiConnected() {
   if (WiFi.isConnected()) return;
@@ -208,29 +375,61 @@ void ensureWifiConnected() {
     wifiBeginCalled = true;
     wifiAttemptStartedAt = millis();
     WifiKnownNetworks::Network picked;
-    if (WifiKnownNetworks::selectBestFromScan(picked)) {
-      Serial.printf("[WIFI] Connecting to known SSID=%s (saved list size=%u)\n",
-                    picked.ssid.c_str(),
-                    static_cast<unsigned>(WifiKnownNetworks::count()));
+    if (!wifiDirectedTried && WifiKnownNetworks::lastLink(picked)) {
+      wifiDirectedTried = true;
+      beginDirectedJoin(picked);
+      return;
+    }
+    if (wifiStaticIpApplied) {
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);  // back to DHCP
+      wifiStaticIpApplied = false;
+    }
+    const WifiKnownNetworks::ScanPick pick =
+        WifiKnownNetworks::selectBestFromScan(picked);
+    if (pick == WifiKnownNetworks::ScanPick::kPending) {
+      // Background scan running; pick again once it has finished.
+      wifiBeginCalled = false;
+      wifiAttemptStartedAt = 0;
+      return;
+    }
+    if (pick == WifiKnownNetworks::ScanPick::kPicked) {
+      LOG_I("[WIFI] Connecting to known SSID=%s (saved list size=%u)",
+            picked.ssid.c_str(),
+            static_cast<unsigned>(WifiKnownNetworks::count()));
+      wifiJoinPath = WifiJoinPath::kScan;
       WiFi.begin(picked.ssid.c_str(), picked.password.c_str());
     } else {
-      Serial.printf("[WIFI] Connecting using stored credentials (known list size=%u)\n",
-                    static_cast<unsigned>(WifiKnownNetworks::count()));
+      LOG_I("[WIFI] Connecting using stored credentials (known list size=%u)",
+            static_cast<unsigned>(WifiKnownNetworks::count()));
+      wifiJoinPath = WifiJoinPath::kStored;
       WiFi.begin();
     }
   }
 
-  // If connection is taking too long, fall back to compile-time SSID (if set).
+  const unsigned long attemptWindow = wifiJoinPath == WifiJoinPath::kDirected
+                                          ? WIFI_DIRECTED_JOIN_TIMEOUT_MS
+                                          : kWifiConnectAttemptMs;
   if (wifiAttemptStartedAt != 0 &&
-      millis() - wifiAttemptStartedAt < kWifiConnectAttemptMs) {
+      millis() - wifiAttemptStartedAt < attemptWindow) {
     return;
   }
 
+  // A directed join that did not come up is retried as a scan.
+  if (wifiJoinPath == WifiJoinPath::kDirected) {
+    LOG_I("[WIFI] Directed join timed out, scanning");
+    wifiBeginCalled = false;
+    wifiAttemptStartedAt = 0;
+    return;
+  }
+
+  // If connection is taking too long, fall back to compile-time SSID (if set).
+
   // Fallback to hardcoded Wi-Fi, if provided.
   if (!wifiFallbackTried && strlen(WIFI_SSID) > 0) {
     wifiFallbackTried = true;
     wifiAttemptStartedAt = millis();
-    Serial.printf("[WIFI] Fallback connect to SSID=%s\n", WIFI_SSID);
+    LOG_I("[WIFI] Fallback connect to SSID=%s", WIFI_SSID);
+    wifiJoinPath = WifiJoinPath::kFallback;
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
     WifiKnownNetworks::upsert(String(WIFI_SSID), String(WIFI_PASSWORD));
     return;
@@ -297,7 +496,7 @@ void startWifiPortal() {
   }
 
   if (!apOk) {
-    Serial.println(F("[WIFI][PORTAL] Failed to start AP"));
+    LOG_E("[WIFI][PORTAL] Failed to start AP");
     return;
   }
 
@@ -317,22 +516,105 @@ void startWifiPortal() {
       doc["ap_ssid"] = wifiPortalApSsid;
       doc["ap_ip"] = WiFi.softAPIP().toString();
       doc["known_count"] = static_cast<uint32_t>(WifiKnownNetworks::count());
+      const IrTransmitter::Stats ir = irTransmitter.stats();
+      JsonObject irQueue = doc["ir_queue"].to<JsonObject>();
+      irQueue["depth"] = ir.depth;
+      irQueue["peak_depth"] = ir.peakDepth;
+      irQueue["enqueued"] = ir.enqueued;
+      irQueue["sent"] = ir.sent;
+      irQueue["dropped"] = ir.dropped;
+      irQueue["last_wait_ms"] = ir.lastWaitMs;
+      irQueue["max_wait_ms"] = ir.maxWaitMs;
+      irQueue["avg_wait_ms"] = ir.sent > 0 ? ir.totalWaitMs / ir.sent : 0;
+      irQueue["rmt_frames"] = ir.rmtFrames;
+      irQueue["frame_cache"] = ir.frameCacheSize;
+      irQueue["frame_cache_misses"] = ir.frameCacheMisses;
+      irQueue["state_cache_bytes"] = ir.stateCacheBytes;
+      irQueue["state_frame_misses"] = ir.stateFrameMisses;
+      irQueue["ac_memo_hits"] = ir.acMemoHits;
+      irQueue["ac_memo_misses"] = ir.acMemoMisses;
+      irQueue["ac_memo_bytes"] = ir.acMemoBytes;
+      irQueue["stack_free"] = ir.taskStackFree;
+      const LearnedKeyStore::Stats store = LearnedKeyStore::stats();
+      JsonObject learned = doc["learned_store"].to<JsonObject>();
+      learned["loads"] = store.loads;
+      learned["load_errors"] = store.loadErrors;
+      learned["writes"] = store.writes;
+      learned["write_errors"] = store.writeErrors;
+      learned["last_write_bytes"] = store.lastWriteBytes;
+      const AcStateStore::Stats acStore = AcStateStore::stats();
+      JsonObject acState = doc["ac_store"].to<JsonObject>();
+      acState["loads"] = acStore.loads;
+      acState["load_errors"] = acStore.loadErrors;
+      acState["writes"] = acStore.writes;
+      acState["write_errors"] = acStore.writeErrors;
+      acState["unchanged"] = acStore.unchanged;
+      const Scenes::Stats sceneStats = Scenes::stats();
+      JsonObject scenes = doc["scenes"].to<JsonObject>();
+      scenes["count"] = sceneStats.scenes;
+      scenes["runs"] = sceneStats.runs;
+      scenes["load_errors"] = sceneStats.loadErrors;
+      scenes["writes"] = sceneStats.writes;
+      scenes["write_errors"] = sceneStats.writeErrors;
+      const Scheduler::Stats schedStats = Scheduler::stats();
+      JsonObject schedule = doc["schedule"].to<JsonObject>();
+      schedule["clock_set"] = Scheduler::clockMs() != 0;
+      schedule["jobs"] = schedStats.jobs;
+      schedule["fired"] = schedStats.fired;
+      schedule["missed"] = schedStats.missed;
+      schedule["late_max_ms"] = schedStats.lateMaxMs;
+      schedule["load_errors"] = schedStats.loadErrors;
+      schedule["writes"] = schedStats.writes;
+      schedule["write_errors"] = schedStats.writeErrors;
+      const Log::Stats logStats = Log::stats();
+      JsonObject log = doc["log"].to<JsonObject>();
+      log["written"] = logStats.written;
+      log["dropped"] = logStats.dropped;
+      log["truncated"] = logStats.truncated;
+      log["peak_queued"] = logStats.peakQueued;
+      addTaskStackFree(doc["tasks"].to<JsonObject>());
+      JsonObject wifiScan = doc["wifi_scan"].to<JsonObject>();
+      wifiScan["scanning"] = WifiScanCache::scanning();
+      wifiScan["count"] = static_cast<uint32_t>(WifiScanCache::results().size());
+      if (WifiScanCache::hasResults()) {
+        wifiScan["age_ms"] = WifiScanCache::ageMs();
+      } else {
+        wifiScan["age_ms"] = nullptr;
+      }
+      JsonObject wifiJoin = doc["wifi_join"].to<JsonObject>();
+      wifiJoin["path"] = wifiJoinPathName(wifiLinkPath);
+      wifiJoin["link_ms"] = wifiLinkUpMs;
+      wifiJoin["online_ms"] = wifiOnlineMs;
+      JsonObject mqttStatus = doc["mqtt"].to<JsonObject>();
+      mqttStatus["connected"] = mqtt.connected();
+      mqttStatus["failures"] = mqttBackoff.failures();
+      mqttStatus["last_rc"] = mqttLastFailure;
+      mqttStatus["retry_in_ms"] = mqttBackoff.retryInMs(millis());
+      const JsonArena::Stats arena = messageArena.stats();
+      JsonObject jsonArena = doc["json_arena"].to<JsonObject>();
+      jsonArena["allocations"] = arena.allocations;
+      jsonArena["heap_fallbacks"] = arena.heapFallbacks;
+      jsonArena["peak_bytes"] = arena.peakBytes;
+      jsonArena["capacity"] = arena.capacity;
       String out;
       serializeJson(doc, out);
       wifiPortalServer.send(200, "application/json", out);
     });
 
     wifiPortalServer.on("/scan", HTTP_GET, []() {
-      const int n = WiFi.scanNetworks(/*async=*/false, /*hidden=*/true);
+      // Served from the background scan; a stale list triggers a refresh
+      // that the next request (or the page's reload) picks up.
+      if (WifiScanCache::ageMs() > kPortalScanMaxAgeMs) {
+        WifiScanCache::request();
+      }
       JsonDocument doc;
       JsonArray arr = doc.to<JsonArray>();
-      for (int i = 0; i < n; ++i) {
+      for (const auto &network : WifiScanCache::results()) {
         JsonObject o = arr.add<JsonObject>();
-        o["ssid"] = WiFi.SSID(i);
-        o["rssi"] = WiFi.RSSI(i);
-        o["enc"] = WiFi.encryptionType(i);
+        o["ssid"] = network.ssid;
+        o["rssi"] = network.rssi;
+        o["enc"] = network.encryption;
       }
-      WiFi.scanDelete();
       String out;
       serializeJson(doc, out);
       wifiPortalServer.send(200, "application/json", out);
@@ -360,24 +642,34 @@ void startWifiPortal() {
       wifiAttemptStartedAt = millis();
 
       WiFi.mode(WIFI_STA);
-      Serial.printf("[WIFI][PORTAL] Connecting to SSID=%s\n", ssid.c_str());
+      LOG_I("[WIFI][PORTAL] Connecting to SSID=%s", ssid.c_str());
+      wifiJoinPath = WifiJoinPath::kPortal;
       WiFi.begin(ssid.c_str(), password.c_str());
     });
 
+    wifiPortalServer.on("/trace", HTTP_GET, []() {
+      std::vector<Trace::Record> records;
+      Trace::snapshot(records);
+      if (wifiPortalServer.arg("clear") == "1") Trace::clear();
+      String csv;
+      Trace::toCsv(records, csv);
+      wifiPortalServer.send(200, "text/csv", csv);
+    });
+
     wifiPortalServer.onNotFound([]() {
       wifiPortalServer.send(404, "text/plain; charset=utf-8", "Not found");
     });
   }
 
   wifiPortalRunning = true;
-  Serial.printf("[WIFI][PORTAL] AP started ssid=%s ip=%s\n", wifiPortalApSsid.c_str(),
-                WiFi.softAPIP().toString().c_str());
+  LOG_I("[WIFI][PORTAL] AP started ssid=%s ip=%s", wifiPortalApSsid.c_str(),
+        WiFi.softAPIP().toString().c_str());
   if (strlen(WIFI_AP_PASSWORD) >= 8) {
-    Serial.println(F("[WIFI][PORTAL] AP password set (>=8 chars)"));
+    LOG_I("[WIFI][PORTAL] AP password set (>=8 chars)");
   } else {
-    Serial.println(F("[WIFI][PORTAL] AP open (no password)"));
+    LOG_I("[WIFI][PORTAL] AP open (no password)");
   }
-  Serial.println(F("[WIFI][PORTAL] Open http://192.168.4.1/ to configure"));
+  LOG_I("[WIFI][PORTAL] Open http://192.168.4.1/ to configure");
   wifiPortalServer.begin();
 }
 
@@ -387,7 +679,7 @@ void stopWifiPortal() {
   portalStartedAt = millis();
   wifiPortalApSsid = "";
   WiFi.softAPdisconnect(true);
-  Serial.println(F("[WIFI][PORTAL] Stopped"));
+  LOG_I("[WIFI][PORTAL] Stopped");
 }
 
 void handleWifiPortalClient() {
@@ -395,267 +687,483 @@ void handleWifiPortalClient() {
   wifiPortalServer.handleClient();
 }
 
-void ensureMqttConnected() {
-  if (mqtt.connected()) return;
-
-  if (!configureMqttServer()) {
-    delay(1000);
-    return;
+void onMqttConnected() {
+  LOG_I("[MQTT] Connected");
+  if (mqttEverConnected) ++Metrics::node().mqttReconnects;
+  mqttEverConnected = true;
+  mqttBackoff.succeeded();
+  mqttLastFailure = 0;
+  mqttUsingRememberedBroker = false;
+  if (wifiOutageActive) {
+    wifiOutageActive = false;
+    wifiOnlineMs = millis() - wifiOutageStartedAt;
+    LOG_I("[WIFI] Online via %s: link %lums, MQTT %lums",
+          wifiJoinPathName(wifiLinkPath),
+          static_cast<unsigned long>(wifiLinkUpMs),
+          static_cast<unsigned long>(wifiOnlineMs));
   }
-
-  while (!mqtt.connected()) {
-    String clientId = String("esp32-") + String(NODE_ID) + "-" + WiFi.macAddress();
-    clientId.replace(":", "");
-    clientId += "-" + String(millis() & 0xFFFF, HEX);
-    Serial.printf("[MQTT] Connecting to %s:%u (clientId=%s)\n", resolvedMqttHost.c_str(),
-                  MQTT_PORT, clientId.c_str());
-
-    bool connected;
-    if (strlen(MQTT_USERNAME) > 0 || strlen(MQTT_PASSWORD) > 0) {
-      connected = mqtt.connect(clientId.c_str(), MQTT_USERNAME, MQTT_PASSWORD,
-                               kStatusTopic.c_str(), 1, true, "offline");
-    } else {
-      connected = mqtt.connect(clientId.c_str(), kStatusTopic.c_str(), 1, true,
-                               "offline");
-    }
-
-    if (connected) {
-      Serial.println(F("[MQTT] Connected"));
-      mqtt.subscribe(kCommandTopic.c_str(), 1);
-      mqtt.subscribe(kLegacyAcTopic.c_str(), 1);
-      mqtt.subscribe(kAcCommandTopic.c_str(), 1);
-      mqtt.subscribe(kFanCommandTopic.c_str(), 1);
-      mqtt.subscribe(kTvCommandTopic.c_str(), 1);
-      mqtt.subscribe(kDvdCommandTopic.c_str(), 1);
-      mqtt.subscribe(kStbCommandTopic.c_str(), 1);
-      mqtt.subscribe(kProjectorCommandTopic.c_str(), 1);
-      mqtt.subscribe(kLearnCommandTopic.c_str(), 1);
-      mqtt.subscribe(kFanLearnCommandTopic.c_str(), 1);
-      publishAvailability();
-      for (size_t i = 0; i < deviceManager.count(); ++i) {
-        if (auto *controller = deviceManager.at(i)) {
-          publishDeviceState(*controller);
-        }
-      }
-    } else {
-      Serial.printf("[MQTT] Failed rc=%d, retry in 2s\n", mqtt.state());
-      if (strlen(MQTT_HOST) == 0) {
-        mqttServerConfigured = false;
-      }
-      delay(2000);
+  if (strlen(MQTT_HOST) == 0) {
+    BrokerDiscovery::Broker broker;
+    broker.host = resolvedMqttHost;
+    broker.port = resolvedMqttPort;
+    BrokerDiscovery::remember(broker);
+  }
+  for (size_t i = 0; i < deviceManager.routeCount(); ++i) {
+    mqtt.subscribe(deviceManager.routeTopic(i), 1);
+  }
+  publishAvailability();
+  for (size_t i = 0; i < deviceManager.count(); ++i) {
+    if (auto *controller = deviceManager.at(i)) {
+      publishDeviceState(*controller, true);
     }
   }
 }
 
-bool configureMqttServer() {
-  if (mqttServerConfigured) return true;
-  if (!WiFi.isConnected()) return false;
-
-  if (strlen(MQTT_HOST) > 0) {
-    resolvedMqttHost = MQTT_HOST;
-    resolvedMqttPort = MQTT_PORT;
-    mqtt.setServer(resolvedMqttHost.c_str(), resolvedMqttPort);
-    mqttServerConfigured = true;
-    Serial.printf("[MQTT] Using configured broker %s:%u\n", resolvedMqttHost.c_str(),
-                  resolvedMqttPort);
-    return true;
+void onMqttConnectFailed(int reason) {
+  mqttLastFailure = reason;
+  mqttBackoff.failed(millis(), static_cast<uint32_t>(random(0x7FFFFFFF)));
+  LOG_W("[MQTT] Failed rc=%d, retry in %lums (attempt %lu)", reason,
+        static_cast<unsigned long>(mqttBackoff.lastDelayMs()),
+        static_cast<unsigned long>(mqttBackoff.failures()));
+  if (mqttUsingRememberedBroker) {
+    // Stale cache (new network, broker moved): search right away instead of
+    // spending the attempt budget on it.
+    LOG_I("[MQTT] Remembered broker unreachable, searching");
+    mqttUsingRememberedBroker = false;
+    mqttTryRememberedBroker = false;
+    mqttServerConfigured = false;
+    mqttBackoff.succeeded();
+    return;
   }
-
-  String discoveredHost;
-  uint16_t discoveredPort = MQTT_PORT;
-  if (!autoDiscoverBroker(discoveredHost, discoveredPort)) {
-    Serial.println(F("[DISCOVERY] Broker not found, retrying"));
-    return false;
+  if (mqttBackoff.budgetExhausted()) {
+    mqttBackoff.resetBudget();
+    if (strlen(MQTT_HOST) == 0) {
+      LOG_I("[MQTT] Attempt budget spent, rediscovering broker");
+      mqttServerConfigured = false;
+    }
   }
-
-  resolvedMqttHost = discoveredHost;
-  resolvedMqttPort = discoveredPort;
-  mqtt.setServer(resolvedMqttHost.c_str(), resolvedMqttPort);
-  mqttServerConfigured = true;
-  Serial.printf("[MQTT] Auto-discovered broker %s:%u\n", resolvedMqttHost.c_str(),
-                resolvedMqttPort);
-  return true;
 }
 
-bool autoDiscoverBroker(String &hostOut, uint16_t &portOut) {
-  WiFiUDP udp;
-  if (!udp.begin(0)) {
-    Serial.println(F("[DISCOVERY] Failed to start UDP socket"));
-    return false;
+// One step of the reconnect state machine; never waits longer than the TCP
+// connect timeout so the portal, learner and IR queue keep running while the
+// broker is away.
+void ensureMqttConnected() {
+  if (mqtt.connected()) return;
+  if (!WiFi.isConnected()) {
+    BrokerDiscovery::stop();
+    return;
   }
+  if (!mqttBackoff.due(millis())) return;
 
-  const IPAddress broadcast = calculateBroadcastAddress();
-  Serial.printf("[DISCOVERY] Broadcasting request to %s:%u\n",
-                broadcast.toString().c_str(), MQTT_DISCOVERY_PORT);
-
-  udp.beginPacket(broadcast, MQTT_DISCOVERY_PORT);
-  udp.write(reinterpret_cast<const uint8_t *>(MQTT_DISCOVERY_REQUEST),
-            strlen(MQTT_DISCOVERY_REQUEST));
-  udp.endPacket();
-
-  const unsigned long start = millis();
-  while (millis() - start < MQTT_DISCOVERY_TIMEOUT_MS) {
-    int packetSize = udp.parsePacket();
-    if (packetSize <= 0) {
-      delay(100);
-      continue;
-    }
+  if (!configureMqttServer()) {
+    if (!BrokerDiscovery::searching()) onMqttConnectFailed(kMqttNoBroker);
+    return;
+  }
 
-    char buffer[128];
-    const int len = udp.read(buffer, sizeof(buffer) - 1);
-    if (len <= 0) {
-      continue;
-    }
-    buffer[len] = '\0';
+  String clientId = String("esp32-") + String(NODE_ID) + "-" + WiFi.macAddress();
+  clientId.replace(":", "");
+  clientId += "-" + String(millis() & 0xFFFF, HEX);
+  LOG_I("[MQTT] Connecting to %s:%u (clientId=%s)", resolvedMqttHost.c_str(),
+        resolvedMqttPort, clientId.c_str());
+
+  // Open the socket ourselves so a dead broker costs MQTT_CONNECT_TIMEOUT_MS
+  // instead of the stack's default; PubSubClient reuses a connected client.
+  if (!wifiClient.connect(resolvedMqttHost.c_str(), resolvedMqttPort,
+                          static_cast<int32_t>(MQTT_CONNECT_TIMEOUT_MS))) {
+    onMqttConnectFailed(kMqttTcpConnectFailed);
+    return;
+  }
 
-    String payload(buffer);
-    payload.trim();
-    if (!parseDiscoveryResponse(payload, hostOut, portOut)) {
-      continue;
-    }
+  bool connected;
+  if (strlen(MQTT_USERNAME) > 0 || strlen(MQTT_PASSWORD) > 0) {
+    connected = mqtt.connect(clientId.c_str(), MQTT_USERNAME, MQTT_PASSWORD,
+                             kStatusTopic.c_str(), 1, true, "offline");
+  } else {
+    connected = mqtt.connect(clientId.c_str(), kStatusTopic.c_str(), 1, true,
+                             "offline");
+  }
 
-    Serial.printf("[DISCOVERY] Received broker %s:%u\n", hostOut.c_str(), portOut);
-    udp.stop();
-    return true;
+  if (connected) {
+    onMqttConnected();
+  } else {
+    wifiClient.stop();
+    onMqttConnectFailed(mqtt.state());
   }
+}
 
-  udp.stop();
-  return false;
+void useMqttBroker(const BrokerDiscovery::Broker &broker, const char *source) {
+  resolvedMqttHost = broker.host;
+  resolvedMqttPort = broker.port;
+  mqtt.setServer(resolvedMqttHost.c_str(), resolvedMqttPort);
+  mqttServerConfigured = true;
+  LOG_I("[MQTT] Using %s broker %s:%u", source, resolvedMqttHost.c_str(),
+        resolvedMqttPort);
 }
 
-bool parseDiscoveryResponse(const String &response, String &hostOut,
-                            uint16_t &portOut) {
-  if (!response.startsWith(kDiscoveryResponsePrefix)) {
-    return false;
-  }
+// Picks the broker: MQTT_HOST, else the remembered one, else one step of
+// the discovery search (false while it is still running).
+bool configureMqttServer() {
+  if (mqttServerConfigured) return true;
+  if (!WiFi.isConnected()) return false;
 
-  String payload = response.substring(kDiscoveryResponsePrefix.length());
-  const int colon = payload.indexOf(':');
-  if (colon == -1) {
-    return false;
+  BrokerDiscovery::Broker broker;
+  if (strlen(MQTT_HOST) > 0) {
+    broker.host = MQTT_HOST;
+    broker.port = MQTT_PORT;
+    useMqttBroker(broker, "configured");
+    return true;
   }
 
-  String host = payload.substring(0, colon);
-  host.trim();
-  String portStr = payload.substring(colon + 1);
-  portStr.trim();
-
-  if (host.isEmpty()) {
-    return false;
+  if (mqttTryRememberedBroker && BrokerDiscovery::remembered(broker)) {
+    useMqttBroker(broker, "remembered");
+    mqttUsingRememberedBroker = true;
+    return true;
   }
 
-  uint16_t port = static_cast<uint16_t>(portStr.toInt());
-  if (port == 0) {
-    port = MQTT_PORT;
+  switch (BrokerDiscovery::poll(broker)) {
+    case BrokerDiscovery::Status::kFound:
+      useMqttBroker(broker, "auto-discovered");
+      return true;
+    case BrokerDiscovery::Status::kTimedOut:
+      LOG_I("[DISCOVERY] Broker not found, retrying");
+      return false;
+    default:
+      return false;
   }
-
-  hostOut = host;
-  portOut = port;
-  return true;
-}
-
-IPAddress calculateBroadcastAddress() {
-  const uint32_t ip = static_cast<uint32_t>(WiFi.localIP());
-  const uint32_t mask = static_cast<uint32_t>(WiFi.subnetMask());
-  const uint32_t broadcast = (ip & mask) | ~mask;
-  return IPAddress(broadcast);
 }
 
 void publishAvailability() {
   if (!mqtt.connected()) return;
 
   if (!mqtt.publish(kStatusTopic.c_str(), "online", true)) {
-    Serial.println(F("[MQTT] Failed to publish availability"));
+    LOG_W("[MQTT] Failed to publish availability");
   } else {
     lastStatusPublished = millis();
     digitalWrite(STATUS_LED_PIN, HIGH);
   }
 }
 
-void publishDeviceState(DeviceController &controller, bool retained) {
+// Bytes of each task's stack never touched so far, keyed by task name.
+void addTaskStackFree(JsonObject out) {
+  out["net"] = networkTaskHandle != nullptr
+                   ? uxTaskGetStackHighWaterMark(networkTaskHandle)
+                   : 0;
+  out["ir_tx"] = irTransmitter.stats().taskStackFree;
+  out["ir_rx"] = irLearner.taskStackFree();
+  out["log"] = Log::stats().taskStackFree;
+}
+
+// Streams the snapshot (about 1.5 KB, larger than PubSubClient's buffer) with
+// beginPublish(). Runs between messages, so it can borrow messageArena.
+void publishMetrics() {
+  if (!mqtt.connected()) return;
+  lastMetricsPublished = millis();
+
+  JsonDocument doc(&messageArena);
+  Metrics::snapshot(deviceManager, doc);
+  const IrTransmitter::Stats ir = irTransmitter.stats();
+  doc["ir_sent"] = ir.sent;
+  doc["ir_dropped"] = ir.dropped;
+  doc["log_dropped"] = Log::stats().dropped;
+  addTaskStackFree(doc["stack_free"].to<JsonObject>());
+
+  const size_t length = measureJson(doc);
+  const bool ok = mqtt.beginPublish(kMetricsTopic.c_str(), length, false) &&
+                  serializeJson(doc, mqtt) == length && mqtt.endPublish() == 1;
+  Trace::record(Trace::Event::kPublish, ok, static_cast<uint16_t>(length));
+  if (!ok) {
+    LOG_W("[METRICS] Failed to publish %u bytes",
+          static_cast<unsigned>(length));
+  }
+}
+
+// Publishes `state` (the controller's serializeState()) through its
+// StateTracker: nothing when it did not change, else the whole state retained
+// on its state topic or, with STATE_PUBLISH_DELTAS, the changed members on
+// <state topic>/delta. `snapshot` always sends the whole state.
+void publishState(DeviceController &controller, JsonDocument &state,
+                  bool snapshot) {
   if (!mqtt.connected()) return;
   // Only AC publishes state; others run stateless
   if (strcmp(controller.deviceType(), "ac") != 0) return;
 
-  JsonDocument doc;
-  controller.serializeState(doc);
+  JsonDocument message(&messageArena);
+  const StateTracker::Publish kind = controller.stateTracker().update(
+      state.as<JsonObjectConst>(), snapshot, STATE_PUBLISH_DELTAS, message);
+  if (kind == StateTracker::Publish::kNothing) {
+    ++Metrics::node().stateUnchanged;
+    LOG_D("[STATE] %s unchanged", controller.deviceType());
+    return;
+  }
 
+  char topic[96];
+  const bool delta = kind == StateTracker::Publish::kDelta;
+  snprintf(topic, sizeof(topic), delta ? "%s/delta" : "%s",
+           controller.stateTopic());
   char buffer[256];
-  size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  size_t len = serializeJson(message, buffer, sizeof(buffer));
   if (len == 0) {
-    Serial.println(F("[STATE] Failed to serialize state"));
+    LOG_E("[STATE] Failed to serialize state");
     return;
   }
 
-  if (!mqtt.publish(controller.stateTopic(), buffer, retained)) {
-    Serial.printf("[STATE] Failed to publish %s\n", controller.deviceType());
+  const bool published = mqtt.publish(topic, buffer, !delta);
+  Trace::record(Trace::Event::kPublish, published, static_cast<uint16_t>(len));
+  if (!published) {
+    LOG_W("[STATE] Failed to publish %s", controller.deviceType());
   } else {
-    Serial.printf("[STATE] Published %s: %s\n", controller.deviceType(), buffer);
+    LOG_D("[STATE] Published %s: %s", topic, buffer);
+  }
+}
+
+void publishDeviceState(DeviceController &controller, bool snapshot) {
+  JsonDocument doc(&messageArena);
+  controller.serializeState(doc);
+  publishState(controller, doc, snapshot);
+}
+
+// Publishes the state of controllers that just sent a deferred change (A/C
+// coalescing); their frames count towards the metrics like any command's.
+void pollControllers() {
+  for (size_t i = 0; i < deviceManager.count(); ++i) {
+    DeviceController *controller = deviceManager.at(i);
+    const uint32_t framesBefore = irTransmitter.enqueued();
+    if (!controller->poll()) continue;
+    controller->metrics().irFrames += irTransmitter.enqueued() - framesBefore;
+    publishDeviceState(*controller, false);
   }
 }
 
 void handleMqttMessage(char *topic, byte *payload, unsigned int length) {
-  const String data = readPayload(payload, length);
-  Serial.printf("[MQTT] Message on %s: %s\n", topic, data.c_str());
+  const uint32_t receivedUs = micros();
+  Trace::record(Trace::Event::kMqttReceive, 0,
+                static_cast<uint16_t>(length > UINT16_MAX ? UINT16_MAX : length));
+  const char *json = reinterpret_cast<const char *>(payload);
+  LOG_D("[MQTT] Message on %s: %.*s", topic, static_cast<int>(length), json);
+  dispatchMessage(topic, json, length, receivedUs);
+}
 
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, data);
+// A scheduled job is handled as if its payload had arrived on its topic.
+void runScheduledJob(const char *topicSuffix, const char *payload,
+                     size_t length) {
+  const String topic = kNodeTopicPrefix + topicSuffix;
+  dispatchMessage(topic.c_str(), payload, length, micros());
+}
+
+void dispatchMessage(const char *topic, const char *json, size_t length,
+                     uint32_t receivedUs) {
+  // Parse straight from PubSubClient's buffer; both documents live in
+  // messageArena, so a command does not allocate on the way in.
+  JsonDocument doc(&messageArena);
+  DeserializationError err = deserializeJson(doc, json, length);
+  Trace::record(Trace::Event::kJsonParsed, static_cast<uint8_t>(err.code()));
   if (err) {
-    Serial.printf("[MQTT] JSON parse error: %s\n", err.c_str());
+    ++Metrics::node().parseErrors;
+    LOG_W("[MQTT] JSON parse error: %s", err.c_str());
+    return;
+  }
+
+  const TopicMatch match = deviceManager.route(topic);
+  if (match.route == TopicRoute::kNone) {
+    LOG_W("[MQTT] No route for topic %s", topic);
+    return;
+  }
+
+  if (match.route == TopicRoute::kLearn) {
+    handleLearnCommand(doc.as<JsonObjectConst>(),
+                       match.controller != nullptr
+                           ? match.controller->deviceType()
+                           : "");
     return;
   }
 
-  const String topicStr(topic);
+  if (match.route == TopicRoute::kTrace) {
+    handleTraceCommand(doc.as<JsonObjectConst>());
+    return;
+  }
 
-  if (topicStr.equalsIgnoreCase(kLearnCommandTopic)) {
-    handleLearnCommand(doc.as<JsonObjectConst>());
+  if (match.route == TopicRoute::kSceneSet ||
+      match.route == TopicRoute::kSceneRun) {
+    handleSceneCommand(doc.as<JsonObjectConst>(), match.route);
     return;
   }
 
-  if (topicStr.equalsIgnoreCase(kFanLearnCommandTopic)) {
-    handleLearnCommand(doc.as<JsonObjectConst>(), "fan");
+  if (match.route == TopicRoute::kSchedule) {
+    handleScheduleCommand(doc.as<JsonObjectConst>());
     return;
   }
 
-  String device = doc["device"].as<String>();
-  if (device.isEmpty() || device.equalsIgnoreCase("null")) {
-    device = inferDeviceFromTopic(topicStr);
+  // An explicit "device" in the payload wins over the topic's device.
+  DeviceController *controller = match.controller;
+  const char *device = doc["device"].as<const char *>();
+  if (device != nullptr && device[0] != '\0' &&
+      strcasecmp(device, "null") != 0) {
+    controller = deviceManager.find(device);
+  }
+
+  // Batch steps may each name their device, so the topic's is only a default.
+  const char *command = doc["cmd"].as<const char *>();
+  if (command != nullptr && strcasecmp(command, "batch") == 0) {
+    handleBatchCommand(doc.as<JsonObjectConst>(), controller);
+    return;
   }
 
-  DeviceController *controller = deviceManager.find(device);
   if (controller == nullptr) {
-    Serial.printf("[MQTT] No controller for device '%s'\n", device.c_str());
+    LOG_W("[MQTT] No controller for device '%s'",
+          device != nullptr ? device : "");
     return;
   }
 
-  JsonDocument stateDoc;
+  // {"cmd":"state"} asks for a full snapshot, e.g. after a gap in "seq".
+  if (command != nullptr && strcasecmp(command, "state") == 0) {
+    publishDeviceState(*controller, true);
+    return;
+  }
+
+  JsonDocument stateDoc(&messageArena);
   stateDoc.clear();
-  if (controller->handleCommand(doc.as<JsonObjectConst>(), stateDoc)) {
-    // Only AC publishes state; other devices run stateless (command-only).
-    if (strcmp(controller->deviceType(), "ac") != 0) {
-      return;
+  Trace::record(Trace::Event::kDispatch,
+                static_cast<uint8_t>(deviceManager.indexOf(controller)));
+  const uint32_t framesBefore = irTransmitter.enqueued();
+  const bool changed =
+      controller->handleCommand(doc.as<JsonObjectConst>(), stateDoc);
+  Trace::record(Trace::Event::kCommandDone, changed);
+  Metrics::DeviceCounters &counters = controller->metrics();
+  ++counters.commands;
+  counters.irFrames += irTransmitter.enqueued() - framesBefore;
+  counters.commandUs.record(micros() - receivedUs);
+  if (changed) publishState(*controller, stateDoc, false);
+}
+
+// Runs a whole batch (see CommandBatch.h), publishes one result for it on
+// kBatchResultTopic ("id" is echoed), then the state of every controller it
+// changed.
+void handleBatchCommand(JsonObjectConst cmd, DeviceController *controller) {
+  const uint32_t receivedUs = micros();
+  JsonDocument stateDoc(&messageArena);
+  CommandBatch::Result result;
+  CommandBatch::run(cmd, controller, deviceManager, irTransmitter, stateDoc,
+                    result);
+  Trace::record(Trace::Event::kCommandDone, result.changed != 0);
+  if (controller != nullptr) {
+    controller->metrics().commandUs.record(micros() - receivedUs);
+  }
+
+  JsonDocument doc(&messageArena);
+  CommandBatch::toJson(result, doc.to<JsonObject>());
+  if (!cmd["id"].isNull()) doc["id"] = cmd["id"];
+  char buffer[256];
+  const size_t len = serializeJson(doc, buffer, sizeof(buffer));
+  const bool published =
+      len > 0 && mqtt.publish(kBatchResultTopic.c_str(), buffer, false);
+  Trace::record(Trace::Event::kPublish, published, static_cast<uint16_t>(len));
+  if (!published) {
+    LOG_W("[BATCH] Failed to publish result");
+  } else {
+    LOG_D("[BATCH] Result: %s", buffer);
+  }
+
+  for (size_t i = 0; i < deviceManager.count(); ++i) {
+    if (result.changed & (1u << i)) {
+      publishDeviceState(*deviceManager.at(i), false);
     }
+  }
+}
 
-    char buffer[256];
-    size_t len = serializeJson(stateDoc, buffer, sizeof(buffer));
-    if (len == 0) {
-      Serial.println(F("[STATE] Failed to serialize updated state"));
-      return;
+// scene/set stores ({"name","steps"}) or deletes ({"name","delete":true}) a
+// scene and answers with the stored names; scene/run runs one and answers
+// like a batch. Both answer on kSceneResultTopic; state follows a run.
+void handleSceneCommand(JsonObjectConst cmd, TopicRoute route) {
+  const char *name = cmd["name"].as<const char *>();
+  JsonDocument doc(&messageArena);
+  uint32_t changed = 0;
+  if (route == TopicRoute::kSceneRun) {
+    CommandBatch::Result result;
+    Scenes::run(name, result);
+    Trace::record(Trace::Event::kCommandDone, result.changed != 0);
+    CommandBatch::toJson(result, doc.to<JsonObject>());
+    changed = result.changed;
+  } else if (cmd["delete"].as<bool>()) {
+    doc["deleted"] = Scenes::remove(name);
+  } else {
+    const char *error = nullptr;
+    int errorStep = -1;
+    if (Scenes::define(cmd, error, errorStep)) {
+      doc["stored"] = true;
+    } else {
+      doc["error"] = error;
+      if (errorStep >= 0) doc["step"] = errorStep;
     }
+  }
+  if (name != nullptr) doc["name"] = name;
+  if (route == TopicRoute::kSceneSet) {
+    Scenes::list(doc["scenes"].to<JsonArray>());
+  }
+
+  const size_t length = measureJson(doc);
+  const bool ok =
+      mqtt.beginPublish(kSceneResultTopic.c_str(), length, false) &&
+      serializeJson(doc, mqtt) == length && mqtt.endPublish() == 1;
+  Trace::record(Trace::Event::kPublish, ok, static_cast<uint16_t>(length));
+  if (!ok) LOG_W("[SCENE] Failed to publish result");
 
-    if (!mqtt.publish(controller->stateTopic(), buffer, true)) {
-      Serial.printf("[STATE] Failed to publish updated %s state\n",
-                    controller->deviceType());
+  for (size_t i = 0; i < deviceManager.count(); ++i) {
+    if (changed & (1u << i)) publishDeviceState(*deviceManager.at(i), false);
+  }
+}
+
+// schedule/set stores ({"name",time,action}) or deletes ({"name",
+// "delete":true}) a timed job (see Scheduler.h) and answers on
+// kScheduleResultTopic with the pending jobs.
+void handleScheduleCommand(JsonObjectConst cmd) {
+  const char *name = cmd["name"].as<const char *>();
+  JsonDocument doc(&messageArena);
+  if (cmd["delete"].as<bool>()) {
+    doc["deleted"] = Scheduler::remove(name);
+  } else {
+    const char *error = nullptr;
+    if (Scheduler::define(cmd, Scheduler::clockMs(), error)) {
+      doc["stored"] = true;
     } else {
-      Serial.printf("[STATE] Updated %s: %s\n", controller->deviceType(), buffer);
+      doc["error"] = error;
     }
   }
+  if (name != nullptr) doc["name"] = name;
+  doc["nowMs"] = Scheduler::clockMs();
+  Scheduler::list(doc["jobs"].to<JsonArray>());
+
+  const size_t length = measureJson(doc);
+  const bool ok =
+      mqtt.beginPublish(kScheduleResultTopic.c_str(), length, false) &&
+      serializeJson(doc, mqtt) == length && mqtt.endPublish() == 1;
+  Trace::record(Trace::Event::kPublish, ok, static_cast<uint16_t>(length));
+  if (!ok) LOG_W("[SCHED] Failed to publish result");
+}
+
+// Publishes the trace ring as CSV on kTraceTopic. The dump is usually larger
+// than PubSubClient's buffer, so it is streamed with beginPublish().
+void handleTraceCommand(JsonObjectConst cmd) {
+  std::vector<Trace::Record> records;
+  Trace::snapshot(records);
+  if (cmd["clear"].as<bool>()) Trace::clear();
+  String csv;
+  Trace::toCsv(records, csv);
+
+  const bool ok =
+      mqtt.beginPublish(kTraceTopic.c_str(), csv.length(), false) &&
+      mqtt.write(reinterpret_cast<const uint8_t *>(csv.c_str()),
+                 csv.length()) == csv.length() &&
+      mqtt.endPublish() == 1;
+  LOG_I("[TRACE] %s %u events (%u bytes)",
+        ok ? "Published" : "Failed to publish",
+        static_cast<unsigned>(records.size()),
+        static_cast<unsigned>(csv.length()));
 }
 
-void handleLearnCommand(JsonObjectConst cmd, const String &topicDevice) {
+void handleLearnCommand(JsonObjectConst cmd, const char *topicDevice) {
   const String action = cmd["cmd"].as<String>();
   if (!action.equalsIgnoreCase("learn")) {
-    Serial.printf("[IR][LEARN] Unsupported cmd=%s\n", action.c_str());
+    LOG_W("[IR][LEARN] Unsupported cmd=%s", action.c_str());
     return;
   }
 
@@ -666,7 +1174,7 @@ void handleLearnCommand(JsonObjectConst cmd, const String &topicDevice) {
   String key = cmd["key"].as<String>();
 
   if (key.isEmpty()) {
-    Serial.println(F("[IR][LEARN] Missing key"));
+    LOG_W("[IR][LEARN] Missing key");
     IrLearningResult result;
     result.success = false;
     result.device = device;
@@ -678,7 +1186,7 @@ void handleLearnCommand(JsonObjectConst cmd, const String &topicDevice) {
 
   String error;
   if (!irLearner.startLearning(device, key, error)) {
-    Serial.printf("[IR][LEARN] Cannot start: %s\n", error.c_str());
+    LOG_W("[IR][LEARN] Cannot start: %s", error.c_str());
     IrLearningResult result;
     result.success = false;
     result.device = device;
@@ -688,13 +1196,12 @@ void handleLearnCommand(JsonObjectConst cmd, const String &topicDevice) {
     return;
   }
 
-  Serial.printf("[IR][LEARN] Listening for %s/%s\n", device.c_str(),
-                key.c_str());
+  LOG_I("[IR][LEARN] Listening for %s/%s", device.c_str(), key.c_str());
 }
 
 void publishLearningResult(const IrLearningResult &result) {
   if (!mqtt.connected()) {
-    Serial.println(F("[IR][LEARN] MQTT not connected, dropping result"));
+    LOG_W("[IR][LEARN] MQTT not connected, dropping result");
     return;
   }
 
@@ -720,22 +1227,22 @@ void publishLearningResult(const IrLearningResult &result) {
       devLower.toLowerCase();
       if (devLower.equalsIgnoreCase("ac")) {
         acController.learnKey(result.key, proto, value, result.bits,
-                              result.raw);
+                              result.raw, result.timing);
       } else if (devLower.equalsIgnoreCase("fan")) {
         fanController.learnKey(result.key, proto, value, result.bits,
-                               result.raw);
+                               result.raw, result.timing);
       } else if (devLower.equalsIgnoreCase("tv")) {
         tvController.learnKey(result.key, proto, value, result.bits,
-                               result.raw);
+                               result.raw, result.timing);
       } else if (devLower.equalsIgnoreCase("stb")) {
         stbController.learnKey(result.key, proto, value, result.bits,
-                               result.raw);
+                               result.raw, result.timing);
       } else if (devLower.equalsIgnoreCase("dvd")) {
         dvdController.learnKey(result.key, proto, value, result.bits,
-                               result.raw);
+                               result.raw, result.timing);
       } else if (devLower.equalsIgnoreCase("projector")) {
         projectorController.learnKey(result.key, proto, value, result.bits,
-                                     result.raw);
+                                     result.raw, result.timing);
       }
     }
   } else if (result.error.length() > 0) {
@@ -746,7 +1253,7 @@ void publishLearningResult(const IrLearningResult &result) {
   char buffer[768];
   size_t len = serializeJson(doc, buffer, sizeof(buffer));
   if (len == 0) {
-    Serial.println(F("[IR][LEARN] Failed to serialize result"));
+    LOG_E("[IR][LEARN] Failed to serialize result");
     return;
   }
 
@@ -758,12 +1265,11 @@ void publishLearningResult(const IrLearningResult &result) {
   const bool deviceOk = mqtt.publish(deviceTopic.c_str(), buffer, false);
 
   if (!generalOk || !deviceOk) {
-    Serial.printf(
-        "[IR][LEARN] Failed to publish result (general=%d device=%d)\n",
-        generalOk, deviceOk);
+    LOG_W("[IR][LEARN] Failed to publish result (general=%d device=%d)",
+          generalOk, deviceOk);
   } else {
-    Serial.printf("[IR][LEARN] Result published to %s and %s: %s\n",
-                  kLearnResultTopic.c_str(), deviceTopic.c_str(), buffer);
+    LOG_I("[IR][LEARN] Result published to %s and %s: %s",
+          kLearnResultTopic.c_str(), deviceTopic.c_str(), buffer);
   }
 }
 
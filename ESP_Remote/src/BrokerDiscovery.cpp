@@ -0,0 +1,208 @@
+#include "BrokerDiscovery.h"
+
+#include <Preferences.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <mdns.h>
+#include <string.h>
+
+#include "Config.h"
+#include "Log.h"
+
+namespace BrokerDiscovery {
+namespace {
+
+constexpr const char *kPrefsNamespace = "mqtt_broker";
+constexpr const char *kPrefsKeyHost = "host";
+constexpr const char *kPrefsKeyPort = "port";
+constexpr const char *kAnnouncementPrefix = "MQTT://";
+constexpr size_t kMaxMdnsResults = 4;
+
+Preferences prefs;
+bool initialized = false;
+Broker cached;
+
+WiFiUDP udp;
+bool active = false;
+uint32_t startedAt = 0;
+uint32_t lastProbeAt = 0;
+uint32_t probeIntervalMs = 0;
+mdns_search_once_t *mdnsSearch = nullptr;
+
+IPAddress calculateBroadcastAddress() {
+  const uint32_t ip = static_cast<uint32_t>(WiFi.localIP());
+  const uint32_t mask = static_cast<uint32_t>(WiFi.subnetMask());
+  const uint32_t broadcast = (ip & mask) | ~mask;
+  return IPAddress(broadcast);
+}
+
+void sendProbe(uint32_t now) {
+  const IPAddress broadcast = calculateBroadcastAddress();
+  LOG_I("[DISCOVERY] Broadcasting request to %s:%u",
+        broadcast.toString().c_str(), MQTT_DISCOVERY_PORT);
+  udp.beginPacket(broadcast, MQTT_DISCOVERY_PORT);
+  udp.write(reinterpret_cast<const uint8_t *>(MQTT_DISCOVERY_REQUEST),
+            strlen(MQTT_DISCOVERY_REQUEST));
+  udp.endPacket();
+  lastProbeAt = now;
+}
+
+void startMdnsQuery() {
+  if (!MQTT_DISCOVERY_USE_MDNS) return;
+  const esp_err_t err = mdns_init();
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    LOG_W("[DISCOVERY] mDNS unavailable (err=%d)", err);
+    return;
+  }
+  mdnsSearch = mdns_query_async_new(nullptr, "_mqtt", "_tcp", MDNS_TYPE_PTR,
+                                    MQTT_DISCOVERY_TIMEOUT_MS, kMaxMdnsResults);
+}
+
+void stopMdnsQuery() {
+  if (mdnsSearch == nullptr) return;
+  mdns_query_async_delete(mdnsSearch);
+  mdnsSearch = nullptr;
+}
+
+bool pollUdp(Broker &out) {
+  while (udp.parsePacket() > 0) {
+    char buffer[128];
+    const int len = udp.read(buffer, sizeof(buffer) - 1);
+    if (len <= 0) continue;
+    buffer[len] = '\0';
+    if (parseAnnouncement(buffer, out)) {
+      LOG_I("[DISCOVERY] Received broker %s:%u", out.host.c_str(), out.port);
+      return true;
+    }
+  }
+  return false;
+}
+
+// First IPv4 answer of the _mqtt._tcp query, if it has completed.
+bool pollMdns(Broker &out) {
+  if (mdnsSearch == nullptr) return false;
+  mdns_result_t *results = nullptr;
+  if (!mdns_query_async_get_results(mdnsSearch, 0, &results)) return false;
+
+  bool found = false;
+  for (mdns_result_t *r = results; r != nullptr && !found; r = r->next) {
+    for (mdns_ip_addr_t *a = r->addr; a != nullptr; a = a->next) {
+      if (a->addr.type != ESP_IPADDR_TYPE_V4) continue;
+      out.host = IPAddress(a->addr.u_addr.ip4.addr).toString();
+      out.port = r->port != 0 ? r->port : MQTT_PORT;
+      found = true;
+      break;
+    }
+  }
+  mdns_query_results_free(results);
+  stopMdnsQuery();
+  if (found) {
+    LOG_I("[DISCOVERY] mDNS broker %s:%u", out.host.c_str(), out.port);
+  }
+  return found;
+}
+
+void start(uint32_t now) {
+  if (!udp.begin(0)) {
+    LOG_E("[DISCOVERY] Failed to start UDP socket");
+    return;
+  }
+  active = true;
+  startedAt = now;
+  probeIntervalMs = MQTT_DISCOVERY_RETRY_MS;
+  sendProbe(now);
+  startMdnsQuery();
+}
+
+}  // namespace
+
+void begin() {
+  if (initialized) return;
+  initialized = prefs.begin(kPrefsNamespace, false);
+  if (!initialized) return;
+  cached.host = prefs.getString(kPrefsKeyHost, "");
+  cached.port = prefs.getUShort(kPrefsKeyPort, 0);
+  if (!cached.host.isEmpty()) {
+    LOG_I("[DISCOVERY] Remembered broker %s:%u", cached.host.c_str(),
+          cached.port);
+  }
+}
+
+bool remembered(Broker &out) {
+  if (cached.host.isEmpty() || cached.port == 0) return false;
+  out = cached;
+  return true;
+}
+
+void remember(const Broker &broker) {
+  if (broker.host == cached.host && broker.port == cached.port) return;
+  cached = broker;
+  if (!initialized) return;
+  prefs.putString(kPrefsKeyHost, broker.host);
+  prefs.putUShort(kPrefsKeyPort, broker.port);
+}
+
+void forget() {
+  cached = Broker();
+  if (!initialized) return;
+  prefs.remove(kPrefsKeyHost);
+  prefs.remove(kPrefsKeyPort);
+}
+
+Status poll(Broker &out) {
+  const uint32_t now = millis();
+  if (!active) {
+    start(now);
+    if (!active) return Status::kTimedOut;
+  }
+
+  if (pollUdp(out) || pollMdns(out)) {
+    stop();
+    return Status::kFound;
+  }
+
+  if (now - startedAt >= MQTT_DISCOVERY_TIMEOUT_MS) {
+    stop();
+    return Status::kTimedOut;
+  }
+
+  if (now - lastProbeAt >= probeIntervalMs) {
+    sendProbe(now);
+    probeIntervalMs *= 2;
+  }
+  return Status::kSearching;
+}
+
+bool searching() { return active; }
+
+void stop() {
+  if (!active) return;
+  active = false;
+  udp.stop();
+  stopMdnsQuery();
+}
+
+bool parseAnnouncement(const char *text, Broker &out) {
+  if (text == nullptr) return false;
+  while (isspace(static_cast<unsigned char>(*text))) ++text;
+  const size_t prefixLength = strlen(kAnnouncementPrefix);
+  if (strncmp(text, kAnnouncementPrefix, prefixLength) != 0) return false;
+
+  String payload(text + prefixLength);
+  payload.trim();
+  const int colon = payload.indexOf(':');
+  if (colon == -1) return false;
+  String host = payload.substring(0, colon);
+  host.trim();
+  if (host.isEmpty()) return false;
+
+  String portStr = payload.substring(colon + 1);
+  portStr.trim();
+  const uint16_t port = static_cast<uint16_t>(portStr.toInt());
+
+  out.host = host;
+  out.port = port != 0 ? port : MQTT_PORT;
+  return true;
+}
+
+}  // namespace BrokerDiscovery
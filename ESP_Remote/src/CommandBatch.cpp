@@ -0,0 +1,139 @@
+#include "CommandBatch.h"
+
+#include <strings.h>
+
+#include "KeyId.h"
+#include "Log.h"
+
+namespace CommandBatch {
+namespace {
+
+constexpr uint8_t kMaxRepeat = IR_TX_QUEUE_DEPTH;
+
+uint8_t repeatOf(JsonVariantConst step) {
+  const int repeat = step["repeat"] | 1;
+  return static_cast<uint8_t>(constrain(repeat, 1, kMaxRepeat));
+}
+
+// Key name of a key step; nullptr for a device command step.
+const char *keyOf(JsonVariantConst step) {
+  if (step.is<const char *>()) return step.as<const char *>();
+  if (!step["cmd"].isNull()) return nullptr;
+  return step["key"].as<const char *>();
+}
+
+void refuse(Result &result, const char *error, int index) {
+  result.error = error;
+  result.errorStep = static_cast<int8_t>(index);
+  LOG_W("[BATCH] Refused: %s (step %d)", error, index);
+}
+
+}  // namespace
+
+void run(JsonObjectConst cmd, DeviceController *controller,
+         DeviceManager &devices, IrTransmitter &ir, JsonDocument &stateDoc,
+         Result &result) {
+  result = Result();
+  JsonArrayConst steps = cmd["steps"].as<JsonArrayConst>();
+  if (steps.isNull() || steps.size() == 0) {
+    refuse(result, "no_steps", -1);
+    return;
+  }
+  if (steps.size() > kMaxSteps) {
+    refuse(result, "too_many_steps", -1);
+    return;
+  }
+  const uint16_t defaultGapMs = cmd["gapMs"] | static_cast<uint16_t>(0);
+
+  // Resolve every step before queuing anything.
+  DeviceController *targets[kMaxSteps];
+  size_t slots = 0;
+  int index = 0;
+  for (JsonVariantConst step : steps) {
+    DeviceController *target = controller;
+    const char *device = step["device"].as<const char *>();
+    if (device != nullptr && device[0] != '\0' &&
+        strcasecmp(device, "null") != 0) {
+      target = devices.find(device);
+    }
+    const char *command = step["cmd"].as<const char *>();
+    if (command != nullptr ? strcasecmp(command, "batch") == 0
+                           : KeyIds::isBlank(keyOf(step))) {
+      refuse(result, "bad_step", index);
+      return;
+    }
+    if (target == nullptr) {
+      refuse(result, "unknown_device", index);
+      return;
+    }
+    targets[index++] = target;
+    // A key press is one frame; a command takes what its controller says,
+    // plus a separate pause job for its gap.
+    const uint16_t gapMs = step["gapMs"] | defaultGapMs;
+    const size_t perRun =
+        command == nullptr
+            ? 1
+            : target->irSlotsFor(step.as<JsonObjectConst>()) + (gapMs > 0);
+    slots += repeatOf(step) * perRun;
+  }
+  if (slots > ir.freeSlots()) {
+    refuse(result, "queue_full", -1);
+    return;
+  }
+
+  result.steps = static_cast<uint8_t>(index);
+  const uint32_t droppedBefore = ir.dropped();
+  index = 0;
+  for (JsonVariantConst step : steps) {
+    DeviceController *target = targets[index];
+    Metrics::DeviceCounters &counters = target->metrics();
+    const uint8_t repeat = repeatOf(step);
+    const uint16_t gapMs = step["gapMs"] | defaultGapMs;
+    const uint32_t framesBefore = ir.enqueued();
+    bool changed = false;
+    if (const char *keyName = keyOf(step)) {
+      ++counters.commands;
+      target->sendKeyPresses(keyName, repeat, gapMs);
+    } else {
+      for (uint8_t i = 0; i < repeat; ++i) {
+        ++counters.commands;
+        stateDoc.clear();
+        changed |= target->handleCommand(step.as<JsonObjectConst>(), stateDoc);
+        // Coalesced A/C state goes out here, in its place in the sequence.
+        changed |= target->flush();
+        if (gapMs > 0) ir.pause(gapMs);
+      }
+    }
+    const uint32_t frames = ir.enqueued() - framesBefore;
+    counters.irFrames += frames;
+    result.frames += frames;
+    if (changed) result.changed |= 1u << devices.indexOf(target);
+    if (frames > 0 || changed) {
+      ++result.ok;
+    } else {
+      result.failed |= 1u << index;
+    }
+    ++index;
+  }
+  result.dropped = static_cast<uint16_t>(ir.dropped() - droppedBefore);
+  LOG_D("[BATCH] %u/%u steps ok, %u frames", result.ok, result.steps,
+        result.frames);
+}
+
+void toJson(const Result &result, JsonObject out) {
+  if (result.error != nullptr) {
+    out["error"] = result.error;
+    if (result.errorStep >= 0) out["step"] = result.errorStep;
+    return;
+  }
+  out["steps"] = result.steps;
+  out["ok"] = result.ok;
+  out["frames"] = result.frames;
+  out["dropped"] = result.dropped;
+  JsonArray failed = out["failed"].to<JsonArray>();
+  for (uint8_t i = 0; i < result.steps; ++i) {
+    if (result.failed & (1u << i)) failed.add(i);
+  }
+}
+
+}  // namespace CommandBatch
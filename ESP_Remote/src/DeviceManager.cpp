@@ -1,27 +1,90 @@
 #include "DeviceManager.h"
 
+#include <string.h>
+
+#include "Log.h"
+#include "PerfectHash.h"
+
+namespace {
+
+constexpr uint32_t kHashSeed = 0;
+
+uint32_t hashName(const char *name) {
+  return PerfectHash::hashText(name, kHashSeed);
+}
+
+}  // namespace
+
+void DeviceManager::setTopicPrefix(const char *topicPrefix) {
+  topicPrefix_ = topicPrefix;
+}
+
 void DeviceManager::registerController(DeviceController &controller) {
-  if (controllerCount_ >= kMaxControllers) {
-    Serial.println(F("[DEVICE] Too many controllers registered"));
-    return;
+  for (const auto &registered : controllers_) {
+    if (registered.controller == &controller) return;
   }
-  controllers_[controllerCount_++] = &controller;
+  controllers_.push_back({&controller, hashName(controller.deviceType())});
+  const String suffix = String(controller.deviceType()) + "/cmd";
+  addRoute(suffix.c_str(), TopicRoute::kCommand, &controller);
 }
 
-void DeviceManager::begin() {
-  for (size_t i = 0; i < controllerCount_; ++i) {
-    if (controllers_[i] != nullptr) {
-      controllers_[i]->begin();
+void DeviceManager::addRoute(const char *suffix, TopicRoute route,
+                             DeviceController *controller) {
+  const uint32_t hash = hashName(suffix);
+  for (const auto &existing : routes_) {
+    if (existing.suffixHash == hash &&
+        PerfectHash::equalsFolded(existing.topic.c_str() + topicPrefix_.length(),
+                                  suffix)) {
+      LOG_W("[DEVICE] Duplicate route %s", suffix);
+      return;
     }
   }
+  routes_.push_back({topicPrefix_ + suffix, hash, route, controller});
 }
 
-DeviceController *DeviceManager::find(const String &deviceType) {
-  for (size_t i = 0; i < controllerCount_; ++i) {
-    if (controllers_[i] == nullptr) continue;
-    if (deviceType.equalsIgnoreCase(controllers_[i]->deviceType())) {
-      return controllers_[i];
+void DeviceManager::begin() {
+  for (const auto &registered : controllers_) {
+    registered.controller->begin();
+  }
+}
+
+DeviceController *DeviceManager::find(const char *deviceType) {
+  if (deviceType == nullptr || deviceType[0] == '\0') return nullptr;
+  const uint32_t hash = hashName(deviceType);
+  for (const auto &registered : controllers_) {
+    if (registered.typeHash == hash &&
+        PerfectHash::equalsFolded(deviceType,
+                                  registered.controller->deviceType())) {
+      return registered.controller;
     }
   }
   return nullptr;
-}
\ No newline at end of file
+}
+
+int DeviceManager::indexOf(const DeviceController *controller) const {
+  for (size_t i = 0; i < controllers_.size(); ++i) {
+    if (controllers_[i].controller == controller) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+TopicMatch DeviceManager::route(const char *topic) const {
+  TopicMatch match;
+  const size_t prefixLength = topicPrefix_.length();
+  if (topic == nullptr ||
+      strncmp(topic, topicPrefix_.c_str(), prefixLength) != 0) {
+    return match;
+  }
+  const char *suffix = topic + prefixLength;
+  const uint32_t hash = hashName(suffix);
+  for (const auto &candidate : routes_) {
+    if (candidate.suffixHash == hash &&
+        PerfectHash::equalsFolded(candidate.topic.c_str() + prefixLength,
+                                  suffix)) {
+      match.route = candidate.route;
+      match.controller = candidate.controller;
+      return match;
+    }
+  }
+  return match;
+}
@@ -2,18 +2,57 @@
 
 #include <IRutils.h>
 
+#include "Config.h"
+#include "IrWaveform.h"
+#include "Log.h"
+
 IrLearner::IrLearner(uint8_t recvPin)
     : recvPin_(recvPin), receiver_(recvPin, kCaptureBuffer, kTimeoutMs, true) {}
 
 void IrLearner::begin() {
+  if (task_ != nullptr) return;
+  if (xTaskCreatePinnedToCore(taskEntry, "ir_rx", IR_RX_TASK_STACK_BYTES, this,
+                              kTaskPriority, &task_,
+                              IR_TASK_CORE) != pdPASS) {
+    LOG_E("[IR][LEARN] Failed to start task");
+    task_ = nullptr;
+  }
+}
+
+void IrLearner::loop() {
+  IrLearningResult result;
+  while (finished_.pop(result)) {
+    if (callback_ != nullptr) callback_(result);
+  }
+}
+
+uint32_t IrLearner::taskStackFree() const {
+  return task_ != nullptr ? uxTaskGetStackHighWaterMark(task_) : 0;
+}
+
+void IrLearner::taskEntry(void *arg) {
+  static_cast<IrLearner *>(arg)->run();
+}
+
+void IrLearner::run() {
   receiver_.enableIRIn();
   receiver_.setUnknownThreshold(12);  // thu cả gói dài, tránh decode rút gọn
   ready_ = true;
-  Serial.printf("[IR][LEARN] Ready (receiver pin=%u)\n", recvPin_);
+  LOG_I("[IR][LEARN] Ready (receiver pin=%u core=%u)", recvPin_,
+        static_cast<unsigned>(IR_TASK_CORE));
+
+  Request request;
+  for (;;) {
+    // Idle until startLearning() notifies; while capturing, poll the decoder.
+    ulTaskNotifyTake(pdTRUE, learning_ ? pdMS_TO_TICKS(IR_RX_POLL_MS)
+                                       : portMAX_DELAY);
+    while (requests_.pop(request)) accept(request);
+    poll();
+  }
 }
 
-void IrLearner::loop() {
-  if (!ready_ || !learning_) {
+void IrLearner::poll() {
+  if (!learning_) {
     return;
   }
 
@@ -29,8 +68,23 @@ void IrLearner::loop() {
     if (code.startsWith("0x") || code.startsWith("0X")) code = code.substring(2);
     code.toUpperCase();
     const uint16_t nbytes = (results_.bits + 7) / 8;
+    // A/C frames also keep the capture, so they can be replayed without
+    // IRsend encoding the state again on every press.
+    std::vector<uint8_t> timing;
+    if (results_.bits > 64 && !results_.overflow && results_.rawlen > 1) {
+      std::vector<uint32_t> captured;
+      captured.reserve(results_.rawlen - 1);
+      for (uint16_t i = 1; i < results_.rawlen; ++i) {  // [0] is the gap before
+        captured.push_back(static_cast<uint32_t>(results_.rawbuf[i]) *
+                           kRawTick);
+      }
+      if (!IrWaveform::pack(captured, timing)) {
+        LOG_D("[IR][LEARN] Capture too irregular to keep (%u durations)",
+              static_cast<unsigned>(captured.size()));
+      }
+    }
     emitResult(true, nullptr, protocol, code, results_.bits, results_.state,
-               nbytes);
+               nbytes, std::move(timing));
     receiver_.resume();
     reset();
     return;
@@ -52,35 +106,43 @@ bool IrLearner::startLearning(const String &device, const String &key,
     errorOut = "missing_key";
     return false;
   }
-  if (learning_) {
+  if (learning_ || !requests_.push(Request{device, key})) {
     errorOut = "busy";
     return false;
   }
+  xTaskNotifyGive(task_);
+  return true;
+}
+
+void IrLearner::accept(Request &request) {
+  if (learning_) {
+    IrLearningResult busy;
+    busy.device = request.device;
+    busy.key = request.key;
+    busy.error = "busy";
+    finished_.push(std::move(busy));
+    return;
+  }
 
-  device_ = device;
+  device_ = request.device;
   if (device_.length() == 0) {
     device_ = "GENERIC";
   }
   device_.toUpperCase();
 
-  key_ = key;
+  key_ = request.key;
   key_.toUpperCase();
 
   learning_ = true;
   startTime_ = millis();
   receiver_.resume();
-  Serial.printf("[IR][LEARN] Waiting for %s/%s\n", device_.c_str(),
-                key_.c_str());
-  return true;
+  LOG_I("[IR][LEARN] Waiting for %s/%s", device_.c_str(), key_.c_str());
 }
 
 void IrLearner::emitResult(bool success, const char *error,
                            const String &protocol, const String &code,
-                           uint16_t bits, const uint8_t *raw, uint16_t nbytes) {
-  if (callback_ == nullptr) {
-    return;
-  }
-
+                           uint16_t bits, const uint8_t *raw, uint16_t nbytes,
+                           std::vector<uint8_t> timing) {
   IrLearningResult result;
   result.success = success;
   result.device = device_;
@@ -92,11 +154,14 @@ void IrLearner::emitResult(bool success, const char *error,
     if (raw != nullptr && nbytes > 0) {
       result.raw.assign(raw, raw + nbytes);
     }
+    result.timing = std::move(timing);
   } else if (error != nullptr) {
     result.error = error;
   }
 
-  callback_(result);
+  if (!finished_.push(std::move(result))) {
+    LOG_W("[IR][LEARN] Result queue full, dropping %s", key_.c_str());
+  }
 }
 
 void IrLearner::reset() {
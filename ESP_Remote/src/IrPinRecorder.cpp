@@ -0,0 +1,124 @@
+#include "IrPinRecorder.h"
+
+namespace {
+
+// Longest LED-off time still inside a mark: a carrier period plus interrupt
+// jitter. Spaces of the A/C protocols IRac drives are 300 us or more.
+constexpr uint32_t kCarrierGapUs = 200;
+// Hitachi's 424-bit frame, the longest IRac sends, is about 860 durations.
+constexpr size_t kMaxDurations = 1024;
+constexpr uint8_t kIdle = 0xFF;
+
+// Written by the recording task only; the hook runs inside its
+// digitalWrite() calls.
+volatile uint8_t recordPin = kIdle;
+uint8_t onLevel = HIGH;
+uint16_t durations[kMaxDurations];  // us, clamped to 65535
+size_t count = 0;
+bool overflow = false;
+bool lit = false;
+uint32_t edges = 0;  // LED switched on
+uint32_t marks = 0;  // closed marks
+uint32_t firstOnUs = 0;
+uint32_t markStartUs = 0;
+uint32_t lastOnUs = 0;
+uint32_t lastOffUs = 0;
+uint32_t onTimeUs = 0;      // LED lit, summed over all carrier cycles
+uint32_t cycleSpanUs = 0;   // first to last switch-on, summed over marks
+
+void IRAM_ATTR push(uint32_t us) {
+  if (count >= kMaxDurations) {
+    overflow = true;
+    return;
+  }
+  durations[count++] =
+      static_cast<uint16_t>(us > UINT16_MAX ? UINT16_MAX : us);
+}
+
+void IRAM_ATTR closeMark() {
+  push(lastOffUs - markStartUs);
+  cycleSpanUs += lastOnUs - markStartUs;
+  ++marks;
+}
+
+#ifdef ESP_PLATFORM
+void IRAM_ATTR recordEdge(uint8_t value) {
+  const uint32_t now = micros();
+  const bool on = value == onLevel;
+  if (on == lit) return;
+  lit = on;
+  if (!on) {
+    onTimeUs += now - lastOnUs;
+    lastOffUs = now;
+    return;
+  }
+  if (edges++ == 0) {
+    firstOnUs = now;
+    markStartUs = now;
+  } else if (now - lastOffUs > kCarrierGapUs) {
+    closeMark();
+    push(now - lastOffUs);
+    markStartUs = now;
+  }
+  lastOnUs = now;
+}
+#endif
+
+}  // namespace
+
+#ifdef ESP_PLATFORM
+extern "C" {
+void __digitalWrite(uint8_t pin, uint8_t val);
+
+// Replaces the core's weak alias of __digitalWrite(); see the header.
+void IRAM_ATTR digitalWrite(uint8_t pin, uint8_t val) {
+  __digitalWrite(pin, val);
+  if (pin == recordPin) recordEdge(val);
+}
+}
+#endif
+
+namespace IrPinRecorder {
+
+bool start(uint8_t pin, uint8_t level) {
+  if (recordPin != kIdle || pin == kIdle) return false;
+  onLevel = level;
+  count = 0;
+  overflow = false;
+  lit = false;
+  edges = 0;
+  marks = 0;
+  onTimeUs = 0;
+  cycleSpanUs = 0;
+  recordPin = pin;
+  return true;
+}
+
+bool finish(IrPulseTrain &out, uint32_t *firstEdgeUs) {
+  const uint32_t now = micros();
+  recordPin = kIdle;
+  out.durations.clear();
+  if (firstEdgeUs != nullptr) *firstEdgeUs = edges > 0 ? firstOnUs : 0;
+  // IRsend always ends a frame with the LED off.
+  if (edges == 0 || lit) return false;
+  closeMark();
+  push(now - lastOffUs);
+  if (overflow) return false;
+
+  out.durations.assign(durations, durations + count);
+  out.durations.back() = now - lastOffUs;  // may be over 65535 us
+  // Without modulation every mark is a single switch-on and there is no
+  // carrier to measure; the RMT then sends plain marks as well.
+  out.carrierHz = 38000;
+  out.dutyPercent = 50;
+  if (edges > marks && cycleSpanUs > 0) {
+    const uint64_t hz = (edges - marks) * 1000000ULL / cycleSpanUs;
+    out.carrierHz = static_cast<uint32_t>((hz + 50) / 100 * 100);
+    const uint64_t duty = 100ULL * onTimeUs * hz / 1000000ULL / edges;
+    out.dutyPercent =
+        static_cast<uint8_t>(duty < 1 ? 1 : duty > 99 ? 99 : duty);
+  }
+  return true;
+}
+
+}  // namespace IrPinRecorder
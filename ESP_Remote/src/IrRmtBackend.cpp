@@ -0,0 +1,133 @@
+#include "IrRmtBackend.h"
+
+#include "Config.h"
+#include "Log.h"
+
+namespace {
+// APB clock / 80 = 1 tick per microsecond, so pulse durations map 1:1.
+constexpr uint8_t kClockDivider = 80;
+constexpr uint32_t kSourceClockHz = 80000000UL;
+constexpr uint32_t kMaxItemDuration = 0x7FFF;  // 15-bit duration field
+constexpr uint8_t kMemBlocks = 2;
+
+void pushSpace(std::vector<rmt_item32_t> &items, uint32_t us) {
+  // The previous item is a mark with an open second half, fill that first.
+  if (!items.empty() && items.back().duration1 == 0 &&
+      items.back().level0 == 1) {
+    const uint32_t chunk = us > kMaxItemDuration ? kMaxItemDuration : us;
+    items.back().duration1 = chunk;
+    items.back().level1 = 0;
+    us -= chunk;
+  }
+  while (us > 0) {
+    // A zero duration marks the end of the stream, so both halves of a
+    // space-only item must be non-zero.
+    rmt_item32_t item = {};
+    const uint32_t take = us > 2 * kMaxItemDuration ? 2 * kMaxItemDuration : us;
+    us -= take;
+    uint32_t first = take / 2;
+    const uint32_t second = take - first;
+    if (first == 0) first = 1;
+    item.duration0 = first;
+    item.level0 = 0;
+    item.duration1 = second;
+    item.level1 = 0;
+    items.push_back(item);
+  }
+}
+
+void pushMark(std::vector<rmt_item32_t> &items, uint32_t us) {
+  while (us > 0) {
+    rmt_item32_t item = {};
+    const uint32_t chunk = us > kMaxItemDuration ? kMaxItemDuration : us;
+    us -= chunk;
+    item.duration0 = chunk;
+    item.level0 = 1;
+    item.duration1 = 0;
+    item.level1 = 0;
+    if (us > 0) {
+      // Marks longer than one half-item continue in the second half.
+      const uint32_t rest = us > kMaxItemDuration ? kMaxItemDuration : us;
+      item.duration1 = rest;
+      item.level1 = 1;
+      us -= rest;
+    }
+    items.push_back(item);
+  }
+}
+}  // namespace
+
+IrRmtBackend::IrRmtBackend(uint8_t pin, rmt_channel_t channel)
+    : pin_(pin), channel_(channel) {}
+
+bool IrRmtBackend::begin() {
+  if (ready_) return true;
+
+  rmt_config_t config = RMT_DEFAULT_CONFIG_TX(static_cast<gpio_num_t>(pin_),
+                                              channel_);
+  config.clk_div = kClockDivider;
+  config.mem_block_num = kMemBlocks;
+  config.tx_config.carrier_en = IR_SEND_USE_MODULATION;
+  config.tx_config.carrier_freq_hz = 38000;
+  config.tx_config.carrier_duty_percent = 33;
+  config.tx_config.carrier_level = RMT_CARRIER_LEVEL_HIGH;
+  config.tx_config.idle_output_en = true;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+  if (rmt_config(&config) != ESP_OK ||
+      rmt_driver_install(channel_, 0, 0) != ESP_OK) {
+    LOG_W("[IR][RMT] Failed to install driver, using IRsend");
+    return false;
+  }
+  carrierHz_ = config.tx_config.carrier_freq_hz;
+  dutyPercent_ = config.tx_config.carrier_duty_percent;
+  ready_ = true;
+  LOG_I("[IR][RMT] Ready (pin=%u channel=%d)", pin_,
+        static_cast<int>(channel_));
+  return true;
+}
+
+void IrRmtBackend::build(const IrPulseTrain &train, IrRmtFrame &out) {
+  out.carrierHz = train.carrierHz;
+  out.dutyPercent = train.dutyPercent;
+  out.items.clear();
+  out.trailingGapUs = 0;
+
+  size_t count = train.durations.size();
+  // The last space only separates this frame from the next one; the
+  // transmitter enforces it as quiet time instead of clocking it out.
+  if (count > 0 && count % 2 == 0) {
+    out.trailingGapUs = train.durations[count - 1];
+    --count;
+  }
+  out.items.reserve(count / 2 + 1);
+  for (size_t i = 0; i < count; ++i) {
+    if (i % 2 == 0) {
+      pushMark(out.items, train.durations[i]);
+    } else {
+      pushSpace(out.items, train.durations[i]);
+    }
+  }
+}
+
+bool IrRmtBackend::transmit(const IrRmtFrame &frame) {
+  if (!ready_ || frame.items.empty()) return false;
+
+  rmt_set_gpio(channel_, RMT_MODE_TX, static_cast<gpio_num_t>(pin_),
+               IR_SEND_INVERTED);
+  applyCarrier(frame.carrierHz, frame.dutyPercent);
+  return rmt_write_items(channel_, frame.items.data(),
+                         static_cast<int>(frame.items.size()),
+                         /*wait_tx_done=*/true) == ESP_OK;
+}
+
+void IrRmtBackend::applyCarrier(uint32_t carrierHz, uint8_t dutyPercent) {
+  if (carrierHz == carrierHz_ && dutyPercent == dutyPercent_) return;
+  const uint32_t period = kSourceClockHz / carrierHz;
+  const uint16_t high = static_cast<uint16_t>(period * dutyPercent / 100);
+  const uint16_t low = static_cast<uint16_t>(period - high);
+  rmt_set_tx_carrier(channel_, IR_SEND_USE_MODULATION, high, low,
+                     RMT_CARRIER_LEVEL_HIGH);
+  carrierHz_ = carrierHz;
+  dutyPercent_ = dutyPercent;
+}
@@ -0,0 +1,346 @@
+#include "IrTransmitter.h"
+
+#include <cstring>
+
+#include "IrPinRecorder.h"
+#include "Log.h"
+#include "Trace.h"
+
+namespace {
+template <typename T>
+auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
+  obj.begin();
+}
+
+template <typename T>
+void tryBegin(T &, ...) {}
+}  // namespace
+
+IrTransmitter::IrTransmitter(uint8_t irPin)
+    : irPin_(irPin),
+      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION),
+      irAc_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION),
+      rmt_(irPin, static_cast<rmt_channel_t>(IR_TX_RMT_CHANNEL)) {}
+
+void IrTransmitter::begin() {
+  if (task_ != nullptr) return;
+
+  tryBegin(irSend_, 0);
+  tryBegin(irAc_, 0);
+
+  if (xTaskCreatePinnedToCore(taskEntry, "ir_tx", kTaskStackBytes, this,
+                              kTaskPriority, &task_,
+                              IR_TASK_CORE) != pdPASS) {
+    LOG_E("[IR][TX] Failed to start task");
+    task_ = nullptr;
+    return;
+  }
+  LOG_I("[IR][TX] Ready (pin=%u depth=%u core=%u)", irPin_,
+        static_cast<unsigned>(IR_TX_QUEUE_DEPTH),
+        static_cast<unsigned>(IR_TASK_CORE));
+}
+
+bool IrTransmitter::sendValue(decode_type_t protocol, uint64_t value,
+                              uint16_t nbits, uint16_t gapAfterMs) {
+  IrTransmitJob job;
+  job.kind = IrTransmitJob::Kind::kValue;
+  job.protocol = protocol;
+  job.value = value;
+  job.nbits = nbits;
+  job.gapAfterMs = gapAfterMs;
+  return enqueue(job);
+}
+
+bool IrTransmitter::sendState(decode_type_t protocol, const uint8_t *state,
+                              uint16_t nbytes, uint8_t repeat,
+                              uint16_t repeatGapMs, uint16_t gapAfterMs,
+                              std::shared_ptr<const std::vector<uint8_t>>
+                                  timing) {
+  if (state == nullptr || nbytes == 0 || nbytes > kStateSizeMax) {
+    LOG_W("[IR][TX] Rejected state frame (%u bytes)", nbytes);
+    return false;
+  }
+  IrTransmitJob job;
+  job.kind = IrTransmitJob::Kind::kState;
+  job.protocol = protocol;
+  job.nbytes = nbytes;
+  memcpy(job.state, state, nbytes);
+  job.repeat = repeat == 0 ? 1 : repeat;
+  job.repeatGapMs = repeatGapMs;
+  job.gapAfterMs = gapAfterMs;
+  job.timing = std::move(timing);
+  return enqueue(job);
+}
+
+bool IrTransmitter::sendAc(const stdAc::state_t &state) {
+  IrTransmitJob job;
+  job.kind = IrTransmitJob::Kind::kAc;
+  job.protocol = state.protocol;
+  job.ac = state;
+  return enqueue(job);
+}
+
+bool IrTransmitter::pause(uint16_t ms) {
+  IrTransmitJob job;
+  job.kind = IrTransmitJob::Kind::kPause;
+  job.gapAfterMs = ms;
+  return enqueue(job);
+}
+
+IrTransmitter::Stats IrTransmitter::stats() const {
+  Stats out;
+  out.enqueued = enqueued_;
+  out.dropped = dropped_;
+  out.sent = sent_;
+  out.depth = static_cast<uint16_t>(queue_.size());
+  out.peakDepth = peakDepth_;
+  out.lastWaitMs = lastWaitMs_;
+  out.maxWaitMs = maxWaitMs_;
+  out.totalWaitMs = totalWaitMs_;
+  out.lastStartUs = lastStartUs_;
+  out.rmtFrames = rmtFrames_;
+  out.frameCacheMisses = frameCacheMisses_;
+  out.frameCacheSize = frameCacheSize_;
+  out.stateFrameMisses = stateFrameMisses_;
+  out.stateCacheBytes = stateCacheBytes_;
+  out.acMemoHits = acMemoHits_;
+  out.acMemoMisses = acMemoMisses_;
+  out.acMemoBytes = acMemoBytes_;
+  out.taskStackFree =
+      task_ != nullptr ? uxTaskGetStackHighWaterMark(task_) : 0;
+  return out;
+}
+
+bool IrTransmitter::enqueue(IrTransmitJob &job) {
+  if (task_ == nullptr) {
+    ++dropped_;
+    return false;
+  }
+  job.enqueuedAtMs = millis();
+  // Recorded before the push so the TX task's ir_start cannot precede it.
+  Trace::record(Trace::Event::kIrQueued, static_cast<uint8_t>(job.kind),
+                static_cast<uint16_t>(queue_.size()));
+  // Never block the caller: a full queue means the LED is already saturated.
+  if (!queue_.push(job)) {
+    ++dropped_;
+    Trace::record(Trace::Event::kIrDropped, static_cast<uint8_t>(job.kind));
+    LOG_W("[IR][TX] Queue full, frame dropped");
+    return false;
+  }
+  xTaskNotifyGive(task_);
+  if (job.kind != IrTransmitJob::Kind::kPause) ++enqueued_;
+  const uint16_t depth = static_cast<uint16_t>(queue_.size());
+  if (depth > peakDepth_) peakDepth_ = depth;
+  return true;
+}
+
+void IrTransmitter::taskEntry(void *arg) {
+  static_cast<IrTransmitter *>(arg)->run();
+}
+
+void IrTransmitter::run() {
+  // Installed here rather than in begin() so the RMT interrupt is allocated
+  // on IR_TASK_CORE, away from the Wi-Fi interrupts.
+  if (IR_TX_USE_RMT) {
+    rmt_.begin();
+    pinOnRmt_ = rmt_.ready();
+  }
+
+  IrTransmitJob job;
+  for (;;) {
+    if (!queue_.pop(job)) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    if (job.kind == IrTransmitJob::Kind::kPause) {
+      // Stacks on the quiet time of the previous job, without blocking.
+      const uint32_t now = millis();
+      const uint32_t from =
+          static_cast<int32_t>(quietUntilMs_ - now) > 0 ? quietUntilMs_ : now;
+      quietUntilMs_ = from + job.gapAfterMs;
+      continue;
+    }
+
+    waitForQuietPeriod();
+
+    const uint32_t waitMs = millis() - job.enqueuedAtMs;
+    lastWaitMs_ = waitMs;
+    totalWaitMs_ += waitMs;
+    if (waitMs > maxWaitMs_) maxWaitMs_ = waitMs;
+
+    lastStartUs_ = micros();
+    Trace::record(Trace::Event::kIrStart, static_cast<uint8_t>(job.kind),
+                  static_cast<uint16_t>(job.protocol));
+    const uint32_t trailingMs = transmit(job);
+    Trace::record(Trace::Event::kIrEnd, static_cast<uint8_t>(job.kind),
+                  static_cast<uint16_t>(job.protocol));
+    ++sent_;
+    quietUntilMs_ = millis() + trailingMs + job.gapAfterMs;
+    job.timing.reset();  // don't pin a replaced recipe until the next job
+  }
+}
+
+uint32_t IrTransmitter::transmit(const IrTransmitJob &job) {
+  switch (job.kind) {
+    case IrTransmitJob::Kind::kValue: {
+      const IrRmtFrame *frame = rmtFrameFor(job);
+      if (frame != nullptr) {
+        pinOnRmt_ = true;
+        if (rmt_.transmit(*frame)) {
+          ++rmtFrames_;
+          return (frame->trailingGapUs + 999) / 1000;
+        }
+      }
+      claimPinForIrSend();
+      irSend_.send(job.protocol, job.value, job.nbits);
+      break;
+    }
+    case IrTransmitJob::Kind::kState: {
+      const IrRmtFrame *frame = stateFrameFor(job);
+      for (uint8_t i = 0; i < job.repeat; ++i) {
+        if (i > 0) {
+          quietUntilMs_ = millis() + job.repeatGapMs;
+          waitForQuietPeriod();
+        }
+        if (frame != nullptr) {
+          pinOnRmt_ = true;
+          if (rmt_.transmit(*frame)) {
+            ++rmtFrames_;
+            continue;
+          }
+          frame = nullptr;
+        }
+        claimPinForIrSend();
+        irSend_.send(job.protocol, job.state, job.nbytes);
+      }
+      if (frame != nullptr) return (frame->trailingGapUs + 999) / 1000;
+      break;
+    }
+    case IrTransmitJob::Kind::kAc:
+      return transmitAc(job.ac);
+    case IrTransmitJob::Kind::kPause:
+      break;
+  }
+  return 0;
+}
+
+const IrRmtFrame *IrTransmitter::rmtFrameFor(const IrTransmitJob &job) {
+  if (!rmt_.ready() || !IrWaveform::isSupported(job.protocol)) return nullptr;
+
+  const FrameKey key{job.protocol, job.nbits, job.value};
+  auto found = frameIndex_.find(key);
+  if (found != frameIndex_.end()) {
+    frameCache_.splice(frameCache_.begin(), frameCache_, found->second);
+    return &frameCache_.front().frame;
+  }
+
+  IrPulseTrain train;
+  if (!IrWaveform::encode(job.protocol, job.value, job.nbits, train)) {
+    return nullptr;
+  }
+  ++frameCacheMisses_;
+  if (frameCache_.size() >= IR_RMT_FRAME_CACHE_SIZE) {
+    frameIndex_.erase(frameCache_.back().key);
+    frameCache_.pop_back();
+  }
+  frameCache_.push_front({key, IrRmtFrame()});
+  frameIndex_[key] = frameCache_.begin();
+  IrRmtBackend::build(train, frameCache_.front().frame);
+  frameCacheSize_ = static_cast<uint16_t>(frameCache_.size());
+  return &frameCache_.front().frame;
+}
+
+const IrRmtFrame *IrTransmitter::stateFrameFor(const IrTransmitJob &job) {
+  if (!rmt_.ready() || job.timing == nullptr) return nullptr;
+
+  for (auto it = stateCache_.begin(); it != stateCache_.end(); ++it) {
+    if (it->recipe == job.timing) {
+      stateCache_.splice(stateCache_.begin(), stateCache_, it);
+      return &stateCache_.front().frame;
+    }
+  }
+
+  IrPulseTrain train;
+  if (!IrWaveform::unpack(job.timing->data(), job.timing->size(), train)) {
+    return nullptr;
+  }
+  ++stateFrameMisses_;
+  StateFrame entry;
+  entry.recipe = job.timing;
+  IrRmtBackend::build(train, entry.frame);
+  const size_t bytes = entry.frame.items.size() * sizeof(rmt_item32_t);
+  if (bytes > IR_STATE_FRAME_CACHE_BYTES) return nullptr;
+
+  size_t total = stateCacheBytes_ + bytes;
+  while (total > IR_STATE_FRAME_CACHE_BYTES) {
+    total -= stateCache_.back().frame.items.size() * sizeof(rmt_item32_t);
+    stateCache_.pop_back();
+  }
+  stateCache_.push_front(std::move(entry));
+  stateCacheBytes_ = static_cast<uint32_t>(total);
+  return &stateCache_.front().frame;
+}
+
+uint32_t IrTransmitter::transmitAc(const stdAc::state_t &state) {
+  const bool memo = AC_FRAME_MEMO_BYTES > 0 && rmt_.ready() &&
+                    AcFrameMemo::isMemoizable(state);
+  const stdAc::state_t prev = irAc_.getStatePrev();
+  if (memo) {
+    const IrRmtFrame *frame = acMemo_.find(state, prev);
+    const AcFrameMemo::Stats memoStats = acMemo_.stats();
+    acMemoHits_ = memoStats.hits;
+    acMemoMisses_ = memoStats.misses;
+    if (frame != nullptr) {
+      pinOnRmt_ = true;
+      if (rmt_.transmit(*frame)) {
+        ++rmtFrames_;
+        // Keeps IRac's previous state right for its toggles and our key.
+        irAc_.next = state;
+        irAc_.markAsSent();
+        return (frame->trailingGapUs + 999) / 1000;
+      }
+    }
+  }
+
+  // IRac builds a fresh protocol object per send and claims the pin itself.
+  pinOnRmt_ = false;
+  irAc_.next = state;
+  const bool recording =
+      memo && IrPinRecorder::start(irPin_, IR_SEND_INVERTED ? LOW : HIGH);
+  irAc_.sendAc();
+  if (!recording) return 0;
+
+  IrPulseTrain sent;
+  if (!IrPinRecorder::finish(sent)) return 0;
+  // Snap the recording to its timing levels, so interrupt jitter from this
+  // one send is not replayed forever. Too irregular: record it next time.
+  std::vector<uint8_t> recipe;
+  IrPulseTrain snapped;
+  if (!IrWaveform::pack(sent.durations, recipe, 0) ||
+      !IrWaveform::unpack(recipe.data(), recipe.size(), snapped)) {
+    return 0;
+  }
+  // Levels are u16; the gap after the frame is kept as measured.
+  snapped.durations.back() = sent.durations.back();
+  snapped.carrierHz = sent.carrierHz;
+  snapped.dutyPercent = sent.dutyPercent;
+  IrRmtFrame frame;
+  IrRmtBackend::build(snapped, frame);
+  acMemo_.store(state, prev, std::move(frame));
+  acMemoBytes_ = acMemo_.stats().bytes;
+  return 0;
+}
+
+void IrTransmitter::claimPinForIrSend() {
+  if (!pinOnRmt_) return;
+  // pinMode() in IRsend::begin() routes the pin back to the GPIO matrix.
+  tryBegin(irSend_, 0);
+  pinOnRmt_ = false;
+}
+
+void IrTransmitter::waitForQuietPeriod() {
+  const int32_t remaining = static_cast<int32_t>(quietUntilMs_ - millis());
+  if (remaining > 0) {
+    vTaskDelay(pdMS_TO_TICKS(remaining));
+  }
+}
@@ -0,0 +1,249 @@
+#include "IrWaveform.h"
+
+namespace IrWaveform {
+namespace {
+
+// Pulse-distance/pulse-width timings, mirrored from the IRremoteESP8266
+// ir_*.cpp sources (sendGeneric() arguments) so the output matches IRsend.
+struct GenericTiming {
+  decode_type_t protocol;
+  uint16_t hdrMark;
+  uint16_t hdrSpace;
+  uint16_t oneMark;
+  uint16_t oneSpace;
+  uint16_t zeroMark;
+  uint16_t zeroSpace;
+  uint16_t footerMark;
+  uint32_t minGap;
+  uint32_t minMessageLength;  // 0 = no fixed message length
+  uint32_t carrierHz;
+  uint8_t dutyPercent;
+  uint8_t frames;  // 1 + default repeats of IRsend::send()
+  // The header is sent before sendGeneric(), so minMessageLength only
+  // counts from the first data bit.
+  bool headerOutsideLength = false;
+};
+
+constexpr GenericTiming kTimings[] = {
+    // NEC: tick 560us, 193-tick minimum command length.
+    {decode_type_t::NEC, 8960, 4480, 560, 1680, 560, 560, 560, 22400, 108080,
+     38000, 33, 1},
+    // Samsung 32/12 bit: tick 560us, 8-tick header.
+    {decode_type_t::SAMSUNG, 4480, 4480, 560, 1680, 560, 560, 560, 26880,
+     108080, 38000, 33, 1},
+    // Sony SIRC: pulse-width, 40kHz, IRsend enforces kSonyMinRepeat (2).
+    {decode_type_t::SONY, 2400, 600, 1200, 600, 600, 600, 0, 10000, 45000,
+     40000, 33, 3},
+    // Panasonic/Kaseikyo 48 bit: tick 432us, 36.7kHz.
+    {decode_type_t::PANASONIC, 3456, 1728, 432, 1296, 432, 432, 432, 74736,
+     163296, 36700, 50, 1},
+    // JVC: tick 75us, 60ms repeat period; sendJVC() sends the header itself.
+    {decode_type_t::JVC, 8400, 4200, 525, 1725, 525, 525, 525, 10875, 60000,
+     38000, 33, 1, true},
+};
+
+const GenericTiming *findTiming(decode_type_t protocol) {
+  for (const auto &timing : kTimings) {
+    if (timing.protocol == protocol) return &timing;
+  }
+  return nullptr;
+}
+
+// Appends durations while keeping the mark/space alternation: consecutive
+// marks or spaces are merged, exactly like back-to-back mark()/space() calls
+// on a real pin.
+class Builder {
+ public:
+  explicit Builder(std::vector<uint32_t> &out) : out_(out) {}
+
+  void mark(uint32_t us) {
+    if (us == 0) return;
+    elapsed_ += us;
+    if (out_.size() % 2 == 1) {
+      out_.back() += us;
+    } else {
+      out_.push_back(us);
+    }
+  }
+
+  void space(uint32_t us) {
+    if (us == 0 || out_.empty()) return;
+    elapsed_ += us;
+    if (out_.size() % 2 == 0) {
+      out_.back() += us;
+    } else {
+      out_.push_back(us);
+    }
+  }
+
+  uint32_t elapsed() const { return elapsed_; }
+  void resetElapsed() { elapsed_ = 0; }
+
+ private:
+  std::vector<uint32_t> &out_;
+  uint32_t elapsed_ = 0;
+};
+
+// Captured frames: IRrecv stops recording at the silence after the last
+// mark. The carrier is not captured; 38 kHz is what IRsend uses for most
+// A/C protocols.
+constexpr uint32_t kCaptureGapUs = 40000;
+constexpr uint32_t kCaptureCarrierHz = 38000;
+constexpr uint8_t kCaptureDutyPercent = 50;
+constexpr size_t kMaxLevels = 16;
+constexpr uint32_t kMinToleranceUs = 150;
+
+struct Level {
+  uint32_t sum;
+  uint32_t count;
+  uint32_t mean() const { return sum / count; }
+};
+
+// Index of the nearest level within 12.5% (at least kMinToleranceUs) of
+// `us`, adding one if there is none; -1 once all kMaxLevels are taken. The
+// tolerance is kept tight because A/C headers and data spaces can be close.
+int levelFor(std::vector<Level> &levels, uint32_t us) {
+  int best = -1;
+  uint32_t bestDistance = UINT32_MAX;
+  for (size_t i = 0; i < levels.size(); ++i) {
+    const uint32_t mean = levels[i].mean();
+    const uint32_t tolerance =
+        mean / 8 > kMinToleranceUs ? mean / 8 : kMinToleranceUs;
+    const uint32_t distance = us > mean ? us - mean : mean - us;
+    if (distance <= tolerance && distance < bestDistance) {
+      best = static_cast<int>(i);
+      bestDistance = distance;
+    }
+  }
+  if (best >= 0) {
+    levels[best].sum += us;
+    ++levels[best].count;
+    return best;
+  }
+  if (levels.size() >= kMaxLevels) return -1;
+  levels.push_back({us, 1});
+  return static_cast<int>(levels.size() - 1);
+}
+
+void putLevel(std::vector<uint8_t> &out, int64_t us) {
+  const uint16_t value =
+      static_cast<uint16_t>(us < 1 ? 1 : us > UINT16_MAX ? UINT16_MAX : us);
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+uint16_t getU16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+}  // namespace
+
+bool isSupported(decode_type_t protocol) {
+  return findTiming(protocol) != nullptr;
+}
+
+bool encode(decode_type_t protocol, uint64_t value, uint16_t nbits,
+            IrPulseTrain &out) {
+  out.durations.clear();
+  const GenericTiming *timing = findTiming(protocol);
+  if (timing == nullptr || nbits == 0 || nbits > 64) return false;
+
+  out.carrierHz = timing->carrierHz;
+  out.dutyPercent = timing->dutyPercent;
+  out.durations.reserve(timing->frames * (2 * nbits + 4));
+
+  Builder frame(out.durations);
+  for (uint8_t f = 0; f < timing->frames; ++f) {
+    frame.resetElapsed();
+    frame.mark(timing->hdrMark);
+    frame.space(timing->hdrSpace);
+    if (timing->headerOutsideLength) frame.resetElapsed();
+    for (uint16_t bit = nbits; bit > 0; --bit) {  // MSB first
+      if ((value >> (bit - 1)) & 1ULL) {
+        frame.mark(timing->oneMark);
+        frame.space(timing->oneSpace);
+      } else {
+        frame.mark(timing->zeroMark);
+        frame.space(timing->zeroSpace);
+      }
+    }
+    frame.mark(timing->footerMark);
+
+    const uint32_t elapsed = frame.elapsed();
+    uint32_t gap = timing->minGap;
+    if (timing->minMessageLength > elapsed + gap) {
+      gap = timing->minMessageLength - elapsed;
+    }
+    frame.space(gap);
+  }
+  return true;
+}
+
+bool pack(const std::vector<uint32_t> &capturedUs,
+          std::vector<uint8_t> &recipe, uint32_t markExcessUs) {
+  recipe.clear();
+  const size_t pairs = (capturedUs.size() + 1) / 2;
+  if (pairs == 0 || pairs > UINT16_MAX) return false;
+
+  std::vector<Level> marks;
+  std::vector<Level> spaces;
+  std::vector<uint8_t> symbols(pairs, 0);
+  for (size_t i = 0; i < capturedUs.size(); ++i) {
+    const bool mark = i % 2 == 0;
+    const int level = levelFor(mark ? marks : spaces, capturedUs[i]);
+    if (level < 0) return false;
+    symbols[i / 2] |= static_cast<uint8_t>(mark ? level << 4 : level);
+  }
+  if (capturedUs.size() % 2 == 1) {
+    const int level = levelFor(spaces, kCaptureGapUs);
+    if (level < 0) return false;
+    symbols.back() |= static_cast<uint8_t>(level);
+  }
+
+  recipe.reserve(2 + 2 * (marks.size() + spaces.size()) + 2 + pairs);
+  recipe.push_back(static_cast<uint8_t>(marks.size()));
+  recipe.push_back(static_cast<uint8_t>(spaces.size()));
+  for (const Level &level : marks) {
+    putLevel(recipe, static_cast<int64_t>(level.mean()) - markExcessUs);
+  }
+  for (const Level &level : spaces) {
+    putLevel(recipe, static_cast<int64_t>(level.mean()) + markExcessUs);
+  }
+  recipe.push_back(static_cast<uint8_t>(pairs));
+  recipe.push_back(static_cast<uint8_t>(pairs >> 8));
+  recipe.insert(recipe.end(), symbols.begin(), symbols.end());
+  return true;
+}
+
+bool unpack(const uint8_t *recipe, size_t length, IrPulseTrain &out) {
+  out.durations.clear();
+  if (recipe == nullptr || length < 2) return false;
+  const uint8_t markLevels = recipe[0];
+  const uint8_t spaceLevels = recipe[1];
+  const size_t header = 2 + 2 * (markLevels + spaceLevels) + 2;
+  if (markLevels == 0 || spaceLevels == 0 || markLevels > kMaxLevels ||
+      spaceLevels > kMaxLevels || length < header) {
+    return false;
+  }
+  const uint16_t pairs = getU16(recipe + header - 2);
+  if (length != header + pairs) return false;
+
+  out.carrierHz = kCaptureCarrierHz;
+  out.dutyPercent = kCaptureDutyPercent;
+  out.durations.reserve(2 * pairs);
+  const uint8_t *levels = recipe + 2;
+  const uint8_t *symbols = recipe + header;
+  for (uint16_t i = 0; i < pairs; ++i) {
+    const uint8_t mark = symbols[i] >> 4;
+    const uint8_t space = symbols[i] & 0x0F;
+    if (mark >= markLevels || space >= spaceLevels) {
+      out.durations.clear();
+      return false;
+    }
+    out.durations.push_back(getU16(levels + 2 * mark));
+    out.durations.push_back(getU16(levels + 2 * (markLevels + space)));
+  }
+  return true;
+}
+
+}  // namespace IrWaveform
@@ -0,0 +1,97 @@
+#include "JsonArena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+constexpr size_t kAlignment = 8;
+}  // namespace
+
+JsonArena::JsonArena(uint8_t *buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity) {}
+
+size_t JsonArena::alignUp(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+bool JsonArena::owns(const void *ptr) const {
+  const uint8_t *p = static_cast<const uint8_t *>(ptr);
+  return p >= buffer_ && p < buffer_ + capacity_;
+}
+
+JsonArena::Header *JsonArena::headerOf(void *ptr) const {
+  return reinterpret_cast<Header *>(static_cast<uint8_t *>(ptr) -
+                                    alignUp(sizeof(Header)));
+}
+
+void *JsonArena::allocate(size_t size) {
+  ++allocations_;
+  const size_t header = alignUp(sizeof(Header));
+  const size_t need = header + alignUp(size);
+  if (need > capacity_ - used_) {
+    ++heapFallbacks_;
+    return malloc(size);
+  }
+  Header *block = reinterpret_cast<Header *>(buffer_ + used_);
+  block->size = size;
+  last_ = used_;
+  used_ += need;
+  if (used_ > peak_) peak_ = used_;
+  ++live_;
+  return buffer_ + last_ + header;
+}
+
+void JsonArena::deallocate(void *ptr) {
+  if (ptr == nullptr) return;
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+  const size_t offset =
+      reinterpret_cast<uint8_t *>(headerOf(ptr)) - buffer_;
+  if (offset == last_) {
+    used_ = last_;  // give back the tail so a rebuilt string can reuse it
+    last_ = SIZE_MAX;
+  }
+  if (live_ > 0) --live_;
+  if (live_ == 0) {
+    used_ = 0;
+    last_ = SIZE_MAX;
+  }
+}
+
+void *JsonArena::reallocate(void *ptr, size_t newSize) {
+  if (ptr == nullptr) return allocate(newSize);
+  if (!owns(ptr)) return realloc(ptr, newSize);
+
+  Header *block = headerOf(ptr);
+  const size_t offset = reinterpret_cast<uint8_t *>(block) - buffer_;
+  const size_t header = alignUp(sizeof(Header));
+  // The string builder grows its buffer one reallocation at a time; when it
+  // is the newest block it can simply grow or shrink in place.
+  if (offset == last_ &&
+      header + alignUp(newSize) <= capacity_ - offset) {
+    block->size = newSize;
+    used_ = offset + header + alignUp(newSize);
+    if (used_ > peak_) peak_ = used_;
+    return ptr;
+  }
+  if (newSize <= block->size) {
+    block->size = newSize;
+    return ptr;
+  }
+  void *moved = allocate(newSize);
+  if (moved == nullptr) return nullptr;
+  memcpy(moved, ptr, block->size);
+  deallocate(ptr);
+  return moved;
+}
+
+JsonArena::Stats JsonArena::stats() const {
+  Stats out;
+  out.allocations = allocations_;
+  out.heapFallbacks = heapFallbacks_;
+  out.peakBytes = peak_;
+  out.capacity = capacity_;
+  return out;
+}
@@ -0,0 +1,101 @@
+#include "KeyId.h"
+
+#include <string.h>
+#include <deque>
+
+namespace KeyIds {
+namespace {
+
+constexpr auto kBuiltinIndex = PerfectHash::buildNameIndex(kBuiltinNames);
+static_assert(kBuiltinIndex.complete,
+              "Built-in key names: no perfect-hash seed found");
+static_assert(kBuiltinCount ==
+                  sizeof(kBuiltinNames) / sizeof(kBuiltinNames[0]) + 1,
+              "KeyId values must match kBuiltinNames order");
+
+struct CustomName {
+  char text[kMaxNameLength + 1];
+};
+
+// Names interned at runtime, id = kFirstCustom + position. Append-only, and a
+// deque so the pointers handed out by name() survive later interning.
+std::deque<CustomName> &customNames() {
+  static std::deque<CustomName> names;
+  return names;
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}  // namespace
+
+bool normalize(const char *name, char (&out)[kMaxNameLength + 1]) {
+  out[0] = '\0';
+  if (name == nullptr) return false;
+  while (isSpace(*name)) ++name;
+  size_t length = strlen(name);
+  while (length > 0 && isSpace(name[length - 1])) --length;
+  if (length == 0 || length > kMaxNameLength) return false;
+  for (size_t i = 0; i < length; ++i) out[i] = PerfectHash::fold(name[i]);
+  out[length] = '\0';
+  return true;
+}
+
+bool isBlank(const char *name) {
+  if (name == nullptr) return true;
+  while (isSpace(*name)) ++name;
+  return *name == '\0';
+}
+
+KeyId findNormalized(const char *normalized) {
+  const KeyName *entry =
+      PerfectHash::findName(kBuiltinIndex, kBuiltinNames, normalized);
+  if (entry != nullptr) return entry->id;
+
+  const std::deque<CustomName> &names = customNames();
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (strcmp(names[i].text, normalized) == 0) {
+      return static_cast<KeyId>(static_cast<size_t>(KeyId::kFirstCustom) + i);
+    }
+  }
+  return KeyId::kNone;
+}
+
+KeyId find(const char *name) {
+  char normalized[kMaxNameLength + 1];
+  if (!normalize(name, normalized)) return KeyId::kNone;
+  return findNormalized(normalized);
+}
+
+KeyId internNormalized(const char *normalized) {
+  const KeyId existing = findNormalized(normalized);
+  if (existing != KeyId::kNone) return existing;
+
+  std::deque<CustomName> &names = customNames();
+  if (static_cast<size_t>(KeyId::kFirstCustom) + names.size() >= UINT16_MAX) {
+    return KeyId::kNone;
+  }
+  CustomName entry{};
+  strncpy(entry.text, normalized, kMaxNameLength);
+  names.push_back(entry);
+  return static_cast<KeyId>(static_cast<size_t>(KeyId::kFirstCustom) +
+                            names.size() - 1);
+}
+
+KeyId intern(const char *name) {
+  char normalized[kMaxNameLength + 1];
+  if (!normalize(name, normalized)) return KeyId::kNone;
+  return internNormalized(normalized);
+}
+
+const char *name(KeyId id) {
+  const size_t value = static_cast<size_t>(id);
+  if (id == KeyId::kNone) return "";
+  if (value < kBuiltinCount) return kBuiltinNames[value - 1].key;
+  const std::deque<CustomName> &names = customNames();
+  const size_t custom = value - kBuiltinCount;
+  return custom < names.size() ? names[custom].text : "";
+}
+
+}  // namespace KeyIds
@@ -0,0 +1,256 @@
+#include "LearnedKeyStore.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+
+#include "Config.h"
+#include "Crc32.h"
+#include "Log.h"
+
+namespace LearnedKeyStore {
+namespace {
+
+constexpr const char *kPrefsNamespace = "ir_learned";
+constexpr uint8_t kMagic0 = 'L';
+constexpr uint8_t kMagic1 = 'K';
+constexpr uint8_t kVersion = 2;
+constexpr uint8_t kVersionNoTiming = 1;
+constexpr size_t kHeaderSize = 10;
+
+class NvsBackend : public LearnedStoreBackend {
+ public:
+  bool read(const char *name, std::vector<uint8_t> &out) override {
+    if (!open()) return false;
+    const size_t length = prefs_.getBytesLength(name);
+    if (length == 0) return false;
+    out.resize(length);
+    return prefs_.getBytes(name, out.data(), length) == length;
+  }
+
+  bool write(const char *name, const uint8_t *data, size_t length) override {
+    if (!open()) return false;
+    return prefs_.putBytes(name, data, length) == length;
+  }
+
+  bool erase(const char *name) override {
+    return open() && prefs_.remove(name);
+  }
+
+ private:
+  bool open() {
+    if (!opened_) opened_ = prefs_.begin(kPrefsNamespace, false);
+    return opened_;
+  }
+
+  Preferences prefs_;
+  bool opened_ = false;
+};
+
+NvsBackend nvsBackend;
+LearnedStoreBackend *backend = &nvsBackend;
+std::vector<LearnedKeyTable *> tables;
+Stats counters;
+
+void putU16(std::vector<uint8_t> &out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+uint16_t getU16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t getU32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool writeTable(LearnedKeyTable &table) {
+  std::vector<uint8_t> blob;
+  encode(table.entries(), blob);
+  if (!backend->write(table.persistName(), blob.data(), blob.size())) {
+    ++counters.writeErrors;
+    LOG_E("[IR][STORE] Write failed for %s (%u bytes)",
+          table.persistName(), static_cast<unsigned>(blob.size()));
+    return false;
+  }
+  table.markClean();
+  ++counters.writes;
+  counters.lastWriteBytes = blob.size();
+  LOG_I("[IR][STORE] Saved %s: %u keys, %u bytes",
+        table.persistName(), static_cast<unsigned>(table.entries().size()),
+        static_cast<unsigned>(blob.size()));
+  return true;
+}
+
+}  // namespace
+
+void setBackend(LearnedStoreBackend *replacement) {
+  backend = replacement != nullptr ? replacement : &nvsBackend;
+}
+
+void track(LearnedKeyTable &table) {
+  for (const auto *tracked : tables) {
+    if (tracked == &table) return;
+  }
+  tables.push_back(&table);
+}
+
+bool load(const char *name, std::vector<LearnedKey> &out) {
+  out.clear();
+  std::vector<uint8_t> blob;
+  if (!backend->read(name, blob)) return false;
+  ++counters.loads;
+  if (!decode(blob.data(), blob.size(), out)) {
+    ++counters.loadErrors;
+    LOG_W("[IR][STORE] Discarding corrupt %s (%u bytes)", name,
+          static_cast<unsigned>(blob.size()));
+    return false;
+  }
+  LOG_I("[IR][STORE] Loaded %s: %u keys", name,
+        static_cast<unsigned>(out.size()));
+  return true;
+}
+
+void loop() {
+  const uint32_t now = millis();
+  for (auto *table : tables) {
+    if (!table->dirty()) continue;
+    const bool idle = now - table->lastChangeMs() >= IR_LEARNED_WRITE_DELAY_MS;
+    const bool overdue =
+        now - table->dirtySinceMs() >= IR_LEARNED_WRITE_MAX_DELAY_MS;
+    if (idle || overdue) writeTable(*table);
+  }
+}
+
+void flushAll() {
+  for (auto *table : tables) {
+    if (table->dirty()) writeTable(*table);
+  }
+}
+
+Stats stats() { return counters; }
+
+void encode(const std::vector<LearnedKey> &entries, std::vector<uint8_t> &out) {
+  out.assign(kHeaderSize, 0);
+  uint8_t count = 0;
+  for (const auto &entry : entries) {
+    if (count == UINT8_MAX) break;
+    const char *name = KeyIds::name(entry.id);
+    const size_t nameLength = strlen(name);
+    const bool wide = entry.nbits > 64;
+    const size_t codeLength =
+        wide ? entry.raw.size() : static_cast<size_t>((entry.nbits + 7) / 8);
+    if (nameLength == 0 || nameLength > KeyIds::kMaxNameLength ||
+        codeLength > UINT8_MAX) {
+      continue;
+    }
+    out.push_back(static_cast<uint8_t>(nameLength));
+    out.insert(out.end(), name, name + nameLength);
+    putU16(out, static_cast<uint16_t>(static_cast<int16_t>(entry.protocol)));
+    putU16(out, entry.nbits);
+    out.push_back(static_cast<uint8_t>(codeLength));
+    if (wide) {
+      out.insert(out.end(), entry.raw.begin(), entry.raw.end());
+    } else {
+      for (size_t i = 0; i < codeLength; ++i) {
+        out.push_back(static_cast<uint8_t>(entry.value >> (8 * i)));
+      }
+    }
+    // The payload length is a u16: drop a capture rather than the key.
+    size_t timingLength = entry.timing != nullptr ? entry.timing->size() : 0;
+    if (out.size() - kHeaderSize + 2 + timingLength > UINT16_MAX) {
+      timingLength = 0;
+    }
+    putU16(out, static_cast<uint16_t>(timingLength));
+    if (timingLength > 0) {
+      out.insert(out.end(), entry.timing->begin(), entry.timing->end());
+    }
+    ++count;
+  }
+
+  const size_t payload = out.size() - kHeaderSize;
+  const uint32_t crc = crc32(out.data() + kHeaderSize, payload);
+  out[0] = kMagic0;
+  out[1] = kMagic1;
+  out[2] = kVersion;
+  out[3] = count;
+  out[4] = static_cast<uint8_t>(payload);
+  out[5] = static_cast<uint8_t>(payload >> 8);
+  for (uint8_t i = 0; i < 4; ++i) {
+    out[6 + i] = static_cast<uint8_t>(crc >> (8 * i));
+  }
+}
+
+bool decode(const uint8_t *data, size_t length, std::vector<LearnedKey> &out) {
+  out.clear();
+  if (data == nullptr || length < kHeaderSize || data[0] != kMagic0 ||
+      data[1] != kMagic1 ||
+      (data[2] != kVersion && data[2] != kVersionNoTiming)) {
+    return false;
+  }
+  const bool hasTiming = data[2] != kVersionNoTiming;
+  const uint8_t count = data[3];
+  const size_t payload = getU16(data + 4);
+  if (kHeaderSize + payload != length ||
+      crc32(data + kHeaderSize, payload) != getU32(data + 6)) {
+    return false;
+  }
+
+  std::vector<LearnedKey> entries;
+  entries.reserve(count);
+  const uint8_t *p = data + kHeaderSize;
+  const uint8_t *end = data + length;
+  for (uint8_t i = 0; i < count; ++i) {
+    if (end - p < 1) return false;
+    const size_t nameLength = *p++;
+    if (nameLength == 0 || nameLength > KeyIds::kMaxNameLength ||
+        static_cast<size_t>(end - p) < nameLength + 5) {
+      return false;
+    }
+    char name[KeyIds::kMaxNameLength + 1];
+    memcpy(name, p, nameLength);
+    name[nameLength] = '\0';
+    p += nameLength;
+
+    LearnedKey entry;
+    entry.protocol = static_cast<decode_type_t>(static_cast<int16_t>(getU16(p)));
+    entry.nbits = getU16(p + 2);
+    const size_t codeLength = p[4];
+    p += 5;
+    if (static_cast<size_t>(end - p) < codeLength || entry.nbits == 0) {
+      return false;
+    }
+    if (entry.nbits > 64) {
+      entry.raw.assign(p, p + codeLength);
+    } else {
+      if (codeLength > 8) return false;
+      for (size_t b = 0; b < codeLength; ++b) {
+        entry.value |= static_cast<uint64_t>(p[b]) << (8 * b);
+      }
+    }
+    p += codeLength;
+    if (hasTiming) {
+      if (end - p < 2) return false;
+      const size_t timingLength = getU16(p);
+      p += 2;
+      if (static_cast<size_t>(end - p) < timingLength) return false;
+      if (timingLength > 0 && entry.nbits > 64) {
+        entry.timing =
+            std::make_shared<const std::vector<uint8_t>>(p, p + timingLength);
+      }
+      p += timingLength;
+    }
+
+    entry.id = KeyIds::intern(name);
+    if (entry.id == KeyId::kNone) continue;
+    entries.push_back(std::move(entry));
+  }
+  if (p != end) return false;
+  out.swap(entries);
+  return true;
+}
+
+}  // namespace LearnedKeyStore
@@ -0,0 +1,138 @@
+#include "LearnedKeyTable.h"
+
+#include <IRutils.h>
+#include <algorithm>
+#include <string.h>
+
+#include "Config.h"
+#include "LearnedKeyStore.h"
+#include "Log.h"
+
+namespace {
+uint8_t hexValue(char c) {
+  if (c >= '0' && c <= '9') return static_cast<uint8_t>(c - '0');
+  if (c >= 'a' && c <= 'f') return static_cast<uint8_t>(c - 'a' + 10);
+  if (c >= 'A' && c <= 'F') return static_cast<uint8_t>(c - 'A' + 10);
+  return 0;
+}
+}  // namespace
+
+bool LearnedKeyTable::save(KeyId id, decode_type_t protocol, uint64_t value,
+                           uint16_t nbits, const std::vector<uint8_t> &raw,
+                           const std::vector<uint8_t> &timing) {
+  if (id == KeyId::kNone || protocol == decode_type_t::UNKNOWN || nbits == 0 ||
+      raw.size() > UINT8_MAX) {
+    return false;
+  }
+  ensureLoaded();
+  // Frames up to 64 bits are replayed from `value`; only wider ones need the
+  // state bytes.
+  const bool wide = nbits > 64;
+  const uint64_t safeValue = wide ? 0 : value;
+  const std::vector<uint8_t> state = wide ? raw : std::vector<uint8_t>();
+  std::shared_ptr<const std::vector<uint8_t>> recipe;
+  if (wide && !timing.empty()) {
+    recipe = std::make_shared<const std::vector<uint8_t>>(timing);
+  }
+  for (auto &entry : entries_) {
+    if (entry.id == id) {
+      // The app resends "ir" with every press; only real changes hit flash.
+      if (entry.protocol == protocol && entry.value == safeValue &&
+          entry.nbits == nbits && entry.raw == state) {
+        if (recipe == nullptr ||
+            (entry.timing != nullptr && *entry.timing == *recipe)) {
+          return true;
+        }
+      }
+      entry.protocol = protocol;
+      entry.value = safeValue;
+      entry.nbits = nbits;
+      entry.raw = state;
+      entry.timing = recipe;
+      markDirty();
+      return true;
+    }
+  }
+  if (entries_.size() >= IR_LEARNED_MAX_KEYS) {
+    LOG_W("[IR][LEARN] Table %s full (%u keys), dropping %s",
+          persistName_ != nullptr ? persistName_ : "-",
+          static_cast<unsigned>(entries_.size()), KeyIds::name(id));
+    return false;
+  }
+
+  LearnedKey entry;
+  entry.id = id;
+  entry.protocol = protocol;
+  entry.value = safeValue;
+  entry.nbits = nbits;
+  entry.raw = state;
+  entry.timing = recipe;
+  entries_.push_back(entry);
+  markDirty();
+  return true;
+}
+
+bool LearnedKeyTable::saveFromJson(KeyId id, JsonObjectConst ir) {
+  const char *protoStr = ir["protocol"].as<const char *>();
+  const char *codeStr = ir["code"].as<const char *>();
+  const uint16_t bits = ir["bits"].as<uint16_t>();
+  if (protoStr == nullptr || codeStr == nullptr || bits == 0) return false;
+  const decode_type_t protocol = strToDecodeType(protoStr);
+  if (protocol == decode_type_t::UNKNOWN) return false;
+
+  const uint64_t value = bits <= 64 ? strtoull(codeStr, nullptr, 16) : 0;
+
+  // Byte i of the state covers hex digits 2i and 2i+1 of the code after it
+  // has been left-padded with '0' to at least the frame size.
+  const size_t digits = strlen(codeStr);
+  const size_t nbytes = (bits + 7) / 8;
+  const size_t padded = std::max(digits, nbytes * 2);
+  const size_t pad = padded - digits;
+  std::vector<uint8_t> raw;
+  raw.reserve(padded / 2);
+  for (size_t i = 0; i + 1 < padded; i += 2) {
+    const char hi = i < pad ? '0' : codeStr[i - pad];
+    const char lo = i + 1 < pad ? '0' : codeStr[i + 1 - pad];
+    raw.push_back(static_cast<uint8_t>((hexValue(hi) << 4) | hexValue(lo)));
+  }
+  return save(id, protocol, value, bits, raw);
+}
+
+const LearnedKey *LearnedKeyTable::find(KeyId id) {
+  if (id == KeyId::kNone) return nullptr;
+  ensureLoaded();
+  for (const auto &entry : entries_) {
+    if (entry.id == id) return &entry;
+  }
+  return nullptr;
+}
+
+size_t LearnedKeyTable::size() {
+  ensureLoaded();
+  return entries_.size();
+}
+
+void LearnedKeyTable::persistAs(const char *name) {
+  if (!IR_LEARNED_PERSIST || name == nullptr || persistName_ != nullptr) {
+    return;
+  }
+  persistName_ = name;
+  loaded_ = false;
+  LearnedKeyStore::track(*this);
+}
+
+void LearnedKeyTable::ensureLoaded() {
+  if (loaded_) return;
+  loaded_ = true;
+  // Every accessor loads first, so entries_ is still empty here.
+  LearnedKeyStore::load(persistName_, entries_);
+  if (entries_.size() > IR_LEARNED_MAX_KEYS) {
+    entries_.resize(IR_LEARNED_MAX_KEYS);
+  }
+}
+
+void LearnedKeyTable::markDirty() {
+  lastChangeMs_ = millis();
+  if (!dirty_) dirtySinceMs_ = lastChangeMs_;
+  dirty_ = persistName_ != nullptr;
+}
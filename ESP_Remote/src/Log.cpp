@@ -0,0 +1,119 @@
+#include "Log.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "Config.h"
+
+namespace Log {
+namespace {
+
+constexpr uint32_t kTaskStackBytes = 3072;
+// Same as the network task and below ir_tx (2): UART writes only run when
+// nothing latency-sensitive is ready.
+constexpr UBaseType_t kTaskPriority = 1;
+
+struct Line {
+  uint16_t length;
+  char text[LOG_LINE_BYTES];
+};
+
+QueueHandle_t queue = nullptr;
+TaskHandle_t task = nullptr;
+std::atomic<uint32_t> written{0};
+std::atomic<uint32_t> dropped{0};
+std::atomic<uint32_t> truncated{0};
+std::atomic<uint16_t> peakQueued{0};
+
+void writeSerial(const Line &line) {
+  Serial.write(reinterpret_cast<const uint8_t *>(line.text), line.length);
+}
+
+void drainTask(void *) {
+  Line line;
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    if (xQueueReceive(queue, &line, portMAX_DELAY) != pdTRUE) continue;
+    writeSerial(line);
+    const uint32_t drops = dropped.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      Serial.printf("[LOG] Dropped %lu line(s)\n",
+                    static_cast<unsigned long>(drops - reportedDrops));
+      reportedDrops = drops;
+    }
+  }
+}
+
+}  // namespace
+
+void begin() {
+  if (queue != nullptr) return;
+  queue = xQueueCreate(LOG_QUEUE_LINES, sizeof(Line));
+  if (queue == nullptr) {
+    Serial.println(F("[LOG] Failed to create queue, logging synchronously"));
+    return;
+  }
+  if (xTaskCreatePinnedToCore(drainTask, "log", kTaskStackBytes, nullptr,
+                              kTaskPriority, &task,
+                              NET_TASK_CORE) != pdPASS) {
+    Serial.println(F("[LOG] Failed to start task, logging synchronously"));
+    vQueueDelete(queue);
+    queue = nullptr;
+    task = nullptr;
+  }
+}
+
+void write(const char *format, ...) {
+  Line line;
+  // Leave room for the newline.
+  constexpr size_t kTextBytes = sizeof(line.text) - 1;
+  va_list args;
+  va_start(args, format);
+  const int length = vsnprintf(line.text, kTextBytes, format, args);
+  va_end(args);
+  if (length < 0) return;
+
+  size_t used = static_cast<size_t>(length);
+  if (used >= kTextBytes) {
+    used = kTextBytes - 1;
+    memcpy(line.text + used - 3, "...", 3);
+    truncated.fetch_add(1, std::memory_order_relaxed);
+  }
+  line.text[used++] = '\n';
+  line.length = static_cast<uint16_t>(used);
+
+  if (queue == nullptr) {
+    writeSerial(line);
+    written.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (xQueueSend(queue, &line, 0) != pdTRUE) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  written.fetch_add(1, std::memory_order_relaxed);
+  const uint16_t queued = static_cast<uint16_t>(uxQueueMessagesWaiting(queue));
+  uint16_t peak = peakQueued.load(std::memory_order_relaxed);
+  while (queued > peak &&
+         !peakQueued.compare_exchange_weak(peak, queued,
+                                           std::memory_order_relaxed)) {
+  }
+}
+
+Stats stats() {
+  Stats result;
+  result.written = written.load(std::memory_order_relaxed);
+  result.dropped = dropped.load(std::memory_order_relaxed);
+  result.truncated = truncated.load(std::memory_order_relaxed);
+  result.peakQueued = peakQueued.load(std::memory_order_relaxed);
+  result.taskStackFree =
+      task != nullptr ? uxTaskGetStackHighWaterMark(task) : 0;
+  return result;
+}
+
+}  // namespace Log
@@ -0,0 +1,60 @@
+#include "Metrics.h"
+
+#include "DeviceManager.h"
+
+namespace Metrics {
+namespace {
+
+NodeCounters nodeCounters;
+
+}  // namespace
+
+void Histogram::record(uint32_t us) {
+  size_t bucket = 0;
+  while (bucket < kBucketCount - 1 && us > kBucketBoundsUs[bucket]) ++bucket;
+  ++buckets_[bucket];
+  ++count_;
+  sumUs_ += us;
+  if (us > maxUs_) maxUs_ = us;
+}
+
+void Histogram::toJson(JsonObject out) const {
+  out["n"] = count_;
+  out["sum_us"] = sumUs_;
+  out["max_us"] = maxUs_;
+  JsonArray buckets = out["b"].to<JsonArray>();
+  for (uint32_t count : buckets_) buckets.add(count);
+}
+
+NodeCounters &node() { return nodeCounters; }
+
+void snapshot(DeviceManager &devices, JsonDocument &doc) {
+  doc["uptime_ms"] = millis();
+  doc["heap_free"] = ESP.getFreeHeap();
+  doc["heap_min"] = ESP.getMinFreeHeap();
+  doc["heap_max_block"] = ESP.getMaxAllocHeap();
+  doc["parse_errors"] = nodeCounters.parseErrors;
+  doc["mqtt_reconnects"] = nodeCounters.mqttReconnects;
+  doc["state_unchanged"] = nodeCounters.stateUnchanged;
+  JsonArray bounds = doc["bounds_us"].to<JsonArray>();
+  for (uint32_t bound : kBucketBoundsUs) bounds.add(bound);
+  nodeCounters.loopUs.toJson(doc["loop"].to<JsonObject>());
+
+  JsonObject perDevice = doc["devices"].to<JsonObject>();
+  for (size_t i = 0; i < devices.count(); ++i) {
+    DeviceController *controller = devices.at(i);
+    const DeviceCounters &counters = controller->metrics();
+    JsonObject out = perDevice[controller->deviceType()].to<JsonObject>();
+    out["cmds"] = counters.commands;
+    out["ir_frames"] = counters.irFrames;
+    out["unknown_keys"] = counters.unknownKeys;
+    out["learned_hits"] = counters.learnedHits;
+    out["codeset_hits"] = counters.codesetHits;
+    out["coalesced"] = counters.coalesced;
+    if (counters.commandUs.count() > 0) {
+      counters.commandUs.toJson(out["cmd"].to<JsonObject>());
+    }
+  }
+}
+
+}  // namespace Metrics
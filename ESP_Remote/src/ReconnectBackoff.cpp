@@ -0,0 +1,34 @@
+#include "ReconnectBackoff.h"
+
+ReconnectBackoff::ReconnectBackoff(uint32_t minDelayMs, uint32_t maxDelayMs,
+                                   uint8_t attemptBudget)
+    : minDelayMs_(minDelayMs),
+      maxDelayMs_(maxDelayMs < minDelayMs ? minDelayMs : maxDelayMs),
+      attemptBudget_(attemptBudget > 0 ? attemptBudget : 1) {}
+
+bool ReconnectBackoff::due(uint32_t nowMs) const {
+  return failures_ == 0 || nowMs - lastFailureMs_ >= lastDelayMs_;
+}
+
+void ReconnectBackoff::failed(uint32_t nowMs, uint32_t entropy) {
+  uint32_t cap = minDelayMs_;
+  for (uint32_t i = 0; i < failures_ && cap < maxDelayMs_; ++i) {
+    cap = cap > maxDelayMs_ / 2 ? maxDelayMs_ : cap * 2;
+  }
+  const uint32_t half = cap / 2;
+  lastDelayMs_ = half + entropy % (cap - half + 1);
+  lastFailureMs_ = nowMs;
+  ++failures_;
+  if (budgetFailures_ < attemptBudget_) ++budgetFailures_;
+}
+
+void ReconnectBackoff::succeeded() {
+  failures_ = 0;
+  budgetFailures_ = 0;
+  lastDelayMs_ = 0;
+}
+
+uint32_t ReconnectBackoff::retryInMs(uint32_t nowMs) const {
+  if (due(nowMs)) return 0;
+  return lastDelayMs_ - (nowMs - lastFailureMs_);
+}
@@ -0,0 +1,476 @@
+#include "Scenes.h"
+
+#include <Preferences.h>
+#include <strings.h>
+#include <vector>
+
+#include "Config.h"
+#include "Crc32.h"
+#include "KeyId.h"
+#include "Log.h"
+#include "devices/AcController.h"
+
+namespace Scenes {
+namespace {
+
+static_assert(SCENE_MAX_STEPS <= CommandBatch::kMaxSteps,
+              "Scene results use the batch step masks");
+
+constexpr const char *kPrefsNamespace = "scenes";
+constexpr const char *kPrefsKeyAll = "all";
+constexpr uint8_t kMagic0 = 'S';
+constexpr uint8_t kMagic1 = 'N';
+constexpr uint8_t kVersion = 1;
+constexpr size_t kHeaderSize = 4;  // magic, version, step count
+constexpr size_t kCrcSize = 4;
+constexpr size_t kMaxNameLength = 32;
+constexpr uint8_t kFlagPower = 0x01;
+constexpr uint8_t kFlagSwing = 0x02;
+
+enum class StepKind : uint8_t { kValue = 0, kState = 1, kAc = 2 };
+
+struct Scene {
+  String name;
+  std::vector<uint8_t> code;
+  uint8_t slots = 0;  // IR queue slots one run takes
+};
+
+DeviceManager *deviceManager = nullptr;
+IrTransmitter *transmitter = nullptr;
+AcController *acController = nullptr;
+std::vector<Scene> scenes;
+Preferences prefs;
+bool opened = false;
+Stats counters;
+
+// Bounds-checked little-endian reads; once one fails, ok() stays false and
+// every later read returns 0.
+class Reader {
+ public:
+  Reader(const uint8_t *data, size_t length)
+      : p_(data), end_(data + length) {}
+
+  bool ok() const { return ok_; }
+  bool done() const { return p_ == end_; }
+
+  uint8_t u8() {
+    if (!ok_ || p_ == end_) {
+      ok_ = false;
+      return 0;
+    }
+    return *p_++;
+  }
+  uint16_t u16() {
+    const uint16_t low = u8();
+    return static_cast<uint16_t>(low | (u8() << 8));
+  }
+  uint64_t u64() {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+      value |= static_cast<uint64_t>(u8()) << (8 * i);
+    }
+    return value;
+  }
+  const uint8_t *bytes(size_t length) {
+    if (!ok_ || static_cast<size_t>(end_ - p_) < length) {
+      ok_ = false;
+      return nullptr;
+    }
+    const uint8_t *at = p_;
+    p_ += length;
+    return at;
+  }
+  void text(String &out) {
+    const uint8_t length = u8();
+    const uint8_t *at = bytes(length);
+    out = String();
+    if (at == nullptr) return;
+    out.reserve(length);
+    for (uint8_t i = 0; i < length; ++i) out += static_cast<char>(at[i]);
+  }
+
+ private:
+  const uint8_t *p_;
+  const uint8_t *end_;
+  bool ok_ = true;
+};
+
+void putU16(std::vector<uint8_t> &out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void putU64(std::vector<uint8_t> &out, uint64_t value) {
+  for (uint8_t i = 0; i < 8; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void putText(std::vector<uint8_t> &out, const String &text) {
+  const size_t length = text.length() > UINT8_MAX ? UINT8_MAX : text.length();
+  out.push_back(static_cast<uint8_t>(length));
+  out.insert(out.end(), text.c_str(), text.c_str() + length);
+}
+
+void readAcState(Reader &in, AcState &state) {
+  const uint8_t flags = in.u8();
+  state.power = (flags & kFlagPower) != 0;
+  state.swing = (flags & kFlagSwing) != 0;
+  state.temp = static_cast<int8_t>(in.u8());
+  in.text(state.mode);
+  in.text(state.fan);
+}
+
+// Walks a compiled scene without running it: false if it is malformed,
+// else the IR queue slots a run takes.
+bool measure(const std::vector<uint8_t> &code, uint8_t &slots) {
+  if (code.size() < kHeaderSize || code[0] != kMagic0 ||
+      code[1] != kMagic1 || code[2] != kVersion ||
+      code[3] > SCENE_MAX_STEPS) {
+    return false;
+  }
+  Reader in(code.data() + kHeaderSize, code.size() - kHeaderSize);
+  size_t total = 0;
+  for (uint8_t i = 0; i < code[3]; ++i) {
+    const StepKind kind = static_cast<StepKind>(in.u8());
+    in.u8();  // controller index
+    const uint8_t presses = in.u8();
+    const uint16_t gapMs = in.u16();
+    switch (kind) {
+      case StepKind::kValue:
+        in.bytes(2 + 1 + 8);
+        total += presses;
+        break;
+      case StepKind::kState:
+        in.bytes(2 + 1 + 2);
+        in.bytes(in.u8());
+        total += presses;
+        break;
+      case StepKind::kAc: {
+        AcState state;
+        readAcState(in, state);
+        total += gapMs > 0 ? 2 : 1;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  if (!in.ok() || !in.done() || total > IR_TX_QUEUE_DEPTH) return false;
+  slots = static_cast<uint8_t>(total);
+  return true;
+}
+
+bool compileStep(JsonVariantConst step, uint16_t defaultGapMs,
+                 std::vector<uint8_t> &out, const char *&error) {
+  const char *device = step["device"].as<const char *>();
+  DeviceController *controller =
+      device != nullptr ? deviceManager->find(device) : nullptr;
+  if (controller == nullptr) {
+    error = "unknown_device";
+    return false;
+  }
+  const int repeat = step["repeat"] | 1;
+  const uint8_t presses =
+      static_cast<uint8_t>(constrain(repeat, 1, IR_TX_QUEUE_DEPTH));
+  const uint16_t gapMs = step["gapMs"] | defaultGapMs;
+
+  const char *keyName = step["key"].as<const char *>();
+  if (!KeyIds::isBlank(keyName)) {
+    IrFrame frame;
+    if (!controller->resolveKey(keyName, frame)) {
+      error = "unknown_key";
+      return false;
+    }
+    if (frame.state.size() > UINT8_MAX) {
+      error = "frame_too_long";
+      return false;
+    }
+    const bool wide = !frame.state.empty();
+    out.push_back(static_cast<uint8_t>(wide ? StepKind::kState
+                                            : StepKind::kValue));
+    out.push_back(static_cast<uint8_t>(deviceManager->indexOf(controller)));
+    out.push_back(presses);
+    putU16(out, gapMs);
+    putU16(out, static_cast<uint16_t>(frame.protocol));
+    if (wide) {
+      out.push_back(frame.repeat);
+      putU16(out, frame.repeatGapMs);
+      out.push_back(static_cast<uint8_t>(frame.state.size()));
+      out.insert(out.end(), frame.state.begin(), frame.state.end());
+    } else {
+      out.push_back(static_cast<uint8_t>(frame.nbits));
+      putU64(out, frame.value);
+    }
+    return true;
+  }
+
+  if (controller != acController) {
+    error = "bad_step";
+    return false;
+  }
+  AcState state = acController->state();
+  if (step["power"].is<bool>()) state.power = step["power"].as<bool>();
+  if (step["mode"].is<const char *>()) state.mode = step["mode"].as<String>();
+  if (step["temp"].is<int>()) state.temp = step["temp"].as<int>();
+  if (step["fan"].is<const char *>()) state.fan = step["fan"].as<String>();
+  if (step["swing"].is<bool>()) state.swing = step["swing"].as<bool>();
+  out.push_back(static_cast<uint8_t>(StepKind::kAc));
+  out.push_back(static_cast<uint8_t>(deviceManager->indexOf(controller)));
+  out.push_back(1);
+  putU16(out, gapMs);
+  out.push_back((state.power ? kFlagPower : 0) |
+                (state.swing ? kFlagSwing : 0));
+  const int temp = constrain(state.temp, INT8_MIN, INT8_MAX);
+  out.push_back(static_cast<uint8_t>(static_cast<int8_t>(temp)));
+  putText(out, state.mode);
+  putText(out, state.fan);
+  return true;
+}
+
+Scene *find(const char *name) {
+  if (name == nullptr) return nullptr;
+  for (Scene &scene : scenes) {
+    if (scene.name.equalsIgnoreCase(name)) return &scene;
+  }
+  return nullptr;
+}
+
+bool open() {
+  if (!opened) opened = prefs.begin(kPrefsNamespace, false);
+  return opened;
+}
+
+bool save() {
+  std::vector<uint8_t> blob;
+  blob.push_back(static_cast<uint8_t>(scenes.size()));
+  for (const Scene &scene : scenes) {
+    putText(blob, scene.name);
+    putU16(blob, static_cast<uint16_t>(scene.code.size()));
+    blob.insert(blob.end(), scene.code.begin(), scene.code.end());
+  }
+  const uint32_t crc = crc32(blob.data(), blob.size());
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    blob.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+  }
+  if (!open() ||
+      prefs.putBytes(kPrefsKeyAll, blob.data(), blob.size()) != blob.size()) {
+    ++counters.writeErrors;
+    LOG_E("[SCENE] Write failed (%u bytes)",
+          static_cast<unsigned>(blob.size()));
+    return false;
+  }
+  ++counters.writes;
+  LOG_D("[SCENE] Saved %u scenes (%u bytes)",
+        static_cast<unsigned>(scenes.size()),
+        static_cast<unsigned>(blob.size()));
+  return true;
+}
+
+bool parse(const std::vector<uint8_t> &blob, std::vector<Scene> &out) {
+  if (blob.size() < 1 + kCrcSize) return false;
+  const size_t body = blob.size() - kCrcSize;
+  uint32_t crc = 0;
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    crc |= static_cast<uint32_t>(blob[body + i]) << (8 * i);
+  }
+  if (crc32(blob.data(), body) != crc) return false;
+
+  Reader in(blob.data(), body);
+  const uint8_t count = in.u8();
+  for (uint8_t i = 0; i < count && in.ok(); ++i) {
+    Scene scene;
+    in.text(scene.name);
+    const uint16_t length = in.u16();
+    const uint8_t *code = in.bytes(length);
+    if (code == nullptr) return false;
+    scene.code.assign(code, code + length);
+    if (!measure(scene.code, scene.slots)) return false;
+    out.push_back(std::move(scene));
+  }
+  return in.ok() && in.done();
+}
+
+void load() {
+  if (!open()) return;
+  const size_t length = prefs.getBytesLength(kPrefsKeyAll);
+  if (length == 0) return;
+  std::vector<uint8_t> blob(length);
+  if (prefs.getBytes(kPrefsKeyAll, blob.data(), length) != length) return;
+  std::vector<Scene> loaded;
+  if (!parse(blob, loaded)) {
+    ++counters.loadErrors;
+    LOG_W("[SCENE] Discarding corrupt scenes (%u bytes)",
+          static_cast<unsigned>(length));
+    return;
+  }
+  scenes.swap(loaded);
+}
+
+}  // namespace
+
+void begin(DeviceManager &devices, IrTransmitter &ir, AcController &ac) {
+  deviceManager = &devices;
+  transmitter = &ir;
+  acController = &ac;
+  load();
+  LOG_I("[SCENE] %u scenes loaded", static_cast<unsigned>(scenes.size()));
+}
+
+bool define(JsonObjectConst scene, const char *&error, int &errorStep) {
+  error = nullptr;
+  errorStep = -1;
+  const char *name = scene["name"].as<const char *>();
+  if (KeyIds::isBlank(name) || strlen(name) > kMaxNameLength) {
+    error = "bad_name";
+    return false;
+  }
+  JsonArrayConst steps = scene["steps"].as<JsonArrayConst>();
+  if (steps.isNull() || steps.size() == 0) {
+    error = "no_steps";
+    return false;
+  }
+  if (steps.size() > SCENE_MAX_STEPS) {
+    error = "too_many_steps";
+    return false;
+  }
+  if (find(name) == nullptr && scenes.size() >= SCENE_MAX_COUNT) {
+    error = "too_many_scenes";
+    return false;
+  }
+
+  Scene compiled;
+  compiled.name = name;
+  compiled.code = {kMagic0, kMagic1, kVersion,
+                   static_cast<uint8_t>(steps.size())};
+  const uint16_t defaultGapMs = scene["gapMs"] | static_cast<uint16_t>(0);
+  int index = 0;
+  for (JsonVariantConst step : steps) {
+    if (!compileStep(step, defaultGapMs, compiled.code, error)) {
+      errorStep = index;
+      return false;
+    }
+    ++index;
+  }
+  if (!measure(compiled.code, compiled.slots)) {
+    error = "queue_full";  // more presses than the IR queue holds
+    return false;
+  }
+
+  std::vector<Scene> previous = scenes;
+  if (Scene *existing = find(name)) {
+    *existing = std::move(compiled);
+  } else {
+    scenes.push_back(std::move(compiled));
+  }
+  if (!save()) {
+    scenes.swap(previous);
+    error = "write_failed";
+    return false;
+  }
+  LOG_I("[SCENE] Stored '%s' (%u steps)", name,
+        static_cast<unsigned>(steps.size()));
+  return true;
+}
+
+bool remove(const char *name) {
+  for (auto it = scenes.begin(); it != scenes.end(); ++it) {
+    if (!it->name.equalsIgnoreCase(name)) continue;
+    std::vector<Scene> previous = scenes;
+    scenes.erase(it);
+    if (!save()) {
+      scenes.swap(previous);
+      return false;
+    }
+    LOG_I("[SCENE] Removed '%s'", name);
+    return true;
+  }
+  return false;
+}
+
+void run(const char *name, CommandBatch::Result &result) {
+  result = CommandBatch::Result();
+  const Scene *scene = find(name);
+  if (scene == nullptr) {
+    result.error = "unknown_scene";
+    return;
+  }
+  if (scene->slots > transmitter->freeSlots()) {
+    result.error = "queue_full";
+    return;
+  }
+  ++counters.runs;
+
+  const std::vector<uint8_t> &code = scene->code;
+  Reader in(code.data() + kHeaderSize, code.size() - kHeaderSize);
+  result.steps = code[3];
+  const uint32_t droppedBefore = transmitter->dropped();
+  for (uint8_t i = 0; i < result.steps && in.ok(); ++i) {
+    const StepKind kind = static_cast<StepKind>(in.u8());
+    const uint8_t controllerIndex = in.u8();
+    const uint8_t presses = in.u8();
+    const uint16_t gapMs = in.u16();
+    const uint32_t framesBefore = transmitter->enqueued();
+    bool changed = false;
+    switch (kind) {
+      case StepKind::kValue: {
+        const auto protocol = static_cast<decode_type_t>(in.u16());
+        const uint8_t nbits = in.u8();
+        const uint64_t value = in.u64();
+        for (uint8_t p = 0; p < presses; ++p) {
+          transmitter->sendValue(protocol, value, nbits, gapMs);
+        }
+        break;
+      }
+      case StepKind::kState: {
+        const auto protocol = static_cast<decode_type_t>(in.u16());
+        const uint8_t copies = in.u8();
+        const uint16_t copyGapMs = in.u16();
+        const uint8_t length = in.u8();
+        const uint8_t *state = in.bytes(length);
+        for (uint8_t p = 0; p < presses && state != nullptr; ++p) {
+          transmitter->sendState(protocol, state, length, copies, copyGapMs,
+                                 gapMs);
+        }
+        break;
+      }
+      case StepKind::kAc: {
+        AcState state;
+        readAcState(in, state);
+        if (!in.ok()) break;
+        acController->applySceneState(state);
+        if (gapMs > 0) transmitter->pause(gapMs);
+        changed = true;
+        break;
+      }
+    }
+
+    const uint32_t frames = transmitter->enqueued() - framesBefore;
+    result.frames += frames;
+    if (DeviceController *controller = deviceManager->at(controllerIndex)) {
+      ++controller->metrics().commands;
+      controller->metrics().irFrames += frames;
+      if (changed) result.changed |= 1u << controllerIndex;
+    }
+    if (frames > 0 || changed) {
+      ++result.ok;
+    } else {
+      result.failed |= 1u << i;
+    }
+  }
+  result.dropped =
+      static_cast<uint16_t>(transmitter->dropped() - droppedBefore);
+  LOG_D("[SCENE] Ran '%s': %u frames", scene->name.c_str(), result.frames);
+}
+
+void list(JsonArray out) {
+  for (const Scene &scene : scenes) out.add(scene.name);
+}
+
+Stats stats() {
+  Stats out = counters;
+  out.scenes = scenes.size();
+  return out;
+}
+
+}  // namespace Scenes
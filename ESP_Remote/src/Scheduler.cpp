@@ -0,0 +1,467 @@
+#include "Scheduler.h"
+
+#include <Preferences.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include <atomic>
+#include <vector>
+
+#include "Config.h"
+#include "Crc32.h"
+#include "KeyId.h"
+#include "Log.h"
+#include "TimerHeap.h"
+
+namespace Scheduler {
+namespace {
+
+constexpr const char *kPrefsNamespace = "sched";
+constexpr const char *kPrefsKeyJobs = "jobs";
+constexpr size_t kCrcSize = 4;
+constexpr size_t kMaxNameLength = 32;
+constexpr time_t kMinValidEpochS = 1704067200;  // 2024-01-01
+// Far enough ahead for a rule that only matches 29 February.
+constexpr int kCronHorizonDays = 4 * 366 + 1;
+
+struct Cron {
+  uint64_t minutes = 0;    // bit n: minute n
+  uint32_t hours = 0;
+  uint32_t monthDays = 0;  // bits 1..31
+  uint16_t months = 0;     // bits 1..12
+  uint8_t weekDays = 0;    // bits 0..6, Sunday first
+  bool restrictsMonthDay = false;
+  bool restrictsWeekDay = false;
+};
+
+struct Job {
+  bool used = false;
+  String name;
+  String topic;     // suffix after iot/nodes/<id>/
+  String payload;   // JSON, dispatched like an MQTT message
+  String cronText;  // empty for a one-shot job
+  Cron cron;
+  uint64_t dueMs = 0;  // one-shot: when to fire; cron: next occurrence
+};
+
+DeviceManager *deviceManager = nullptr;
+FireCallback fireCallback = nullptr;
+Job jobs[SCHED_MAX_JOBS];
+TimerHeap<SCHED_MAX_JOBS> pending;
+bool clockSeen = false;  // loop() has run with a set clock
+std::atomic<bool> clockStepped{false};
+Preferences prefs;
+bool opened = false;
+Stats counters;
+
+bool parseNumber(const char *&p, unsigned &out) {
+  if (!isdigit(static_cast<unsigned char>(*p))) return false;
+  out = 0;
+  while (isdigit(static_cast<unsigned char>(*p))) {
+    out = out * 10 + static_cast<unsigned>(*p++ - '0');
+    if (out > 99) return false;
+  }
+  return true;
+}
+
+// One cron field into `bits`; `restricted` is false for a bare "*".
+bool parseField(const char *&p, unsigned low, unsigned high, uint64_t &bits,
+                bool &restricted) {
+  const char *start = p;
+  bits = 0;
+  for (;;) {
+    unsigned first = low;
+    unsigned last = high;
+    unsigned step = 1;
+    bool single = false;
+    if (*p == '*') {
+      ++p;
+    } else {
+      if (!parseNumber(p, first)) return false;
+      last = first;
+      single = true;
+      if (*p == '-') {
+        ++p;
+        if (!parseNumber(p, last)) return false;
+        single = false;
+      }
+    }
+    if (*p == '/') {
+      ++p;
+      if (!parseNumber(p, step) || step == 0) return false;
+      if (single) last = high;  // "5/15" is "5-<high>/15"
+    }
+    if (first < low || last > high || first > last) return false;
+    for (unsigned value = first; value <= last; value += step) {
+      bits |= 1ULL << value;
+    }
+    if (*p != ',') break;
+    ++p;
+  }
+  restricted = !(p - start == 1 && *start == '*');
+  return *p == '\0' || *p == ' ';
+}
+
+bool parseCron(const char *text, Cron &cron) {
+  static constexpr unsigned kLow[] = {0, 0, 1, 1, 0};
+  static constexpr unsigned kHigh[] = {59, 23, 31, 12, 7};
+  uint64_t bits[5];
+  bool restricted[5];
+  const char *p = text;
+  for (uint8_t i = 0; i < 5; ++i) {
+    while (*p == ' ') ++p;
+    if (!parseField(p, kLow[i], kHigh[i], bits[i], restricted[i])) {
+      return false;
+    }
+  }
+  while (*p == ' ') ++p;
+  if (*p != '\0') return false;
+  cron.minutes = bits[0];
+  cron.hours = static_cast<uint32_t>(bits[1]);
+  cron.monthDays = static_cast<uint32_t>(bits[2]);
+  cron.months = static_cast<uint16_t>(bits[3]);
+  cron.weekDays = static_cast<uint8_t>((bits[4] | bits[4] >> 7) & 0x7F);
+  cron.restrictsMonthDay = restricted[2];
+  cron.restrictsWeekDay = restricted[4];
+  return true;
+}
+
+bool dayMatches(const Cron &cron, const tm &day) {
+  if (!(cron.months >> (day.tm_mon + 1) & 1)) return false;
+  const bool monthDay = cron.monthDays >> day.tm_mday & 1;
+  const bool weekDay = cron.weekDays >> day.tm_wday & 1;
+  if (cron.restrictsMonthDay && cron.restrictsWeekDay) {
+    return monthDay || weekDay;
+  }
+  return monthDay && weekDay;
+}
+
+// First local minute matching `cron` strictly after `afterMs`, in Unix ms;
+// 0 if there is none within kCronHorizonDays. Walks days, not minutes.
+uint64_t nextOccurrence(const Cron &cron, uint64_t afterMs) {
+  const time_t start = static_cast<time_t>(afterMs / 60000 + 1) * 60;
+  tm day;
+  localtime_r(&start, &day);
+  for (int i = 0; i < kCronHorizonDays; ++i) {
+    if (dayMatches(cron, day)) {
+      for (int hour = day.tm_hour; hour < 24; ++hour) {
+        if (!(cron.hours >> hour & 1)) continue;
+        for (int minute = hour == day.tm_hour ? day.tm_min : 0; minute < 60;
+             ++minute) {
+          if (!(cron.minutes >> minute & 1)) continue;
+          day.tm_hour = hour;
+          day.tm_min = minute;
+          day.tm_sec = 0;
+          day.tm_isdst = -1;
+          return static_cast<uint64_t>(mktime(&day)) * 1000;
+        }
+      }
+    }
+    ++day.tm_mday;
+    day.tm_hour = 0;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+    day.tm_isdst = -1;
+    mktime(&day);
+  }
+  return 0;
+}
+
+// Puts a job in the heap at its next due time; false if it has none.
+bool arm(uint8_t slot, uint64_t nowMs) {
+  Job &job = jobs[slot];
+  if (!job.cronText.isEmpty()) job.dueMs = nextOccurrence(job.cron, nowMs);
+  if (job.dueMs == 0) return false;
+  pending.push(slot, job.dueMs);
+  return true;
+}
+
+void rearmAll(uint64_t nowMs) {
+  pending.clear();
+  for (uint8_t slot = 0; slot < SCHED_MAX_JOBS; ++slot) {
+    if (jobs[slot].used) arm(slot, nowMs);
+  }
+}
+
+int findSlot(const char *name) {
+  for (uint8_t slot = 0; slot < SCHED_MAX_JOBS; ++slot) {
+    if (jobs[slot].used && jobs[slot].name.equalsIgnoreCase(name)) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+bool open() {
+  if (!opened) opened = prefs.begin(kPrefsNamespace, false);
+  return opened;
+}
+
+bool save() {
+  JsonDocument doc;
+  JsonArray out = doc.to<JsonArray>();
+  for (const Job &job : jobs) {
+    if (!job.used) continue;
+    JsonObject entry = out.add<JsonObject>();
+    entry["name"] = job.name;
+    entry["topic"] = job.topic;
+    entry["payload"] = job.payload;
+    if (job.cronText.isEmpty()) {
+      entry["atMs"] = job.dueMs;
+    } else {
+      entry["cron"] = job.cronText;
+    }
+  }
+  std::vector<uint8_t> blob(measureJson(doc) + 1);
+  blob.resize(serializeJson(doc, reinterpret_cast<char *>(blob.data()),
+                            blob.size()));
+  const uint32_t crc = crc32(blob.data(), blob.size());
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    blob.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+  }
+  if (!open() ||
+      prefs.putBytes(kPrefsKeyJobs, blob.data(), blob.size()) != blob.size()) {
+    ++counters.writeErrors;
+    LOG_E("[SCHED] Write failed (%u bytes)",
+          static_cast<unsigned>(blob.size()));
+    return false;
+  }
+  ++counters.writes;
+  return true;
+}
+
+bool parse(const std::vector<uint8_t> &blob) {
+  if (blob.size() < kCrcSize) return false;
+  const size_t body = blob.size() - kCrcSize;
+  uint32_t crc = 0;
+  for (uint8_t i = 0; i < kCrcSize; ++i) {
+    crc |= static_cast<uint32_t>(blob[body + i]) << (8 * i);
+  }
+  if (crc32(blob.data(), body) != crc) return false;
+
+  JsonDocument doc;
+  if (deserializeJson(doc, reinterpret_cast<const char *>(blob.data()),
+                      body)) {
+    return false;
+  }
+  uint8_t slot = 0;
+  for (JsonObjectConst entry : doc.as<JsonArrayConst>()) {
+    if (slot >= SCHED_MAX_JOBS) return false;
+    Job &job = jobs[slot++];
+    job.used = true;
+    job.name = entry["name"] | "";
+    job.topic = entry["topic"] | "";
+    job.payload = entry["payload"] | "";
+    job.cronText = entry["cron"] | "";
+    job.dueMs = entry["atMs"] | static_cast<uint64_t>(0);
+    if (!job.cronText.isEmpty() && !parseCron(job.cronText.c_str(), job.cron)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void load() {
+  if (!open()) return;
+  const size_t length = prefs.getBytesLength(kPrefsKeyJobs);
+  if (length == 0) return;
+  std::vector<uint8_t> blob(length);
+  if (prefs.getBytes(kPrefsKeyJobs, blob.data(), length) != length) return;
+  if (!parse(blob)) {
+    for (Job &job : jobs) job = Job();
+    ++counters.loadErrors;
+    LOG_W("[SCHED] Discarding corrupt jobs (%u bytes)",
+          static_cast<unsigned>(length));
+  }
+}
+
+}  // namespace
+
+void begin(DeviceManager &devices, FireCallback fire) {
+  deviceManager = &devices;
+  fireCallback = fire;
+  // Local time for cron rules, also before SNTP (configTzTime) has run.
+  setenv("TZ", SCHED_TIMEZONE, 1);
+  tzset();
+  load();
+  LOG_I("[SCHED] %u jobs loaded", static_cast<unsigned>(stats().jobs));
+}
+
+void clockAdjusted() { clockStepped = true; }
+
+uint64_t clockMs() {
+  timeval now;
+  gettimeofday(&now, nullptr);
+  if (now.tv_sec < kMinValidEpochS) return 0;
+  return static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+void loop(uint64_t nowMs) {
+  if (nowMs == 0) return;
+  if (clockStepped.exchange(false) || !clockSeen) {
+    clockSeen = true;
+    rearmAll(nowMs);
+    LOG_I("[SCHED] Clock set, %u jobs armed",
+          static_cast<unsigned>(pending.size()));
+  }
+
+  bool removed = false;
+  while (!pending.empty() && pending.topDue() <= nowMs) {
+    const uint8_t slot = pending.pop();
+    Job &job = jobs[slot];
+    const uint64_t lateMs = nowMs - job.dueMs;
+    const bool missed = lateMs > SCHED_LATE_LIMIT_MS;
+    if (missed) {
+      ++counters.missed;
+      LOG_W("[SCHED] Skipped '%s', %lu ms late", job.name.c_str(),
+            static_cast<unsigned long>(lateMs));
+    } else {
+      ++counters.fired;
+      if (lateMs > counters.lateMaxMs) {
+        counters.lateMaxMs = static_cast<uint32_t>(lateMs);
+      }
+      LOG_I("[SCHED] Firing '%s' (%lu ms late)", job.name.c_str(),
+            static_cast<unsigned long>(lateMs));
+      if (fireCallback != nullptr) {
+        fireCallback(job.topic.c_str(), job.payload.c_str(),
+                     job.payload.length());
+      }
+    }
+    if (job.cronText.isEmpty()) {
+      job = Job();
+      removed = true;
+      continue;
+    }
+    // From its own due time, so a late run does not push the next one back.
+    job.dueMs = nextOccurrence(job.cron, missed ? nowMs : job.dueMs);
+    if (job.dueMs != 0) pending.push(slot, job.dueMs);
+  }
+  if (removed) save();
+}
+
+bool define(JsonObjectConst spec, uint64_t nowMs, const char *&error) {
+  error = nullptr;
+  const char *name = spec["name"].as<const char *>();
+  if (KeyIds::isBlank(name) || strlen(name) > kMaxNameLength) {
+    error = "bad_name";
+    return false;
+  }
+  Job job;
+  job.used = true;
+  job.name = name;
+
+  // What to run: a scene, or a command for one device.
+  const char *scene = spec["scene"].as<const char *>();
+  const char *device = spec["device"].as<const char *>();
+  if (!KeyIds::isBlank(scene)) {
+    JsonDocument payload;
+    payload["name"] = scene;
+    job.topic = "scene/run";
+    serializeJson(payload, job.payload);
+  } else if (!KeyIds::isBlank(device)) {
+    DeviceController *controller = deviceManager->find(device);
+    JsonObjectConst command = spec["command"].as<JsonObjectConst>();
+    if (controller == nullptr) {
+      error = "unknown_device";
+      return false;
+    }
+    if (command.isNull() || command.size() == 0) {
+      error = "bad_command";
+      return false;
+    }
+    job.topic = String(controller->deviceType()) + "/cmd";
+    serializeJson(command, job.payload);
+  } else {
+    error = "no_action";
+    return false;
+  }
+
+  // When to run it: exactly one of "cron", "at" and "inMs".
+  const int timings = !spec["cron"].isNull() + !spec["at"].isNull() +
+                      !spec["inMs"].isNull();
+  if (timings != 1) {
+    error = "bad_time";
+    return false;
+  }
+  if (const char *cron = spec["cron"].as<const char *>()) {
+    if (!parseCron(cron, job.cron) ||
+        (nowMs != 0 && nextOccurrence(job.cron, nowMs) == 0)) {
+      error = "bad_cron";
+      return false;
+    }
+    job.cronText = cron;
+  } else if (!spec["at"].isNull()) {
+    const double atS = spec["at"].as<double>();
+    if (!(atS > kMinValidEpochS)) {
+      error = "bad_time";
+      return false;
+    }
+    job.dueMs = static_cast<uint64_t>(atS * 1000.0);
+  } else {
+    if (nowMs == 0) {
+      error = "clock_not_set";
+      return false;
+    }
+    job.dueMs = nowMs + (spec["inMs"] | static_cast<uint32_t>(0));
+  }
+  if (nowMs != 0 && job.cronText.isEmpty() &&
+      job.dueMs + SCHED_LATE_LIMIT_MS < nowMs) {
+    error = "in_past";
+    return false;
+  }
+
+  int slot = findSlot(name);
+  for (uint8_t i = 0; slot < 0 && i < SCHED_MAX_JOBS; ++i) {
+    if (!jobs[i].used) slot = i;
+  }
+  if (slot < 0) {
+    error = "too_many_jobs";
+    return false;
+  }
+  Job previous = jobs[slot];
+  jobs[slot] = job;
+  if (!save()) {
+    jobs[slot] = previous;
+    error = "write_failed";
+    return false;
+  }
+  pending.erase(static_cast<uint8_t>(slot));
+  if (clockSeen && nowMs != 0) arm(static_cast<uint8_t>(slot), nowMs);
+  LOG_I("[SCHED] Stored '%s' -> %s", name, job.topic.c_str());
+  return true;
+}
+
+bool remove(const char *name) {
+  const int slot = name != nullptr ? findSlot(name) : -1;
+  if (slot < 0) return false;
+  Job previous = jobs[slot];
+  jobs[slot] = Job();
+  if (!save()) {
+    jobs[slot] = previous;
+    return false;
+  }
+  pending.erase(static_cast<uint8_t>(slot));
+  LOG_I("[SCHED] Removed '%s'", name);
+  return true;
+}
+
+void list(JsonArray out) {
+  for (uint8_t slot = 0; slot < SCHED_MAX_JOBS; ++slot) {
+    const Job &job = jobs[slot];
+    if (!job.used) continue;
+    JsonObject entry = out.add<JsonObject>();
+    entry["name"] = job.name;
+    if (!job.cronText.isEmpty()) entry["cron"] = job.cronText;
+    if (pending.contains(slot)) entry["dueMs"] = job.dueMs;
+  }
+}
+
+Stats stats() {
+  Stats out = counters;
+  out.jobs = 0;
+  for (const Job &job : jobs) out.jobs += job.used ? 1 : 0;
+  return out;
+}
+
+}  // namespace Scheduler
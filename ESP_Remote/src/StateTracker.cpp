@@ -0,0 +1,32 @@
+#include "StateTracker.h"
+
+StateTracker::Publish StateTracker::update(JsonObjectConst state,
+                                           bool snapshot, bool deltas,
+                                           JsonDocument &out) {
+  out.clear();
+  JsonObject delta = out.to<JsonObject>();
+  JsonObjectConst last = last_.as<JsonObjectConst>();
+  for (JsonPairConst member : state) {
+    if (last[member.key()] != member.value()) {
+      delta[member.key()] = member.value();
+    }
+  }
+  for (JsonPairConst member : last) {
+    if (state[member.key()].isNull()) delta[member.key()] = nullptr;
+  }
+
+  const bool changed = delta.size() > 0;
+  if (changed) {
+    last_.set(state);
+    ++seq_;
+    changedAtMs_ = millis();
+  }
+  if (!changed && !snapshot) {
+    out.clear();
+    return Publish::kNothing;
+  }
+  if (snapshot || !deltas) out.set(state);
+  out["seq"] = seq_;
+  out["updatedAt"] = changedAtMs_;
+  return snapshot || !deltas ? Publish::kSnapshot : Publish::kDelta;
+}
@@ -0,0 +1,107 @@
+#include "Trace.h"
+
+#include <atomic>
+
+#include "Config.h"
+
+namespace Trace {
+namespace {
+
+static_assert(sizeof(Record) == 8, "trace records are meant to stay small");
+static_assert(TRACE_BUFFER_EVENTS > 0 &&
+                  (TRACE_BUFFER_EVENTS & (TRACE_BUFFER_EVENTS - 1)) == 0,
+              "TRACE_BUFFER_EVENTS must be a power of two");
+
+constexpr uint32_t kMask = TRACE_BUFFER_EVENTS - 1;
+
+// Slot i holds event number n when sequence[i] == n + 1; 0 while a writer
+// is filling it. `next` only grows, so a slot is reused every
+// TRACE_BUFFER_EVENTS events.
+Record ring[TRACE_BUFFER_EVENTS];
+std::atomic<uint32_t> sequence[TRACE_BUFFER_EVENTS];
+std::atomic<uint32_t> next{0};
+// Events numbered below this are hidden by clear().
+std::atomic<uint32_t> clearedBefore{0};
+
+}  // namespace
+
+void record(Event event, uint8_t tag, uint16_t value) {
+  if (!TRACE_ENABLED) return;
+  const uint32_t n = next.fetch_add(1, std::memory_order_relaxed);
+  const uint32_t slot = n & kMask;
+  sequence[slot].store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  ring[slot].atUs = micros();
+  ring[slot].value = value;
+  ring[slot].event = event;
+  ring[slot].tag = tag;
+  sequence[slot].store(n + 1, std::memory_order_release);
+}
+
+void snapshot(std::vector<Record> &out) {
+  out.clear();
+  const uint32_t end = next.load(std::memory_order_acquire);
+  uint32_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+  const uint32_t cleared = clearedBefore.load(std::memory_order_relaxed);
+  if (cleared > begin) begin = cleared;
+  out.reserve(end - begin);
+  for (uint32_t n = begin; n != end; ++n) {
+    const uint32_t slot = n & kMask;
+    if (sequence[slot].load(std::memory_order_acquire) != n + 1) continue;
+    const Record copy = ring[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Overwritten (or being overwritten) while copying.
+    if (sequence[slot].load(std::memory_order_relaxed) != n + 1) continue;
+    out.push_back(copy);
+  }
+}
+
+uint32_t recorded() { return next.load(std::memory_order_relaxed); }
+
+void clear() {
+  clearedBefore.store(next.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+}
+
+const char *eventName(Event event) {
+  switch (event) {
+    case Event::kMqttReceive:
+      return "mqtt_rx";
+    case Event::kJsonParsed:
+      return "json";
+    case Event::kDispatch:
+      return "dispatch";
+    case Event::kCommandDone:
+      return "cmd_done";
+    case Event::kIrQueued:
+      return "ir_queued";
+    case Event::kIrDropped:
+      return "ir_drop";
+    case Event::kIrStart:
+      return "ir_start";
+    case Event::kIrEnd:
+      return "ir_end";
+    case Event::kPublish:
+      return "publish";
+  }
+  return "?";
+}
+
+void toCsv(const std::vector<Record> &records, String &out) {
+  out = "us,event,tag,value\n";
+  out.reserve(out.length() + (records.size() + 1) * 28);
+  char line[48];
+  for (const Record &entry : records) {
+    snprintf(line, sizeof(line), "%lu,%s,%u,%u\n",
+             static_cast<unsigned long>(entry.atUs), eventName(entry.event),
+             static_cast<unsigned>(entry.tag),
+             static_cast<unsigned>(entry.value));
+    out += line;
+  }
+  snprintf(line, sizeof(line), "%lu,dump,0,%u\n",
+           static_cast<unsigned long>(micros()),
+           static_cast<unsigned>(records.size()));
+  out += line;
+}
+
+}  // namespace Trace
@@ -3,8 +3,12 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <WiFi.h>
+#include <string.h>
 #include <vector>
 
+#include "Config.h"
+#include "WifiScanCache.h"
+
 namespace WifiKnownNetworks {
 namespace {
 
@@ -15,12 +19,25 @@ constexpr size_t kMaxNetworks = 8;
 Preferences prefs;
 bool initialized = false;
 
-struct Stored {
-  String ssid;
-  String password;
-};
+std::vector<Network> cached;
 
-std::vector<Stored> cached;
+String bssidToHex(const uint8_t *bssid) {
+  char out[13];
+  snprintf(out, sizeof(out), "%02X%02X%02X%02X%02X%02X", bssid[0], bssid[1],
+           bssid[2], bssid[3], bssid[4], bssid[5]);
+  return String(out);
+}
+
+bool bssidFromHex(const char *hex, uint8_t *bssid) {
+  if (hex == nullptr || strlen(hex) != 12) return false;
+  for (size_t i = 0; i < 6; ++i) {
+    char byte[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    char *end = nullptr;
+    bssid[i] = static_cast<uint8_t>(strtoul(byte, &end, 16));
+    if (end != byte + 2) return false;
+  }
+  return true;
+}
 
 String normalizeSsid(const String &ssid) {
   String out = ssid;
@@ -39,8 +56,17 @@ void loadFromPrefs() {
   for (JsonVariant v : arr) {
     const String ssid = normalizeSsid(String(v["ssid"] | ""));
     if (ssid.isEmpty()) continue;
-    const String password = String(v["pw"] | "");
-    cached.push_back(Stored{ssid, password});
+    Network stored;
+    stored.ssid = ssid;
+    stored.password = String(v["pw"] | "");
+    if (bssidFromHex(v["bssid"] | "", stored.bssid)) {
+      stored.channel = v["ch"] | 0;
+    }
+    stored.ip = v["ip"].as<uint32_t>();
+    stored.gateway = v["gw"].as<uint32_t>();
+    stored.subnet = v["mask"].as<uint32_t>();
+    stored.dns = v["dns"].as<uint32_t>();
+    cached.push_back(stored);
     if (cached.size() >= kMaxNetworks) break;
   }
 }
@@ -52,6 +78,16 @@ void saveToPrefs() {
     JsonObject o = arr.add<JsonObject>();
     o["ssid"] = n.ssid;
     o["pw"] = n.password;
+    if (n.channel != 0) {
+      o["bssid"] = bssidToHex(n.bssid);
+      o["ch"] = n.channel;
+    }
+    if (n.ip != 0) {
+      o["ip"] = n.ip;
+      o["gw"] = n.gateway;
+      o["mask"] = n.subnet;
+      o["dns"] = n.dns;
+    }
   }
   String out;
   serializeJson(doc, out);
@@ -95,7 +131,10 @@ void upsert(const String &ssid, const String &password) {
     }
     moveToFront(static_cast<size_t>(idx));
   } else {
-    cached.insert(cached.begin(), Stored{normalized, password});
+    Network stored;
+    stored.ssid = normalized;
+    stored.password = password;
+    cached.insert(cached.begin(), stored);
     if (cached.size() > kMaxNetworks) {
       cached.resize(kMaxNetworks);
     }
@@ -111,43 +150,54 @@ void markUsed(const String &ssid) {
   saveToPrefs();
 }
 
-bool selectBestFromScan(Network &out) {
+void rememberLink(const String &ssid, const uint8_t *bssid, uint8_t channel,
+                  uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns) {
   begin();
-  if (cached.empty()) return false;
-
-  const int n = WiFi.scanNetworks(/*async=*/false, /*hidden=*/true);
-  if (n <= 0) {
-    WiFi.scanDelete();
-    return false;
-  }
+  const int idx = findIndexBySsid(ssid);
+  if (idx < 0) return;
+  Network &entry = cached[static_cast<size_t>(idx)];
+  const bool sameBssid =
+      bssid == nullptr || memcmp(entry.bssid, bssid, sizeof(entry.bssid)) == 0;
+  const bool changed = idx != 0 || !sameBssid || entry.channel != channel ||
+                       entry.ip != ip || entry.gateway != gateway ||
+                       entry.subnet != subnet || entry.dns != dns;
+  if (!changed) return;
+
+  if (bssid != nullptr) memcpy(entry.bssid, bssid, sizeof(entry.bssid));
+  entry.channel = bssid != nullptr ? channel : 0;
+  entry.ip = ip;
+  entry.gateway = gateway;
+  entry.subnet = subnet;
+  entry.dns = dns;
+  moveToFront(static_cast<size_t>(idx));
+  saveToPrefs();
+}
 
-  int bestRssi = -10000;
-  int bestScanIndex = -1;
-  int bestKnownIndex = -1;
+bool lastLink(Network &out) {
+  begin();
+  if (cached.empty() || cached.front().channel == 0) return false;
+  out = cached.front();
+  return true;
+}
 
-  for (int i = 0; i < n; ++i) {
-    const String ssid = normalizeSsid(WiFi.SSID(i));
-    if (ssid.isEmpty()) continue;
-    const int knownIdx = findIndexBySsid(ssid);
-    if (knownIdx < 0) continue;
+ScanPick selectBestFromScan(Network &out) {
+  begin();
+  if (cached.empty()) return ScanPick::kNoMatch;
 
-    const int rssi = WiFi.RSSI(i);
-    if (bestScanIndex == -1 || rssi > bestRssi) {
-      bestRssi = rssi;
-      bestScanIndex = i;
-      bestKnownIndex = knownIdx;
-    }
+  if (!WifiScanCache::hasResults() ||
+      WifiScanCache::ageMs() > WIFI_SCAN_MAX_AGE_MS) {
+    WifiScanCache::request();
+    return ScanPick::kPending;
   }
 
-  if (bestKnownIndex < 0) {
-    WiFi.scanDelete();
-    return false;
+  // Results are sorted by RSSI, so the first known SSID is the best one.
+  for (const auto &seen : WifiScanCache::results()) {
+    const int knownIdx = findIndexBySsid(seen.ssid);
+    if (knownIdx < 0) continue;
+    out = cached[static_cast<size_t>(knownIdx)];
+    return ScanPick::kPicked;
   }
-  const auto &picked = cached[static_cast<size_t>(bestKnownIndex)];
-  out.ssid = picked.ssid;
-  out.password = picked.password;
-  WiFi.scanDelete();
-  return true;
+  return ScanPick::kNoMatch;
 }
 
 size_t count() {
@@ -0,0 +1,95 @@
+#include "WifiScanCache.h"
+
+#include <WiFi.h>
+#include <algorithm>
+#include <string.h>
+
+#include "Config.h"
+#include "Log.h"
+
+namespace WifiScanCache {
+namespace {
+
+constexpr uint32_t kScanTimeoutMs = 15000;
+
+std::vector<Entry> cached;
+bool running = false;
+bool requested = false;
+bool completed = false;
+uint32_t startedAt = 0;
+uint32_t completedAt = 0;
+
+void collect(int16_t count) {
+  cached.clear();
+  cached.reserve(count > 0 ? count : 0);
+  for (int16_t i = 0; i < count; ++i) {
+    Entry entry;
+    entry.ssid = WiFi.SSID(i);
+    entry.rssi = WiFi.RSSI(i);
+    entry.encryption = static_cast<uint8_t>(WiFi.encryptionType(i));
+    entry.channel = static_cast<uint8_t>(WiFi.channel(i));
+    if (const uint8_t *bssid = WiFi.BSSID(i)) {
+      memcpy(entry.bssid, bssid, sizeof(entry.bssid));
+    }
+    cached.push_back(entry);
+  }
+  std::stable_sort(cached.begin(), cached.end(),
+                   [](const Entry &a, const Entry &b) { return a.rssi > b.rssi; });
+}
+
+void finish(uint32_t now) {
+  WiFi.scanDelete();
+  running = false;
+  completed = true;
+  completedAt = now;
+}
+
+}  // namespace
+
+void loop(bool periodic) {
+  const uint32_t now = millis();
+  if (running) {
+    const int16_t result = WiFi.scanComplete();
+    if (result >= 0) {
+      collect(result);
+      finish(now);
+      LOG_D("[WIFI][SCAN] %d networks in %lums", result,
+            static_cast<unsigned long>(now - startedAt));
+    } else if (result == WIFI_SCAN_FAILED || now - startedAt >= kScanTimeoutMs) {
+      cached.clear();
+      finish(now);
+      LOG_W("[WIFI][SCAN] Scan failed");
+    }
+    return;
+  }
+
+  const bool stale = !completed || now - completedAt >= WIFI_SCAN_REFRESH_MS;
+  if (!requested && !(periodic && stale)) return;
+
+  requested = false;
+  if (WiFi.scanNetworks(/*async=*/true, /*hidden=*/true) == WIFI_SCAN_FAILED) {
+    cached.clear();
+    finish(now);
+    LOG_W("[WIFI][SCAN] Could not start scan");
+    return;
+  }
+  running = true;
+  startedAt = now;
+}
+
+void request() {
+  if (!running) requested = true;
+}
+
+bool scanning() { return running || requested; }
+
+bool hasResults() { return completed; }
+
+uint32_t ageMs() {
+  if (!completed) return UINT32_MAX;
+  return millis() - completedAt;
+}
+
+const std::vector<Entry> &results() { return cached; }
+
+}  // namespace WifiScanCache
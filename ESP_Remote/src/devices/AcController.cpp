@@ -2,9 +2,12 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <strings.h>
 #include <IRutils.h>
 #include <vector>
 
+#include "Log.h"
+
 namespace {
 #if !AC_CONTROLLER_HAS_REMOTE_MODEL_ENUM
 constexpr uint16_t kDaikinBase = 0x0100;
@@ -18,14 +21,6 @@ constexpr uint16_t kTclBase = 0x0800;
 constexpr uint16_t kAquaBase = 0x0900;
 #endif
 
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
-
 String bytesToHexString(const std::vector<uint8_t> &bytes) {
   static const char kHexChars[] = "0123456789ABCDEF";
   String out;
@@ -113,20 +108,28 @@ const AcController::IrModelConfig AcController::kModels[] = {
 
 #undef AC_REMOTE_MODEL
 
-AcController::AcController(const char *nodeId, uint8_t irPin)
+size_t AcController::modelCount() {
+  return sizeof(kModels) / sizeof(kModels[0]);
+}
+
+const AcController::IrModelConfig &AcController::model(size_t index) {
+  return kModels[index < modelCount() ? index : 0];
+}
+
+AcController::AcController(const char *nodeId, IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/ac/state"),
-      irPin_(irPin),
-      irAc_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {
+  IRac::initState(&irState_);
+}
 
 void AcController::begin() {
-  if (!irReady_) {
-    tryBegin(irAc_, 0);
-    tryBegin(irSend_, 0);
-    irReady_ = true;
+  learned_.persistAs(deviceType());
+  if (AC_STATE_PERSIST && AcStateStore::load(state_, remote_)) {
+    LOG_I("[AC] Restored power=%d mode=%s temp=%d fan=%s brand=%s",
+          static_cast<int>(state_.power), state_.mode.c_str(), state_.temp,
+          state_.fan.c_str(), remote_.brand.c_str());
   }
-
-  Serial.printf("[AC] Controller ready (IR pin=%u)\n", irPin_);
+  LOG_I("[AC] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void AcController::serializeState(JsonDocument &doc) const {
@@ -139,7 +142,6 @@ void AcController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remote_.brand;
   doc["type"] = remote_.type;
   doc["index"] = remote_.index;
-  doc["updatedAt"] = millis();
 }
 
 bool AcController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
@@ -150,46 +152,30 @@ bool AcController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   if (cmd["index"].is<uint16_t>())
     remote_.index = cmd["index"].as<uint16_t>();
 
-  String command = cmd["cmd"].as<String>();
-  if (command.isEmpty()) {
-    Serial.println(F("[AC] Missing command name"));
+  const char *command = cmd["cmd"].as<const char *>();
+  if (command == nullptr || command[0] == '\0') {
+    LOG_W("[AC] Missing command name");
     return false;
   }
-  if (command.equalsIgnoreCase("key")) {
-    const String key = cmd["key"].as<String>();
-    if (key.isEmpty()) {
-      Serial.println(F("[AC] Missing key name"));
+  if (strcasecmp(command, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[AC] Missing key name");
       return false;
     }
 
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          uint64_t value = 0;
-          if (bits <= 64) value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::find(keyName);
+    } else {
+      key = KeyIds::intern(keyName);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     if (!sendLearnedKey(key)) {
-      Serial.printf("[AC][IR] No learned mapping for key=%s\n", key.c_str());
+      ++metrics_.unknownKeys;
+      LOG_W("[AC][IR] No learned mapping for key=%s", keyName);
       return false;
     }
 
@@ -198,15 +184,15 @@ bool AcController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   }
   bool stateChanged = false;
 
-  if (command.equalsIgnoreCase("power")) {
+  if (strcasecmp(command, "power") == 0) {
     if (cmd["value"].is<bool>()) {
       state_.power = cmd["value"].as<bool>();
       stateChanged = true;
     }
-  } else if (command.equalsIgnoreCase("toggle")) {
+  } else if (strcasecmp(command, "toggle") == 0) {
     state_.power = !state_.power;
     stateChanged = true;
-  } else if (command.equalsIgnoreCase("set")) {
+  } else if (strcasecmp(command, "set") == 0) {
     if (cmd["power"].is<bool>())
       state_.power = cmd["power"].as<bool>();
     if (cmd["mode"].is<const char *>())
@@ -218,51 +204,107 @@ bool AcController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
     if (cmd["swing"].is<bool>())
       state_.swing = cmd["swing"].as<bool>();
     stateChanged = true;
-  } else if (command.equalsIgnoreCase("temp")) {
+  } else if (strcasecmp(command, "temp") == 0) {
     if (cmd["value"].is<int>()) {
       state_.temp = cmd["value"].as<int>();
       stateChanged = true;
     }
-  } else if (command.equalsIgnoreCase("mode")) {
+  } else if (strcasecmp(command, "mode") == 0) {
     if (cmd["value"].is<const char *>()) {
       state_.mode = cmd["value"].as<const char *>();
       stateChanged = true;
     }
-  } else if (command.equalsIgnoreCase("fan")) {
+  } else if (strcasecmp(command, "fan") == 0) {
     if (cmd["value"].is<const char *>()) {
       state_.fan = cmd["value"].as<const char *>();
       stateChanged = true;
     }
-  } else if (command.equalsIgnoreCase("swing")) {
+  } else if (strcasecmp(command, "swing") == 0) {
     if (cmd["value"].is<bool>()) {
       state_.swing = cmd["value"].as<bool>();
       stateChanged = true;
     }
+  } else if (strcasecmp(command, "flush") == 0) {
+    if (!flush()) return false;
+    stateDoc.clear();
+    serializeState(stateDoc);
+    return true;
   }
 
   if (!stateChanged) {
     return false;
   }
 
-  return applyState(stateDoc);
+  // "flush": true on any state command skips the window as well.
+  if (AC_COALESCE_WINDOW_MS == 0 || cmd["flush"].as<bool>()) {
+    applyState();
+    stateDoc.clear();
+    serializeState(stateDoc);
+    return true;
+  }
+  if (pending_) {
+    ++metrics_.coalesced;
+  } else {
+    pending_ = true;
+    pendingSinceMs_ = millis();
+  }
+  return false;
+}
+
+bool AcController::flush() {
+  if (!pending_) return false;
+  applyState();
+  return true;
 }
 
-bool AcController::applyState(JsonDocument &stateDoc) {
+bool AcController::poll() {
+  persistIfDue();
+  if (!pending_ || millis() - pendingSinceMs_ < AC_COALESCE_WINDOW_MS) {
+    return false;
+  }
+  applyState();
+  return true;
+}
+
+void AcController::persistIfDue() {
+  if (!unsaved_) return;
+  const uint32_t now = millis();
+  const bool idle = now - lastSentMs_ >= AC_STATE_WRITE_DELAY_MS;
+  const bool overdue = now - unsavedSinceMs_ >= AC_STATE_WRITE_MAX_DELAY_MS;
+  if (!idle && !overdue) return;
+  // On a write error the next attempt waits for another full delay.
+  if (AcStateStore::save(state_, remote_)) {
+    unsaved_ = false;
+  } else {
+    unsavedSinceMs_ = now;
+    lastSentMs_ = now;
+  }
+}
+
+void AcController::applyState() {
+  pending_ = false;
+  if (AC_STATE_PERSIST) {
+    lastSentMs_ = millis();
+    if (!unsaved_) {
+      unsaved_ = true;
+      unsavedSinceMs_ = lastSentMs_;
+    }
+  }
   const IrModelConfig *model =
       findModel(remote_.brand, remote_.type, remote_.index);
   if (model == nullptr) {
-    Serial.printf("[AC][IR] No IR model for brand=%s type=%s index=%u\n",
-                  remote_.brand.c_str(), remote_.type.c_str(), remote_.index);
+    LOG_W("[AC][IR] No IR model for brand=%s type=%s index=%u",
+          remote_.brand.c_str(), remote_.type.c_str(), remote_.index);
   } else if (!IRac::isProtocolSupported(model->protocol)) {
-    Serial.printf(
+    LOG_W(
         "[AC][IR] Unsupported protocol=%s for brand=%s type=%s index=%u. "
-        "Use learning mode.\n",
+        "Use learning mode.",
         typeToString(model->protocol).c_str(), model->brand,
         (model->type ? model->type : ""), model->index);
   } else {
-    Serial.printf(
+    LOG_D(
         "[AC][IR] Sending brand=%s type=%s index=%u protocol=%s(%d) power=%d "
-        "mode=%s temp=%d fan=%s swing=%d\n",
+        "mode=%s temp=%d fan=%s swing=%d",
         remote_.brand.c_str(), remote_.type.c_str(), remote_.index,
         typeToString(model->protocol).c_str(), static_cast<int>(model->protocol),
         static_cast<int>(state_.power), state_.mode.c_str(), state_.temp,
@@ -271,97 +313,102 @@ bool AcController::applyState(JsonDocument &stateDoc) {
     if (remote_.type.length() == 0 && model->type != nullptr)
       remote_.type = model->type;
     if (remote_.index == 0) remote_.index = model->index;
-    irAc_.next.protocol = model->protocol;
-    irAc_.next.model = model->model;
-    irAc_.next.power = state_.power;
-    irAc_.next.degrees = state_.temp;
-    irAc_.next.celsius = true;
-    irAc_.next.mode = parseMode(state_.mode);
-    irAc_.next.fanspeed = parseFan(state_.fan);
-    irAc_.next.swingv = parseSwing(state_.swing);
-    irAc_.next.swingh = stdAc::swingh_t::kOff;
+    irState_.protocol = model->protocol;
+    irState_.model = model->model;
+    irState_.power = state_.power;
+    irState_.degrees = state_.temp;
+    irState_.celsius = true;
+    irState_.mode = parseMode(state_.mode);
+    irState_.fanspeed = parseFan(state_.fan);
+    irState_.swingv = parseSwing(state_.swing);
+    irState_.swingh = stdAc::swingh_t::kOff;
     // Some IRremoteESP8266 releases expose the light field as a private enum,
     // so skip forcing it on to keep compilation working across versions.
-    irAc_.sendAc();
-    Serial.println(F("[AC][IR] Command sent"));
+    if (ir_.sendAc(irState_)) {
+      ++metrics_.codesetHits;
+      LOG_D("[AC][IR] Command queued");
+    }
   }
-
-  stateDoc.clear();
-  serializeState(stateDoc);
-  return true;
 }
 
 bool AcController::learnKey(const String &key, decode_type_t protocol,
                             uint64_t value, uint16_t nbits,
-                            const std::vector<uint8_t> &raw) {
-  if (key.length() == 0 || protocol == decode_type_t::UNKNOWN || nbits == 0) {
-    return false;
+                            const std::vector<uint8_t> &raw,
+                            const std::vector<uint8_t> &timing) {
+  return learned_.save(KeyIds::intern(key.c_str()), protocol, value, nbits,
+                       raw, timing);
+}
+
+uint8_t AcController::sendKeyPresses(const char *keyName, uint8_t presses,
+                                     uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::find(keyName);
+  uint8_t sent = 0;
+  while (sent < presses && sendLearnedKey(key, gapAfterMs)) {
+    ++sent;
   }
-  saveLearnedCommand(key, protocol, value, nbits, raw);
-  return true;
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[AC][IR] No learned mapping for key=%s", keyName);
+  }
+  return sent;
 }
 
-void AcController::saveLearnedCommand(const String &key, decode_type_t protocol,
-                                      uint64_t value, uint16_t nbits,
-                                      const std::vector<uint8_t> &raw) {
-  const uint64_t safeValue = (nbits > 64) ? 0 : value;
-  for (auto &entry : learnedCommands_) {
-    if (key.equalsIgnoreCase(entry.key)) {
-      entry.protocol = protocol;
-      entry.value = safeValue;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool AcController::resolveKey(const char *keyName, IrFrame &frame) {
+  const LearnedKey *entry = learned_.find(KeyIds::find(keyName));
+  if (entry == nullptr || (entry->nbits > 64 && entry->raw.empty())) {
+    return false;
   }
+  frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                            entry->raw);
+  if (!frame.state.empty()) {
+    frame.repeat = IR_AC_LEARNED_BURST_COUNT == 0 ? 1
+                                                  : IR_AC_LEARNED_BURST_COUNT;
+    frame.repeatGapMs = IR_AC_LEARNED_BURST_GAP_MS;
+  }
+  return true;
+}
 
-  LearnedCommand cmd;
-  cmd.key = key;
-  cmd.protocol = protocol;
-  cmd.value = safeValue;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
+void AcController::applySceneState(const AcState &state) {
+  state_ = state;
+  applyState();
 }
 
-bool AcController::sendLearnedKey(const String &key) {
-  for (const auto &entry : learnedCommands_) {
-    if (key.equalsIgnoreCase(entry.key)) {
-      const String protocolName = typeToString(entry.protocol);
-      if (entry.nbits > 64) {
-        if (entry.raw.empty()) {
-          Serial.printf(
-              "[AC][IR] Learned key=%s missing raw protocol=%s(%d) bits=%u\n",
-              key.c_str(), protocolName.c_str(),
-              static_cast<int>(entry.protocol), entry.nbits);
-          return false;
-        }
-
-        uint8_t burstCount = IR_AC_LEARNED_BURST_COUNT;
-        if (burstCount == 0) burstCount = 1;
-        for (uint8_t i = 0; i < burstCount; ++i) {
-          irSend_.send(entry.protocol, entry.raw.data(),
-                       static_cast<uint16_t>(entry.raw.size()));
-          if (i + 1 < burstCount) delay(IR_AC_LEARNED_BURST_GAP_MS);
-        }
-        const String code = bytesToHexString(entry.raw);
-        Serial.printf(
-            "[AC][IR] Sent learned key=%s protocol=%s(%d) bits=%u code=%s burst=%u\n",
-            key.c_str(), protocolName.c_str(),
-            static_cast<int>(entry.protocol), entry.nbits, code.c_str(),
-            burstCount);
-      } else {
-        irSend_.send(entry.protocol, entry.value, entry.nbits);
-        Serial.printf(
-            "[AC][IR] Sent learned key=%s protocol=%s(%d) value=0x%llX bits=%u\n",
-            key.c_str(), protocolName.c_str(),
-            static_cast<int>(entry.protocol),
-            static_cast<unsigned long long>(entry.value), entry.nbits);
-      }
-      return true;
+bool AcController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  if (entry->nbits > 64) {
+    if (entry->raw.empty()) {
+      LOG_W(
+          "[AC][IR] Learned key=%s missing raw protocol=%s(%d) bits=%u",
+          KeyIds::name(key), typeToString(entry->protocol).c_str(),
+          static_cast<int>(entry->protocol), entry->nbits);
+      return false;
     }
+
+    uint8_t burstCount = IR_AC_LEARNED_BURST_COUNT;
+    if (burstCount == 0) burstCount = 1;
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), burstCount,
+                  IR_AC_LEARNED_BURST_GAP_MS, gapAfterMs, entry->timing);
+    ++metrics_.learnedHits;
+    // The hex dump and protocol name are only built when LOG_D is compiled in.
+    LOG_D(
+        "[AC][IR] Queued learned key=%s protocol=%s(%d) bits=%u code=%s burst=%u",
+        KeyIds::name(key), typeToString(entry->protocol).c_str(),
+        static_cast<int>(entry->protocol), entry->nbits,
+        bytesToHexString(entry->raw).c_str(), burstCount);
+  } else {
+    ir_.sendValue(entry->protocol, entry->value, entry->nbits, gapAfterMs);
+    ++metrics_.learnedHits;
+    LOG_D(
+        "[AC][IR] Queued learned key=%s protocol=%s(%d) value=0x%llX bits=%u",
+        KeyIds::name(key), typeToString(entry->protocol).c_str(),
+        static_cast<int>(entry->protocol),
+        static_cast<unsigned long long>(entry->value), entry->nbits);
   }
-  return false;
+  return true;
 }
 
 const AcController::IrModelConfig *AcController::findModel(const String &brand,
@@ -4,65 +4,49 @@
 #include <IRutils.h>
 #include <algorithm>
 #include <cstdlib>
+#include <strings.h>
 
-namespace {
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
-
-String canonicalizeKey(const String &key) {
-  String out = key;
-  out.trim();
-  out.toUpperCase();
+#include "CodesetIndex.h"
+#include "Log.h"
 
-  // Common aliases (helps keep ESP compatible if Android naming changes).
-  if (out.equalsIgnoreCase("EJECTCD") || out.equalsIgnoreCase("OPEN") ||
-      out.equalsIgnoreCase("TRAY")) {
-    return "EJECT";
-  }
-  if (out.equalsIgnoreCase("PLAYPAUSE") || out.equalsIgnoreCase("PLAY/PAUSE") ||
-      out.equalsIgnoreCase("PLAY_PAUSE")) {
-    return "PLAY_PAUSE";
-  }
-  if (out.equalsIgnoreCase("FAST_FORWARD") || out.equalsIgnoreCase("FORWARD") ||
-      out.equalsIgnoreCase("FFWD") || out.equalsIgnoreCase("FWD")) {
-    return "FF";
-  }
-  if (out.equalsIgnoreCase("FAST_BACKWARD") || out.equalsIgnoreCase("REWIND") ||
-      out.equalsIgnoreCase("BACKWARD") || out.equalsIgnoreCase("RW") ||
-      out.equalsIgnoreCase("RWD")) {
-    return "REW";
-  }
-  if (out.equalsIgnoreCase("PREVIOUS") || out.equalsIgnoreCase("PREV") ||
-      out.equalsIgnoreCase("SKIP_PREV") || out.equalsIgnoreCase("SKIP_BACK") ||
-      out.equalsIgnoreCase("TRACK_PREV")) {
-    return "PREV";
-  }
-  if (out.equalsIgnoreCase("SKIP_NEXT") || out.equalsIgnoreCase("SKIP_FORWARD") ||
-      out.equalsIgnoreCase("TRACK_NEXT")) {
-    return "NEXT";
-  }
-  if (out.equalsIgnoreCase("ENTER") || out.equalsIgnoreCase("SELECT") ||
-      out.equalsIgnoreCase("CONFIRM")) {
-    return "OK";
-  }
-  if (out.equalsIgnoreCase("RETURN")) {
-    return "BACK";
-  }
-  if (out.equalsIgnoreCase("SETTINGS") || out.equalsIgnoreCase("OPTIONS") ||
-      out.equalsIgnoreCase("SETUP")) {
-    return "MENU";
-  }
-
-  return out;
-}
+namespace {
+// Common aliases (helps keep ESP compatible if Android naming changes).
+constexpr KeyName kDvdAliases[] = {
+    {"EJECTCD", KeyId::kEject},
+    {"OPEN", KeyId::kEject},
+    {"TRAY", KeyId::kEject},
+    {"PLAYPAUSE", KeyId::kPlayPause},
+    {"PLAY/PAUSE", KeyId::kPlayPause},
+    {"FAST_FORWARD", KeyId::kFf},
+    {"FORWARD", KeyId::kFf},
+    {"FFWD", KeyId::kFf},
+    {"FWD", KeyId::kFf},
+    {"FAST_BACKWARD", KeyId::kRew},
+    {"REWIND", KeyId::kRew},
+    {"BACKWARD", KeyId::kRew},
+    {"RW", KeyId::kRew},
+    {"RWD", KeyId::kRew},
+    {"PREVIOUS", KeyId::kPrev},
+    {"SKIP_PREV", KeyId::kPrev},
+    {"SKIP_BACK", KeyId::kPrev},
+    {"TRACK_PREV", KeyId::kPrev},
+    {"SKIP_NEXT", KeyId::kNext},
+    {"SKIP_FORWARD", KeyId::kNext},
+    {"TRACK_NEXT", KeyId::kNext},
+    {"ENTER", KeyId::kOk},
+    {"SELECT", KeyId::kOk},
+    {"CONFIRM", KeyId::kOk},
+    {"RETURN", KeyId::kBack},
+    {"SETTINGS", KeyId::kMenu},
+    {"OPTIONS", KeyId::kMenu},
+    {"SETUP", KeyId::kMenu},
+};
+constexpr auto kDvdKeyAliases = KeyIds::makeAliasTable(kDvdAliases);
+static_assert(kDvdKeyAliases.index.complete,
+              "DVD key aliases: no perfect-hash seed found");
 
 // LG Blu-ray/DVD (BD300) - NECx (use NEC 32-bit payload with pre_data 0xB4B4)
-const DvdController::KeyCommand kLgDvdCommands1[] = {
+constexpr DvdController::KeyCommand kLgDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0xB4B46E91, 32},
     {"MUTE", decode_type_t::NEC, 0xB4B4F20D, 32},  // KEY_AUDIO (fallback)
     {"EJECT", decode_type_t::NEC, 0xB4B46C93, 32},
@@ -104,7 +88,7 @@ const DvdController::KeyCommand kLgDvdCommands1[] = {
 };
 
 // Samsung DVD (SV-DVD3E) - NECx (use NEC 32-bit payload with pre_data 0xA0A0)
-const DvdController::KeyCommand kSamsungDvdCommands1[] = {
+constexpr DvdController::KeyCommand kSamsungDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0xA0A040BF, 32},       // STANDBY/ON
     {"EJECT", decode_type_t::NEC, 0xA0A04CB3, 32},       // KEY_OPEN
     {"PLAY_PAUSE", decode_type_t::NEC, 0xA0A09867, 32},  // KEY_PLAYPAUSE
@@ -142,7 +126,7 @@ const DvdController::KeyCommand kSamsungDvdCommands1[] = {
 
 // Sony DVD - RMT-V501A (Sony20 / SIRC 20-bit, device=26 ext=83)
 // Values are compatible with IRsend::sendSony() format (bit-reversed payload).
-const DvdController::KeyCommand kSonyDvdCommands1[] = {
+constexpr DvdController::KeyCommand kSonyDvdCommands1[] = {
     {"POWER", decode_type_t::SONY, 0xA8BCA, 20},
     {"EJECT", decode_type_t::SONY, 0x68BCA, 20},
     {"PLAY_PAUSE", decode_type_t::SONY, 0x98BCA, 20},  // Use PAUSE as toggle-like
@@ -178,7 +162,7 @@ const DvdController::KeyCommand kSonyDvdCommands1[] = {
 
 // Sony DVD - RMT-V181N (Sony12 / SIRC 12-bit, mixed device ids)
 // Values are compatible with IRsend::sendSony() format (bit-reversed payload).
-const DvdController::KeyCommand kSonyDvdCommands2[] = {
+constexpr DvdController::KeyCommand kSonyDvdCommands2[] = {
     {"POWER", decode_type_t::SONY, 0x0A9A, 12},    // VTRPOWER (device 11)
     {"EJECT", decode_type_t::SONY, 0x069A, 12},    // KEY_EJECTCD (device 11)
     {"PLAY_PAUSE", decode_type_t::SONY, 0x059A, 12},
@@ -206,7 +190,7 @@ const DvdController::KeyCommand kSonyDvdCommands2[] = {
 };
 
 // Panasonic DVD (IRDB: Panasonic/DVD Player/176,0.csv) - Panasonic 48-bit.
-const DvdController::KeyCommand kPanasonicDvdCommands1[] = {
+constexpr DvdController::KeyCommand kPanasonicDvdCommands1[] = {
     {"POWER", decode_type_t::PANASONIC, 0x4004B0003D8D, 48},
     {"EJECT", decode_type_t::PANASONIC, 0x4004B00001B1, 48},  // OPEN/CLOSE
     {"PLAY_PAUSE", decode_type_t::PANASONIC, 0x4004B0000ABA, 48},  // PLAY
@@ -241,7 +225,7 @@ const DvdController::KeyCommand kPanasonicDvdCommands1[] = {
 };
 
 // Philips DVD (IRDB: Philips/DVD Player/4,-1.csv) - RC6 mode0 20-bit.
-const DvdController::KeyCommand kPhilipsDvdCommands1[] = {
+constexpr DvdController::KeyCommand kPhilipsDvdCommands1[] = {
     // Values are compatible with IRsend::sendRC6() format.
     // (mode=0, addr=4, cmd=<x>) => 0x4<cmd>
     {"POWER", decode_type_t::RC6, 0x40C, 20},
@@ -271,7 +255,7 @@ const DvdController::KeyCommand kPhilipsDvdCommands1[] = {
 };
 
 // Toshiba DVD (IRDB: Toshiba/DVD Player/69,-1.csv) - NEC1/NEC 32-bit.
-const DvdController::KeyCommand kToshibaDvdCommands1[] = {
+constexpr DvdController::KeyCommand kToshibaDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x45BA12ED, 32},
     {"PLAY_PAUSE", decode_type_t::NEC, 0x45BA15EA, 32},  // PLAY
     {"STOP", decode_type_t::NEC, 0x45BA14EB, 32},
@@ -305,7 +289,7 @@ const DvdController::KeyCommand kToshibaDvdCommands1[] = {
 };
 
 // JVC DVD (IRDB: JVC/DVD Player/239,-1.csv) - JVC 16-bit.
-const DvdController::KeyCommand kJvcDvdCommands1[] = {
+constexpr DvdController::KeyCommand kJvcDvdCommands1[] = {
     // Values are compatible with IRsend::sendJVC() format.
     {"POWER", decode_type_t::JVC, 0xF702, 16},
     {"EJECT", decode_type_t::JVC, 0xF722, 16},        // OPEN/CLOSE
@@ -333,7 +317,7 @@ const DvdController::KeyCommand kJvcDvdCommands1[] = {
 };
 
 // Yamaha DVD (IRDB: Yamaha/DVD Player/124,-1.csv) - NEC1/NEC 32-bit.
-const DvdController::KeyCommand kYamahaDvdCommands1[] = {
+constexpr DvdController::KeyCommand kYamahaDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x7C83807F, 32},
     {"EJECT", decode_type_t::NEC, 0x7C83817E, 32},       // OPEN/CLOSE
     {"PLAY_PAUSE", decode_type_t::NEC, 0x7C83827D, 32},  // PLAY
@@ -365,7 +349,7 @@ const DvdController::KeyCommand kYamahaDvdCommands1[] = {
 };
 
 // Magnavox DVD (IRDB: Magnavox/DVD Player/1,-1.csv) - NEC1/NEC 32-bit.
-const DvdController::KeyCommand kMagnavoxDvdCommands1[] = {
+constexpr DvdController::KeyCommand kMagnavoxDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x01FE16E9, 32},
     {"EJECT", decode_type_t::NEC, 0x01FE1EE1, 32},       // OPEN/CLOSE
     {"PLAY_PAUSE", decode_type_t::NEC, 0x01FE0FF0, 32},
@@ -394,7 +378,7 @@ const DvdController::KeyCommand kMagnavoxDvdCommands1[] = {
 };
 
 // Memorex DVD (IRDB: Memorex/DVD Player/0,-1.csv) - NEC1/NEC 32-bit.
-const DvdController::KeyCommand kMemorexDvdCommands1[] = {
+constexpr DvdController::KeyCommand kMemorexDvdCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x00FFC53A, 32},
     {"PLAY_PAUSE", decode_type_t::NEC, 0x00FF936C, 32},  // PLAY/SELECT
     {"STOP", decode_type_t::NEC, 0x00FFC936, 32},
@@ -420,9 +404,9 @@ const DvdController::KeyCommand kMemorexDvdCommands1[] = {
     {"DIGIT_9", decode_type_t::NEC, 0x00FFCD32, 32},
 };
 
-const DvdController::KeyCommand kGenericDvdCommands[] = {};
+constexpr DvdController::KeyCommand kGenericDvdCommands[] = {};
 
-const DvdController::RemoteConfig kDvdRemotes[] = {
+constexpr DvdController::RemoteConfig kDvdRemotes[] = {
     {"", "", 0, kGenericDvdCommands,
      sizeof(kGenericDvdCommands) / sizeof(kGenericDvdCommands[0])},
 
@@ -473,6 +457,11 @@ const DvdController::RemoteConfig kDvdRemotes[] = {
     {"", "DVD", 2011, kMemorexDvdCommands1,
      sizeof(kMemorexDvdCommands1) / sizeof(kMemorexDvdCommands1[0])},
 };
+
+constexpr auto kDvdRemoteIndex = CodesetIndex::buildRemoteIndex(kDvdRemotes);
+constexpr auto kDvdKeyIndex = CodesetIndex::buildKeyIndex(kDvdRemotes);
+static_assert(kDvdRemoteIndex.complete && kDvdKeyIndex.complete,
+              "DVD codeset index: no perfect-hash seed found");
 }  // namespace
 
 const DvdController::RemoteConfig DvdController::kRemotes[] = {
@@ -484,17 +473,13 @@ const DvdController::RemoteConfig DvdController::kRemotes[] = {
     kDvdRemotes[20], kDvdRemotes[21], kDvdRemotes[22],
 };
 
-DvdController::DvdController(const char *nodeId, uint8_t irPin)
+DvdController::DvdController(const char *nodeId, IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/dvd/state"),
-      irPin_(irPin),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {}
 
 void DvdController::begin() {
-  if (!irReady_) {
-    tryBegin(irSend_, 0);
-    irReady_ = true;
-  }
-  Serial.printf("[DVD] Controller ready (IR pin=%u)\n", irPin_);
+  learned_.persistAs(deviceType());
+  LOG_I("[DVD] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void DvdController::serializeState(JsonDocument &doc) const {
@@ -504,7 +489,6 @@ void DvdController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remoteBrand_;
   doc["type"] = remoteType_;
   doc["index"] = remoteIndex_;
-  doc["updatedAt"] = millis();
 }
 
 bool DvdController::handleCommand(JsonObjectConst cmd,
@@ -516,50 +500,35 @@ bool DvdController::handleCommand(JsonObjectConst cmd,
   if (cmd["index"].is<uint16_t>())
     remoteIndex_ = cmd["index"].as<uint16_t>();
 
-  String action = cmd["cmd"].as<String>();
-  if (action.isEmpty()) {
-    Serial.println(F("[DVD] Missing command name"));
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || action[0] == '\0') {
+    LOG_W("[DVD] Missing command name");
     return false;
   }
 
   bool updated = false;
 
-  if (action.equalsIgnoreCase("key")) {
-    const String key = canonicalizeKey(cmd["key"].as<String>());
-    if (key.isEmpty()) {
-      Serial.println(F("[DVD] Missing key name"));
+  if (strcasecmp(action, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[DVD] Missing key name");
       return false;
     }
 
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          const uint64_t value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::resolve(keyName, kDvdKeyAliases);
+    } else {
+      key = KeyIds::resolveOrIntern(keyName, kDvdKeyAliases);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     updated = applyKeyEffects(key);
     if (!sendKey(key)) {
-      Serial.printf("[DVD][IR] No IR mapping for brand=%s key=%s\n",
-                    remoteBrand_.c_str(), key.c_str());
+      ++metrics_.unknownKeys;
+      LOG_W("[DVD][IR] No IR mapping for brand=%s key=%s",
+            remoteBrand_.c_str(), keyName);
     }
   }
 
@@ -570,8 +539,42 @@ bool DvdController::handleCommand(JsonObjectConst cmd,
   return applyState(stateDoc);
 }
 
-bool DvdController::sendKey(const String &key) {
-  if (sendLearnedKey(key)) {
+uint8_t DvdController::sendKeyPresses(const char *keyName, uint8_t presses,
+                                      uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::resolve(keyName, kDvdKeyAliases);
+  uint8_t sent = 0;
+  while (sent < presses && sendKey(key, gapAfterMs)) {
+    applyKeyEffects(key);
+    ++sent;
+  }
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[DVD][IR] No IR mapping for brand=%s key=%s",
+          remoteBrand_.c_str(), keyName);
+  }
+  return sent;
+}
+
+bool DvdController::resolveKey(const char *keyName, IrFrame &frame) {
+  const KeyId key = KeyIds::resolve(keyName, kDvdKeyAliases);
+  if (const LearnedKey *entry = learned_.find(key)) {
+    frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                              entry->raw);
+    return true;
+  }
+  const RemoteConfig *remote =
+      findRemote(remoteBrand_, remoteType_, remoteIndex_);
+  const KeyCommand *cmd = remote != nullptr ? findKey(remote, key) : nullptr;
+  if (cmd == nullptr || !cmd->nbits ||
+      cmd->protocol == decode_type_t::UNKNOWN) {
+    return false;
+  }
+  frame = IrFrame::fromCode(cmd->protocol, cmd->value, cmd->nbits, {});
+  return true;
+}
+
+bool DvdController::sendKey(KeyId key, uint16_t gapAfterMs) {
+  if (sendLearnedKey(key, gapAfterMs)) {
     return true;
   }
 
@@ -591,89 +594,61 @@ bool DvdController::sendKey(const String &key) {
 
   uint64_t value = cmd->value;
   if (cmd->protocol == decode_type_t::RC6) {
-    if (rc6Toggle_) value = irSend_.toggleRC6(value, cmd->nbits);
+    if (rc6Toggle_) value = ir_.toggleRC6(value, cmd->nbits);
     rc6Toggle_ = !rc6Toggle_;
   }
-  irSend_.send(cmd->protocol, value, cmd->nbits);
-  Serial.printf("[DVD][IR] Sent key=%s protocol=%d value=0x%llX bits=%u\n",
-                key.c_str(), static_cast<int>(cmd->protocol),
-                static_cast<unsigned long long>(value), cmd->nbits);
+  ir_.sendValue(cmd->protocol, value, cmd->nbits, gapAfterMs);
+  ++metrics_.codesetHits;
+  LOG_D("[DVD][IR] Queued key=%s protocol=%d value=0x%llX bits=%u",
+        KeyIds::name(key), static_cast<int>(cmd->protocol),
+        static_cast<unsigned long long>(value), cmd->nbits);
   return true;
 }
 
 bool DvdController::learnKey(const String &key, decode_type_t protocol,
                              uint64_t value, uint16_t nbits,
-                             const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  if (normalizedKey.length() == 0 || protocol == decode_type_t::UNKNOWN ||
-      nbits == 0) {
-    return false;
-  }
-  saveLearnedCommand(normalizedKey, protocol, value, nbits, raw);
-  return true;
+                             const std::vector<uint8_t> &raw,
+                             const std::vector<uint8_t> &timing) {
+  const KeyId id = KeyIds::resolveOrIntern(key.c_str(), kDvdKeyAliases);
+  return learned_.save(id, protocol, value, nbits, raw, timing);
 }
 
-void DvdController::saveLearnedCommand(const String &key,
-                                       decode_type_t protocol, uint64_t value,
-                                       uint16_t nbits,
-                                       const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      entry.protocol = protocol;
-      entry.value = value;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool DvdController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
   }
-
-  LearnedCommand cmd;
-  cmd.key = normalizedKey;
-  cmd.protocol = protocol;
-  cmd.value = value;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
-}
-
-bool DvdController::sendLearnedKey(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (const auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      if (!entry.raw.empty() && entry.nbits > 64) {
-        irSend_.send(entry.protocol, entry.raw.data(),
-                     static_cast<uint16_t>(entry.raw.size()));
-      } else {
-        uint64_t value = entry.value;
-        if (entry.protocol == decode_type_t::RC6) {
-          if (rc6Toggle_) value = irSend_.toggleRC6(value, entry.nbits);
-          rc6Toggle_ = !rc6Toggle_;
-        }
-        irSend_.send(entry.protocol, value, entry.nbits);
-      }
-      Serial.printf(
-          "[DVD][IR] Sent learned key=%s protocol=%d value=0x%llX bits=%u\n",
-          normalizedKey.c_str(), static_cast<int>(entry.protocol),
-          static_cast<unsigned long long>(entry.value), entry.nbits);
-      return true;
+  if (!entry->raw.empty() && entry->nbits > 64) {
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), 1, 0, gapAfterMs,
+                  entry->timing);
+  } else {
+    uint64_t value = entry->value;
+    if (entry->protocol == decode_type_t::RC6) {
+      if (rc6Toggle_) value = ir_.toggleRC6(value, entry->nbits);
+      rc6Toggle_ = !rc6Toggle_;
     }
+    ir_.sendValue(entry->protocol, value, entry->nbits, gapAfterMs);
   }
-  return false;
+  ++metrics_.learnedHits;
+  LOG_D(
+      "[DVD][IR] Queued learned key=%s protocol=%d value=0x%llX bits=%u",
+      KeyIds::name(key), static_cast<int>(entry->protocol),
+      static_cast<unsigned long long>(entry->value), entry->nbits);
+  return true;
 }
 
-bool DvdController::applyKeyEffects(const String &key) {
-  bool changed = false;
-  if (key.equalsIgnoreCase("POWER")) {
-    state_.power = !state_.power;
-    changed = true;
-  } else if (key.equalsIgnoreCase("MUTE")) {
-    state_.muted = !state_.muted;
-    changed = true;
+bool DvdController::applyKeyEffects(KeyId key) {
+  switch (key) {
+    case KeyId::kPower:
+      state_.power = !state_.power;
+      return true;
+    case KeyId::kMute:
+      state_.muted = !state_.muted;
+      return true;
+    default:
+      return false;
   }
-  return changed;
 }
 
 bool DvdController::applyState(JsonDocument &stateDoc) {
@@ -684,32 +659,11 @@ bool DvdController::applyState(JsonDocument &stateDoc) {
 
 const DvdController::RemoteConfig *DvdController::findRemote(
     const String &brand, const String &type, uint16_t index) {
-  const RemoteConfig *fallback = nullptr;
-  for (const auto &remote : kRemotes) {
-    bool brandMatch = brand.length() == 0 ||
-                      remote.brand == nullptr || remote.brand[0] == '\0' ||
-                      brand.equalsIgnoreCase(remote.brand);
-    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
-                     type.equalsIgnoreCase(remote.type);
-    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
-    if (brandMatch && typeMatch && indexMatch) {
-      if (fallback == nullptr) fallback = &remote;
-      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
-          (remote.index != 0 && remote.index == index)) {
-        return &remote;
-      }
-    }
-  }
-  return fallback;
+  return CodesetIndex::findRemote(kDvdRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
 }
 
 const DvdController::KeyCommand *DvdController::findKey(
-    const RemoteConfig *remote, const String &key) {
-  if (remote == nullptr) return nullptr;
-  for (size_t i = 0; i < remote->commandCount; ++i) {
-    if (key.equalsIgnoreCase(remote->commands[i].key)) {
-      return &remote->commands[i];
-    }
-  }
-  return nullptr;
+    const RemoteConfig *remote, KeyId key) {
+  return CodesetIndex::findKey(kDvdKeyIndex, kRemotes, remote, key);
 }
@@ -3,18 +3,14 @@
 #include <Arduino.h>
 #include <algorithm>
 #include <cstdlib>
+#include <strings.h>
 #include <IRutils.h>
 #include <vector>
 
-namespace {
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
+#include "CodesetIndex.h"
+#include "Log.h"
 
+namespace {
 constexpr uint8_t kMaxSpeed = 5;
 const char *const kFanTypes[] = {"normal", "natural", "sleep"};
 constexpr uint8_t kFanTypeCount = sizeof(kFanTypes) / sizeof(kFanTypes[0]);
@@ -22,7 +18,7 @@ constexpr uint8_t kFanTypeCount = sizeof(kFanTypes) / sizeof(kFanTypes[0]);
 constexpr uint16_t kTimerOptions[] = {0, 60, 120, 240};
 constexpr uint8_t kTimerOptionCount = sizeof(kTimerOptions) / sizeof(kTimerOptions[0]);
 
-const FanController::KeyCommand kLgCommands[] = {
+constexpr FanController::KeyCommand kLgCommands[] = {
     {"POWER", decode_type_t::NEC, 0x20DF10EF, 32},
     {"TIMER", decode_type_t::NEC, 0x20DF906F, 32},
     {"SPEED_UP", decode_type_t::NEC, 0x20DF40BF, 32},
@@ -31,7 +27,7 @@ const FanController::KeyCommand kLgCommands[] = {
     {"TYPE", decode_type_t::NEC, 0x20DF22DD, 32},
 };
 
-const FanController::KeyCommand kPanasonicCommands[] = {
+constexpr FanController::KeyCommand kPanasonicCommands[] = {
     {"POWER", decode_type_t::PANASONIC, 0x400401UL, 48},
     {"TIMER", decode_type_t::PANASONIC, 0x400409UL, 48},
     {"SPEED_UP", decode_type_t::PANASONIC, 0x400405UL, 48},
@@ -40,7 +36,7 @@ const FanController::KeyCommand kPanasonicCommands[] = {
     {"TYPE", decode_type_t::PANASONIC, 0x400407UL, 48},
 };
 
-const FanController::KeyCommand kMitsubishiCommands[] = {
+constexpr FanController::KeyCommand kMitsubishiCommands[] = {
     {"POWER", decode_type_t::MITSUBISHI, 0x11090B, 24},
     {"TIMER", decode_type_t::MITSUBISHI, 0x11090E, 24},
     {"SPEED_UP", decode_type_t::MITSUBISHI, 0x110902, 24},
@@ -49,7 +45,7 @@ const FanController::KeyCommand kMitsubishiCommands[] = {
     {"TYPE", decode_type_t::MITSUBISHI, 0x110908, 24},
 };
 
-const FanController::KeyCommand kSamsungCommands[] = {
+constexpr FanController::KeyCommand kSamsungCommands[] = {
     {"POWER", decode_type_t::SAMSUNG, 0x707, 12},
     {"TIMER", decode_type_t::SAMSUNG, 0x70F, 12},
     {"SPEED_UP", decode_type_t::SAMSUNG, 0x702, 12},
@@ -58,7 +54,7 @@ const FanController::KeyCommand kSamsungCommands[] = {
     {"TYPE", decode_type_t::SAMSUNG, 0x708, 12},
 };
 
-const FanController::KeyCommand kSharpCommands[] = {
+constexpr FanController::KeyCommand kSharpCommands[] = {
     {"POWER", decode_type_t::SHARP, 0x5DA2, 15},
     {"TIMER", decode_type_t::SHARP, 0x5DA0, 15},
     {"SPEED_UP", decode_type_t::SHARP, 0x5DA8, 15},
@@ -67,7 +63,7 @@ const FanController::KeyCommand kSharpCommands[] = {
     {"TYPE", decode_type_t::SHARP, 0x5DAE, 15},
 };
 
-const FanController::KeyCommand kToshibaCommands[] = {
+constexpr FanController::KeyCommand kToshibaCommands[] = {
     {"POWER", decode_type_t::NEC, 0x2FD48B7, 32},
     {"TIMER", decode_type_t::NEC, 0x2FD40BF, 32},
     {"SPEED_UP", decode_type_t::NEC, 0x2FD00FF, 32},
@@ -76,7 +72,7 @@ const FanController::KeyCommand kToshibaCommands[] = {
     {"TYPE", decode_type_t::NEC, 0x2FD20DF, 32},
 };
 
-const FanController::KeyCommand kGenericCommands[] = {
+constexpr FanController::KeyCommand kGenericCommands[] = {
     {"POWER", decode_type_t::NEC, 0x00FF00FF, 32},
     {"TIMER", decode_type_t::NEC, 0x00FF807F, 32},
     {"SPEED_UP", decode_type_t::NEC, 0x00FF40BF, 32},
@@ -85,9 +81,7 @@ const FanController::KeyCommand kGenericCommands[] = {
     {"TYPE", decode_type_t::NEC, 0x00FFA05F, 32},
 };
 
-}  // namespace
-
-const FanController::RemoteConfig FanController::kRemotes[] = {
+constexpr FanController::RemoteConfig kFanRemotes[] = {
     // Curated codesets (index=1) per brand.
     {"LG", "FAN", 1, kLgCommands,
      sizeof(kLgCommands) / sizeof(kLgCommands[0])},
@@ -120,17 +114,36 @@ const FanController::RemoteConfig FanController::kRemotes[] = {
      sizeof(kToshibaCommands) / sizeof(kToshibaCommands[0])},
 };
 
-FanController::FanController(const char *nodeId, uint8_t irPin)
+constexpr auto kFanRemoteIndex = CodesetIndex::buildRemoteIndex(kFanRemotes);
+constexpr auto kFanKeyIndex = CodesetIndex::buildKeyIndex(kFanRemotes);
+static_assert(kFanRemoteIndex.complete && kFanKeyIndex.complete,
+              "Fan codeset index: no perfect-hash seed found");
+
+}  // namespace
+
+const FanController::RemoteConfig FanController::kRemotes[] = {
+    kFanRemotes[0],
+    kFanRemotes[1],
+    kFanRemotes[2],
+    kFanRemotes[3],
+    kFanRemotes[4],
+    kFanRemotes[5],
+    kFanRemotes[6],
+    kFanRemotes[7],
+    kFanRemotes[8],
+    kFanRemotes[9],
+    kFanRemotes[10],
+    kFanRemotes[11],
+    kFanRemotes[12],
+};
+
+FanController::FanController(const char *nodeId, IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/fan/state"),
-      irPin_(irPin),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {}
 
 void FanController::begin() {
-  if (!irReady_) {
-    tryBegin(irSend_, 0);
-    irReady_ = true;
-  }
-  Serial.printf("[FAN] Controller ready (IR pin=%u)\n", irPin_);
+  learned_.persistAs(deviceType());
+  LOG_I("[FAN] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void FanController::serializeState(JsonDocument &doc) const {
@@ -143,7 +156,6 @@ void FanController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remoteBrand_;
   doc["profileType"] = remoteType_;
   doc["index"] = remoteIndex_;
-  doc["updatedAt"] = millis();
 }
 
 bool FanController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
@@ -154,52 +166,37 @@ bool FanController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   if (cmd["index"].is<uint16_t>())
     remoteIndex_ = cmd["index"].as<uint16_t>();
 
-  String action = cmd["cmd"].as<String>();
-  if (action.isEmpty()) {
-    Serial.println(F("[FAN] Missing command name"));
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || action[0] == '\0') {
+    LOG_W("[FAN] Missing command name");
     return false;
   }
 
   bool updated = false;
 
-  if (action.equalsIgnoreCase("key")) {
-    const String key = cmd["key"].as<String>();
-    if (key.isEmpty()) {
-      Serial.println(F("[FAN] Missing key name"));
+  if (strcasecmp(action, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[FAN] Missing key name");
       return false;
     }
 
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          const uint64_t value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::find(keyName);
+    } else {
+      key = KeyIds::intern(keyName);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     updated = applyKeyEffects(key);
     if (!sendKey(key)) {
-      Serial.printf("[FAN][IR] No IR mapping for brand=%s key=%s\n",
-                    remoteBrand_.c_str(), key.c_str());
+      ++metrics_.unknownKeys;
+      LOG_W("[FAN][IR] No IR mapping for brand=%s key=%s",
+            remoteBrand_.c_str(), keyName);
     }
-  } else if (action.equalsIgnoreCase("set")) {
+  } else if (strcasecmp(action, "set") == 0) {
     if (cmd["power"].is<bool>()) {
       state_.power = cmd["power"].as<bool>();
       updated = true;
@@ -239,8 +236,42 @@ bool FanController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   return applyState(stateDoc);
 }
 
-bool FanController::sendKey(const String &key) {
-  if (sendLearnedKey(key)) {
+uint8_t FanController::sendKeyPresses(const char *keyName, uint8_t presses,
+                                      uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::find(keyName);
+  uint8_t sent = 0;
+  while (sent < presses && sendKey(key, gapAfterMs)) {
+    applyKeyEffects(key);
+    ++sent;
+  }
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[FAN][IR] No IR mapping for brand=%s key=%s",
+          remoteBrand_.c_str(), keyName);
+  }
+  return sent;
+}
+
+bool FanController::resolveKey(const char *keyName, IrFrame &frame) {
+  const KeyId key = KeyIds::find(keyName);
+  if (const LearnedKey *entry = learned_.find(key)) {
+    frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                              entry->raw);
+    return true;
+  }
+  const RemoteConfig *remote =
+      findRemote(remoteBrand_, remoteType_, remoteIndex_);
+  const KeyCommand *cmd = remote != nullptr ? findKey(remote, key) : nullptr;
+  if (cmd == nullptr || !cmd->nbits ||
+      cmd->protocol == decode_type_t::UNKNOWN) {
+    return false;
+  }
+  frame = IrFrame::fromCode(cmd->protocol, cmd->value, cmd->nbits, {});
+  return true;
+}
+
+bool FanController::sendKey(KeyId key, uint16_t gapAfterMs) {
+  if (sendLearnedKey(key, gapAfterMs)) {
     return true;
   }
 
@@ -253,100 +284,77 @@ bool FanController::sendKey(const String &key) {
   if (cmd == nullptr) {
     return false;
   }
-  irSend_.send(cmd->protocol, cmd->value, cmd->nbits);
-  Serial.printf("[FAN][IR] Sent key=%s protocol=%d value=0x%llX bits=%u\n",
-                key.c_str(), static_cast<int>(cmd->protocol),
-                static_cast<unsigned long long>(cmd->value), cmd->nbits);
+  ir_.sendValue(cmd->protocol, cmd->value, cmd->nbits, gapAfterMs);
+  ++metrics_.codesetHits;
+  LOG_D("[FAN][IR] Queued key=%s protocol=%d value=0x%llX bits=%u",
+        KeyIds::name(key), static_cast<int>(cmd->protocol),
+        static_cast<unsigned long long>(cmd->value), cmd->nbits);
   return true;
 }
 
 bool FanController::learnKey(const String &key, decode_type_t protocol,
                              uint64_t value, uint16_t nbits,
-                             const std::vector<uint8_t> &raw) {
-  if (key.length() == 0 || protocol == decode_type_t::UNKNOWN || nbits == 0) {
-    return false;
-  }
-  saveLearnedCommand(key, protocol, value, nbits, raw);
-  return true;
+                             const std::vector<uint8_t> &raw,
+                             const std::vector<uint8_t> &timing) {
+  return learned_.save(KeyIds::intern(key.c_str()), protocol, value, nbits,
+                       raw, timing);
 }
 
-void FanController::saveLearnedCommand(const String &key, decode_type_t protocol,
-                                       uint64_t value, uint16_t nbits,
-                                       const std::vector<uint8_t> &raw) {
-  for (auto &entry : learnedCommands_) {
-    if (key.equalsIgnoreCase(entry.key)) {
-      entry.protocol = protocol;
-      entry.value = value;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool FanController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
   }
-
-  LearnedCommand cmd;
-  cmd.key = key;
-  cmd.protocol = protocol;
-  cmd.value = value;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
-}
-
-bool FanController::sendLearnedKey(const String &key) {
-  for (const auto &entry : learnedCommands_) {
-    if (key.equalsIgnoreCase(entry.key)) {
-      if (!entry.raw.empty() && entry.nbits > 64) {
-        irSend_.send(entry.protocol, entry.raw.data(),
-                     static_cast<uint16_t>(entry.raw.size()));
-      } else {
-        irSend_.send(entry.protocol, entry.value, entry.nbits);
-      }
-      Serial.printf(
-          "[FAN][IR] Sent learned key=%s protocol=%d value=0x%llX bits=%u\n",
-          key.c_str(), static_cast<int>(entry.protocol),
-          static_cast<unsigned long long>(entry.value), entry.nbits);
-      return true;
-    }
+  if (!entry->raw.empty() && entry->nbits > 64) {
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), 1, 0, gapAfterMs,
+                  entry->timing);
+  } else {
+    ir_.sendValue(entry->protocol, entry->value, entry->nbits, gapAfterMs);
   }
-  return false;
+  ++metrics_.learnedHits;
+  LOG_D(
+      "[FAN][IR] Queued learned key=%s protocol=%d value=0x%llX bits=%u",
+      KeyIds::name(key), static_cast<int>(entry->protocol),
+      static_cast<unsigned long long>(entry->value), entry->nbits);
+  return true;
 }
 
-
-bool FanController::applyKeyEffects(const String &key) {
-  bool changed = false;
-  if (key.equalsIgnoreCase("POWER")) {
-    state_.power = !state_.power;
-    changed = true;
-  } else if (key.equalsIgnoreCase("SPEED_UP")) {
-    if (state_.speed < kMaxSpeed) {
+bool FanController::applyKeyEffects(KeyId key) {
+  switch (key) {
+    case KeyId::kPower:
+      state_.power = !state_.power;
+      return true;
+    case KeyId::kSpeedUp:
+      if (state_.speed >= kMaxSpeed) return false;
       state_.speed++;
-      changed = true;
-    }
-  } else if (key.equalsIgnoreCase("SPEED_DOWN")) {
-    if (state_.speed > 0) {
+      return true;
+    case KeyId::kSpeedDown:
+      if (state_.speed == 0) return false;
       state_.speed--;
-      changed = true;
-    }
-  } else if (key.equalsIgnoreCase("SWING")) {
-    state_.swing = !state_.swing;
-    changed = true;
-  } else if (key.equalsIgnoreCase("TYPE")) {
-    typeIndex_ = (typeIndex_ + 1) % kFanTypeCount;
-    state_.type = kFanTypes[typeIndex_];
-    changed = true;
-  } else if (key.equalsIgnoreCase("TIMER")) {
-    const uint16_t current = state_.timer;
-    uint8_t index = 0;
-    for (; index < kTimerOptionCount; ++index) {
-      if (kTimerOptions[index] == current) {
-        break;
+      return true;
+    case KeyId::kSwing:
+      state_.swing = !state_.swing;
+      return true;
+    case KeyId::kType:
+      typeIndex_ = (typeIndex_ + 1) % kFanTypeCount;
+      state_.type = kFanTypes[typeIndex_];
+      return true;
+    case KeyId::kTimer: {
+      const uint16_t current = state_.timer;
+      uint8_t index = 0;
+      for (; index < kTimerOptionCount; ++index) {
+        if (kTimerOptions[index] == current) {
+          break;
+        }
       }
+      index = (index + 1) % kTimerOptionCount;
+      state_.timer = kTimerOptions[index];
+      return true;
     }
-    index = (index + 1) % kTimerOptionCount;
-    state_.timer = kTimerOptions[index];
-    changed = true;
+    default:
+      return false;
   }
-  return changed;
 }
 
 bool FanController::applyState(JsonDocument &stateDoc) {
@@ -357,33 +365,11 @@ bool FanController::applyState(JsonDocument &stateDoc) {
 
 const FanController::RemoteConfig *FanController::findRemote(
     const String &brand, const String &type, uint16_t index) {
-  const RemoteConfig *fallback = nullptr;
-  for (const auto &remote : kRemotes) {
-    bool brandMatch = brand.length() == 0 ||
-                      remote.brand == nullptr || remote.brand[0] == '\0' ||
-                      brand.equalsIgnoreCase(remote.brand);
-    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
-                     type.equalsIgnoreCase(remote.type);
-    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
-    if (brandMatch && typeMatch && indexMatch) {
-      if (fallback == nullptr) fallback = &remote;
-      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
-          (remote.index != 0 && remote.index == index)) {
-        return &remote;
-      }
-    }
-  }
-  return fallback;
+  return CodesetIndex::findRemote(kFanRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
 }
 
 const FanController::KeyCommand *FanController::findKey(
-    const RemoteConfig *remote, const String &key) {
-  if (remote == nullptr) return nullptr;
-  for (size_t i = 0; i < remote->commandCount; ++i) {
-    if (key.equalsIgnoreCase(remote->commands[i].key)) {
-      return &remote->commands[i];
-    }
-  }
-  return nullptr;
-  
+    const RemoteConfig *remote, KeyId key) {
+  return CodesetIndex::findKey(kFanKeyIndex, kRemotes, remote, key);
 }
@@ -4,56 +4,44 @@
 #include <IRutils.h>
 #include <algorithm>
 #include <cstdlib>
+#include <strings.h>
 
-namespace {
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
+#include "CodesetIndex.h"
+#include "Log.h"
 
-String canonicalizeKey(const String &key) {
-  String out = key;
-  out.trim();
-  out.toUpperCase();
-
-  if (out.equalsIgnoreCase("SOURCE") || out.equalsIgnoreCase("INPUT") ||
-      out.equalsIgnoreCase("AV") || out.equalsIgnoreCase("HDMI")) {
-    return "SOURCE";
-  }
-  if (out.equalsIgnoreCase("ENTER") || out.equalsIgnoreCase("SELECT") ||
-      out.equalsIgnoreCase("CONFIRM")) {
-    return "OK";
-  }
-  if (out.equalsIgnoreCase("RETURN")) {
-    return "BACK";
-  }
-  if (out.equalsIgnoreCase("SETTINGS") || out.equalsIgnoreCase("OPTIONS")) {
-    return "MENU";
-  }
-  if (out.equalsIgnoreCase("TOOLS") || out.equalsIgnoreCase("MORE") ||
-      out.equalsIgnoreCase("MORE_INFO")) {
-    return "INFO";
-  }
-  if (out.equalsIgnoreCase("PAGEUP")) return "PAGE_UP";
-  if (out.equalsIgnoreCase("PAGEDOWN")) return "PAGE_DOWN";
-  if (out.equalsIgnoreCase("ZOOM+") || out.equalsIgnoreCase("ZOOMIN"))
-    return "ZOOM_IN";
-  if (out.equalsIgnoreCase("ZOOM-") || out.equalsIgnoreCase("ZOOMOUT"))
-    return "ZOOM_OUT";
-  if (out.equalsIgnoreCase("KEYSTONE+") || out.equalsIgnoreCase("TRAP+"))
-    return "TRAP_UP";
-  if (out.equalsIgnoreCase("KEYSTONE-") || out.equalsIgnoreCase("TRAP-"))
-    return "TRAP_DOWN";
-
-  return out;
-}
+namespace {
+// Common aliases (helps keep ESP compatible if Android naming changes).
+constexpr KeyName kProjectorAliases[] = {
+    {"INPUT", KeyId::kSource},
+    {"AV", KeyId::kSource},
+    {"HDMI", KeyId::kSource},
+    {"ENTER", KeyId::kOk},
+    {"SELECT", KeyId::kOk},
+    {"CONFIRM", KeyId::kOk},
+    {"RETURN", KeyId::kBack},
+    {"SETTINGS", KeyId::kMenu},
+    {"OPTIONS", KeyId::kMenu},
+    {"TOOLS", KeyId::kInfo},
+    {"MORE", KeyId::kInfo},
+    {"MORE_INFO", KeyId::kInfo},
+    {"PAGEUP", KeyId::kPageUp},
+    {"PAGEDOWN", KeyId::kPageDown},
+    {"ZOOM+", KeyId::kZoomIn},
+    {"ZOOMIN", KeyId::kZoomIn},
+    {"ZOOM-", KeyId::kZoomOut},
+    {"ZOOMOUT", KeyId::kZoomOut},
+    {"KEYSTONE+", KeyId::kTrapUp},
+    {"TRAP+", KeyId::kTrapUp},
+    {"KEYSTONE-", KeyId::kTrapDown},
+    {"TRAP-", KeyId::kTrapDown},
+};
+constexpr auto kProjectorKeyAliases = KeyIds::makeAliasTable(kProjectorAliases);
+static_assert(kProjectorKeyAliases.index.complete,
+              "Projector key aliases: no perfect-hash seed found");
 
 // InFocus projector (IRDB: InFocus/Video Projector/135,78.csv) - NEC1/NEC 32-bit.
 // Provides SOURCE, FREEZE, ZOOM_IN/OUT, KEYSTONE+/- etc (mapped to TRAP_UP/DOWN).
-const ProjectorController::KeyCommand kInFocusProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kInFocusProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x72E1E817, 32},
     {"MUTE", decode_type_t::NEC, 0x72E100FF, 32},
     {"FREEZE", decode_type_t::NEC, 0x72E1708F, 32},
@@ -79,7 +67,7 @@ const ProjectorController::KeyCommand kInFocusProjectorCommands1[] = {
 };
 
 // Epson projector (IRDB: Epson/Projector/131,85.csv) - NEC2/NEC 32-bit.
-const ProjectorController::KeyCommand kEpsonProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kEpsonProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0xAAC109F6, 32},
     {"MUTE", decode_type_t::NEC, 0xAAC1C936, 32},  // A/V MUTE / BLANK
     {"FREEZE", decode_type_t::NEC, 0xAAC149B6, 32},
@@ -104,7 +92,7 @@ const ProjectorController::KeyCommand kEpsonProjectorCommands1[] = {
 };
 
 // BenQ projector (IRDB: BenQ/Projector/48,-1.csv) - NEC1/NEC 32-bit.
-const ProjectorController::KeyCommand kBenqProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kBenqProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x0CF318E7, 32},
     {"MUTE", decode_type_t::NEC, 0x0CF348B7, 32},
     {"FREEZE", decode_type_t::NEC, 0x0CF3708F, 32},
@@ -122,7 +110,7 @@ const ProjectorController::KeyCommand kBenqProjectorCommands1[] = {
 };
 
 // Optoma projector (IRDB: Optoma/Projector/50,-1.csv) - NEC1/NEC 32-bit.
-const ProjectorController::KeyCommand kOptomaProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kOptomaProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x32CD02FD, 32},   // Power On
     {"SOURCE", decode_type_t::NEC, 0x32CD05FA, 32},  // Mode
     {"MENU", decode_type_t::NEC, 0x32CD0EF1, 32},
@@ -134,7 +122,7 @@ const ProjectorController::KeyCommand kOptomaProjectorCommands1[] = {
 };
 
 // Sony projector (IRDB: Sony/Video Projector/84,-1.csv) - Sony15 (SIRC 15-bit).
-const ProjectorController::KeyCommand kSonyProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kSonyProjectorCommands1[] = {
     {"POWER", decode_type_t::SONY, 0x542A, 15},
     {"MUTE", decode_type_t::SONY, 0x142A, 15},
     {"VOL_UP", decode_type_t::SONY, 0x242A, 15},
@@ -150,7 +138,7 @@ const ProjectorController::KeyCommand kSonyProjectorCommands1[] = {
 };
 
 // Hitachi projector (IRDB: Hitachi/Video Projector/80,-1.csv) - NEC1/NEC 32-bit.
-const ProjectorController::KeyCommand kHitachiProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kHitachiProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x50AF17E8, 32},     // STANDBY/ON
     {"MUTE", decode_type_t::NEC, 0x50AF0BF4, 32},
     {"VOL_UP", decode_type_t::NEC, 0x50AF12ED, 32},
@@ -166,7 +154,7 @@ const ProjectorController::KeyCommand kHitachiProjectorCommands1[] = {
 };
 
 // Sanyo projector (IRDB: Sanyo/Video Projector/48,-1.csv) - NEC1/NEC 32-bit.
-const ProjectorController::KeyCommand kSanyoProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kSanyoProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x30CF00FF, 32},
     {"MUTE", decode_type_t::NEC, 0x30CF0BF4, 32},
     {"VOL_UP", decode_type_t::NEC, 0x30CF09F6, 32},
@@ -180,7 +168,7 @@ const ProjectorController::KeyCommand kSanyoProjectorCommands1[] = {
 };
 
 // Sharp projector (IRDB: Sharp/Video Projector/13,-1.csv) - Sharp 15-bit.
-const ProjectorController::KeyCommand kSharpProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kSharpProjectorCommands1[] = {
     {"POWER", decode_type_t::SHARP, 0x59A2, 15},
     {"MUTE", decode_type_t::SHARP, 0x5BA2, 15},
     {"VOL_UP", decode_type_t::SHARP, 0x58A2, 15},
@@ -194,7 +182,7 @@ const ProjectorController::KeyCommand kSharpProjectorCommands1[] = {
 };
 
 // JVC projector (IRDB: JVC/Projector/115,-1.csv) - JVC 16-bit.
-const ProjectorController::KeyCommand kJvcProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kJvcProjectorCommands1[] = {
     {"POWER", decode_type_t::JVC, 0xCEA0, 16},  // POWER ON
     {"POWER_OFF", decode_type_t::JVC, 0xCE60, 16},
     {"MENU", decode_type_t::JVC, 0xCE74, 16},
@@ -210,7 +198,7 @@ const ProjectorController::KeyCommand kJvcProjectorCommands1[] = {
 };
 
 // Boxlight projector (IRDB: Boxlight/Projector/48,-1.csv) - NEC1/NEC 32-bit.
-const ProjectorController::KeyCommand kBoxlightProjectorCommands1[] = {
+constexpr ProjectorController::KeyCommand kBoxlightProjectorCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x30CF00FF, 32},
     {"FREEZE", decode_type_t::NEC, 0x30CF43BC, 32},
     {"SOURCE", decode_type_t::NEC, 0x30CF05FA, 32},  // VIDEO 1
@@ -221,9 +209,9 @@ const ProjectorController::KeyCommand kBoxlightProjectorCommands1[] = {
     {"TRAP_DOWN", decode_type_t::NEC, 0x30CF8F70, 32},
 };
 
-const ProjectorController::KeyCommand kGenericProjectorCommands[] = {};
+constexpr ProjectorController::KeyCommand kGenericProjectorCommands[] = {};
 
-const ProjectorController::RemoteConfig kProjectorRemotes[] = {
+constexpr ProjectorController::RemoteConfig kProjectorRemotes[] = {
     {"", "", 0, kGenericProjectorCommands,
      sizeof(kGenericProjectorCommands) / sizeof(kGenericProjectorCommands[0])},
 
@@ -270,6 +258,12 @@ const ProjectorController::RemoteConfig kProjectorRemotes[] = {
     {"", "PROJECTOR", 4010, kBoxlightProjectorCommands1,
      sizeof(kBoxlightProjectorCommands1) / sizeof(kBoxlightProjectorCommands1[0])},
 };
+
+constexpr auto kProjectorRemoteIndex = CodesetIndex::buildRemoteIndex(kProjectorRemotes);
+constexpr auto kProjectorKeyIndex =
+    CodesetIndex::buildKeyIndex(kProjectorRemotes);
+static_assert(kProjectorRemoteIndex.complete && kProjectorKeyIndex.complete,
+              "Projector codeset index: no perfect-hash seed found");
 }  // namespace
 
 const ProjectorController::RemoteConfig ProjectorController::kRemotes[] = {
@@ -282,17 +276,14 @@ const ProjectorController::RemoteConfig ProjectorController::kRemotes[] = {
     kProjectorRemotes[18], kProjectorRemotes[19], kProjectorRemotes[20],
 };
 
-ProjectorController::ProjectorController(const char *nodeId, uint8_t irPin)
+ProjectorController::ProjectorController(const char *nodeId,
+                                         IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/projector/state"),
-      irPin_(irPin),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {}
 
 void ProjectorController::begin() {
-  if (!irReady_) {
-    tryBegin(irSend_, 0);
-    irReady_ = true;
-  }
-  Serial.printf("[PROJECTOR] Controller ready (IR pin=%u)\n", irPin_);
+  learned_.persistAs(deviceType());
+  LOG_I("[PROJECTOR] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void ProjectorController::serializeState(JsonDocument &doc) const {
@@ -302,7 +293,6 @@ void ProjectorController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remoteBrand_;
   doc["type"] = remoteType_;
   doc["index"] = remoteIndex_;
-  doc["updatedAt"] = millis();
 }
 
 bool ProjectorController::handleCommand(JsonObjectConst cmd,
@@ -314,50 +304,35 @@ bool ProjectorController::handleCommand(JsonObjectConst cmd,
   if (cmd["index"].is<uint16_t>())
     remoteIndex_ = cmd["index"].as<uint16_t>();
 
-  String action = cmd["cmd"].as<String>();
-  if (action.isEmpty()) {
-    Serial.println(F("[PROJECTOR] Missing command name"));
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || action[0] == '\0') {
+    LOG_W("[PROJECTOR] Missing command name");
     return false;
   }
 
   bool updated = false;
 
-  if (action.equalsIgnoreCase("key")) {
-    const String key = canonicalizeKey(cmd["key"].as<String>());
-    if (key.isEmpty()) {
-      Serial.println(F("[PROJECTOR] Missing key name"));
+  if (strcasecmp(action, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[PROJECTOR] Missing key name");
       return false;
     }
 
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          const uint64_t value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::resolve(keyName, kProjectorKeyAliases);
+    } else {
+      key = KeyIds::resolveOrIntern(keyName, kProjectorKeyAliases);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     updated = applyKeyEffects(key);
     if (!sendKey(key)) {
-      Serial.printf("[PROJECTOR][IR] No IR mapping for brand=%s key=%s\n",
-                    remoteBrand_.c_str(), key.c_str());
+      ++metrics_.unknownKeys;
+      LOG_W("[PROJECTOR][IR] No IR mapping for brand=%s key=%s",
+            remoteBrand_.c_str(), keyName);
     }
   }
 
@@ -368,9 +343,43 @@ bool ProjectorController::handleCommand(JsonObjectConst cmd,
   return applyState(stateDoc);
 }
 
-bool ProjectorController::sendKey(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  if (sendLearnedKey(normalizedKey)) {
+uint8_t ProjectorController::sendKeyPresses(const char *keyName,
+                                            uint8_t presses,
+                                            uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::resolve(keyName, kProjectorKeyAliases);
+  uint8_t sent = 0;
+  while (sent < presses && sendKey(key, gapAfterMs)) {
+    applyKeyEffects(key);
+    ++sent;
+  }
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[PROJECTOR][IR] No IR mapping for brand=%s key=%s",
+          remoteBrand_.c_str(), keyName);
+  }
+  return sent;
+}
+
+bool ProjectorController::resolveKey(const char *keyName, IrFrame &frame) {
+  const KeyId key = KeyIds::resolve(keyName, kProjectorKeyAliases);
+  if (const LearnedKey *entry = learned_.find(key)) {
+    frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                              entry->raw);
+    return true;
+  }
+  const RemoteConfig *remote =
+      findRemote(remoteBrand_, remoteType_, remoteIndex_);
+  const KeyCommand *cmd = remote != nullptr ? findKey(remote, key) : nullptr;
+  if (cmd == nullptr || !cmd->nbits ||
+      cmd->protocol == decode_type_t::UNKNOWN) {
+    return false;
+  }
+  frame = IrFrame::fromCode(cmd->protocol, cmd->value, cmd->nbits, {});
+  return true;
+}
+
+bool ProjectorController::sendKey(KeyId key, uint16_t gapAfterMs) {
+  if (sendLearnedKey(key, gapAfterMs)) {
     return true;
   }
 
@@ -379,7 +388,7 @@ bool ProjectorController::sendKey(const String &key) {
   if (remote == nullptr) {
     return false;
   }
-  const KeyCommand *cmd = findKey(remote, normalizedKey);
+  const KeyCommand *cmd = findKey(remote, key);
   if (cmd == nullptr) {
     return false;
   }
@@ -388,82 +397,53 @@ bool ProjectorController::sendKey(const String &key) {
     return false;
   }
 
-  irSend_.send(cmd->protocol, cmd->value, cmd->nbits);
-  Serial.printf("[PROJECTOR][IR] Sent key=%s protocol=%d value=0x%llX bits=%u\n",
-                normalizedKey.c_str(), static_cast<int>(cmd->protocol),
-                static_cast<unsigned long long>(cmd->value), cmd->nbits);
+  ir_.sendValue(cmd->protocol, cmd->value, cmd->nbits, gapAfterMs);
+  ++metrics_.codesetHits;
+  LOG_D("[PROJECTOR][IR] Queued key=%s protocol=%d value=0x%llX bits=%u",
+        KeyIds::name(key), static_cast<int>(cmd->protocol),
+        static_cast<unsigned long long>(cmd->value), cmd->nbits);
   return true;
 }
 
 bool ProjectorController::learnKey(const String &key, decode_type_t protocol,
                                    uint64_t value, uint16_t nbits,
-                                   const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  if (normalizedKey.length() == 0 || protocol == decode_type_t::UNKNOWN ||
-      nbits == 0) {
-    return false;
-  }
-  saveLearnedCommand(normalizedKey, protocol, value, nbits, raw);
-  return true;
+                                   const std::vector<uint8_t> &raw,
+                                   const std::vector<uint8_t> &timing) {
+  const KeyId id = KeyIds::resolveOrIntern(key.c_str(), kProjectorKeyAliases);
+  return learned_.save(id, protocol, value, nbits, raw, timing);
 }
 
-void ProjectorController::saveLearnedCommand(const String &key,
-                                             decode_type_t protocol,
-                                             uint64_t value, uint16_t nbits,
-                                             const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      entry.protocol = protocol;
-      entry.value = value;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool ProjectorController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
   }
-
-  LearnedCommand cmd;
-  cmd.key = normalizedKey;
-  cmd.protocol = protocol;
-  cmd.value = value;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
-}
-
-bool ProjectorController::sendLearnedKey(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (const auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      if (!entry.raw.empty() && entry.nbits > 64) {
-        irSend_.send(entry.protocol, entry.raw.data(),
-                     static_cast<uint16_t>(entry.raw.size()));
-      } else {
-        irSend_.send(entry.protocol, entry.value, entry.nbits);
-      }
-      Serial.printf(
-          "[PROJECTOR][IR] Sent learned key=%s protocol=%d value=0x%llX bits=%u\n",
-          normalizedKey.c_str(), static_cast<int>(entry.protocol),
-          static_cast<unsigned long long>(entry.value), entry.nbits);
-      return true;
-    }
+  if (!entry->raw.empty() && entry->nbits > 64) {
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), 1, 0, gapAfterMs,
+                  entry->timing);
+  } else {
+    ir_.sendValue(entry->protocol, entry->value, entry->nbits, gapAfterMs);
   }
-  return false;
+  ++metrics_.learnedHits;
+  LOG_D(
+      "[PROJECTOR][IR] Queued learned key=%s protocol=%d value=0x%llX bits=%u",
+      KeyIds::name(key), static_cast<int>(entry->protocol),
+      static_cast<unsigned long long>(entry->value), entry->nbits);
+  return true;
 }
 
-bool ProjectorController::applyKeyEffects(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  bool changed = false;
-  if (normalizedKey.equalsIgnoreCase("POWER")) {
-    state_.power = !state_.power;
-    changed = true;
-  } else if (normalizedKey.equalsIgnoreCase("FREEZE")) {
-    state_.frozen = !state_.frozen;
-    changed = true;
+bool ProjectorController::applyKeyEffects(KeyId key) {
+  switch (key) {
+    case KeyId::kPower:
+      state_.power = !state_.power;
+      return true;
+    case KeyId::kFreeze:
+      state_.frozen = !state_.frozen;
+      return true;
+    default:
+      return false;
   }
-  return changed;
 }
 
 bool ProjectorController::applyState(JsonDocument &stateDoc) {
@@ -474,32 +454,11 @@ bool ProjectorController::applyState(JsonDocument &stateDoc) {
 
 const ProjectorController::RemoteConfig *ProjectorController::findRemote(
     const String &brand, const String &type, uint16_t index) {
-  const RemoteConfig *fallback = nullptr;
-  for (const auto &remote : kRemotes) {
-    bool brandMatch = brand.length() == 0 ||
-                      remote.brand == nullptr || remote.brand[0] == '\0' ||
-                      brand.equalsIgnoreCase(remote.brand);
-    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
-                     type.equalsIgnoreCase(remote.type);
-    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
-    if (brandMatch && typeMatch && indexMatch) {
-      if (fallback == nullptr) fallback = &remote;
-      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
-          (remote.index != 0 && remote.index == index)) {
-        return &remote;
-      }
-    }
-  }
-  return fallback;
+  return CodesetIndex::findRemote(kProjectorRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
 }
 
 const ProjectorController::KeyCommand *ProjectorController::findKey(
-    const RemoteConfig *remote, const String &key) {
-  if (remote == nullptr) return nullptr;
-  for (size_t i = 0; i < remote->commandCount; ++i) {
-    if (key.equalsIgnoreCase(remote->commands[i].key)) {
-      return &remote->commands[i];
-    }
-  }
-  return nullptr;
+    const RemoteConfig *remote, KeyId key) {
+  return CodesetIndex::findKey(kProjectorKeyIndex, kRemotes, remote, key);
 }
@@ -4,54 +4,42 @@
 #include <IRutils.h>
 #include <algorithm>
 #include <cstdlib>
+#include <strings.h>
 
-namespace {
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
+#include "CodesetIndex.h"
+#include "Log.h"
 
+namespace {
 constexpr uint16_t kChannelGapMs = 120;
 
-String canonicalizeKey(const String &key) {
-  String out = key;
-  out.trim();
-  out.toUpperCase();
-
-  // Common aliases (helps keep ESP compatible if Android naming changes).
-  if (out.equalsIgnoreCase("SOURCE") || out.equalsIgnoreCase("INPUT") ||
-      out.equalsIgnoreCase("AV") || out.equalsIgnoreCase("TVAV")) {
-    return "TV_AV";
-  }
-  if (out.equalsIgnoreCase("ENTER") || out.equalsIgnoreCase("SELECT") ||
-      out.equalsIgnoreCase("CONFIRM")) {
-    return "OK";
-  }
-  if (out.equalsIgnoreCase("RETURN")) {
-    return "BACK";
-  }
-  if (out.equalsIgnoreCase("SETTINGS") || out.equalsIgnoreCase("OPTIONS")) {
-    return "MENU";
-  }
-  if (out.equalsIgnoreCase("INFO") || out.equalsIgnoreCase("TOOLS") ||
-      out.equalsIgnoreCase("MORE_INFO")) {
-    return "MORE";
-  }
-  if (out.equalsIgnoreCase("CHANNEL_UP")) return "CH_UP";
-  if (out.equalsIgnoreCase("CHANNEL_DOWN")) return "CH_DOWN";
-  if (out.equalsIgnoreCase("VOLUME_UP")) return "VOL_UP";
-  if (out.equalsIgnoreCase("VOLUME_DOWN")) return "VOL_DOWN";
-  if (out.equalsIgnoreCase("PAGEUP")) return "PAGE_UP";
-  if (out.equalsIgnoreCase("PAGEDOWN")) return "PAGE_DOWN";
-
-  return out;
-}
+// Common aliases (helps keep ESP compatible if Android naming changes).
+constexpr KeyName kStbAliases[] = {
+    {"SOURCE", KeyId::kTvAv},
+    {"INPUT", KeyId::kTvAv},
+    {"AV", KeyId::kTvAv},
+    {"TVAV", KeyId::kTvAv},
+    {"ENTER", KeyId::kOk},
+    {"SELECT", KeyId::kOk},
+    {"CONFIRM", KeyId::kOk},
+    {"RETURN", KeyId::kBack},
+    {"SETTINGS", KeyId::kMenu},
+    {"OPTIONS", KeyId::kMenu},
+    {"INFO", KeyId::kMore},
+    {"TOOLS", KeyId::kMore},
+    {"MORE_INFO", KeyId::kMore},
+    {"CHANNEL_UP", KeyId::kChUp},
+    {"CHANNEL_DOWN", KeyId::kChDown},
+    {"VOLUME_UP", KeyId::kVolUp},
+    {"VOLUME_DOWN", KeyId::kVolDown},
+    {"PAGEUP", KeyId::kPageUp},
+    {"PAGEDOWN", KeyId::kPageDown},
+};
+constexpr auto kStbKeyAliases = KeyIds::makeAliasTable(kStbAliases);
+static_assert(kStbKeyAliases.index.complete,
+              "STB key aliases: no perfect-hash seed found");
 
 // Samsung STB codeset #1 (NEC 32-bit, BN59-00603A-STB)
-const StbController::KeyCommand kSamsungStbCommands1[] = {
+constexpr StbController::KeyCommand kSamsungStbCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x909040BF, 32},
     // TV-mapped keys on many Samsung STB remotes use Samsung protocol.
     {"MUTE", decode_type_t::SAMSUNG, 0xE0E0F00F, 32},
@@ -86,7 +74,7 @@ const StbController::KeyCommand kSamsungStbCommands1[] = {
 
 // Generic Cable Box (IRDB: Comcast/Cable Box/0,-1.csv) - G.I.Cable 16-bit.
 // For GICABLE, IRDB's "function" maps directly to the 16-bit payload.
-const StbController::KeyCommand kGicableStbCommands1[] = {
+constexpr StbController::KeyCommand kGicableStbCommands1[] = {
     {"POWER", decode_type_t::GICABLE, 10, 16},
     {"CH_UP", decode_type_t::GICABLE, 11, 16},
     {"CH_DOWN", decode_type_t::GICABLE, 12, 16},
@@ -113,9 +101,9 @@ const StbController::KeyCommand kGicableStbCommands1[] = {
     {"DIGIT_9", decode_type_t::GICABLE, 9, 16},
 };
 
-const StbController::KeyCommand kGenericStbCommands[] = {};
+constexpr StbController::KeyCommand kGenericStbCommands[] = {};
 
-const StbController::RemoteConfig kStbRemotes[] = {
+constexpr StbController::RemoteConfig kStbRemotes[] = {
     {"", "", 0, kGenericStbCommands,
      sizeof(kGenericStbCommands) / sizeof(kGenericStbCommands[0])},
 
@@ -142,6 +130,11 @@ const StbController::RemoteConfig kStbRemotes[] = {
     {"", "STB", 3002, kGicableStbCommands1,
      sizeof(kGicableStbCommands1) / sizeof(kGicableStbCommands1[0])},
 };
+
+constexpr auto kStbRemoteIndex = CodesetIndex::buildRemoteIndex(kStbRemotes);
+constexpr auto kStbKeyIndex = CodesetIndex::buildKeyIndex(kStbRemotes);
+static_assert(kStbRemoteIndex.complete && kStbKeyIndex.complete,
+              "STB codeset index: no perfect-hash seed found");
 }  // namespace
 
 const StbController::RemoteConfig StbController::kRemotes[] = {
@@ -157,17 +150,13 @@ const StbController::RemoteConfig StbController::kRemotes[] = {
     kStbRemotes[9],
 };
 
-StbController::StbController(const char *nodeId, uint8_t irPin)
+StbController::StbController(const char *nodeId, IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/stb/state"),
-      irPin_(irPin),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {}
 
 void StbController::begin() {
-  if (!irReady_) {
-    tryBegin(irSend_, 0);
-    irReady_ = true;
-  }
-  Serial.printf("[STB] Controller ready (IR pin=%u)\n", irPin_);
+  learned_.persistAs(deviceType());
+  LOG_I("[STB] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void StbController::serializeState(JsonDocument &doc) const {
@@ -178,7 +167,6 @@ void StbController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remoteBrand_;
   doc["type"] = remoteType_;
   doc["index"] = remoteIndex_;
-  doc["updatedAt"] = millis();
 }
 
 bool StbController::handleCommand(JsonObjectConst cmd,
@@ -190,59 +178,41 @@ bool StbController::handleCommand(JsonObjectConst cmd,
   if (cmd["index"].is<uint16_t>())
     remoteIndex_ = cmd["index"].as<uint16_t>();
 
-  String action = cmd["cmd"].as<String>();
-  if (action.isEmpty()) {
-    Serial.println(F("[STB] Missing command name"));
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || action[0] == '\0') {
+    LOG_W("[STB] Missing command name");
     return false;
   }
 
   bool updated = false;
 
-  if (action.equalsIgnoreCase("key")) {
-    const String key = canonicalizeKey(cmd["key"].as<String>());
-    if (key.isEmpty()) {
-      Serial.println(F("[STB] Missing key name"));
+  if (strcasecmp(action, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[STB] Missing key name");
       return false;
     }
 
     // If IR payload included, store it as learned.
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          const uint64_t value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::resolve(keyName, kStbKeyAliases);
+    } else {
+      key = KeyIds::resolveOrIntern(keyName, kStbKeyAliases);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     updated = applyKeyEffects(key);
     if (!sendKey(key)) {
-      Serial.printf("[STB][IR] No IR mapping for brand=%s key=%s\n",
-                    remoteBrand_.c_str(), key.c_str());
-    }
-  } else if (action.equalsIgnoreCase("channel")) {
-    String channelStr = cmd["channel"].as<String>();
-    if (channelStr.isEmpty() && cmd["value"].is<const char *>()) {
-      channelStr = cmd["value"].as<const char *>();
+      ++metrics_.unknownKeys;
+      LOG_W("[STB][IR] No IR mapping for brand=%s key=%s",
+            remoteBrand_.c_str(), keyName);
     }
+  } else if (strcasecmp(action, "channel") == 0) {
+    const String channelStr = channelOf(cmd);
     if (channelStr.isEmpty()) {
-      Serial.println(F("[STB] Missing channel value"));
+      LOG_W("[STB] Missing channel value");
       return false;
     }
     sendChannelDigits(channelStr);
@@ -257,8 +227,42 @@ bool StbController::handleCommand(JsonObjectConst cmd,
   return applyState(stateDoc);
 }
 
-bool StbController::sendKey(const String &key) {
-  if (sendLearnedKey(key)) {
+uint8_t StbController::sendKeyPresses(const char *keyName, uint8_t presses,
+                                      uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::resolve(keyName, kStbKeyAliases);
+  uint8_t sent = 0;
+  while (sent < presses && sendKey(key, gapAfterMs)) {
+    applyKeyEffects(key);
+    ++sent;
+  }
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[STB][IR] No IR mapping for brand=%s key=%s",
+          remoteBrand_.c_str(), keyName);
+  }
+  return sent;
+}
+
+bool StbController::resolveKey(const char *keyName, IrFrame &frame) {
+  const KeyId key = KeyIds::resolve(keyName, kStbKeyAliases);
+  if (const LearnedKey *entry = learned_.find(key)) {
+    frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                              entry->raw);
+    return true;
+  }
+  const RemoteConfig *remote =
+      findRemote(remoteBrand_, remoteType_, remoteIndex_);
+  const KeyCommand *cmd = remote != nullptr ? findKey(remote, key) : nullptr;
+  if (cmd == nullptr || !cmd->nbits ||
+      cmd->protocol == decode_type_t::UNKNOWN) {
+    return false;
+  }
+  frame = IrFrame::fromCode(cmd->protocol, cmd->value, cmd->nbits, {});
+  return true;
+}
+
+bool StbController::sendKey(KeyId key, uint16_t gapAfterMs) {
+  if (sendLearnedKey(key, gapAfterMs)) {
     return true;
   }
 
@@ -276,25 +280,44 @@ bool StbController::sendKey(const String &key) {
     return false;
   }
 
-  irSend_.send(cmd->protocol, cmd->value, cmd->nbits);
-  Serial.printf("[STB][IR] Sent key=%s protocol=%d value=0x%llX bits=%u\n",
-                key.c_str(), static_cast<int>(cmd->protocol),
-                static_cast<unsigned long long>(cmd->value), cmd->nbits);
+  ir_.sendValue(cmd->protocol, cmd->value, cmd->nbits, gapAfterMs);
+  ++metrics_.codesetHits;
+  LOG_D("[STB][IR] Queued key=%s protocol=%d value=0x%llX bits=%u",
+        KeyIds::name(key), static_cast<int>(cmd->protocol),
+        static_cast<unsigned long long>(cmd->value), cmd->nbits);
   return true;
 }
 
+// One frame per digit or dash, see sendChannelDigits().
+size_t StbController::irSlotsFor(JsonObjectConst cmd) const {
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || strcasecmp(action, "channel") != 0) return 1;
+  const String channel = channelOf(cmd);
+  size_t slots = 0;
+  for (size_t i = 0; i < channel.length(); ++i) {
+    const char c = channel[i];
+    if ((c >= '0' && c <= '9') || c == '-' || c == '_') ++slots;
+  }
+  return slots;
+}
+
+// "channel" as a string or number, else a string "value".
+String StbController::channelOf(JsonObjectConst cmd) {
+  String channel = cmd["channel"].as<String>();
+  if (channel.isEmpty() && cmd["value"].is<const char *>()) {
+    channel = cmd["value"].as<const char *>();
+  }
+  return channel;
+}
+
 bool StbController::sendChannelDigits(const String &channel) {
   bool anySent = false;
   for (size_t i = 0; i < channel.length(); ++i) {
     const char c = channel[i];
     if (c >= '0' && c <= '9') {
-      String key = "DIGIT_";
-      key += c;
-      anySent = sendKey(key) || anySent;
-      delay(kChannelGapMs);
+      anySent = sendKey(KeyIds::digit(c), kChannelGapMs) || anySent;
     } else if (c == '-' || c == '_') {
-      anySent = sendKey("DASH") || anySent;
-      delay(kChannelGapMs);
+      anySent = sendKey(KeyId::kDash, kChannelGapMs) || anySent;
     }
   }
   return anySent;
@@ -302,80 +325,50 @@ bool StbController::sendChannelDigits(const String &channel) {
 
 bool StbController::learnKey(const String &key, decode_type_t protocol,
                              uint64_t value, uint16_t nbits,
-                             const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  if (normalizedKey.length() == 0 || protocol == decode_type_t::UNKNOWN ||
-      nbits == 0) {
-    return false;
-  }
-  saveLearnedCommand(normalizedKey, protocol, value, nbits, raw);
-  return true;
+                             const std::vector<uint8_t> &raw,
+                             const std::vector<uint8_t> &timing) {
+  const KeyId id = KeyIds::resolveOrIntern(key.c_str(), kStbKeyAliases);
+  return learned_.save(id, protocol, value, nbits, raw, timing);
 }
 
-void StbController::saveLearnedCommand(const String &key,
-                                       decode_type_t protocol, uint64_t value,
-                                       uint16_t nbits,
-                                       const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      entry.protocol = protocol;
-      entry.value = value;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool StbController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
   }
-
-  LearnedCommand cmd;
-  cmd.key = normalizedKey;
-  cmd.protocol = protocol;
-  cmd.value = value;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
-}
-
-bool StbController::sendLearnedKey(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (const auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      if (!entry.raw.empty() && entry.nbits > 64) {
-        irSend_.send(entry.protocol, entry.raw.data(),
-                     static_cast<uint16_t>(entry.raw.size()));
-      } else {
-        irSend_.send(entry.protocol, entry.value, entry.nbits);
-      }
-      Serial.printf(
-          "[STB][IR] Sent learned key=%s protocol=%d value=0x%llX bits=%u\n",
-          normalizedKey.c_str(), static_cast<int>(entry.protocol),
-          static_cast<unsigned long long>(entry.value), entry.nbits);
-      return true;
-    }
+  if (!entry->raw.empty() && entry->nbits > 64) {
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), 1, 0, gapAfterMs,
+                  entry->timing);
+  } else {
+    ir_.sendValue(entry->protocol, entry->value, entry->nbits, gapAfterMs);
   }
-  return false;
+  ++metrics_.learnedHits;
+  LOG_D(
+      "[STB][IR] Queued learned key=%s protocol=%d value=0x%llX bits=%u",
+      KeyIds::name(key), static_cast<int>(entry->protocol),
+      static_cast<unsigned long long>(entry->value), entry->nbits);
+  return true;
 }
 
-bool StbController::applyKeyEffects(const String &key) {
-  bool changed = false;
-  if (key.equalsIgnoreCase("POWER")) {
-    state_.power = !state_.power;
-    changed = true;
-  } else if (key.equalsIgnoreCase("MUTE")) {
-    state_.muted = !state_.muted;
-    changed = true;
-  } else if (key.startsWith("DIGIT_")) {
-    // Channel changes handled when full channel sent; keep state intact here.
-  } else if (key.equalsIgnoreCase("CH_UP")) {
-    state_.channel = std::max(1, state_.channel + 1);
-    changed = true;
-  } else if (key.equalsIgnoreCase("CH_DOWN")) {
-    state_.channel = std::max(1, state_.channel - 1);
-    changed = true;
+bool StbController::applyKeyEffects(KeyId key) {
+  // Digits: channel changes handled when full channel sent; keep state intact.
+  switch (key) {
+    case KeyId::kPower:
+      state_.power = !state_.power;
+      return true;
+    case KeyId::kMute:
+      state_.muted = !state_.muted;
+      return true;
+    case KeyId::kChUp:
+      state_.channel = std::max(1, state_.channel + 1);
+      return true;
+    case KeyId::kChDown:
+      state_.channel = std::max(1, state_.channel - 1);
+      return true;
+    default:
+      return false;
   }
-  return changed;
 }
 
 bool StbController::applyState(JsonDocument &stateDoc) {
@@ -386,32 +379,11 @@ bool StbController::applyState(JsonDocument &stateDoc) {
 
 const StbController::RemoteConfig *StbController::findRemote(
     const String &brand, const String &type, uint16_t index) {
-  const RemoteConfig *fallback = nullptr;
-  for (const auto &remote : kRemotes) {
-    bool brandMatch = brand.length() == 0 ||
-                      remote.brand == nullptr || remote.brand[0] == '\0' ||
-                      brand.equalsIgnoreCase(remote.brand);
-    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
-                     type.equalsIgnoreCase(remote.type);
-    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
-    if (brandMatch && typeMatch && indexMatch) {
-      if (fallback == nullptr) fallback = &remote;
-      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
-          (remote.index != 0 && remote.index == index)) {
-        return &remote;
-      }
-    }
-  }
-  return fallback;
+  return CodesetIndex::findRemote(kStbRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
 }
 
 const StbController::KeyCommand *StbController::findKey(
-    const RemoteConfig *remote, const String &key) {
-  if (remote == nullptr) return nullptr;
-  for (size_t i = 0; i < remote->commandCount; ++i) {
-    if (key.equalsIgnoreCase(remote->commands[i].key)) {
-      return &remote->commands[i];
-    }
-  }
-  return nullptr;
+    const RemoteConfig *remote, KeyId key) {
+  return CodesetIndex::findKey(kStbKeyIndex, kRemotes, remote, key);
 }
@@ -4,54 +4,42 @@
 #include <IRutils.h>
 #include <algorithm>
 #include <cstdlib>
+#include <strings.h>
 
-namespace {
-template <typename T>
-auto tryBegin(T &obj, int) -> decltype(obj.begin(), void()) {
-  obj.begin();
-}
-
-template <typename T>
-void tryBegin(T &, ...) {}
+#include "CodesetIndex.h"
+#include "Log.h"
 
+namespace {
 constexpr uint16_t kChannelGapMs = 120;
 
-String canonicalizeKey(const String &key) {
-  String out = key;
-  out.trim();
-  out.toUpperCase();
-
-  // Common aliases (helps keep ESP compatible if Android naming changes).
-  if (out.equalsIgnoreCase("SOURCE") || out.equalsIgnoreCase("INPUT") ||
-      out.equalsIgnoreCase("AV") || out.equalsIgnoreCase("TVAV")) {
-    return "TV_AV";
-  }
-  if (out.equalsIgnoreCase("ENTER") || out.equalsIgnoreCase("SELECT") ||
-      out.equalsIgnoreCase("CONFIRM")) {
-    return "OK";
-  }
-  if (out.equalsIgnoreCase("RETURN")) {
-    return "BACK";
-  }
-  if (out.equalsIgnoreCase("SETTINGS") || out.equalsIgnoreCase("OPTIONS")) {
-    return "MENU";
-  }
-  if (out.equalsIgnoreCase("INFO") || out.equalsIgnoreCase("TOOLS") ||
-      out.equalsIgnoreCase("MORE_INFO")) {
-    return "MORE";
-  }
-  if (out.equalsIgnoreCase("CHANNEL_UP")) return "CH_UP";
-  if (out.equalsIgnoreCase("CHANNEL_DOWN")) return "CH_DOWN";
-  if (out.equalsIgnoreCase("VOLUME_UP")) return "VOL_UP";
-  if (out.equalsIgnoreCase("VOLUME_DOWN")) return "VOL_DOWN";
-
-  return out;
-}
+// Common aliases (helps keep ESP compatible if Android naming changes).
+constexpr KeyName kTvAliases[] = {
+    {"SOURCE", KeyId::kTvAv},
+    {"INPUT", KeyId::kTvAv},
+    {"AV", KeyId::kTvAv},
+    {"TVAV", KeyId::kTvAv},
+    {"ENTER", KeyId::kOk},
+    {"SELECT", KeyId::kOk},
+    {"CONFIRM", KeyId::kOk},
+    {"RETURN", KeyId::kBack},
+    {"SETTINGS", KeyId::kMenu},
+    {"OPTIONS", KeyId::kMenu},
+    {"INFO", KeyId::kMore},
+    {"TOOLS", KeyId::kMore},
+    {"MORE_INFO", KeyId::kMore},
+    {"CHANNEL_UP", KeyId::kChUp},
+    {"CHANNEL_DOWN", KeyId::kChDown},
+    {"VOLUME_UP", KeyId::kVolUp},
+    {"VOLUME_DOWN", KeyId::kVolDown},
+};
+constexpr auto kTvKeyAliases = KeyIds::makeAliasTable(kTvAliases);
+static_assert(kTvKeyAliases.index.complete,
+              "TV key aliases: no perfect-hash seed found");
 
-const TvController::KeyCommand kGenericTvCommands[] = {};
+constexpr TvController::KeyCommand kGenericTvCommands[] = {};
 
 // LG TV codeset #1 (NEC 32-bit, common on many LG remotes)
-const TvController::KeyCommand kLgTvCommands1[] = {
+constexpr TvController::KeyCommand kLgTvCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x20DF10EF, 32},
     {"MUTE", decode_type_t::NEC, 0x20DF906F, 32},
     {"VOL_UP", decode_type_t::NEC, 0x20DF40BF, 32},
@@ -82,16 +70,16 @@ const TvController::KeyCommand kLgTvCommands1[] = {
 };
 
 // LG TV codeset #2/#3: LG protocol samples (limited keys; extend as needed).
-const TvController::KeyCommand kLgTvCommands2[] = {
+constexpr TvController::KeyCommand kLgTvCommands2[] = {
     {"POWER", decode_type_t::LG, 0x04B4AE51, 28},
 };
 
-const TvController::KeyCommand kLgTvCommands3[] = {
+constexpr TvController::KeyCommand kLgTvCommands3[] = {
     {"POWER", decode_type_t::LG, 0xB4B4AE51, 32},
 };
 
 // Samsung TV codeset #1 (Samsung 32-bit, common mapping)
-const TvController::KeyCommand kSamsungTvCommands1[] = {
+constexpr TvController::KeyCommand kSamsungTvCommands1[] = {
     {"POWER", decode_type_t::SAMSUNG, 0xE0E040BF, 32},
     {"MUTE", decode_type_t::SAMSUNG, 0xE0E0F00F, 32},
     {"VOL_UP", decode_type_t::SAMSUNG, 0xE0E0E01F, 32},
@@ -122,7 +110,7 @@ const TvController::KeyCommand kSamsungTvCommands1[] = {
 };
 
 // Samsung TV codeset #2: alternate POWER (discrete ON), other keys same.
-const TvController::KeyCommand kSamsungTvCommands2[] = {
+constexpr TvController::KeyCommand kSamsungTvCommands2[] = {
     {"POWER", decode_type_t::SAMSUNG, 0xE0E09966, 32},
     {"MUTE", decode_type_t::SAMSUNG, 0xE0E0F00F, 32},
     {"VOL_UP", decode_type_t::SAMSUNG, 0xE0E0E01F, 32},
@@ -154,7 +142,7 @@ const TvController::KeyCommand kSamsungTvCommands2[] = {
 
 // Sony TV codeset #1/#2/#3: SIRC (12/15/20-bit variants).
 // Values are compatible with IRsend::sendSony() format (bit-reversed payload).
-const TvController::KeyCommand kSonyTvCommands1[] = {
+constexpr TvController::KeyCommand kSonyTvCommands1[] = {
     {"POWER", decode_type_t::SONY, 0x0A90, 12},
     {"MUTE", decode_type_t::SONY, 0x0290, 12},
     {"VOL_UP", decode_type_t::SONY, 0x0490, 12},
@@ -184,7 +172,7 @@ const TvController::KeyCommand kSonyTvCommands1[] = {
     {"DIGIT_9", decode_type_t::SONY, 0x0910, 12},
 };
 
-const TvController::KeyCommand kSonyTvCommands2[] = {
+constexpr TvController::KeyCommand kSonyTvCommands2[] = {
     {"POWER", decode_type_t::SONY, 0x5480, 15},
     {"MUTE", decode_type_t::SONY, 0x1480, 15},
     {"VOL_UP", decode_type_t::SONY, 0x2480, 15},
@@ -214,7 +202,7 @@ const TvController::KeyCommand kSonyTvCommands2[] = {
     {"DIGIT_9", decode_type_t::SONY, 0x4880, 15},
 };
 
-const TvController::KeyCommand kSonyTvCommands3[] = {
+constexpr TvController::KeyCommand kSonyTvCommands3[] = {
     {"POWER", decode_type_t::SONY, 0x0A9000, 20},
     {"MUTE", decode_type_t::SONY, 0x029000, 20},
     {"VOL_UP", decode_type_t::SONY, 0x049000, 20},
@@ -246,7 +234,7 @@ const TvController::KeyCommand kSonyTvCommands3[] = {
 
 // Panasonic TV (IRDB: Panasonic/TV/128,0.csv) - Panasonic (Kaseikyo) 48-bit.
 // Uses IRsend::encodePanasonic(0x4004, device=0x80, subdevice=0x00, function)
-const TvController::KeyCommand kPanasonicTvCommands1[] = {
+constexpr TvController::KeyCommand kPanasonicTvCommands1[] = {
     {"POWER", decode_type_t::PANASONIC, 0x400480003DBD, 48},     // POWER TOGGLE
     {"MUTE", decode_type_t::PANASONIC, 0x4004800032B2, 48},      // VOLUME MUTE TOGGLE
     {"VOL_UP", decode_type_t::PANASONIC, 0x4004800020A0, 48},    // VOLUME UP
@@ -276,7 +264,7 @@ const TvController::KeyCommand kPanasonicTvCommands1[] = {
 };
 
 // Sharp TV (IRDB: Sharp/TV/1,-1.csv) - Sharp 15-bit.
-const TvController::KeyCommand kSharpTvCommands1[] = {
+constexpr TvController::KeyCommand kSharpTvCommands1[] = {
     {"POWER", decode_type_t::SHARP, 0x41A2, 15},
     {"MUTE", decode_type_t::SHARP, 0x43A2, 15},
     {"VOL_UP", decode_type_t::SHARP, 0x40A2, 15},
@@ -300,7 +288,7 @@ const TvController::KeyCommand kSharpTvCommands1[] = {
 };
 
 // Mitsubishi TV (IRDB: Mitsubishi/TV/1,-1.csv) - OEM Sharp 15-bit.
-const TvController::KeyCommand kMitsubishiTvCommands1[] = {
+constexpr TvController::KeyCommand kMitsubishiTvCommands1[] = {
     {"POWER", decode_type_t::SHARP, 0x41A2, 15},
     {"MUTE", decode_type_t::SHARP, 0x43A2, 15},
     {"VOL_UP", decode_type_t::SHARP, 0x40A2, 15},
@@ -324,7 +312,7 @@ const TvController::KeyCommand kMitsubishiTvCommands1[] = {
 };
 
 // Toshiba TV (IRDB: Toshiba/TV/64,-1.csv) - NEC1/NEC 32-bit.
-const TvController::KeyCommand kToshibaTvCommands1[] = {
+constexpr TvController::KeyCommand kToshibaTvCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x40BF12ED, 32},
     {"MUTE", decode_type_t::NEC, 0x40BF10EF, 32},
     {"VOL_UP", decode_type_t::NEC, 0x40BF1AE5, 32},
@@ -350,7 +338,7 @@ const TvController::KeyCommand kToshibaTvCommands1[] = {
 };
 
 // Philips TV (IRDB: Philips/TV/0,-1.csv) - RC5 12-bit.
-const TvController::KeyCommand kPhilipsTvCommands1[] = {
+constexpr TvController::KeyCommand kPhilipsTvCommands1[] = {
     {"POWER", decode_type_t::RC5, 12, 12},
     {"MUTE", decode_type_t::RC5, 13, 12},
     {"VOL_UP", decode_type_t::RC5, 16, 12},
@@ -377,7 +365,7 @@ const TvController::KeyCommand kPhilipsTvCommands1[] = {
 };
 
 // JVC TV (IRDB: JVC/TV/3,-1.csv) - JVC 16-bit.
-const TvController::KeyCommand kJvcTvCommands1[] = {
+constexpr TvController::KeyCommand kJvcTvCommands1[] = {
     {"POWER", decode_type_t::JVC, 0xC0E8, 16},
     {"MUTE", decode_type_t::JVC, 0xC038, 16},
     {"VOL_UP", decode_type_t::JVC, 0xC078, 16},
@@ -406,7 +394,7 @@ const TvController::KeyCommand kJvcTvCommands1[] = {
 };
 
 // Sanyo TV (IRDB: Sanyo/TV/56,-1.csv) - NEC1/NEC 32-bit.
-const TvController::KeyCommand kSanyoTvCommands1[] = {
+constexpr TvController::KeyCommand kSanyoTvCommands1[] = {
     {"POWER", decode_type_t::NEC, 0x38C712ED, 32},
     {"MUTE", decode_type_t::NEC, 0x38C718E7, 32},
     {"VOL_UP", decode_type_t::NEC, 0x38C70EF1, 32},
@@ -429,7 +417,7 @@ const TvController::KeyCommand kSanyoTvCommands1[] = {
     {"DIGIT_9", decode_type_t::NEC, 0x38C709F6, 32},
 };
 
-const TvController::RemoteConfig kTvRemotes[] = {
+constexpr TvController::RemoteConfig kTvRemotes[] = {
     {"", "", 0, kGenericTvCommands,
      sizeof(kGenericTvCommands) / sizeof(kGenericTvCommands[0])},
     {"LG", "TV", 1, kLgTvCommands1,
@@ -497,6 +485,11 @@ const TvController::RemoteConfig kTvRemotes[] = {
      sizeof(kSanyoTvCommands1) / sizeof(kSanyoTvCommands1[0])},
 };
 
+constexpr auto kTvRemoteIndex = CodesetIndex::buildRemoteIndex(kTvRemotes);
+constexpr auto kTvKeyIndex = CodesetIndex::buildKeyIndex(kTvRemotes);
+static_assert(kTvRemoteIndex.complete && kTvKeyIndex.complete,
+              "TV codeset index: no perfect-hash seed found");
+
 int clampVolume(int v) {
   return std::max(0, std::min(100, v));
 }
@@ -537,17 +530,13 @@ const TvController::RemoteConfig TvController::kRemotes[] = {
     kTvRemotes[30],
 };
 
-TvController::TvController(const char *nodeId, uint8_t irPin)
+TvController::TvController(const char *nodeId, IrTransmitter &transmitter)
     : stateTopic_(String("iot/nodes/") + nodeId + "/tv/state"),
-      irPin_(irPin),
-      irSend_(irPin, IR_SEND_INVERTED, IR_SEND_USE_MODULATION) {}
+      ir_(transmitter) {}
 
 void TvController::begin() {
-  if (!irReady_) {
-    tryBegin(irSend_, 0);
-    irReady_ = true;
-  }
-  Serial.printf("[TV] Controller ready (IR pin=%u)\n", irPin_);
+  learned_.persistAs(deviceType());
+  LOG_I("[TV] Controller ready (IR pin=%u)", ir_.pin());
 }
 
 void TvController::serializeState(JsonDocument &doc) const {
@@ -560,7 +549,6 @@ void TvController::serializeState(JsonDocument &doc) const {
   doc["brand"] = remoteBrand_;
   doc["type"] = remoteType_;
   doc["index"] = remoteIndex_;
-  doc["updatedAt"] = millis();
 }
 
 bool TvController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
@@ -571,64 +559,46 @@ bool TvController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   if (cmd["index"].is<uint16_t>())
     remoteIndex_ = cmd["index"].as<uint16_t>();
 
-  String action = cmd["cmd"].as<String>();
-  if (action.isEmpty()) {
-    Serial.println(F("[TV] Missing command name"));
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || action[0] == '\0') {
+    LOG_W("[TV] Missing command name");
     return false;
   }
 
   bool updated = false;
 
-  if (action.equalsIgnoreCase("key")) {
-    const String key = canonicalizeKey(cmd["key"].as<String>());
-    if (key.isEmpty()) {
-      Serial.println(F("[TV] Missing key name"));
+  if (strcasecmp(action, "key") == 0) {
+    const char *keyName = cmd["key"].as<const char *>();
+    if (KeyIds::isBlank(keyName)) {
+      LOG_W("[TV] Missing key name");
       return false;
     }
 
     JsonObjectConst learnedIr = cmd["ir"].as<JsonObjectConst>();
-    if (!learnedIr.isNull()) {
-      const char *protoStr = learnedIr["protocol"].as<const char *>();
-      const char *codeStr = learnedIr["code"].as<const char *>();
-      const uint16_t bits = learnedIr["bits"].as<uint16_t>();
-      if (protoStr != nullptr && codeStr != nullptr && bits > 0) {
-        const decode_type_t protocol = strToDecodeType(protoStr);
-        if (protocol != decode_type_t::UNKNOWN) {
-          const uint64_t value = strtoull(codeStr, nullptr, 16);
-          std::vector<uint8_t> raw;
-          const size_t nbytes = (bits + 7) / 8;
-          raw.reserve(nbytes);
-          String hexStr(codeStr);
-          while (hexStr.length() < nbytes * 2) {
-            hexStr = String('0') + hexStr;
-          }
-          for (size_t i = 0; i + 1 < hexStr.length(); i += 2) {
-            char buf[3] = {hexStr[i], hexStr[i + 1], '\0'};
-            raw.push_back(static_cast<uint8_t>(strtoul(buf, nullptr, 16)));
-          }
-          saveLearnedCommand(key, protocol, value, bits, raw);
-        }
-      }
+    KeyId key;
+    if (learnedIr.isNull()) {
+      key = KeyIds::resolve(keyName, kTvKeyAliases);
+    } else {
+      key = KeyIds::resolveOrIntern(keyName, kTvKeyAliases);
+      learned_.saveFromJson(key, learnedIr);
     }
 
     updated = applyKeyEffects(key);
     if (!sendKey(key)) {
-      Serial.printf("[TV][IR] No IR mapping for brand=%s key=%s\n",
-                    remoteBrand_.c_str(), key.c_str());
-    }
-  } else if (action.equalsIgnoreCase("channel")) {
-    String channelStr = cmd["channel"].as<String>();
-    if (channelStr.isEmpty() && cmd["value"].is<const char *>()) {
-      channelStr = cmd["value"].as<const char *>();
+      ++metrics_.unknownKeys;
+      LOG_W("[TV][IR] No IR mapping for brand=%s key=%s",
+            remoteBrand_.c_str(), keyName);
     }
+  } else if (strcasecmp(action, "channel") == 0) {
+    const String channelStr = channelOf(cmd);
     if (channelStr.isEmpty()) {
-      Serial.println(F("[TV] Missing channel value"));
+      LOG_W("[TV] Missing channel value");
       return false;
     }
     sendChannelDigits(channelStr);
     state_.channel = channelStr.toInt() > 0 ? channelStr.toInt() : state_.channel;
     updated = true;
-  } else if (action.equalsIgnoreCase("set")) {
+  } else if (strcasecmp(action, "set") == 0) {
     if (cmd["power"].is<bool>()) {
       state_.power = cmd["power"].as<bool>();
       updated = true;
@@ -659,8 +629,42 @@ bool TvController::handleCommand(JsonObjectConst cmd, JsonDocument &stateDoc) {
   return applyState(stateDoc);
 }
 
-bool TvController::sendKey(const String &key) {
-  if (sendLearnedKey(key)) {
+uint8_t TvController::sendKeyPresses(const char *keyName, uint8_t presses,
+                                     uint16_t gapAfterMs) {
+  const KeyId key = KeyIds::resolve(keyName, kTvKeyAliases);
+  uint8_t sent = 0;
+  while (sent < presses && sendKey(key, gapAfterMs)) {
+    applyKeyEffects(key);
+    ++sent;
+  }
+  if (sent == 0) {
+    ++metrics_.unknownKeys;
+    LOG_W("[TV][IR] No IR mapping for brand=%s key=%s",
+          remoteBrand_.c_str(), keyName);
+  }
+  return sent;
+}
+
+bool TvController::resolveKey(const char *keyName, IrFrame &frame) {
+  const KeyId key = KeyIds::resolve(keyName, kTvKeyAliases);
+  if (const LearnedKey *entry = learned_.find(key)) {
+    frame = IrFrame::fromCode(entry->protocol, entry->value, entry->nbits,
+                              entry->raw);
+    return true;
+  }
+  const RemoteConfig *remote =
+      findRemote(remoteBrand_, remoteType_, remoteIndex_);
+  const KeyCommand *cmd = remote != nullptr ? findKey(remote, key) : nullptr;
+  if (cmd == nullptr || !cmd->nbits ||
+      cmd->protocol == decode_type_t::UNKNOWN) {
+    return false;
+  }
+  frame = IrFrame::fromCode(cmd->protocol, cmd->value, cmd->nbits, {});
+  return true;
+}
+
+bool TvController::sendKey(KeyId key, uint16_t gapAfterMs) {
+  if (sendLearnedKey(key, gapAfterMs)) {
     return true;
   }
 
@@ -680,28 +684,47 @@ bool TvController::sendKey(const String &key) {
 
   uint64_t value = cmd->value;
   if (cmd->protocol == decode_type_t::RC5 || cmd->protocol == decode_type_t::RC5X) {
-    if (rc5Toggle_) value = irSend_.toggleRC5(value);
+    if (rc5Toggle_) value = ir_.toggleRC5(value);
     rc5Toggle_ = !rc5Toggle_;
   }
-  irSend_.send(cmd->protocol, value, cmd->nbits);
-  Serial.printf("[TV][IR] Sent key=%s protocol=%d value=0x%llX bits=%u\n",
-                key.c_str(), static_cast<int>(cmd->protocol),
-                static_cast<unsigned long long>(value), cmd->nbits);
+  ir_.sendValue(cmd->protocol, value, cmd->nbits, gapAfterMs);
+  ++metrics_.codesetHits;
+  LOG_D("[TV][IR] Queued key=%s protocol=%d value=0x%llX bits=%u",
+        KeyIds::name(key), static_cast<int>(cmd->protocol),
+        static_cast<unsigned long long>(value), cmd->nbits);
   return true;
 }
 
+// One frame per digit or dash, see sendChannelDigits().
+size_t TvController::irSlotsFor(JsonObjectConst cmd) const {
+  const char *action = cmd["cmd"].as<const char *>();
+  if (action == nullptr || strcasecmp(action, "channel") != 0) return 1;
+  const String channel = channelOf(cmd);
+  size_t slots = 0;
+  for (size_t i = 0; i < channel.length(); ++i) {
+    const char c = channel[i];
+    if ((c >= '0' && c <= '9') || c == '-' || c == '_') ++slots;
+  }
+  return slots;
+}
+
+// "channel" as a string or number, else a string "value".
+String TvController::channelOf(JsonObjectConst cmd) {
+  String channel = cmd["channel"].as<String>();
+  if (channel.isEmpty() && cmd["value"].is<const char *>()) {
+    channel = cmd["value"].as<const char *>();
+  }
+  return channel;
+}
+
 bool TvController::sendChannelDigits(const String &channel) {
   bool anySent = false;
   for (size_t i = 0; i < channel.length(); ++i) {
     const char c = channel[i];
     if (c >= '0' && c <= '9') {
-      String key = "DIGIT_";
-      key += c;
-      anySent = sendKey(key) || anySent;
-      delay(kChannelGapMs);
+      anySent = sendKey(KeyIds::digit(c), kChannelGapMs) || anySent;
     } else if (c == '-' || c == '_') {
-      anySent = sendKey("DASH") || anySent;
-      delay(kChannelGapMs);
+      anySent = sendKey(KeyId::kDash, kChannelGapMs) || anySent;
     }
   }
   return anySent;
@@ -709,89 +732,61 @@ bool TvController::sendChannelDigits(const String &channel) {
 
 bool TvController::learnKey(const String &key, decode_type_t protocol,
                             uint64_t value, uint16_t nbits,
-                            const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  if (normalizedKey.length() == 0 || protocol == decode_type_t::UNKNOWN ||
-      nbits == 0) {
-    return false;
-  }
-  saveLearnedCommand(normalizedKey, protocol, value, nbits, raw);
-  return true;
+                            const std::vector<uint8_t> &raw,
+                            const std::vector<uint8_t> &timing) {
+  const KeyId id = KeyIds::resolveOrIntern(key.c_str(), kTvKeyAliases);
+  return learned_.save(id, protocol, value, nbits, raw, timing);
 }
 
-void TvController::saveLearnedCommand(const String &key, decode_type_t protocol,
-                                      uint64_t value, uint16_t nbits,
-                                      const std::vector<uint8_t> &raw) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      entry.protocol = protocol;
-      entry.value = value;
-      entry.nbits = nbits;
-      entry.raw = raw;
-      return;
-    }
+bool TvController::sendLearnedKey(KeyId key, uint16_t gapAfterMs) {
+  const LearnedKey *entry = learned_.find(key);
+  if (entry == nullptr) {
+    return false;
   }
-
-  LearnedCommand cmd;
-  cmd.key = normalizedKey;
-  cmd.protocol = protocol;
-  cmd.value = value;
-  cmd.nbits = nbits;
-  cmd.raw = raw;
-  learnedCommands_.push_back(cmd);
-}
-
-bool TvController::sendLearnedKey(const String &key) {
-  const String normalizedKey = canonicalizeKey(key);
-  for (const auto &entry : learnedCommands_) {
-    if (normalizedKey.equalsIgnoreCase(entry.key) ||
-        canonicalizeKey(entry.key).equalsIgnoreCase(normalizedKey)) {
-      if (!entry.raw.empty() && entry.nbits > 64) {
-        irSend_.send(entry.protocol, entry.raw.data(),
-                     static_cast<uint16_t>(entry.raw.size()));
-      } else {
-        uint64_t value = entry.value;
-        if (entry.protocol == decode_type_t::RC5 ||
-            entry.protocol == decode_type_t::RC5X) {
-          if (rc5Toggle_) value = irSend_.toggleRC5(value);
-          rc5Toggle_ = !rc5Toggle_;
-        }
-        irSend_.send(entry.protocol, value, entry.nbits);
-      }
-      Serial.printf(
-          "[TV][IR] Sent learned key=%s protocol=%d value=0x%llX bits=%u\n",
-          normalizedKey.c_str(), static_cast<int>(entry.protocol),
-          static_cast<unsigned long long>(entry.value), entry.nbits);
-      return true;
+  if (!entry->raw.empty() && entry->nbits > 64) {
+    ir_.sendState(entry->protocol, entry->raw.data(),
+                  static_cast<uint16_t>(entry->raw.size()), 1, 0, gapAfterMs,
+                  entry->timing);
+  } else {
+    uint64_t value = entry->value;
+    if (entry->protocol == decode_type_t::RC5 ||
+        entry->protocol == decode_type_t::RC5X) {
+      if (rc5Toggle_) value = ir_.toggleRC5(value);
+      rc5Toggle_ = !rc5Toggle_;
     }
+    ir_.sendValue(entry->protocol, value, entry->nbits, gapAfterMs);
   }
-  return false;
+  ++metrics_.learnedHits;
+  LOG_D(
+      "[TV][IR] Queued learned key=%s protocol=%d value=0x%llX bits=%u",
+      KeyIds::name(key), static_cast<int>(entry->protocol),
+      static_cast<unsigned long long>(entry->value), entry->nbits);
+  return true;
 }
 
-bool TvController::applyKeyEffects(const String &key) {
-  bool changed = false;
-  if (key.equalsIgnoreCase("POWER")) {
-    state_.power = !state_.power;
-    changed = true;
-  } else if (key.equalsIgnoreCase("MUTE")) {
-    state_.muted = !state_.muted;
-    changed = true;
-  } else if (key.equalsIgnoreCase("VOL_UP")) {
-    state_.volume = clampVolume(state_.volume + 1);
-    changed = true;
-  } else if (key.equalsIgnoreCase("VOL_DOWN")) {
-    state_.volume = clampVolume(state_.volume - 1);
-    changed = true;
-  } else if (key.equalsIgnoreCase("CH_UP")) {
-    state_.channel = std::max(1, state_.channel + 1);
-    changed = true;
-  } else if (key.equalsIgnoreCase("CH_DOWN")) {
-    state_.channel = std::max(1, state_.channel - 1);
-    changed = true;
+bool TvController::applyKeyEffects(KeyId key) {
+  switch (key) {
+    case KeyId::kPower:
+      state_.power = !state_.power;
+      return true;
+    case KeyId::kMute:
+      state_.muted = !state_.muted;
+      return true;
+    case KeyId::kVolUp:
+      state_.volume = clampVolume(state_.volume + 1);
+      return true;
+    case KeyId::kVolDown:
+      state_.volume = clampVolume(state_.volume - 1);
+      return true;
+    case KeyId::kChUp:
+      state_.channel = std::max(1, state_.channel + 1);
+      return true;
+    case KeyId::kChDown:
+      state_.channel = std::max(1, state_.channel - 1);
+      return true;
+    default:
+      return false;
   }
-  return changed;
 }
 
 bool TvController::applyState(JsonDocument &stateDoc) {
@@ -802,32 +797,11 @@ bool TvController::applyState(JsonDocument &stateDoc) {
 
 const TvController::RemoteConfig *TvController::findRemote(
     const String &brand, const String &type, uint16_t index) {
-  const RemoteConfig *fallback = nullptr;
-  for (const auto &remote : kRemotes) {
-    bool brandMatch = brand.length() == 0 ||
-                      remote.brand == nullptr || remote.brand[0] == '\0' ||
-                      brand.equalsIgnoreCase(remote.brand);
-    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
-                     type.equalsIgnoreCase(remote.type);
-    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
-    if (brandMatch && typeMatch && indexMatch) {
-      if (fallback == nullptr) fallback = &remote;
-      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
-          (remote.index != 0 && remote.index == index)) {
-        return &remote;
-      }
-    }
-  }
-  return fallback;
+  return CodesetIndex::findRemote(kTvRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
 }
 
 const TvController::KeyCommand *TvController::findKey(
-    const RemoteConfig *remote, const String &key) {
-  if (remote == nullptr) return nullptr;
-  for (size_t i = 0; i < remote->commandCount; ++i) {
-    if (key.equalsIgnoreCase(remote->commands[i].key)) {
-      return &remote->commands[i];
-    }
-  }
-  return nullptr;
+    const RemoteConfig *remote, KeyId key) {
+  return CodesetIndex::findKey(kTvKeyIndex, kRemotes, remote, key);
 }
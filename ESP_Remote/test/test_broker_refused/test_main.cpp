@@ -0,0 +1,225 @@
+// The whole firmware on the NativeShims simulator with a broker that
+// refuses every connect: the network task keeps stepping while MQTT backs
+// off, the config portal still answers once Wi-Fi is gone too, and a learn
+// started before the outage times out on schedule, so the learner takes a
+// new one when the broker is back.
+//
+// Runs in real time (about 30 s): the Wi-Fi join windows and the learning
+// timeout are the firmware's own.
+//
+//   pio test -e test-native -f test_broker_refused
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <NativeSim.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <unity.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "App.h"
+#include "Config.h"
+
+namespace {
+
+// IrLearner::kLearningTimeoutMs.
+constexpr uint32_t kLearnTimeoutMs = 15000;
+// A connect that blocked for MQTT_CONNECT_TIMEOUT_MS would show up here.
+constexpr uint32_t kMaxStepGapMs = 250;
+constexpr uint32_t kRefusedWithWifiMs = 6000;
+constexpr uint32_t kOnlineWithinMs = 20000;
+// Directed join, scan, stored credentials and fallback SSID windows.
+constexpr uint32_t kPortalWithinMs = 35000;
+
+const String kNodePrefix = String("iot/nodes/") + NODE_ID + "/";
+const String kStatusTopic = kNodePrefix + "status";
+const String kLearnResultTopic = kNodePrefix + "tv/learn";
+
+std::atomic<bool> setupDone{false};
+
+// Network task side: gaps between steps, and one call from the test thread.
+std::atomic<bool> measuring{false};
+std::atomic<uint32_t> lastStepMs{0};
+std::atomic<uint32_t> maxStepGapMs{0};
+std::atomic<uint32_t> steps{0};
+std::mutex callMutex;
+std::function<void()> pendingCall;
+
+std::vector<NativeSim::Message> published;
+
+void onNetworkStep() {
+  const uint32_t now = millis();
+  const uint32_t last = lastStepMs.exchange(now);
+  if (measuring && last != 0 && now - last > maxStepGapMs) {
+    maxStepGapMs = now - last;
+  }
+  ++steps;
+  std::lock_guard<std::mutex> lock(callMutex);
+  if (pendingCall) {
+    pendingCall();
+    pendingCall = nullptr;
+  }
+}
+
+// Runs `call` from the network task, which alone may touch the simulated
+// radio, broker and portal, and waits for it.
+void onNetworkTask(std::function<void()> call) {
+  {
+    std::lock_guard<std::mutex> lock(callMutex);
+    pendingCall = std::move(call);
+  }
+  for (;;) {
+    delay(1);
+    std::lock_guard<std::mutex> lock(callMutex);
+    if (!pendingCall) return;
+  }
+}
+
+void startMeasuring() {
+  maxStepGapMs = 0;
+  lastStepMs = 0;
+  measuring = true;
+}
+
+// Waits up to `timeoutMs` for a message on `topic` whose payload contains
+// `text`, looking only at messages published from `since` on.
+bool waitForPublish(const String &topic, const char *text, uint32_t timeoutMs,
+                    size_t since) {
+  const uint32_t startedAt = millis();
+  for (;;) {
+    for (NativeSim::Message &message : NativeSim::takePublished()) {
+      published.push_back(message);
+    }
+    for (size_t i = since; i < published.size(); ++i) {
+      if (published[i].topic == topic &&
+          published[i].payload.indexOf(text) >= 0) {
+        return true;
+      }
+    }
+    if (millis() - startedAt >= timeoutMs) return false;
+    delay(5);
+  }
+}
+
+void publishLearn(const char *key) {
+  const String payload =
+      String(R"({"cmd":"learn","device":"tv","key":")") + key + "\"}";
+  onNetworkTask([payload]() {
+    NativeSim::publishToNode(kNodePrefix + "ir/learn/cmd", payload);
+  });
+}
+
+void loopTask(void *) {
+  setupApp();
+  setupDone = true;
+  for (;;) loopApp();
+}
+
+uint32_t firstLearnAt = 0;
+uint32_t connectsWhileRefused = 0;
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() { measuring = false; }
+
+void test_node_comes_online() {
+  TEST_ASSERT_TRUE(waitForPublish(kStatusTopic, "online", kOnlineWithinMs, 0));
+  delay(200);  // subscriptions follow the status message
+  publishLearn("POWER");
+  firstLearnAt = millis();
+  delay(200);
+}
+
+void test_refused_broker_does_not_stall_the_network_task() {
+  const uint32_t connectsBefore = NativeSim::brokerConnects();
+  const size_t seen = published.size();
+  onNetworkTask([]() { NativeSim::setBrokerReachable(false); });
+  startMeasuring();
+  const uint32_t stepsBefore = steps;
+  delay(kRefusedWithWifiMs);
+
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kMaxStepGapMs, maxStepGapMs);
+  TEST_ASSERT_GREATER_THAN_UINT32(kRefusedWithWifiMs / kMaxStepGapMs,
+                                  steps - stepsBefore);
+  // Backing off: one attempt at once, then 0.5-1 s, 1-2 s and 2-4 s
+  // apart, so 3 or 4 within kRefusedWithWifiMs.
+  connectsWhileRefused = NativeSim::brokerConnects() - connectsBefore;
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3, connectsWhileRefused);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, connectsWhileRefused);
+  TEST_ASSERT_FALSE(waitForPublish(kStatusTopic, "online", 0, seen));
+}
+
+void test_portal_answers_while_the_broker_refuses() {
+  onNetworkTask([]() { NativeSim::setWifiAvailable(false); });
+  startMeasuring();
+  const uint32_t connectsBefore = NativeSim::brokerConnects();
+  const uint32_t startedAt = millis();
+  int status = 0;
+  String body;
+  while (status != 200 && millis() - startedAt < kPortalWithinMs) {
+    delay(250);
+    onNetworkTask([&status, &body]() {
+      body = NativeSim::http("GET", "/status", status);
+    });
+  }
+  TEST_ASSERT_EQUAL_INT(200, status);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(kMaxStepGapMs, maxStepGapMs);
+  // No link, no connects.
+  TEST_ASSERT_EQUAL_UINT32(connectsBefore, NativeSim::brokerConnects());
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, body.c_str()));
+  TEST_ASSERT_FALSE(doc["connected"].as<bool>());
+  TEST_ASSERT_FALSE(doc["mqtt"]["connected"].as<bool>());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(connectsWhileRefused,
+                                      doc["mqtt"]["failures"].as<uint32_t>());
+}
+
+void test_learning_timed_out_during_the_outage() {
+  while (millis() - firstLearnAt < kLearnTimeoutMs + 500) delay(50);
+  const size_t seen = published.size();
+  onNetworkTask([]() {
+    NativeSim::setWifiAvailable(true);
+    NativeSim::setBrokerReachable(true);
+  });
+  TEST_ASSERT_TRUE(
+      waitForPublish(kStatusTopic, "online", kOnlineWithinMs, seen));
+
+  // Still learning POWER would answer "busy" instead of listening.
+  publishLearn("MUTE");
+  delay(200);
+  NativeSim::injectIrReceive(decode_type_t::NEC, 0x20DFD02F, 32);
+  TEST_ASSERT_TRUE(waitForPublish(kLearnResultTopic, "\"MUTE\"", 2000, seen));
+  TEST_ASSERT_FALSE(waitForPublish(kLearnResultTopic, "busy", 0, seen));
+  TEST_ASSERT_TRUE(waitForPublish(kLearnResultTopic, "\"ok\"", 0, seen));
+}
+
+int main() {
+  NativeSim::setSerialEcho(false);
+  NativeSim::AccessPoint ap;
+  ap.ssid = WIFI_SSID;
+  ap.password = WIFI_PASSWORD;
+  NativeSim::addAccessPoint(ap);
+  // A node that has joined before: the stack kept the credentials.
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD, 0, nullptr, false);
+  NativeSim::setNetworkTick(onNetworkStep);
+  xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, nullptr, 1, nullptr, 1);
+  while (!setupDone) delay(1);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_node_comes_online);
+  RUN_TEST(test_refused_broker_does_not_stall_the_network_task);
+  RUN_TEST(test_portal_answers_while_the_broker_refuses);
+  RUN_TEST(test_learning_timed_out_during_the_outage);
+  const int failures = UNITY_END();
+  fflush(stdout);
+  // Firmware tasks never return; skip static destructors they may still use.
+  _Exit(failures);
+}
@@ -0,0 +1,233 @@
+// Microbenchmark of the compile-time codeset lookup (CodesetIndex, KeyIds)
+// against the linear scans the controllers used before it. The table has
+// the TV codeset's layout: 31 remotes, brand-specific ones first, then the
+// brand-less 1001..1015 entries, each with the LG remote's key names.
+//
+// Both paths must agree on every (remote, key); the hashed one must not be
+// slower. Timings are printed per press (remote + key lookup):
+//
+//   pio test -e test-native -f test_codeset_lookup -v
+
+#include <Arduino.h>
+#include <IRremoteESP8266.h>
+#include <unity.h>
+
+#include "CodesetIndex.h"
+#include "KeyId.h"
+
+namespace {
+
+struct KeyCommand {
+  const char *key;
+  decode_type_t protocol;
+  uint64_t value;
+  uint16_t nbits;
+};
+
+struct RemoteConfig {
+  const char *brand;
+  const char *type;
+  uint16_t index;
+  const KeyCommand *commands;
+  size_t commandCount;
+};
+
+constexpr KeyCommand kCommands[] = {
+    {"POWER", decode_type_t::NEC, 0x20DF10EF, 32},
+    {"MUTE", decode_type_t::NEC, 0x20DF906F, 32},
+    {"VOL_UP", decode_type_t::NEC, 0x20DF40BF, 32},
+    {"VOL_DOWN", decode_type_t::NEC, 0x20DFC03F, 32},
+    {"CH_UP", decode_type_t::NEC, 0x20DF00FF, 32},
+    {"CH_DOWN", decode_type_t::NEC, 0x20DF807F, 32},
+    {"TV_AV", decode_type_t::NEC, 0x20DFD02F, 32},
+    {"MENU", decode_type_t::NEC, 0x20DFC23D, 32},
+    {"EXIT", decode_type_t::NEC, 0x20DFDA25, 32},
+    {"UP", decode_type_t::NEC, 0x20DF02FD, 32},
+    {"DOWN", decode_type_t::NEC, 0x20DF827D, 32},
+    {"LEFT", decode_type_t::NEC, 0x20DFE01F, 32},
+    {"RIGHT", decode_type_t::NEC, 0x20DF609F, 32},
+    {"OK", decode_type_t::NEC, 0x20DF22DD, 32},
+    {"BACK", decode_type_t::NEC, 0x20DF14EB, 32},
+    {"HOME", decode_type_t::NEC, 0x20DF3EC1, 32},
+    {"MORE", decode_type_t::NEC, 0x20DF55AA, 32},
+    {"DIGIT_0", decode_type_t::NEC, 0x20DF08F7, 32},
+    {"DIGIT_1", decode_type_t::NEC, 0x20DF8877, 32},
+    {"DIGIT_2", decode_type_t::NEC, 0x20DF48B7, 32},
+    {"DIGIT_3", decode_type_t::NEC, 0x20DFC837, 32},
+    {"DIGIT_4", decode_type_t::NEC, 0x20DF28D7, 32},
+    {"DIGIT_5", decode_type_t::NEC, 0x20DFA857, 32},
+    {"DIGIT_6", decode_type_t::NEC, 0x20DF6897, 32},
+    {"DIGIT_7", decode_type_t::NEC, 0x20DFE817, 32},
+    {"DIGIT_8", decode_type_t::NEC, 0x20DF18E7, 32},
+    {"DIGIT_9", decode_type_t::NEC, 0x20DF9867, 32},
+};
+constexpr size_t kCommandCount = sizeof(kCommands) / sizeof(kCommands[0]);
+
+#define REMOTE(brand, index) {brand, "TV", index, kCommands, kCommandCount}
+constexpr RemoteConfig kRemotes[] = {
+    {"", "", 0, kCommands, 0},
+    REMOTE("LG", 1),
+    REMOTE("LG", 2),
+    REMOTE("LG", 3),
+    REMOTE("Samsung", 1),
+    REMOTE("Samsung", 2),
+    REMOTE("Sony", 1),
+    REMOTE("Sony", 2),
+    REMOTE("Sony", 3),
+    REMOTE("Panasonic", 1),
+    REMOTE("Sharp", 1),
+    REMOTE("Mitsubishi", 1),
+    REMOTE("Toshiba", 1),
+    REMOTE("Philips", 1),
+    REMOTE("JVC", 1),
+    REMOTE("Sanyo", 1),
+    REMOTE("", 1001),
+    REMOTE("", 1002),
+    REMOTE("", 1003),
+    REMOTE("", 1004),
+    REMOTE("", 1005),
+    REMOTE("", 1006),
+    REMOTE("", 1007),
+    REMOTE("", 1008),
+    REMOTE("", 1009),
+    REMOTE("", 1010),
+    REMOTE("", 1011),
+    REMOTE("", 1012),
+    REMOTE("", 1013),
+    REMOTE("", 1014),
+    REMOTE("", 1015),
+};
+#undef REMOTE
+constexpr size_t kRemoteCount = sizeof(kRemotes) / sizeof(kRemotes[0]);
+
+constexpr auto kRemoteIndex = CodesetIndex::buildRemoteIndex(kRemotes);
+constexpr auto kKeyIndex = CodesetIndex::buildKeyIndex(kRemotes);
+static_assert(kRemoteIndex.complete && kKeyIndex.complete,
+              "no perfect-hash seed found");
+
+constexpr size_t kPresses = 200000;
+
+// ---- Before: String compares over both tables ------------------------------
+
+const RemoteConfig *scanRemote(const String &brand, const String &type,
+                               uint16_t index) {
+  const RemoteConfig *fallback = nullptr;
+  for (const auto &remote : kRemotes) {
+    bool brandMatch = brand.length() == 0 || remote.brand == nullptr ||
+                      remote.brand[0] == '\0' ||
+                      brand.equalsIgnoreCase(remote.brand);
+    bool typeMatch = remote.type == nullptr || remote.type[0] == '\0' ||
+                     type.equalsIgnoreCase(remote.type);
+    bool indexMatch = remote.index == 0 || index == 0 || remote.index == index;
+    if (brandMatch && typeMatch && indexMatch) {
+      if (fallback == nullptr) fallback = &remote;
+      if ((remote.brand != nullptr && brand.equalsIgnoreCase(remote.brand)) ||
+          (remote.index != 0 && remote.index == index)) {
+        return &remote;
+      }
+    }
+  }
+  return fallback;
+}
+
+const KeyCommand *scanKey(const RemoteConfig *remote, const String &key) {
+  if (remote == nullptr) return nullptr;
+  for (size_t i = 0; i < remote->commandCount; ++i) {
+    if (key.equalsIgnoreCase(remote->commands[i].key)) {
+      return &remote->commands[i];
+    }
+  }
+  return nullptr;
+}
+
+// ---- After: what the controllers do now ------------------------------------
+
+const RemoteConfig *hashRemote(const String &brand, const String &type,
+                               uint16_t index) {
+  return CodesetIndex::findRemote(kRemoteIndex, kRemotes, brand.c_str(),
+                                  type.c_str(), index);
+}
+
+const KeyCommand *hashKey(const RemoteConfig *remote, const char *key) {
+  return CodesetIndex::findKey(kKeyIndex, kRemotes, remote,
+                               KeyIds::find(key));
+}
+
+uint32_t nsPerPress(uint32_t startedUs) {
+  return static_cast<uint32_t>((micros() - startedUs) * 1000ULL / kPresses);
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_hashed_lookup_matches_scan() {
+  for (const RemoteConfig &entry : kRemotes) {
+    const String brands[] = {entry.brand, String(entry.brand) + "x", ""};
+    for (const String &brand : brands) {
+      String lower = brand;
+      lower.toLowerCase();
+      const String types[] = {"TV", "tv", "", "STB"};
+      const uint16_t indexes[] = {entry.index, 0, 7};
+      for (const String &type : types) {
+        for (uint16_t index : indexes) {
+          TEST_ASSERT_TRUE(scanRemote(brand, type, index) ==
+                           hashRemote(brand, type, index));
+          TEST_ASSERT_TRUE(scanRemote(lower, type, index) ==
+                           hashRemote(lower, type, index));
+        }
+      }
+    }
+    for (size_t c = 0; c < kCommandCount; ++c) {
+      String key = kCommands[c].key;
+      TEST_ASSERT_TRUE(scanKey(&entry, key) == hashKey(&entry, key.c_str()));
+      key.toLowerCase();
+      TEST_ASSERT_TRUE(scanKey(&entry, key) == hashKey(&entry, key.c_str()));
+    }
+    TEST_ASSERT_NULL(hashKey(&entry, "NO_SUCH_KEY"));
+  }
+}
+
+void test_hashed_lookup_is_faster_than_scan() {
+  // Rotate through every remote and key; the scan's cost grows with both
+  // positions, the hashed path's does not.
+  String brands[kRemoteCount];
+  String keys[kCommandCount];
+  for (size_t r = 0; r < kRemoteCount; ++r) brands[r] = kRemotes[r].brand;
+  for (size_t c = 0; c < kCommandCount; ++c) keys[c] = kCommands[c].key;
+  const String type = "TV";
+  const KeyCommand *volatile sink = nullptr;
+
+  uint32_t t0 = micros();
+  for (size_t i = 0; i < kPresses; ++i) {
+    const RemoteConfig &remote = kRemotes[1 + i % (kRemoteCount - 1)];
+    sink = scanKey(scanRemote(brands[&remote - kRemotes], type, remote.index),
+                   keys[i % kCommandCount]);
+  }
+  const uint32_t scanNs = nsPerPress(t0);
+
+  t0 = micros();
+  for (size_t i = 0; i < kPresses; ++i) {
+    const RemoteConfig &remote = kRemotes[1 + i % (kRemoteCount - 1)];
+    sink = hashKey(hashRemote(brands[&remote - kRemotes], type, remote.index),
+                   keys[i % kCommandCount].c_str());
+  }
+  const uint32_t hashNs = nsPerPress(t0);
+  (void)sink;
+
+  char line[96];
+  snprintf(line, sizeof(line), "per press: scan %lu ns, hashed %lu ns",
+           static_cast<unsigned long>(scanNs),
+           static_cast<unsigned long>(hashNs));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN_UINT32(scanNs, hashNs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hashed_lookup_matches_scan);
+  RUN_TEST(test_hashed_lookup_is_faster_than_scan);
+  return UNITY_END();
+}
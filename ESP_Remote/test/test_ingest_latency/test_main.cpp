@@ -0,0 +1,137 @@
+// Command ingest must not wait for the IR LED: while a 10-digit channel is
+// still going out (one frame plus a 120 ms gap per digit), further commands
+// are parsed, routed and queued as fast as on an idle transmitter.
+//
+//   pio test -e test-native -f test_ingest_latency
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <NativeSim.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "IrTransmitter.h"
+#include "Log.h"
+#include "devices/TvController.h"
+
+namespace {
+
+constexpr const char *kChannel =
+    R"({"cmd":"channel","channel":"1234567890","brand":"LG","type":"TV",)"
+    R"("index":1})";
+constexpr const char *kVolumeUp =
+    R"({"cmd":"key","key":"VOLUME_UP","brand":"LG","type":"TV","index":1})";
+constexpr size_t kDigits = 10;
+constexpr uint32_t kDigitGapMs = 120;  // TvController's kChannelGapMs
+constexpr size_t kSamples = 5;
+// Spread over the first half of the channel so every sample lands while
+// digits are still queued.
+constexpr uint32_t kSampleSpacingMs = 100;
+// Well under one digit gap: an ingest that waited for the transmitter even
+// once would take kDigitGapMs.
+constexpr uint32_t kIngestBudgetUs = 10000;
+constexpr uint32_t kSendTimeoutMs = 5000;
+
+IrTransmitter ir(IR_LED_PIN);
+TvController tv(NODE_ID, ir);
+
+// The same steps App.cpp runs for a message on <device>/cmd.
+uint32_t ingestUs(const char *json) {
+  const uint32_t t0 = micros();
+  JsonDocument doc;
+  deserializeJson(doc, json);
+  JsonDocument state;
+  tv.handleCommand(doc.as<JsonObjectConst>(), state);
+  return micros() - t0;
+}
+
+bool waitForSent(uint32_t sent) {
+  const uint32_t startedAt = millis();
+  while (ir.stats().sent < sent) {
+    if (millis() - startedAt > kSendTimeoutMs) return false;
+    delay(1);
+  }
+  return true;
+}
+
+void waitForIdle() {
+  TEST_ASSERT_TRUE(waitForSent(ir.stats().enqueued));
+  delay(kDigitGapMs + 30);  // the last frame's gap
+  NativeSim::takeIrFrames();
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_channel_digits_are_queued_not_sent() {
+  const IrTransmitter::Stats before = ir.stats();
+  TEST_ASSERT_LESS_THAN_UINT32(kIngestBudgetUs, ingestUs(kChannel));
+  const IrTransmitter::Stats queued = ir.stats();
+  TEST_ASSERT_EQUAL_UINT32(before.enqueued + kDigits, queued.enqueued);
+  TEST_ASSERT_LESS_THAN_UINT32(before.sent + kDigits, queued.sent);
+  waitForIdle();
+}
+
+void test_ingest_stays_flat_while_channel_is_sent() {
+  std::vector<uint32_t> idle;
+  for (size_t i = 0; i < kSamples; ++i) {
+    const uint32_t sent = ir.stats().enqueued + 1;
+    idle.push_back(ingestUs(kVolumeUp));
+    TEST_ASSERT_TRUE(waitForSent(sent));
+    delay(kSampleSpacingMs);
+  }
+  waitForIdle();
+
+  const uint32_t channelSent = ir.stats().enqueued + kDigits;
+  ingestUs(kChannel);
+  std::vector<uint32_t> busy;
+  for (size_t i = 0; i < kSamples; ++i) {
+    delay(kSampleSpacingMs);
+    TEST_ASSERT_LESS_THAN_MESSAGE(channelSent, ir.stats().sent,
+                                  "channel finished before the sample");
+    busy.push_back(ingestUs(kVolumeUp));
+  }
+  waitForIdle();
+
+  const uint32_t idleMax = *std::max_element(idle.begin(), idle.end());
+  const uint32_t busyMax = *std::max_element(busy.begin(), busy.end());
+  char line[96];
+  snprintf(line, sizeof(line), "ingest max: idle %lu us, busy %lu us",
+           static_cast<unsigned long>(idleMax),
+           static_cast<unsigned long>(busyMax));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN_UINT32(kIngestBudgetUs, busyMax);
+  TEST_ASSERT_LESS_THAN_UINT32(idleMax + kIngestBudgetUs, busyMax);
+}
+
+void test_keys_follow_the_channel_in_order() {
+  ingestUs(kChannel);
+  delay(kSampleSpacingMs);
+  ingestUs(kVolumeUp);
+  TEST_ASSERT_TRUE(waitForSent(ir.stats().enqueued));
+
+  const std::vector<NativeSim::IrFrame> frames = NativeSim::takeIrFrames();
+  TEST_ASSERT_EQUAL_size_t(kDigits + 1, frames.size());
+  for (size_t i = 1; i < frames.size(); ++i) {
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(frames[i - 1].atMs + kDigitGapMs,
+                                        frames[i].atMs);
+  }
+  waitForIdle();
+}
+
+int main() {
+  Log::begin();
+  ir.begin();
+  tv.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_channel_digits_are_queued_not_sent);
+  RUN_TEST(test_ingest_stays_flat_while_channel_is_sent);
+  RUN_TEST(test_keys_follow_the_channel_in_order);
+  return UNITY_END();
+}
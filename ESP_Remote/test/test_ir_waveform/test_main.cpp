@@ -0,0 +1,208 @@
+// IrWaveform::encode() against the mark/space list IRsend puts on the LED.
+// The reference below replays what IRremoteESP8266 2.8.6 does for each
+// protocol: the ir_*.cpp tick constants and the sendGeneric() arguments of
+// sendNEC(), sendSAMSUNG(), sendSony(), sendPanasonic64() and sendJVC().
+//
+//   pio test -e test-native -f test_ir_waveform
+
+#include <unity.h>
+
+#include <vector>
+
+#include "IrWaveform.h"
+
+namespace {
+
+// What IRsend::mark()/space() leave on the pin; back-to-back spaces (or
+// marks) are one longer pulse.
+class Recorder {
+ public:
+  void mark(uint32_t us) { add(true, us); }
+  void space(uint32_t us) {
+    if (!out.empty()) add(false, us);
+  }
+
+  std::vector<uint32_t> out;
+
+ private:
+  void add(bool isMark, uint32_t us) {
+    if (us == 0) return;
+    if (!out.empty() && (out.size() % 2 == 1) == isMark) {
+      out.back() += us;
+    } else {
+      out.push_back(us);
+    }
+  }
+};
+
+// IRsend::sendGeneric() with a minimum message length, MSB first.
+void sendGeneric(Recorder &ir, uint32_t hdrMark, uint32_t hdrSpace,
+                 uint32_t oneMark, uint32_t oneSpace, uint32_t zeroMark,
+                 uint32_t zeroSpace, uint32_t footerMark, uint32_t gap,
+                 uint32_t mesgTime, uint64_t data, uint16_t nbits,
+                 uint16_t repeat) {
+  for (uint16_t r = 0; r <= repeat; ++r) {
+    uint32_t elapsed = hdrMark + hdrSpace + footerMark;
+    ir.mark(hdrMark);
+    ir.space(hdrSpace);
+    for (uint16_t bit = nbits; bit > 0; --bit) {
+      const bool one = (data >> (bit - 1)) & 1ULL;
+      ir.mark(one ? oneMark : zeroMark);
+      ir.space(one ? oneSpace : zeroSpace);
+      elapsed += one ? oneMark + oneSpace : zeroMark + zeroSpace;
+    }
+    ir.mark(footerMark);
+    ir.space(elapsed + gap > mesgTime ? gap : mesgTime - elapsed);
+  }
+}
+
+// ir_NEC.h
+constexpr uint32_t kNecTick = 560;
+void sendNEC(Recorder &ir, uint64_t data, uint16_t nbits) {
+  const uint32_t minCommandLength = 193 * kNecTick;
+  const uint32_t minGap =
+      minCommandLength - (16 + 8 + 32 * (1 + 3) + 1) * kNecTick;
+  sendGeneric(ir, 16 * kNecTick, 8 * kNecTick, kNecTick, 3 * kNecTick,
+              kNecTick, kNecTick, kNecTick, minGap, minCommandLength, data,
+              nbits, 0);
+}
+
+// ir_Samsung.cpp
+constexpr uint32_t kSamsungTick = 560;
+void sendSAMSUNG(Recorder &ir, uint64_t data, uint16_t nbits) {
+  sendGeneric(ir, 8 * kSamsungTick, 8 * kSamsungTick, kSamsungTick,
+              3 * kSamsungTick, kSamsungTick, kSamsungTick, kSamsungTick,
+              48 * kSamsungTick, 193 * kSamsungTick, data, nbits, 0);
+}
+
+// ir_Sony.cpp: kSonyMinRepeat extra frames.
+constexpr uint32_t kSonyTick = 200;
+void sendSony(Recorder &ir, uint64_t data, uint16_t nbits) {
+  sendGeneric(ir, 12 * kSonyTick, 3 * kSonyTick, 6 * kSonyTick,
+              3 * kSonyTick, 3 * kSonyTick, 3 * kSonyTick, 0, 50 * kSonyTick,
+              225 * kSonyTick, data, nbits, 2);
+}
+
+// ir_Panasonic.cpp
+constexpr uint32_t kPanasonicTick = 432;
+void sendPanasonic64(Recorder &ir, uint64_t data, uint16_t nbits) {
+  const uint32_t minCommandLength = 378 * kPanasonicTick;
+  const uint32_t minGap =
+      minCommandLength - (8 + 4 + 48 * (1 + 3) + 1) * kPanasonicTick;
+  sendGeneric(ir, 8 * kPanasonicTick, 4 * kPanasonicTick, kPanasonicTick,
+              3 * kPanasonicTick, kPanasonicTick, kPanasonicTick,
+              kPanasonicTick, minGap, minCommandLength, data, nbits, 0);
+}
+
+// ir_JVC.cpp: the header goes out once, ahead of sendGeneric().
+constexpr uint32_t kJvcTick = 75;
+void sendJVC(Recorder &ir, uint64_t data, uint16_t nbits) {
+  const uint32_t rptLength = 800 * kJvcTick;
+  const uint32_t minGap =
+      rptLength - (112 + 56 + 16 * (7 + 23) + 7) * kJvcTick;
+  ir.mark(112 * kJvcTick);
+  ir.space(56 * kJvcTick);
+  sendGeneric(ir, 0, 0, 7 * kJvcTick, 23 * kJvcTick, 7 * kJvcTick,
+              7 * kJvcTick, 7 * kJvcTick, minGap, rptLength, data, nbits, 0);
+}
+
+uint32_t total(const std::vector<uint32_t> &durations) {
+  uint32_t sum = 0;
+  for (uint32_t us : durations) sum += us;
+  return sum;
+}
+
+void expectSame(decode_type_t protocol, uint64_t value, uint16_t nbits,
+                void (*send)(Recorder &, uint64_t, uint16_t)) {
+  Recorder reference;
+  send(reference, value, nbits);
+  IrPulseTrain train;
+  TEST_ASSERT_TRUE(IrWaveform::encode(protocol, value, nbits, train));
+  TEST_ASSERT_EQUAL_size_t(reference.out.size(), train.durations.size());
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(reference.out.data(), train.durations.data(),
+                                 reference.out.size());
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_nec_matches_irsend() {
+  const uint64_t values[] = {0x20DF10EF, 0x20DF40BF, 0, 0xFFFFFFFF};
+  for (uint64_t value : values) {
+    expectSame(decode_type_t::NEC, value, 32, sendNEC);
+  }
+  IrPulseTrain train;
+  IrWaveform::encode(decode_type_t::NEC, 0x20DF10EF, 32, train);
+  TEST_ASSERT_EQUAL_size_t(2 + 2 * 32 + 2, train.durations.size());
+  TEST_ASSERT_EQUAL_UINT32(8960, train.durations[0]);
+  TEST_ASSERT_EQUAL_UINT32(4480, train.durations[1]);
+  TEST_ASSERT_EQUAL_UINT32(108080, total(train.durations));
+  TEST_ASSERT_EQUAL_UINT32(38000, train.carrierHz);
+  TEST_ASSERT_EQUAL_UINT8(33, train.dutyPercent);
+}
+
+void test_samsung_matches_irsend() {
+  const uint64_t values[] = {0xE0E040BF, 0xE0E0E01F, 0, 0xFFFFFFFF};
+  for (uint64_t value : values) {
+    expectSame(decode_type_t::SAMSUNG, value, 32, sendSAMSUNG);
+  }
+}
+
+void test_sony_matches_irsend() {
+  const uint64_t values[] = {0xA90, 0x490, 0xFFF, 0};
+  for (uint64_t value : values) {
+    expectSame(decode_type_t::SONY, value, 12, sendSony);
+  }
+  expectSame(decode_type_t::SONY, 0x2D0F, 15, sendSony);
+  expectSame(decode_type_t::SONY, 0x1E3F0, 20, sendSony);
+
+  IrPulseTrain train;
+  IrWaveform::encode(decode_type_t::SONY, 0xA90, 12, train);
+  TEST_ASSERT_EQUAL_UINT32(3 * 45000, total(train.durations));
+  TEST_ASSERT_EQUAL_UINT32(40000, train.carrierHz);
+}
+
+void test_panasonic_matches_irsend() {
+  const uint64_t values[] = {0x40040100BCBD, 0x400401000405, 0,
+                             0xFFFFFFFFFFFF};
+  for (uint64_t value : values) {
+    expectSame(decode_type_t::PANASONIC, value, 48, sendPanasonic64);
+  }
+  IrPulseTrain train;
+  IrWaveform::encode(decode_type_t::PANASONIC, 0x40040100BCBD, 48, train);
+  TEST_ASSERT_EQUAL_UINT32(36700, train.carrierHz);
+  TEST_ASSERT_EQUAL_UINT8(50, train.dutyPercent);
+}
+
+void test_jvc_matches_irsend() {
+  const uint64_t values[] = {0xC5E8, 0xC5F8, 0, 0xFFFF};
+  for (uint64_t value : values) {
+    expectSame(decode_type_t::JVC, value, 16, sendJVC);
+  }
+  // The 60 ms repeat window starts after the 12.6 ms header.
+  IrPulseTrain train;
+  IrWaveform::encode(decode_type_t::JVC, 0xC5E8, 16, train);
+  TEST_ASSERT_EQUAL_UINT32(8400 + 4200 + 60000, total(train.durations));
+}
+
+void test_unsupported_input_is_refused() {
+  IrPulseTrain train;
+  TEST_ASSERT_FALSE(IrWaveform::encode(decode_type_t::RC5, 0x1, 13, train));
+  TEST_ASSERT_TRUE(train.durations.empty());
+  TEST_ASSERT_FALSE(IrWaveform::encode(decode_type_t::NEC, 0x1, 0, train));
+  TEST_ASSERT_FALSE(IrWaveform::encode(decode_type_t::NEC, 0x1, 65, train));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_nec_matches_irsend);
+  RUN_TEST(test_samsung_matches_irsend);
+  RUN_TEST(test_sony_matches_irsend);
+  RUN_TEST(test_panasonic_matches_irsend);
+  RUN_TEST(test_jvc_matches_irsend);
+  RUN_TEST(test_unsupported_input_is_refused);
+  return UNITY_END();
+}
@@ -0,0 +1,185 @@
+// Allocation budget of the key-press dispatch path: once a command is
+// parsed, resolving the key (aliases, learned codes, codeset tables) and
+// queuing its frame must not touch the heap.
+//
+// operator new is counted on the test's thread only, so the IR task's own
+// work does not show up; the host String is std::string, so String
+// temporaries are counted too. ArduinoJson allocates through the JsonArena
+// given to the documents, whose heap fallbacks are checked separately.
+//
+//   pio test -e test-native -f test_key_allocations
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <new>
+
+#include "IrTransmitter.h"
+#include "JsonArena.h"
+#include "devices/DvdController.h"
+#include "devices/FanController.h"
+#include "devices/ProjectorController.h"
+#include "devices/StbController.h"
+#include "devices/TvController.h"
+
+namespace {
+
+thread_local bool countAllocations = false;
+uint32_t allocationCount = 0;
+
+}  // namespace
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(size_t size) {
+  if (countAllocations) ++allocationCount;
+  if (void *ptr = malloc(size != 0 ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+#pragma GCC diagnostic pop
+
+namespace {
+
+// Per press, after each controller's first one: that one reads the learned
+// keys from NVS (LearnedKeyTable loads on first use), once per boot.
+constexpr uint32_t kAllocationBudget = 0;
+constexpr size_t kPresses = 8;
+constexpr uint32_t kSendTimeoutMs = 2000;
+
+IrTransmitter ir(IR_LED_PIN);
+TvController tv(NODE_ID, ir);
+StbController stb(NODE_ID, ir);
+DvdController dvd(NODE_ID, ir);
+FanController fan(NODE_ID, ir);
+ProjectorController projector(NODE_ID, ir);
+
+alignas(8) uint8_t arenaBuffer[MQTT_JSON_ARENA_BYTES];
+JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+
+struct Press {
+  DeviceController *controller;
+  const char *json;
+};
+
+// What the Android app sends; some names go through the alias tables.
+const Press kKeyCommands[] = {
+    {&tv, R"({"cmd":"key","key":"VOLUME_UP","brand":"LG","type":"TV",)"
+          R"("index":1})"},
+    {&tv, R"({"cmd":"key","key":"channel_down","brand":"Samsung",)"
+          R"("type":"TV","index":1})"},
+    {&tv, R"({"cmd":"key","key":"POWER","brand":"Sony","type":"TV",)"
+          R"("index":2})"},
+    {&stb, R"({"cmd":"key","key":"OK","brand":"Samsung","type":"STB",)"
+           R"("index":1})"},
+    {&dvd, R"({"cmd":"key","key":"PLAY_PAUSE","brand":"LG","type":"DVD",)"
+           R"("index":1})"},
+    {&fan, R"({"cmd":"key","key":"SPEED_UP","brand":"LG","type":"FAN",)"
+           R"("index":1})"},
+    {&projector, R"({"cmd":"key","key":"MENU","brand":"InFocus",)"
+                 R"("type":"PROJECTOR","index":1})"},
+};
+
+void waitForIdle() {
+  const uint32_t startedAt = millis();
+  while (ir.stats().sent < ir.stats().enqueued &&
+         millis() - startedAt < kSendTimeoutMs) {
+    delay(1);
+  }
+}
+
+// Allocations made by one handleCommand() on an already parsed message.
+uint32_t allocationsFor(const Press &press, uint32_t &frames) {
+  JsonDocument doc(&arena);
+  TEST_ASSERT_FALSE(deserializeJson(doc, press.json));
+  JsonDocument stateDoc(&arena);
+  const uint32_t enqueuedBefore = ir.enqueued();
+
+  allocationCount = 0;
+  countAllocations = true;
+  press.controller->handleCommand(doc.as<JsonObjectConst>(), stateDoc);
+  countAllocations = false;
+
+  frames = ir.enqueued() - enqueuedBefore;
+  return allocationCount;
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() { waitForIdle(); }
+
+void test_key_commands_do_not_allocate() {
+  uint32_t frames = 0;
+  for (const Press &press : kKeyCommands) allocationsFor(press, frames);
+  waitForIdle();
+
+  const uint32_t fallbacksBefore = arena.stats().heapFallbacks;
+  for (const Press &press : kKeyCommands) {
+    for (size_t i = 0; i < kPresses; ++i) {
+      const uint32_t allocations = allocationsFor(press, frames);
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, frames, press.json);
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(kAllocationBudget, allocations,
+                                       press.json);
+      waitForIdle();
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(fallbacksBefore, arena.stats().heapFallbacks);
+}
+
+void test_key_presses_do_not_allocate() {
+  // The batch command's path: a key name straight to the controller.
+  const char *keys[] = {"VOL_UP", "volume_down", "MUTE", "DIGIT_7", "MENU"};
+  uint32_t frames = 0;
+  allocationsFor(kKeyCommands[0], frames);  // selects the LG remote
+  waitForIdle();
+  for (const char *key : keys) {
+    const uint32_t enqueuedBefore = ir.enqueued();
+    allocationCount = 0;
+    countAllocations = true;
+    const uint8_t sent = tv.sendKeyPresses(key, 3, 0);
+    countAllocations = false;
+    TEST_ASSERT_EQUAL_UINT8(3, sent);
+    TEST_ASSERT_EQUAL_UINT32(enqueuedBefore + 3, ir.enqueued());
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(kAllocationBudget, allocationCount, key);
+    waitForIdle();
+  }
+}
+
+void test_learned_key_press_does_not_allocate() {
+  TEST_ASSERT_TRUE(
+      tv.learnKey("NETFLIX", decode_type_t::NEC, 0x20DF6A95, 32));
+  for (size_t i = 0; i < kPresses; ++i) {
+    const uint32_t enqueuedBefore = ir.enqueued();
+    allocationCount = 0;
+    countAllocations = true;
+    const uint8_t sent = tv.sendKeyPresses("netflix", 1, 0);
+    countAllocations = false;
+    TEST_ASSERT_EQUAL_UINT8(1, sent);
+    TEST_ASSERT_EQUAL_UINT32(enqueuedBefore + 1, ir.enqueued());
+    TEST_ASSERT_EQUAL_UINT32(kAllocationBudget, allocationCount);
+    waitForIdle();
+  }
+}
+
+int main() {
+  ir.begin();
+  tv.begin();
+  stb.begin();
+  dvd.begin();
+  fan.begin();
+  projector.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_key_commands_do_not_allocate);
+  RUN_TEST(test_key_presses_do_not_allocate);
+  RUN_TEST(test_learned_key_press_does_not_allocate);
+  return UNITY_END();
+}
@@ -0,0 +1,224 @@
+// LearnedKeyStore against an in-memory backend: blobs round-trip through
+// a table, corrupt and old (version 1) blobs load the way a reboot would
+// see them, and a burst of learns is written once.
+//
+//   pio test -e test-native -f test_learned_store
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "Crc32.h"
+#include "LearnedKeyStore.h"
+#include "LearnedKeyTable.h"
+
+namespace {
+
+class RamBackend : public LearnedStoreBackend {
+ public:
+  bool read(const char *name, std::vector<uint8_t> &out) override {
+    auto it = blobs.find(name);
+    if (it == blobs.end()) return false;
+    out = it->second;
+    return true;
+  }
+
+  bool write(const char *name, const uint8_t *data, size_t length) override {
+    ++writes;
+    blobs[name].assign(data, data + length);
+    return true;
+  }
+
+  bool erase(const char *name) override { return blobs.erase(name) > 0; }
+
+  std::map<std::string, std::vector<uint8_t>> blobs;
+  uint32_t writes = 0;
+};
+
+RamBackend ram;
+
+// Each test persists under its own name; tables stay tracked by the store
+// for the rest of the run, so they must outlive the test.
+LearnedKeyTable &freshTable(const char *name) {
+  static std::vector<std::unique_ptr<LearnedKeyTable>> tables;
+  tables.push_back(std::unique_ptr<LearnedKeyTable>(new LearnedKeyTable()));
+  tables.back()->persistAs(name);
+  return *tables.back();
+}
+
+std::vector<uint8_t> wideTiming() {
+  std::vector<uint8_t> timing(40);
+  for (size_t i = 0; i < timing.size(); ++i) {
+    timing[i] = static_cast<uint8_t>(i * 7);
+  }
+  return timing;
+}
+
+// A version 1 blob: the version 2 layout without the timing fields.
+std::vector<uint8_t> versionOneBlob() {
+  const std::vector<uint8_t> payload = {
+      5,    'P',  'O',  'W',  'E',  'R',        // name
+      0x03, 0x00, 0x20, 0x00, 4,                // NEC, 32 bits, 4 bytes
+      0xEF, 0x10, 0xDF, 0x20,                   // 0x20DF10EF
+      4,    'M',  'U',  'T',  'E',              // name
+      0x07, 0x00, 0x20, 0x00, 4,                // SAMSUNG, 32 bits
+      0xF7, 0x0F, 0xE0, 0xE0,                   // 0xE0E00FF7
+  };
+  const uint32_t crc = crc32(payload.data(), payload.size());
+  std::vector<uint8_t> blob = {
+      'L', 'K', 1, 2, static_cast<uint8_t>(payload.size()), 0,
+      static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8),
+      static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 24)};
+  blob.insert(blob.end(), payload.begin(), payload.end());
+  return blob;
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_table_round_trips_through_the_backend() {
+  LearnedKeyTable &learned = freshTable("rt");
+  const std::vector<uint8_t> state = {0x11, 0xDA, 0x27, 0x00, 0xC5,
+                                      0x00, 0x00, 0xD7, 0x11, 0xDA};
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("POWER"), decode_type_t::NEC,
+                                0x20DF10EF, 32));
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("SONY_INPUT"),
+                                decode_type_t::SONY, 0xA50, 12));
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("AC_ON"),
+                                decode_type_t::DAIKIN, 0, 80, state,
+                                wideTiming()));
+  LearnedKeyStore::flushAll();
+  TEST_ASSERT_FALSE(learned.dirty());
+  TEST_ASSERT_EQUAL_size_t(1, ram.blobs.count("rt"));
+
+  std::vector<LearnedKey> loaded;
+  TEST_ASSERT_TRUE(LearnedKeyStore::load("rt", loaded));
+  TEST_ASSERT_EQUAL_size_t(3, loaded.size());
+  TEST_ASSERT_EQUAL_STRING("POWER", KeyIds::name(loaded[0].id));
+  TEST_ASSERT_TRUE(loaded[0].protocol == decode_type_t::NEC);
+  TEST_ASSERT_TRUE(loaded[0].value == 0x20DF10EF);
+  TEST_ASSERT_EQUAL_UINT16(32, loaded[0].nbits);
+  TEST_ASSERT_TRUE(loaded[1].protocol == decode_type_t::SONY);
+  TEST_ASSERT_TRUE(loaded[1].value == 0xA50);
+  TEST_ASSERT_EQUAL_UINT16(12, loaded[1].nbits);
+  TEST_ASSERT_TRUE(loaded[2].protocol == decode_type_t::DAIKIN);
+  TEST_ASSERT_EQUAL_UINT16(80, loaded[2].nbits);
+  TEST_ASSERT_TRUE(loaded[2].raw == state);
+  TEST_ASSERT_NOT_NULL(loaded[2].timing.get());
+  TEST_ASSERT_TRUE(*loaded[2].timing == wideTiming());
+
+  // A table persisted under the same name after a reboot sees the keys.
+  LearnedKeyTable &rebooted = freshTable("rt");
+  TEST_ASSERT_EQUAL_size_t(3, rebooted.size());
+  const LearnedKey *power = rebooted.find(KeyIds::intern("POWER"));
+  TEST_ASSERT_NOT_NULL(power);
+  TEST_ASSERT_TRUE(power->value == 0x20DF10EF);
+  TEST_ASSERT_FALSE(rebooted.dirty());
+}
+
+void test_corrupt_crc_starts_empty() {
+  LearnedKeyTable &learned = freshTable("crc");
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("POWER"), decode_type_t::NEC,
+                                0x20DF10EF, 32));
+  LearnedKeyStore::flushAll();
+  ram.blobs["crc"].back() ^= 0x01;
+
+  const LearnedKeyStore::Stats before = LearnedKeyStore::stats();
+  std::vector<LearnedKey> loaded;
+  TEST_ASSERT_FALSE(LearnedKeyStore::load("crc", loaded));
+  TEST_ASSERT_TRUE(loaded.empty());
+  TEST_ASSERT_EQUAL_UINT32(before.loadErrors + 1,
+                           LearnedKeyStore::stats().loadErrors);
+
+  LearnedKeyTable &rebooted = freshTable("crc");
+  TEST_ASSERT_EQUAL_size_t(0, rebooted.size());
+  TEST_ASSERT_NULL(rebooted.find(KeyIds::intern("POWER")));
+
+  // A truncated blob is refused the same way.
+  std::vector<uint8_t> blob;
+  LearnedKeyStore::encode(learned.entries(), blob);
+  TEST_ASSERT_TRUE(LearnedKeyStore::decode(blob.data(), blob.size(), loaded));
+  TEST_ASSERT_FALSE(
+      LearnedKeyStore::decode(blob.data(), blob.size() - 1, loaded));
+  TEST_ASSERT_TRUE(loaded.empty());
+}
+
+void test_version_one_blob_loads() {
+  ram.blobs["v1"] = versionOneBlob();
+  LearnedKeyTable &learned = freshTable("v1");
+  TEST_ASSERT_EQUAL_size_t(2, learned.size());
+  const LearnedKey *power = learned.find(KeyIds::intern("power"));
+  TEST_ASSERT_NOT_NULL(power);
+  TEST_ASSERT_TRUE(power->protocol == decode_type_t::NEC);
+  TEST_ASSERT_TRUE(power->value == 0x20DF10EF);
+  const LearnedKey *mute = learned.find(KeyIds::intern("MUTE"));
+  TEST_ASSERT_NOT_NULL(mute);
+  TEST_ASSERT_TRUE(mute->protocol == decode_type_t::SAMSUNG);
+  TEST_ASSERT_TRUE(mute->value == 0xE0E00FF7);
+  TEST_ASSERT_NULL(mute->timing.get());
+
+  // The next write upgrades the blob to the current version.
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("MUTE"),
+                                decode_type_t::SAMSUNG, 0xE0E0F00F, 32));
+  LearnedKeyStore::flushAll();
+  TEST_ASSERT_EQUAL_UINT8(2, ram.blobs["v1"][2]);
+  std::vector<LearnedKey> loaded;
+  TEST_ASSERT_TRUE(LearnedKeyStore::load("v1", loaded));
+  TEST_ASSERT_EQUAL_size_t(2, loaded.size());
+  TEST_ASSERT_TRUE(loaded[1].value == 0xE0E0F00F);
+}
+
+void test_burst_of_learns_is_written_once() {
+  LearnedKeyTable &learned = freshTable("burst");
+  const uint32_t writesBefore = ram.writes;
+  const char *keys[] = {"POWER", "MUTE", "VOL_UP", "VOL_DOWN", "MENU"};
+  uint64_t value = 0x20DF0000;
+  for (const char *key : keys) {
+    TEST_ASSERT_TRUE(learned.save(KeyIds::intern(key), decode_type_t::NEC,
+                                  ++value, 32));
+    LearnedKeyStore::loop();
+  }
+  // The app resends an unchanged code with every press.
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("MENU"), decode_type_t::NEC,
+                                value, 32));
+  LearnedKeyStore::loop();
+  TEST_ASSERT_EQUAL_UINT32(writesBefore, ram.writes);
+  TEST_ASSERT_TRUE(learned.dirty());
+
+  delay(IR_LEARNED_WRITE_DELAY_MS + 50);
+  LearnedKeyStore::loop();
+  TEST_ASSERT_EQUAL_UINT32(writesBefore + 1, ram.writes);
+  TEST_ASSERT_FALSE(learned.dirty());
+  LearnedKeyStore::loop();
+  TEST_ASSERT_EQUAL_UINT32(writesBefore + 1, ram.writes);
+
+  std::vector<LearnedKey> loaded;
+  TEST_ASSERT_TRUE(LearnedKeyStore::load("burst", loaded));
+  TEST_ASSERT_EQUAL_size_t(5, loaded.size());
+
+  // Relearning a key with its current code does not dirty the table.
+  TEST_ASSERT_TRUE(learned.save(KeyIds::intern("POWER"), decode_type_t::NEC,
+                                0x20DF0001, 32));
+  TEST_ASSERT_FALSE(learned.dirty());
+}
+
+int main() {
+  LearnedKeyStore::setBackend(&ram);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_table_round_trips_through_the_backend);
+  RUN_TEST(test_corrupt_crc_starts_empty);
+  RUN_TEST(test_version_one_blob_loads);
+  RUN_TEST(test_burst_of_learns_is_written_once);
+  const int failures = UNITY_END();
+  LearnedKeyStore::setBackend(nullptr);
+  return failures;
+}
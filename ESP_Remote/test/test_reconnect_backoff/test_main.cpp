@@ -0,0 +1,167 @@
+// ReconnectBackoff on a fake clock: each delay lands in [cap / 2, cap] as
+// the cap doubles up to the maximum, due() opens on the exact millisecond
+// (also across the millis() wrap), retryInMs() counts down to it, and the
+// attempt budget and succeeded() reset the way ensureMqttConnected() uses
+// them. Same limits as the MQTT reconnect in Config.h.
+//
+//   pio test -e test-native -f test_reconnect_backoff
+
+#include <unity.h>
+
+#include "Config.h"
+#include "ReconnectBackoff.h"
+
+namespace {
+
+constexpr uint32_t kMinMs = MQTT_RECONNECT_MIN_MS;
+constexpr uint32_t kMaxMs = MQTT_RECONNECT_MAX_MS;
+constexpr uint8_t kBudget = MQTT_CONNECT_ATTEMPT_BUDGET;
+
+uint32_t nowMs = 0;
+uint32_t seed = 1;
+
+// Stand-in for random(): any 32-bit value is valid entropy.
+uint32_t nextEntropy() {
+  seed = seed * 1664525u + 1013904223u;
+  return seed;
+}
+
+// The cap of the n-th failure in a row (0-based).
+uint32_t capFor(uint32_t failuresBefore) {
+  uint32_t cap = kMinMs;
+  for (uint32_t i = 0; i < failuresBefore && cap < kMaxMs; ++i) {
+    cap = cap > kMaxMs / 2 ? kMaxMs : cap * 2;
+  }
+  return cap;
+}
+
+// Fails at the current time and moves the clock to when the retry is due.
+void failAndWait(ReconnectBackoff &backoff, uint32_t entropy) {
+  backoff.failed(nowMs, entropy);
+  nowMs += backoff.lastDelayMs();
+}
+
+}  // namespace
+
+void setUp() {
+  nowMs = 100000;
+  seed = 1;
+}
+
+void tearDown() {}
+
+void test_delay_stays_within_half_cap_to_cap() {
+  for (int run = 0; run < 200; ++run) {
+    ReconnectBackoff backoff(kMinMs, kMaxMs, kBudget);
+    for (uint32_t n = 0; n < 12; ++n) {
+      failAndWait(backoff, nextEntropy());
+      const uint32_t cap = capFor(n);
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(cap / 2, backoff.lastDelayMs());
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(cap, backoff.lastDelayMs());
+    }
+    TEST_ASSERT_EQUAL_UINT32(12, backoff.failures());
+  }
+
+  // Both ends are reachable: entropy 0 gives half the cap, cap / 2 gives
+  // the cap itself.
+  ReconnectBackoff low(kMinMs, kMaxMs, kBudget);
+  ReconnectBackoff high(kMinMs, kMaxMs, kBudget);
+  for (uint32_t n = 0; n < 10; ++n) {
+    const uint32_t cap = capFor(n);
+    failAndWait(low, 0);
+    failAndWait(high, cap / 2);
+    TEST_ASSERT_EQUAL_UINT32(cap / 2, low.lastDelayMs());
+    TEST_ASSERT_EQUAL_UINT32(cap, high.lastDelayMs());
+  }
+  TEST_ASSERT_EQUAL_UINT32(kMaxMs, capFor(9));
+}
+
+void test_due_opens_exactly_at_the_delay() {
+  ReconnectBackoff backoff(kMinMs, kMaxMs, kBudget);
+  TEST_ASSERT_TRUE(backoff.due(nowMs));
+  for (uint32_t n = 0; n < 8; ++n) {
+    const uint32_t failedAt = nowMs;
+    backoff.failed(failedAt, nextEntropy());
+    const uint32_t delay = backoff.lastDelayMs();
+    TEST_ASSERT_FALSE(backoff.due(failedAt));
+    TEST_ASSERT_FALSE(backoff.due(failedAt + delay - 1));
+    TEST_ASSERT_TRUE(backoff.due(failedAt + delay));
+    TEST_ASSERT_TRUE(backoff.due(failedAt + delay + 1));
+    nowMs = failedAt + delay;
+  }
+
+  // A failure just before millis() wraps is still due on time.
+  const uint32_t failedAt = 0xFFFFFFFFu - 100;
+  backoff.failed(failedAt, 0);
+  const uint32_t delay = backoff.lastDelayMs();
+  TEST_ASSERT_FALSE(backoff.due(failedAt + delay - 1));
+  TEST_ASSERT_TRUE(backoff.due(failedAt + delay));
+}
+
+void test_retry_in_ms_counts_down_to_the_attempt() {
+  ReconnectBackoff backoff(kMinMs, kMaxMs, kBudget);
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.retryInMs(nowMs));
+  failAndWait(backoff, 0);
+  failAndWait(backoff, 0);
+  const uint32_t failedAt = nowMs;
+  backoff.failed(failedAt, nextEntropy());
+  const uint32_t delay = backoff.lastDelayMs();
+  for (uint32_t elapsed = 0; elapsed < delay; elapsed += 100) {
+    TEST_ASSERT_EQUAL_UINT32(delay - elapsed,
+                             backoff.retryInMs(failedAt + elapsed));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, backoff.retryInMs(failedAt + delay - 1));
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.retryInMs(failedAt + delay));
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.retryInMs(failedAt + delay + 5000));
+}
+
+void test_budget_runs_out_after_the_attempt_budget() {
+  ReconnectBackoff backoff(kMinMs, kMaxMs, kBudget);
+  for (uint8_t n = 1; n < kBudget; ++n) {
+    failAndWait(backoff, nextEntropy());
+    TEST_ASSERT_FALSE(backoff.budgetExhausted());
+  }
+  failAndWait(backoff, nextEntropy());
+  TEST_ASSERT_TRUE(backoff.budgetExhausted());
+  failAndWait(backoff, nextEntropy());
+  TEST_ASSERT_TRUE(backoff.budgetExhausted());
+
+  // Re-resolving the broker starts a new budget but keeps the delay
+  // growing: the streak of failures is not over.
+  backoff.resetBudget();
+  TEST_ASSERT_FALSE(backoff.budgetExhausted());
+  failAndWait(backoff, 0);
+  TEST_ASSERT_EQUAL_UINT32(kBudget + 2, backoff.failures());
+  TEST_ASSERT_EQUAL_UINT32(capFor(kBudget + 1) / 2, backoff.lastDelayMs());
+  for (uint8_t n = 1; n < kBudget; ++n) failAndWait(backoff, 0);
+  TEST_ASSERT_TRUE(backoff.budgetExhausted());
+}
+
+void test_success_resets_the_backoff() {
+  ReconnectBackoff backoff(kMinMs, kMaxMs, kBudget);
+  for (uint32_t n = 0; n < 9; ++n) failAndWait(backoff, nextEntropy());
+  TEST_ASSERT_TRUE(backoff.budgetExhausted());
+  backoff.failed(nowMs, nextEntropy());
+  TEST_ASSERT_FALSE(backoff.due(nowMs));
+
+  backoff.succeeded();
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.failures());
+  TEST_ASSERT_FALSE(backoff.budgetExhausted());
+  TEST_ASSERT_TRUE(backoff.due(nowMs));
+  TEST_ASSERT_EQUAL_UINT32(0, backoff.retryInMs(nowMs));
+
+  // The next failure starts over from the minimum delay.
+  backoff.failed(nowMs, kMinMs / 2);
+  TEST_ASSERT_EQUAL_UINT32(kMinMs, backoff.lastDelayMs());
+  TEST_ASSERT_EQUAL_UINT32(1, backoff.failures());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_delay_stays_within_half_cap_to_cap);
+  RUN_TEST(test_due_opens_exactly_at_the_delay);
+  RUN_TEST(test_retry_in_ms_counts_down_to_the_attempt);
+  RUN_TEST(test_budget_runs_out_after_the_attempt_budget);
+  RUN_TEST(test_success_resets_the_backoff);
+  return UNITY_END();
+}
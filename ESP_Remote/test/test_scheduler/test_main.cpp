@@ -0,0 +1,230 @@
+// Scheduler on a virtual clock: loop() is called exactly at each job's due
+// time (taken from list()), so a job that fires off its due millisecond is
+// drift in the scheduler itself. Covers the TimerHeap order, one-shot
+// order and ties, a month of cron rules in local time (SCHED_TIMEZONE,
+// UTC+7), a rule that never matches, a late loop and a job missed beyond
+// SCHED_LATE_LIMIT_MS.
+//
+//   pio test -e test-native -f test_scheduler
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <time.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "Config.h"
+#include "DeviceManager.h"
+#include "IrTransmitter.h"
+#include "Scheduler.h"
+#include "TimerHeap.h"
+#include "devices/AcController.h"
+#include "devices/TvController.h"
+
+namespace {
+
+// 2026-01-01 00:00:00 UTC, 07:00 local; a Thursday.
+constexpr uint64_t kStartMs = 1767225600000ULL;
+constexpr uint64_t kMinuteMs = 60000;
+constexpr uint64_t kDayMs = 86400000ULL;
+
+struct Fired {
+  uint64_t atMs;
+  std::string topic;
+  std::string payload;
+};
+
+IrTransmitter ir(IR_LED_PIN);
+AcController ac(NODE_ID, ir);
+TvController tv(NODE_ID, ir);
+DeviceManager devices;
+
+uint64_t nowMs = kStartMs;
+std::vector<Fired> fired;
+
+void onFire(const char *topicSuffix, const char *payload, size_t length) {
+  fired.push_back({nowMs, topicSuffix, std::string(payload, length)});
+}
+
+void define(const char *json) {
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  const char *error = nullptr;
+  TEST_ASSERT_TRUE_MESSAGE(
+      Scheduler::define(doc.as<JsonObjectConst>(), nowMs, error), json);
+}
+
+void removeJob(const char *name) {
+  TEST_ASSERT_TRUE(Scheduler::remove(name));
+}
+
+// Earliest "dueMs" in list(); UINT64_MAX when nothing is armed.
+uint64_t nextDueMs() {
+  JsonDocument doc;
+  Scheduler::list(doc.to<JsonArray>());
+  uint64_t earliest = UINT64_MAX;
+  for (JsonObjectConst job : doc.as<JsonArrayConst>()) {
+    if (job["dueMs"].isNull()) continue;
+    const uint64_t due = job["dueMs"].as<uint64_t>();
+    if (due < earliest) earliest = due;
+  }
+  return earliest;
+}
+
+// Steps the clock from due time to due time up to `endMs`.
+void runUntil(uint64_t endMs) {
+  for (uint64_t due = nextDueMs(); due <= endMs; due = nextDueMs()) {
+    TEST_ASSERT_TRUE(due >= nowMs);
+    nowMs = due;
+    Scheduler::loop(nowMs);
+  }
+  nowMs = endMs;
+  Scheduler::loop(nowMs);
+}
+
+bool firedScene(const Fired &entry, const char *scene) {
+  return entry.topic == "scene/run" &&
+         entry.payload.find(std::string("\"") + scene + "\"") !=
+             std::string::npos;
+}
+
+tm localTime(uint64_t ms) {
+  const time_t seconds = static_cast<time_t>(ms / 1000);
+  tm local;
+  localtime_r(&seconds, &local);
+  return local;
+}
+
+}  // namespace
+
+void setUp() { fired.clear(); }
+
+void tearDown() {}
+
+void test_timer_heap_pops_earliest_then_oldest() {
+  TimerHeap<8> heap;
+  heap.push(3, 500);
+  heap.push(1, 100);
+  heap.push(4, 100);
+  heap.push(2, 300);
+  heap.push(5, 100);
+  heap.erase(4);
+  heap.push(6, 50);
+  TEST_ASSERT_EQUAL_size_t(5, heap.size());
+  const uint8_t expected[] = {6, 1, 5, 2, 3};
+  for (uint8_t slot : expected) TEST_ASSERT_EQUAL_UINT8(slot, heap.pop());
+  TEST_ASSERT_EQUAL_size_t(0, heap.size());
+}
+
+void test_one_shots_fire_in_due_order_on_time() {
+  define(R"({"name":"c","inMs":250,"scene":"s3"})");
+  define(R"({"name":"a","inMs":100,"scene":"s1"})");
+  define(R"({"name":"b","inMs":100,"scene":"s2"})");
+  define(R"({"name":"d","at":1767225600.333,"scene":"s4"})");
+  define(R"({"name":"e","inMs":40,"device":"ac",)"
+         R"("command":{"cmd":"power","value":false}})");
+  const uint64_t definedAt = nowMs;
+  runUntil(definedAt + 1000);
+
+  TEST_ASSERT_EQUAL_size_t(5, fired.size());
+  TEST_ASSERT_EQUAL_STRING("ac/cmd", fired[0].topic.c_str());
+  TEST_ASSERT_TRUE(fired[0].atMs == definedAt + 40);
+  // Same due time: definition order.
+  TEST_ASSERT_TRUE(firedScene(fired[1], "s1"));
+  TEST_ASSERT_TRUE(firedScene(fired[2], "s2"));
+  TEST_ASSERT_TRUE(fired[1].atMs == definedAt + 100);
+  TEST_ASSERT_TRUE(fired[2].atMs == definedAt + 100);
+  TEST_ASSERT_TRUE(firedScene(fired[3], "s3"));
+  TEST_ASSERT_TRUE(fired[3].atMs == definedAt + 250);
+  TEST_ASSERT_TRUE(firedScene(fired[4], "s4"));
+  TEST_ASSERT_TRUE(fired[4].atMs == kStartMs + 333);
+  TEST_ASSERT_EQUAL_UINT32(0, Scheduler::stats().lateMaxMs);
+  TEST_ASSERT_TRUE(nextDueMs() == UINT64_MAX);
+}
+
+void test_cron_fires_on_the_minute_for_a_month() {
+  const uint64_t startMs = nowMs;
+  define(R"({"name":"q","cron":"*/15 8-9 * * *","scene":"q"})");
+  define(R"({"name":"n","cron":"30 2 * * 1-5","device":"ac",)"
+         R"("command":{"cmd":"power","value":false}})");
+  runUntil(startMs + 31 * kDayMs);
+
+  size_t quarters = 0;
+  size_t nights = 0;
+  for (const Fired &entry : fired) {
+    // Zero drift: every run lands on its minute, to the millisecond.
+    TEST_ASSERT_TRUE(entry.atMs % kMinuteMs == 0);
+    const tm local = localTime(entry.atMs);
+    if (firedScene(entry, "q")) {
+      ++quarters;
+      TEST_ASSERT_TRUE(local.tm_hour == 8 || local.tm_hour == 9);
+      TEST_ASSERT_EQUAL_INT(0, local.tm_min % 15);
+    } else if (entry.topic == "ac/cmd") {
+      ++nights;
+      TEST_ASSERT_EQUAL_INT(2, local.tm_hour);
+      TEST_ASSERT_EQUAL_INT(30, local.tm_min);
+      TEST_ASSERT_TRUE(local.tm_wday >= 1 && local.tm_wday <= 5);
+    } else {
+      TEST_FAIL_MESSAGE(entry.topic.c_str());
+    }
+  }
+  // 31 days from 07:00 on Jan 1st: 8 quarter-hours a day, and the 21
+  // weekday nights from Jan 2nd to Feb 1st.
+  TEST_ASSERT_EQUAL_size_t(31 * 8, quarters);
+  TEST_ASSERT_EQUAL_size_t(21, nights);
+  TEST_ASSERT_EQUAL_UINT32(0, Scheduler::stats().lateMaxMs);
+  removeJob("n");
+}
+
+void test_cron_rule_that_never_fires_is_refused() {
+  JsonDocument doc;
+  deserializeJson(doc, R"({"name":"x","cron":"0 12 30 2 *","scene":"x"})");
+  const char *error = nullptr;
+  TEST_ASSERT_FALSE(
+      Scheduler::define(doc.as<JsonObjectConst>(), nowMs, error));
+  TEST_ASSERT_NOT_NULL(error);
+}
+
+void test_late_loop_does_not_shift_the_rule() {
+  const uint64_t due = nextDueMs();
+  nowMs = due + 5000;
+  Scheduler::loop(nowMs);
+  TEST_ASSERT_EQUAL_size_t(1, fired.size());
+  TEST_ASSERT_TRUE(firedScene(fired[0], "q"));
+  TEST_ASSERT_EQUAL_UINT32(5000, Scheduler::stats().lateMaxMs);
+  // Re-armed from its own due time: still the next quarter-hour.
+  const uint64_t next = nextDueMs();
+  TEST_ASSERT_TRUE(next % kMinuteMs == 0);
+  TEST_ASSERT_TRUE((next - due) % (15 * kMinuteMs) == 0);
+  removeJob("q");
+}
+
+void test_job_missed_past_the_limit_is_skipped() {
+  const uint32_t missedBefore = Scheduler::stats().missed;
+  define(R"({"name":"z","inMs":10,"scene":"z"})");
+  nowMs += 10 + SCHED_LATE_LIMIT_MS + 1;
+  Scheduler::loop(nowMs);
+  TEST_ASSERT_EQUAL_size_t(0, fired.size());
+  TEST_ASSERT_EQUAL_UINT32(missedBefore + 1, Scheduler::stats().missed);
+  TEST_ASSERT_TRUE(nextDueMs() == UINT64_MAX);
+}
+
+int main() {
+  devices.setTopicPrefix((String("iot/nodes/") + NODE_ID + "/").c_str());
+  devices.registerController(ac);
+  devices.registerController(tv);
+  devices.begin();
+  Scheduler::begin(devices, onFire);
+  Scheduler::loop(nowMs);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_timer_heap_pops_earliest_then_oldest);
+  RUN_TEST(test_one_shots_fire_in_due_order_on_time);
+  RUN_TEST(test_cron_fires_on_the_minute_for_a_month);
+  RUN_TEST(test_cron_rule_that_never_fires_is_refused);
+  RUN_TEST(test_late_loop_does_not_shift_the_rule);
+  RUN_TEST(test_job_missed_past_the_limit_is_skipped);
+  return UNITY_END();
+}